@@ -0,0 +1,256 @@
+/*
+ * File: arena.c
+ * Author: Iztok Savnik
+ *
+ * Description: Slab allocator of the objects of a set-trie index. The
+ * objects are allocated by bumping a pointer in large slabs and are
+ * freed all at once with the arena.
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#include "arena.h"
+
+/* Current arena of a thread. */
+static __thread arena *arena_cur = NULL;
+
+/* Last id given to an arena. */
+static long arena_ids = 0;
+
+/*
+  Create an empty arena; the first slab is allocated on demand. The id
+  of an arena is never reused, so it identifies the arena even after
+  its memory is given to a new one.
+ */
+arena *arena_create()
+{
+   arena *a = (arena *)malloc(sizeof(arena));
+   if (a == NULL) {
+      printf("error: (arena_create) malloc failed.\n");
+      return NULL;
+   }
+   memset(a, 0, sizeof(arena));
+   a->id = __sync_add_and_fetch(&arena_ids, 1);
+   return a;
+
+} /*arena_create*/
+
+/*
+  Free the arena a with all its slabs and the arenas joined to it.
+  The registered cleanup functions are called first.
+ */
+void arena_free( arena *a )
+{
+   while (a != NULL) {
+      arena *an = a->next;
+      for (arena_cleanup *c = a->cleanup; c != NULL; c = c->next)
+	 c->fn(c->p);
+      arena_slab *s = a->slab;
+      while (s != NULL) {
+	 arena_slab *sn = s->next;
+	 free(s);
+	 s = sn;
+      }
+      if (arena_cur == a)
+	 arena_cur = NULL;
+      free(a);
+      a = an;
+   }
+
+} /*arena_free*/
+
+/*
+  Allocate a new slab with at least size bytes. A slab for a large
+  object is put behind the current slab, so that the free space of the
+  current slab is still used.
+ */
+static arena_slab *arena_add_slab( arena *a, size_t size )
+{
+   boolean large = (size > ARENA_SLAB_SIZE / 4);
+   size_t len = large ? size : ARENA_SLAB_SIZE;
+   arena_slab *s = (arena_slab *)malloc(sizeof(arena_slab) + len);
+   if (s == NULL) {
+      printf("error: (arena_add_slab) malloc failed.\n");
+      return NULL;
+   }
+   s->size = len;
+   s->used = 0;
+   if (large && (a->slab != NULL)) {
+      s->next = a->slab->next;
+      a->slab->next = s;
+   } else {
+      s->next = a->slab;
+      a->slab = s;
+   }
+   a->nslabs++;
+   a->bytes += sizeof(arena_slab) + len;
+   return s;
+
+} /*arena_add_slab*/
+
+/*
+  Allocate size bytes from the arena a. The memory is not cleared.
+ */
+void *arena_alloc( arena *a, size_t size )
+{
+   arena_slab *s = a->slab;
+   size = (size + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1);
+   if ((s == NULL) || (s->used + size > s->size)) {
+      if ((s = arena_add_slab(a, size)) == NULL)
+	 return NULL;
+   }
+   void *p = (char *)(s + 1) + s->used;
+   s->used += size;
+   return p;
+
+} /*arena_alloc*/
+
+/*
+  Return the index of the size class of size bytes.
+ */
+static int arena_class( size_t size )
+{
+   int c = 0;
+   while (((size_t)1 << (c + ARENA_MIN_SHIFT)) < size)
+      c++;
+   return c;
+
+} /*arena_class*/
+
+/*
+  Return the number of bytes of the size class of size bytes.
+ */
+size_t arena_class_size( size_t size )
+{
+   return (size_t)1 << (arena_class(size) + ARENA_MIN_SHIFT);
+
+} /*arena_class_size*/
+
+/*
+  Allocate an array of size bytes in its size class. A released array
+  of the class is reused if there is one.
+ */
+void *arena_alloc_class( arena *a, size_t size )
+{
+   int c = arena_class(size);
+   if (c >= ARENA_CLASSES) {
+      printf("error: (arena_alloc_class) size %lu too large.\n", (unsigned long)size);
+      return NULL;
+   }
+   void *p = a->free[c];
+   if (p != NULL) {
+      a->free[c] = *(void **)p;
+      return p;
+   }
+   return arena_alloc(a, (size_t)1 << (c + ARENA_MIN_SHIFT));
+
+} /*arena_alloc_class*/
+
+/*
+  Put the array p of size bytes, allocated by arena_alloc_class(), on
+  the free list of its class.
+ */
+void arena_release( arena *a, void *p, size_t size )
+{
+   if (p == NULL)
+      return;
+   int c = arena_class(size);
+   *(void **)p = a->free[c];
+   a->free[c] = p;
+
+} /*arena_release*/
+
+/*
+  Grow the array p of size bytes to nsize bytes; the contents are
+  copied and the old array is released. An array stays in place if
+  its class is large enough.
+ */
+void *arena_grow( arena *a, void *p, size_t size, size_t nsize )
+{
+   if ((p != NULL) && (arena_class(nsize) == arena_class(size)))
+      return p;
+   void *q = arena_alloc_class(a, nsize);
+   if ((q != NULL) && (p != NULL)) {
+      memcpy(q, p, (size < nsize) ? size : nsize);
+      arena_release(a, p, size);
+   }
+   return q;
+
+} /*arena_grow*/
+
+/*
+  Register the function fn to be called with p when a is freed.
+ */
+boolean arena_defer( arena *a, void (*fn)( void *p ), void *p )
+{
+   arena_cleanup *c = (arena_cleanup *)arena_alloc(a, sizeof(arena_cleanup));
+   if (c == NULL)
+      return false;
+   c->fn = fn;
+   c->p = p;
+   c->next = a->cleanup;
+   a->cleanup = c;
+   return true;
+
+} /*arena_defer*/
+
+/*
+  Join the arena b to a; b is freed together with a. The free lists
+  of b are kept by b, so objects of b still grow within b.
+ */
+void arena_join( arena *a, arena *b )
+{
+   while (a->next != NULL)
+      a = a->next;
+   a->next = b;
+
+} /*arena_join*/
+
+/*
+  Number of slabs of a and the arenas joined to it.
+ */
+long arena_slabs( arena *a )
+{
+   long n = 0;
+   for (; a != NULL; a = a->next)
+      n += a->nslabs;
+   return n;
+
+} /*arena_slabs*/
+
+/*
+  Bytes of the slabs of a and the arenas joined to it.
+ */
+size_t arena_bytes( arena *a )
+{
+   size_t n = 0;
+   for (; a != NULL; a = a->next)
+      n += a->bytes;
+   return n;
+
+} /*arena_bytes*/
+
+/*
+  Make a the current arena of the calling thread; NULL selects
+  malloc. Return the previous current arena.
+ */
+arena *arena_use( arena *a )
+{
+   arena *prev = arena_cur;
+   arena_cur = a;
+   return prev;
+
+} /*arena_use*/
+
+/*
+  Return the current arena of the calling thread.
+ */
+arena *arena_current()
+{
+   return arena_cur;
+
+} /*arena_current*/
@@ -0,0 +1,87 @@
+/*
+ * File: arena.h
+ * Author: Iztok Savnik
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+  An arena is a list of large slabs from which the objects of an index
+  (set2 nodes, connectors and their arrays of links, blocks of skip
+  lists) are allocated by bumping a pointer. An object is never freed
+  by itself; the whole index is disposed by freeing its slabs.
+
+  Arrays that grow (the links of a connector, the skip slots of a
+  block) are allocated in power-of-two size classes. A released array
+  is put on the free list of its class and reused by the next request
+  of the same class, so a connector that doubles its array does not
+  leave the old arrays behind.
+
+  Each thread has its current arena. set2_alloc() and con_alloc() take
+  their memory from the current arena of the calling thread and fall
+  back to malloc when there is none. Arenas of the threads of a
+  parallel build are joined into the arena of the index.
+
+  The functions that release memory other than slabs (e.g. a set_arena
+  with the sets of an index) are registered with arena_defer() and
+  called when the arena is freed.
+*/
+
+/* Size of a slab; larger objects get a slab of their own. */
+#define ARENA_SLAB_SIZE   (1 << 20)
+
+/* Alignment of objects allocated from an arena. */
+#define ARENA_ALIGN       16
+
+/* Size classes are 2^ARENA_MIN_SHIFT .. 2^(ARENA_MIN_SHIFT+ARENA_CLASSES-1). */
+#define ARENA_MIN_SHIFT   4
+#define ARENA_CLASSES     28
+
+/* A slab of memory; objects are allocated after the header. */
+typedef struct arena_slab {
+   struct arena_slab *next;   // previously allocated slab
+   size_t size;               // bytes after the header
+   size_t used;               // bytes allocated
+   size_t pad;                // keeps the data aligned
+} arena_slab;
+
+/* A function called when an arena is freed. */
+typedef struct arena_cleanup {
+   struct arena_cleanup *next;
+   void (*fn)( void *p );
+   void *p;
+} arena_cleanup;
+
+typedef struct arena {
+   arena_slab *slab;                 // current slab; others are linked
+   void *free[ARENA_CLASSES];        // released arrays by size class
+   arena_cleanup *cleanup;           // functions called by arena_free()
+   struct arena *next;               // joined arenas
+   long id;                          // unique among all arenas created
+   long nslabs;                      // number of slabs
+   size_t bytes;                     // bytes of slabs
+} arena;
+
+/*---------------------- Exported functions ------------------------------*/
+
+extern arena*  arena_create();
+extern void    arena_free( arena *a );
+extern void*   arena_alloc( arena *a, size_t size );
+extern void*   arena_alloc_class( arena *a, size_t size );
+extern void    arena_release( arena *a, void *p, size_t size );
+extern void*   arena_grow( arena *a, void *p, size_t size, size_t nsize );
+extern size_t  arena_class_size( size_t size );
+extern boolean arena_defer( arena *a, void (*fn)( void *p ), void *p );
+extern void    arena_join( arena *a, arena *b );
+extern long    arena_slabs( arena *a );
+extern size_t  arena_bytes( arena *a );
+
+extern arena*  arena_use( arena *a );
+extern arena*  arena_current();
+
+#endif /*ARENA_H*/
@@ -85,14 +85,11 @@ static int migrate_to_skiplist(askiplist* asl) {
     cskiplist* sl = csl_create();
     if (!sl) return 0;
     
-    /* Copy all items from array to skiplist */
-    for (int i = 0; i < asl->store.arr.count; i++) {
-        int rc = csl_insert(sl, asl->store.arr.items[i].key, 
-                           asl->store.arr.items[i].val);
-        if (rc < 0) {
-            csl_free(sl, NULL);
-            return 0;
-        }
+    /* Copy all items from array to skiplist (sorted: one merge) */
+    if (csl_insert_sorted(sl, (const csl_kv*)asl->store.arr.items,
+                          (size_t)asl->store.arr.count) < 0) {
+        csl_free(sl, NULL);
+        return 0;
     }
     
     /* Rebuild skip pointers for optimal search */
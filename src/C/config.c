@@ -9,6 +9,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <malloc.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 #include "config.h"
 
 /* Files */
@@ -54,6 +60,26 @@ char *strtrm(char *S)
   return S;
 }/*strtrm*/
 
+/*
+  Number of threads for parallel work: the value of the environment
+  variable SET2_THREADS, or the number of processors.
+*/
+int num_threads()
+{
+  char *ev = getenv("SET2_THREADS");
+  if ((ev != NULL) && (atoi(ev) > 0))
+    return atoi(ev);
+
+#ifdef _WIN32
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0) ? (int)n : 1;
+#endif
+}/*num_threads*/
+
 /*
   Cut last number from the end of the tring.
 */
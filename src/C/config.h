@@ -55,6 +55,7 @@ extern int ST_do_get_supseteq;
 extern void init_params( int parc, char *param[] );
 extern int  interpret( char opt[] );
 extern char *strtrm( char *S );
+extern int  num_threads();
 
 
 #endif /* CONFIG_H */
@@ -17,6 +17,7 @@
 //#include "qesa.h"
 //#include "set2.h"
 #include "connector.h"
+#include "arena.h"
 
 /* Local variables */
 
@@ -25,7 +26,12 @@
 */
 connector *con_alloc()
 {
-   connector *sp = (connector *)malloc(sizeof(connector));
+   arena *a = arena_current();
+   connector *sp = NULL;
+   if (a != NULL)
+      sp = (connector *)arena_alloc(a, sizeof(connector));
+   else
+      sp = (connector *)malloc(sizeof(connector));
    if (sp == NULL) {
       printf("error: (con_create) mealloc failed.\n");
       return NULL;
@@ -34,7 +40,11 @@ connector *con_alloc()
    sp->length = INIT_CONNECT_SIZE;
    sp->last = -1;
    sp->cursor = -1;
-   sp->seq = (link *)malloc(sp->length * sizeof(link));
+   sp->mem = a;
+   if (a != NULL)
+      sp->seq = (link *)arena_alloc_class(a, sp->length * sizeof(link));
+   else
+      sp->seq = (link *)malloc(sp->length * sizeof(link));
    if (sp->seq == NULL) {
       printf("error: (con_create) mealloc failed.\n");
       return NULL;
@@ -44,10 +54,13 @@ connector *con_alloc()
 } /*con_alloc*/
 
 /*
-  Dispose a sequence of key-value pairs.
+  Dispose a sequence of key-value pairs. A connector of an arena is
+  freed with its arena.
  */
 boolean con_free(connector *sp)
 {
+   if (sp->mem != NULL)
+      return true;
    free(sp->seq);
    free(sp);
    return true;
@@ -283,19 +296,34 @@ boolean con_eos(connector *sp)
 } /*con_eos*/
 
 
+/*
+  Double the length of the array of links of sp.
+ */
+static boolean con_grow( connector *sp )
+{
+   int len = sp->length * 2;
+   if (sp->mem != NULL)
+      sp->seq = (link *)arena_grow(sp->mem, sp->seq, sp->length * sizeof(link), len * sizeof(link));
+   else
+      sp->seq = (link *)realloc(sp->seq, len * sizeof(link));
+   if (sp->seq == NULL) {
+      printf("error: (con_grow) realloc failed.\n");
+      return false;
+   }
+   sp->length = len;
+   return true;
+
+} /*con_grow*/
+
 /*
   Add a new key-value pair at the end of a sequence.
  */
-boolean con_write( connector *sp, int key, void* val )
+boolean con_write( connector *sp, int key, con_val val )
 {
    // check for space
    if (sp->last >= (sp->length - 1)) {
-      sp->length *= 2;
-      sp->seq = (link *)realloc(sp->seq, sp->length * sizeof(link));
-      if (sp->seq == NULL) {
-         printf("error: (con_insert) realloc failed.\n");
+      if (!con_grow(sp))
          return false;
-      }
    }
 
    // insert key-value pair at the end of sequence
@@ -308,16 +336,12 @@ boolean con_write( connector *sp, int key, void* val )
 /*
   Insert a key-value pair into an ordered sequence of key-value pairs.
 */
-boolean con_insert( connector *sp, int key, void* pvl )
+boolean con_insert( connector *sp, int key, con_val pvl )
 {
    // last_ix always points to the last accessed element
    if (sp->last >= (sp->length - 1)) {
-      sp->length *= 2;
-      sp->seq = (link *)realloc(sp->seq, sp->length * sizeof(link));
-      if (sp->seq == NULL) {
-         printf("error: (con_insert) realloc failed.\n");
+      if (!con_grow(sp))
          return false;
-      }
    }
  
    // ix is assigned last, then last++
@@ -10,24 +10,38 @@
 
 /* Global constants, types, ... */ 
 
+#include <stdint.h>
+
 /* Declaration of circular typedef references. */
 //typedef struct set2_node set2_node;
 /* Removed: kv store of arbitrarily objects ref by (void *) 18/7/24
 
+/* A value of a link is a pointer, or a 32-bit handle of a set2 node
+   when compiled with SET2_HANDLES (see set2.h); a link then takes 8
+   bytes instead of 16. */
+#ifdef SET2_HANDLES
+typedef uint32_t con_val;
+#else
+typedef void *con_val;
+#endif
+
 /* A type kv_pair is a structure composed of two fields. */
 typedef struct link {
   int key;           /* a key is an element of a set */
-  void *val;         /* value is of type (void *) */
+  con_val val;       /* value is a pointer or a handle */
 } link;
 
 /* A connector is a structure composed of a sequence of key-value
    pairs sorted by keys. The length of a sequence and the index of the
-   currently accessed key-value pair are included. */
+   currently accessed key-value pair are included. A connector created
+   while an arena is current is allocated in the arena and grows
+   within it; it is freed with the arena. */
 typedef struct connector {
   int length;        // length of the array seq
   int last;          // inx of last occupied element
   int cursor;        // indx of the last pair 
   link *seq;         // sorted array of links 
+  struct arena *mem; // arena of the connector, or NULL (malloc)
 } connector;
 
 /*---------------------------- Exported functions ------------------------------
@@ -49,8 +63,8 @@ extern link*   con_current( connector* sp );
 extern link*   con_peek_prev( connector* sp );
 extern link*   con_read_prev( connector* sp );
 extern boolean con_eos( connector *sp );
-extern boolean con_write( connector *sp, int key, void* val );
-extern boolean con_insert( connector *sp, int key, void* val );
+extern boolean con_write( connector *sp, int key, con_val val );
+extern boolean con_insert( connector *sp, int key, con_val val );
 
 extern int  con_get_cursor( connector *sp );
 extern void con_set_cursor( connector *sp, int cur );
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "config.h"
 #include "connector.h"
 #include "cskiplist.h"
+#include "arena.h"
 
 /* Adapter: implement connector API atop cskiplist. Maintains semantics used by set2 code.
    The conn_impl pointer is stored in the seq field (cast to link*) since the sorted-array
@@ -18,6 +20,21 @@
  */
 #define CON_SCRATCH 8
 
+/* Layout of the blocks of the connectors' skip lists (CSL_LAYOUT_*); e.g.
+ * -DCON_CSL_LAYOUT=CSL_LAYOUT_EYTZINGER builds set2-csl-eyt. */
+#ifndef CON_CSL_LAYOUT
+#define CON_CSL_LAYOUT CSL_LAYOUT_SORTED
+#endif
+
+/* Links hold what the skip list stores: 32-bit handles of set2 nodes
+ * need 32-bit skip-list values. */
+#if defined(SET2_HANDLES) && !defined(CSL_VAL32)
+#error "SET2_HANDLES requires CSL_VAL32"
+#endif
+#if defined(CSL_VAL32) && !defined(SET2_HANDLES)
+#error "CSL_VAL32 requires SET2_HANDLES"
+#endif
+
 typedef struct conn_impl {
     cskiplist* sl;
     csl_iter it;                /* iterator state for forward reads */
@@ -28,25 +45,58 @@ typedef struct conn_impl {
 /* Access the impl pointer stored in the seq field */
 #define IMPL(sp) ((conn_impl*)(sp)->seq)
 
-static link* make_link(conn_impl* im, int key, void* val) {
+static link* make_link(conn_impl* im, int key, con_val val) {
     link* l = &im->scratch[im->scratch_ix++ % CON_SCRATCH];
     l->key = key; l->val = val; return l;
 }
 
+/* Skip list memory from an arena: arrays of power-of-two sizes (items,
+ * skip slots) come from its size classes and are reused when released;
+ * other objects are bumped from a slab and stay there until the arena
+ * is freed. */
+static void* con_arena_alloc(void* ctx, size_t size) {
+    arena* a = (arena*)ctx;
+    void* p = (arena_class_size(size) == size) ? arena_alloc_class(a, size)
+                                               : arena_alloc(a, size);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+static void con_arena_release(void* ctx, void* p, size_t size) {
+    if (arena_class_size(size) == size) arena_release((arena*)ctx, p, size);
+}
+
+/* A connector created while an arena is current lives in the arena
+ * together with its skip list; it is freed with the arena. */
 connector* con_alloc() {
-    connector* c = (connector*)calloc(1, sizeof(connector));
-    if (!c) return NULL;
-    conn_impl* im = (conn_impl*)calloc(1, sizeof(conn_impl));
-    if (!im) { free(c); return NULL; }
-    im->sl = csl_create();
-    if (!im->sl) { free(im); free(c); return NULL; }
+    arena* a = arena_current();
+    connector* c;
+    conn_impl* im;
+    if (a) {
+        csl_allocator m = { con_arena_alloc, con_arena_release, a };
+        c = (connector*)con_arena_alloc(a, sizeof(connector));
+        im = (conn_impl*)con_arena_alloc(a, sizeof(conn_impl));
+        if (!c || !im) return NULL;
+        im->sl = csl_create_with_allocator(CSL_BLOCK_CAP, &m);
+        if (!im->sl) return NULL;
+    } else {
+        c = (connector*)calloc(1, sizeof(connector));
+        if (!c) return NULL;
+        im = (conn_impl*)calloc(1, sizeof(conn_impl));
+        if (!im) { free(c); return NULL; }
+        im->sl = csl_create();
+        if (!im->sl) { free(im); free(c); return NULL; }
+    }
+    csl_set_layout(im->sl, CON_CSL_LAYOUT);
     c->length = 0; c->last = -1; c->cursor = -1;
     c->seq = (link*)im; /* store impl in seq field */
+    c->mem = a;
     return c;
 }
 
 boolean con_free(connector* sp) {
     if (!sp) return false;
+    if (sp->mem) return true; /* freed with its arena */
     csl_free(IMPL(sp)->sl, NULL);
     free(IMPL(sp));
     free(sp);
@@ -76,9 +126,11 @@ link* con_lookup(connector* sp, int key) {
 
 boolean con_member(connector* sp, int key) { return con_lookup(sp, key) != NULL; }
 
-boolean con_open(connector* sp) { if (!sp) return false; IMPL(sp)->it.b = IMPL(sp)->sl->head; IMPL(sp)->it.idx = 0; IMPL(sp)->it.eytzinger = IMPL(sp)->sl->eytzinger; sp->cursor = -1; sp->last = IMPL(sp)->sl->size - 1; return true; }
+boolean con_open(connector* sp) { if (!sp) return false; csl_iter_rewind(IMPL(sp)->sl, &IMPL(sp)->it); sp->cursor = -1; sp->last = IMPL(sp)->sl->size - 1; return true; }
 
-boolean con_open_at(connector* sp, int key) { if (!sp) return false; int exact=0; int found = csl_iter_seek(IMPL(sp)->sl, key, &IMPL(sp)->it, &exact); if (!found) { IMPL(sp)->it.b = NULL; IMPL(sp)->it.idx = -1; sp->cursor = -1; return 0; } if (!csl_iter_prev(IMPL(sp)->sl, &IMPL(sp)->it)) { IMPL(sp)->it.b = IMPL(sp)->sl->head; IMPL(sp)->it.idx = 0; } sp->cursor = -1; return exact; }
+/* The set-trie searches move forward through a connector, so the seek
+ * starts from where the cursor is (finger search). */
+boolean con_open_at(connector* sp, int key) { if (!sp) return false; int exact=0; int found = csl_iter_seek_from(IMPL(sp)->sl, &IMPL(sp)->it, key, &exact); if (!found) { IMPL(sp)->it.b = NULL; IMPL(sp)->it.idx = -1; sp->cursor = -1; return 0; } if (!csl_iter_prev(IMPL(sp)->sl, &IMPL(sp)->it)) csl_iter_rewind(IMPL(sp)->sl, &IMPL(sp)->it); sp->cursor = -1; return exact; }
 
 link* con_peek(connector* sp) { if (!sp) return NULL; csl_iter it = IMPL(sp)->it; /* copy */ csl_iter_next(&it); csl_kv* kv = csl_iter_get(&it); return kv ? make_link(IMPL(sp), kv->key, kv->val) : NULL; }
 
@@ -92,9 +144,9 @@ link* con_read_prev(connector* sp) { if (!sp) return NULL; if (!csl_iter_prev(IM
 
 boolean con_eos(connector* sp) { if (!sp) return true; csl_iter tmp = IMPL(sp)->it; return !csl_iter_next(&tmp); }
 
-boolean con_write(connector* sp, int key, void* val) { if (!sp) return false; int r = csl_append(IMPL(sp)->sl, key, val); if (r < 0) return false; sp->last = IMPL(sp)->sl->size - 1; return true; }
+boolean con_write(connector* sp, int key, con_val val) { if (!sp) return false; int r = csl_append(IMPL(sp)->sl, key, val); if (r < 0) return false; sp->last = IMPL(sp)->sl->size - 1; return true; }
 
-boolean con_insert(connector* sp, int key, void* val) { if (!sp) return false; int r = csl_insert(IMPL(sp)->sl, key, val); if (r < 0) return false; sp->last = IMPL(sp)->sl->size - 1; return true; }
+boolean con_insert(connector* sp, int key, con_val val) { if (!sp) return false; int r = csl_insert(IMPL(sp)->sl, key, val); if (r < 0) return false; sp->last = IMPL(sp)->sl->size - 1; return true; }
 
 int con_get_cursor(connector* sp) { return sp ? sp->cursor : -1; }
 void con_set_cursor(connector* sp, int cur) { if (sp) sp->cursor = cur; }
@@ -2,6 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <pthread.h>
+#ifdef _WIN32
+  #include <malloc.h>     /* _aligned_malloc, _aligned_free */
+#endif
 
 /*-----------------------------------------------------------------------------
  * SSE2 SIMD support for parallel key comparisons within blocks.
@@ -9,10 +13,15 @@
  * When CSL_USE_SIMD is enabled (default on x86 with SSE2), we use 128-bit
  * SIMD registers to compare 4 keys simultaneously during intra-block search.
  *
- * The csl_kv struct is {int key, void* val} = 8 bytes per entry, so keys
- * are at stride-2-int positions.  We gather 4 keys from 4 consecutive
- * entries into one __m128i register using _mm_set_epi32, then compare all
- * 4 against the search key in a single instruction.
+ * The csl_kv struct is {int key, void* val}: 16 bytes per entry on 64-bit
+ * targets (4 bytes of padding after the key), 8 bytes with -DCSL_VAL32.
+ * We gather 4 keys from 4 consecutive entries into one __m128i register,
+ * then compare all 4 against the search key in a single instruction.
+ * With 8-byte entries the keys are at stride-2-int positions, so the 4
+ * entries are loaded as two vectors and the keys are picked by a shuffle.
+ * Blocks in the struct-of-arrays layout keep their keys dense, so 4 keys
+ * are one unaligned load (lb_sse2).  Wider kernels (AVX2, AVX-512) are
+ * chosen at run time, see "Block search kernels" below.
  *
  * Compile with: gcc -O3 -msse2 (or just -O3 on any modern x86)
  * Disable with: -DCSL_USE_SIMD=0
@@ -43,54 +52,217 @@
 
 /* Items per cache line for Eytzinger prefetch distance (64-byte cache line). */
 #define EYT_ITEMS_PER_CL (64 / (int)sizeof(csl_kv))
+#define EYT_KEYS_PER_CL  (64 / (int)sizeof(csl_key_t))
+
+/* A SoA search narrows the block by halving down to this many keys (one
+ * cache line) and counts the keys below the search key with vectors. */
+#define CSL_SOA_WINDOW 16
 
 /* Heuristic limits used by the TLB-aware block-cap helpers. */
 #define CSL_MIN_BLOCK_CAP 4
 #define CSL_TLB_AWARE_MAX_BLOCK_BYTES (16 * 1024)
 
-/* Allocate a block with runtime-sized item and skip arrays. */
-static csl_block* blk_alloc_with_cap(int item_cap, int skip_slots) {
-    csl_block* b = (csl_block*)calloc(1, sizeof(csl_block));
-    if (!b) return NULL;
+/* Zeroed memory of a skip list: its allocator, or cache-line aligned
+ * memory of the C library (released with csl_mem_release). */
+static void* csl_mem_alloc(const csl_allocator* mem, size_t size) {
+    void* p;
 
-    b->items = (item_cap > 0)
-        ? (csl_kv*)calloc((size_t)item_cap, sizeof(csl_kv))
-        : NULL;
-    b->next = (csl_block**)calloc((size_t)skip_slots, sizeof(csl_block*));
+    if (mem->alloc) return mem->alloc(mem->ctx, size);
+#ifdef _WIN32
+    p = _aligned_malloc(size, CSL_CACHE_LINE);
+#else
+    if (posix_memalign(&p, CSL_CACHE_LINE, size) != 0) p = NULL;
+#endif
+    if (p) memset(p, 0, size);
+    return p;
+}
 
-    if ((item_cap > 0 && !b->items) || !b->next) {
-        free(b->items);
-        free(b->next);
-        free(b);
-        return NULL;
-    }
+static void csl_mem_release(const csl_allocator* mem, void* p, size_t size) {
+    if (!p) return;
+    if (mem->alloc) { if (mem->release) mem->release(mem->ctx, p, size); }
+#ifdef _WIN32
+    else _aligned_free(p);
+#else
+    else free(p);
+#endif
+}
+
+/* Bytes of the item storage of a block with item_cap items. */
+static size_t blk_items_bytes(int soa, int item_cap) {
+    if (soa)
+        return (size_t)CSL_SOA_KEY_SLOTS(item_cap) * sizeof(csl_key_t)
+             + (size_t)item_cap * sizeof(csl_val_t);
+    return (size_t)item_cap * sizeof(csl_kv);
+}
+
+/* Bytes of a tower slot: the link, with CSL_FAT_SKIPS its key, and its width. */
+#define CSL_SLOT_BYTES (sizeof(csl_block*) + CSL_FAT_SKIPS * sizeof(csl_key_t) + sizeof(uint32_t))
+
+/* Offset of the items in the chunk of a block with a tower of height
+ * slots; 16-byte aligned for the vector loads of the search.  The keys[]
+ * of a SoA block start a cache line, so an S-tree node is one line. */
+static size_t blk_items_offset(int height, int soa) {
+    size_t align = soa ? CSL_CACHE_LINE : 16;
+    size_t off = sizeof(csl_block) + (size_t)height * CSL_SLOT_BYTES;
+    return (off + align - 1) & ~(align - 1);
+}
+
+size_t csl_block_bytes(int item_cap, int height, int soa) {
+    return blk_items_offset(height, soa) + blk_items_bytes(soa, item_cap);
+}
+
+/* Bytes of the chunk of b. */
+static size_t blk_bytes(const csl_block* b) {
+    return csl_block_bytes(b->item_cap, b->skip_alloc, b->keys != NULL);
+}
+
+/* Allocate a block with item_cap items and a tower of height skip slots
+ * in one chunk; the items are laid out as csl_kv or, with soa, as
+ * keys[] and vals[]. */
+static csl_block* blk_alloc(cskiplist* sl, int item_cap, int height, int soa) {
+    csl_block* b = (csl_block*)csl_mem_alloc(&sl->mem,
+                                             csl_block_bytes(item_cap, height, soa));
+    if (!b) return NULL;
 
     b->min_key = INT_MIN;
     b->count = 0;
     b->item_cap = item_cap;
-    b->skip_alloc = skip_slots;
+    b->skip_alloc = height;
+    b->nbuf = 0;
     b->prev = NULL;
+    b->items = NULL;
+    b->keys = NULL;
+    b->vals = NULL;
+#if CSL_FAT_SKIPS
+    for (int lvl = 0; lvl < height; ++lvl) csl_skip_keys(b)[lvl] = INT_MAX;
+#endif
+    if (item_cap > 0) {
+        char* p = (char*)b + blk_items_offset(height, soa);
+        if (soa) {
+            b->keys = (csl_key_t*)p;
+            b->vals = (csl_val_t*)(b->keys + CSL_SOA_KEY_SLOTS(item_cap));
+        } else {
+            b->items = (csl_kv*)p;
+        }
+    }
     return b;
 }
 
+/* Allocate a block with runtime-sized item and skip arrays; the items are
+ * laid out as selected by sl->soa. */
+static csl_block* blk_alloc_with_cap(cskiplist* sl, int item_cap, int skip_slots) {
+    return blk_alloc(sl, item_cap, skip_slots, sl->soa);
+}
+
+/* Release a block (one chunk). */
+static void blk_release(cskiplist* sl, csl_block* b) {
+    csl_mem_release(&sl->mem, b, blk_bytes(b));
+}
+
+/* Link slot lvl of b to t.  With fat skip entries the slot also gets
+ * t->min_key (INT_MAX for NULL). */
+static inline void blk_link(csl_block* b, int lvl, csl_block* t) {
+    b->next[lvl] = t;
+#if CSL_FAT_SKIPS
+    csl_skip_keys(b)[lvl] = t ? t->min_key : INT_MAX;
+#endif
+}
+
+/* min_key of b->next[lvl], which must not be NULL; from the slot itself
+ * with fat skip entries. */
+static inline csl_key_t blk_next_key(const csl_block* b, int lvl) {
+#if CSL_FAT_SKIPS
+    return csl_skip_keys(b)[lvl];
+#else
+    return b->next[lvl]->min_key;
+#endif
+}
+
+/* Link of slot lvl of b for a reader that may run alongside a writer
+ * (concurrent mode, iterators). */
+static inline csl_block* blk_next_acq(const csl_block* b, int lvl) {
+    return __atomic_load_n(&b->next[lvl], __ATOMIC_ACQUIRE);
+}
+
+/* Key and value of item i of a block in either layout. */
+static inline csl_key_t blk_key(const csl_block* b, int i) {
+    return b->keys ? b->keys[i] : b->items[i].key;
+}
+
+static inline csl_val_t blk_val(const csl_block* b, int i) {
+    return b->keys ? b->vals[i] : b->items[i].val;
+}
+
+static inline void blk_put(csl_block* b, int i, csl_key_t key, csl_val_t val) {
+    if (b->keys) { b->keys[i] = key; b->vals[i] = val; }
+    else { b->items[i].key = key; b->items[i].val = val; }
+}
+
+static inline void blk_put_val(csl_block* b, int i, csl_val_t val) {
+    if (b->keys) b->vals[i] = val;
+    else b->items[i].val = val;
+}
+
+/* Move n items of b from position src to position dst (may overlap). */
+static void blk_move(csl_block* b, int dst, int src, int n) {
+    if (n <= 0) return;
+    if (b->keys) {
+        memmove(&b->keys[dst], &b->keys[src], (size_t)n * sizeof(csl_key_t));
+        memmove(&b->vals[dst], &b->vals[src], (size_t)n * sizeof(csl_val_t));
+    } else {
+        memmove(&b->items[dst], &b->items[src], (size_t)n * sizeof(csl_kv));
+    }
+}
+
+/* Copy n items from position si of src to position di of dst. */
+static void blk_copy(csl_block* dst, int di, const csl_block* src, int si, int n) {
+    if (n <= 0) return;
+    if (dst->keys && src->keys) {
+        memcpy(&dst->keys[di], &src->keys[si], (size_t)n * sizeof(csl_key_t));
+        memcpy(&dst->vals[di], &src->vals[si], (size_t)n * sizeof(csl_val_t));
+    } else if (!dst->keys && !src->keys) {
+        memcpy(&dst->items[di], &src->items[si], (size_t)n * sizeof(csl_kv));
+    } else {
+        for (int i = 0; i < n; ++i)
+            blk_put(dst, di + i, blk_key(src, si + i), blk_val(src, si + i));
+    }
+}
+
 /* Allocate the head/sentinel block with full skip-pointer array. */
-static csl_block* blk_alloc_head(void) {
-    return blk_alloc_with_cap(0, CSL_MAX_LEVEL);
+static csl_block* blk_alloc_head(cskiplist* sl) {
+    return blk_alloc_with_cap(sl, 0, CSL_MAX_LEVEL);
 }
 
-/* Ensure block has at least `needed` skip-pointer slots. */
-static csl_block* blk_ensure_skips(csl_block* b, int needed) {
-    csl_block** new_next;
+/* Copy of b in a new chunk with a tower of height slots and the given
+ * layout: items, links and widths (as far as both towers go), min_key
+ * and prev.
+ * b is left as it is; the caller relinks the copy and releases b. */
+static csl_block* blk_relocate(cskiplist* sl, const csl_block* b, int height, int soa) {
+    csl_block* nb = blk_alloc(sl, b->item_cap, height, soa);
+    if (!nb) return NULL;
+    nb->min_key = b->min_key;
+    nb->count = b->count;
+    nb->nbuf = b->nbuf;
+    nb->prev = b->prev;
+    int h = (height < b->skip_alloc) ? height : b->skip_alloc;
+    memcpy(nb->next, b->next, (size_t)h * sizeof(csl_block*));
+#if CSL_FAT_SKIPS
+    memcpy(csl_skip_keys(nb), csl_skip_keys(b), (size_t)h * sizeof(csl_key_t));
+#endif
+    memcpy(csl_skip_widths(nb), csl_skip_widths(b), (size_t)h * sizeof(uint32_t));
+    blk_copy(nb, 0, b, 0, b->count);
+    return nb;
+}
 
+/* Block with at least `needed` skip-pointer slots: b itself, or a taller
+ * copy of b (b is released); NULL on OOM (b is kept).  The links to a
+ * moved block are left to the caller. */
+static csl_block* blk_ensure_skips(cskiplist* sl, csl_block* b, int needed) {
     if (b->skip_alloc >= needed) return b;
-    new_next = (csl_block**)realloc(b->next, (size_t)needed * sizeof(csl_block*));
-    if (!new_next) return NULL;
-
-    memset(&new_next[b->skip_alloc], 0,
-           (size_t)(needed - b->skip_alloc) * sizeof(csl_block*));
-    b->next = new_next;
-    b->skip_alloc = needed;
-    return b;
+    csl_block* nb = blk_relocate(sl, b, needed, b->keys != NULL);
+    if (!nb) return NULL;
+    blk_release(sl, b);
+    return nb;
 }
 
 int csl_tlb_aware_block_cap_hint(int requested_block_cap) {
@@ -117,16 +289,19 @@ int csl_choose_block_cap_for_level(int trie_level) {
     return csl_tlb_aware_block_cap_hint(suggested);
 }
 
-cskiplist* csl_create_with_block_cap(int block_cap) {
-    cskiplist* sl = (cskiplist*)calloc(1, sizeof(cskiplist));
+cskiplist* csl_create_with_allocator(int block_cap, const csl_allocator* mem) {
+    csl_allocator m = { NULL, NULL, NULL };
+    if (mem) m = *mem;
+    cskiplist* sl = (cskiplist*)csl_mem_alloc(&m, sizeof(cskiplist));
 
     if (!sl) return NULL;
+    sl->mem = m;
     /* Honor the requested capacity exactly (block-size experiments depend
      * on it); only reject nonsensical values.  Use the TLB-aware helper
      * yourself if you want the clamped heuristic. */
     sl->block_cap = (block_cap >= 2) ? block_cap : CSL_BLOCK_CAP;
-    sl->head = blk_alloc_head();
-    if (!sl->head) { free(sl); return NULL; }
+    sl->head = blk_alloc_head(sl);
+    if (!sl->head) { csl_mem_release(&m, sl, sizeof(cskiplist)); return NULL; }
     sl->tail = NULL;
     sl->level = 0;
     sl->nblocks = 0;
@@ -136,9 +311,16 @@ cskiplist* csl_create_with_block_cap(int block_cap) {
     sl->stat_updates = 0;
     sl->stat_deletes = 0;
     sl->stat_splits = 0;
+    sl->stat_merges = 0;
+    sl->scratch = NULL;
+    sl->scratch_cap = 0;
     return sl;
 }
 
+cskiplist* csl_create_with_block_cap(int block_cap) {
+    return csl_create_with_allocator(block_cap, NULL);
+}
+
 cskiplist* csl_create_for_level(int trie_level) {
     return csl_create_with_block_cap(csl_choose_block_cap_for_level(trie_level));
 }
@@ -157,14 +339,16 @@ void csl_free(cskiplist* sl, void (*free_val)(csl_val_t)) {
     while (cur) {
         csl_block* nxt = cur->next[0];
         if (cur != sl->head && free_val) {
-            for (int i = 0; i < cur->count; ++i) free_val(cur->items[i].val);
+            for (int i = 0; i < cur->count; ++i) free_val(blk_val(cur, i));
         }
-        free(cur->items);
-        free(cur->next);
-        free(cur);
+        blk_release(sl, cur);
         cur = nxt;
     }
-    free(sl);
+    if (sl->lanes) csl_mem_release(&sl->mem, sl->lanes, sl->lanes->bytes);
+    csl_set_concurrent(sl, 0);
+    csl_mem_release(&sl->mem, sl->scratch, (size_t)sl->scratch_cap * sizeof(csl_kv));
+    csl_allocator m = sl->mem;
+    csl_mem_release(&m, sl, sizeof(cskiplist));
 }
 
 /* locate block with min_key <= key < next.min_key using top-down skip traversal */
@@ -172,12 +356,26 @@ static csl_block* locate_block(cskiplist* sl, csl_key_t key) {
     csl_block* x = sl->head;
     for (int lvl = sl->level; lvl >= 0; --lvl) {
         while (lvl < x->skip_alloc && x->next[lvl] &&
-               x->next[lvl]->min_key <= key)
+               blk_next_key(x, lvl) <= key)
             x = x->next[lvl];
     }
     return x; /* x is the block whose min_key <= key, or head if before first */
 }
 
+/* locate_block() that also leaves in path[lvl], for each level up to
+ * sl->level, the block it stopped at: the one whose slot on that level
+ * covers the block found. */
+static csl_block* locate_block_path(cskiplist* sl, csl_key_t key, csl_block** path) {
+    csl_block* x = sl->head;
+    for (int lvl = sl->level; lvl >= 0; --lvl) {
+        while (lvl < x->skip_alloc && x->next[lvl] &&
+               blk_next_key(x, lvl) <= key)
+            x = x->next[lvl];
+        path[lvl] = x;
+    }
+    return x;
+}
+
 /*-----------------------------------------------------------------------------
  * Incremental skip maintenance.
  *
@@ -188,6 +386,14 @@ static csl_block* locate_block(cskiplist* sl, csl_key_t key) {
  * skip structure stays valid at all times and searches remain O(log n_blocks)
  * without ever calling csl_rebuild_skips().  The rebuild is still available
  * to produce perfectly balanced deterministic skips after a bulk load.
+ *
+ * Each slot above level 0 also counts the items it skips (its width, as in
+ * Pugh's "A Skip List Cookbook"), so a descent can sum positions for
+ * csl_rank() and csl_select().  A splice cuts the width of each slot it
+ * goes under in two, an unsplice adds the widths of the block to the slots
+ * before it, and an item that comes or goes changes the widths of the
+ * slots over its block by one.  The bulk paths set sl->widths_stale
+ * instead and leave them to widths_recount().
  *----------------------------------------------------------------------------*/
 
 static uint32_t csl_rand(cskiplist* sl) {
@@ -212,32 +418,72 @@ static void locate_preds(cskiplist* sl, csl_key_t key, csl_block** update) {
     csl_block* x = sl->head;
     for (int lvl = sl->level; lvl >= 0; --lvl) {
         while (lvl < x->skip_alloc && x->next[lvl] &&
-               x->next[lvl]->min_key < key)
+               blk_next_key(x, lvl) < key)
             x = x->next[lvl];
         update[lvl] = x;
     }
 }
 
-/* Splice a freshly allocated, not-yet-linked block into levels
- * [0, nb->skip_alloc).  nb->min_key must be set and unique among blocks.
- * Maintains prev pointers, tail, nblocks and sl->level. */
-static void splice_block(cskiplist* sl, csl_block* nb) {
-    csl_block* update[CSL_MAX_LEVEL];
+/* Link the not-yet-linked block nb behind update[lvl] on each level of its
+ * tower; update[lvl] must be the last block on level lvl before nb (the
+ * head above sl->level) and becomes nb.  Maintains prev pointers, tail,
+ * nblocks and sl->level. */
+static void link_block(cskiplist* sl, csl_block* nb, csl_block** update) {
     int h = nb->skip_alloc;
 
-    /* preds above the current top level are simply the head */
-    for (int lvl = sl->level + 1; lvl < h; ++lvl) update[lvl] = sl->head;
-    locate_preds(sl, nb->min_key, update);
     if (h - 1 > sl->level) sl->level = h - 1;
-
     for (int lvl = 0; lvl < h; ++lvl) {
-        nb->next[lvl] = update[lvl]->next[lvl];
-        update[lvl]->next[lvl] = nb;
+        blk_link(nb, lvl, update[lvl]->next[lvl]);
+        blk_link(update[lvl], lvl, nb);
     }
     nb->prev = (update[0] == sl->head) ? NULL : update[0];
     if (nb->next[0]) nb->next[0]->prev = nb;
     else sl->tail = nb;
+    for (int lvl = 0; lvl < h; ++lvl) update[lvl] = nb;
     sl->nblocks++;
+    if (sl->lanes) sl->lanes->dirty = 1;
+}
+
+/* Width of the slot of b on level lvl (b->count on level 0). */
+static inline size_t blk_width(const csl_block* b, int lvl) {
+    return lvl ? csl_skip_widths(b)[lvl] : (size_t)b->count;
+}
+
+/* Splice a freshly allocated, not-yet-linked block into levels
+ * [0, nb->skip_alloc).  nb->min_key must be set and unique among blocks.
+ * The items of nb count as being in the list already (they come from the
+ * block before it in a split; an insert adds its own afterwards). */
+static void splice_block(cskiplist* sl, csl_block* nb) {
+    csl_block* update[CSL_MAX_LEVEL];
+    size_t pos[CSL_MAX_LEVEL];  /* items before update[lvl] */
+    csl_block* x = sl->head;
+    size_t at = 0;
+
+    /* preds above the current top level are simply the head */
+    for (int lvl = sl->level + 1; lvl < nb->skip_alloc; ++lvl) {
+        update[lvl] = sl->head;
+        pos[lvl] = 0;
+    }
+    /* locate_preds(), counting the items passed */
+    for (int lvl = sl->level; lvl >= 0; --lvl) {
+        while (lvl < x->skip_alloc && x->next[lvl] &&
+               blk_next_key(x, lvl) < nb->min_key) {
+            at += blk_width(x, lvl);
+            x = x->next[lvl];
+        }
+        update[lvl] = x;
+        pos[lvl] = at;
+    }
+    if (!sl->widths_stale) {
+        at += x->count; /* nb's first item */
+        for (int lvl = 1; lvl < nb->skip_alloc; ++lvl) {
+            uint32_t* w = csl_skip_widths(update[lvl]);
+            size_t end = (lvl > sl->level) ? sl->size : pos[lvl] + w[lvl];
+            csl_skip_widths(nb)[lvl] = (uint32_t)(end - at);
+            w[lvl] = (uint32_t)(at - pos[lvl]);
+        }
+    }
+    link_block(sl, nb, update);
 }
 
 /* Unsplice block b from every level it participates in and update
@@ -246,16 +492,364 @@ static void unsplice_block(cskiplist* sl, csl_block* b) {
     csl_block* update[CSL_MAX_LEVEL];
     locate_preds(sl, b->min_key, update);
     for (int lvl = 0; lvl <= sl->level; ++lvl) {
-        if (lvl < update[lvl]->skip_alloc && update[lvl]->next[lvl] == b)
-            update[lvl]->next[lvl] = b->next[lvl];
+        if (lvl < update[lvl]->skip_alloc && update[lvl]->next[lvl] == b) {
+            blk_link(update[lvl], lvl, b->next[lvl]);
+            if (lvl > 0) csl_skip_widths(update[lvl])[lvl] += csl_skip_widths(b)[lvl];
+        }
     }
     if (b->next[0]) b->next[0]->prev = b->prev;
     if (sl->tail == b) sl->tail = b->prev; /* NULL if b was the only block */
     while (sl->level > 0 && !sl->head->next[sl->level]) sl->level--;
     sl->nblocks--;
+    if (sl->lanes) sl->lanes->dirty = 1;
+}
+
+/* Add delta to the widths of the slots path[lvl] (from
+ * locate_block_path()) over the block found, whose count changed by
+ * delta. */
+static void widths_add(cskiplist* sl, csl_block** path, int delta) {
+    if (sl->widths_stale) return;
+    for (int lvl = 1; lvl <= sl->level; ++lvl)
+        csl_skip_widths(path[lvl])[lvl] += (uint32_t)delta;
+}
+
+/* widths_add() for the linked block b. */
+static void blk_widths_add(cskiplist* sl, const csl_block* b, int delta) {
+    csl_block* path[CSL_MAX_LEVEL];
+    if (sl->widths_stale) return;
+    locate_block_path(sl, b->min_key, path);
+    widths_add(sl, path, delta);
+}
+
+/* k items moved from the block before the linked block b into b (from b
+ * to it if k < 0): the slots of b gain them and the slots that end at b
+ * lose them. */
+static void blk_widths_shift(cskiplist* sl, csl_block* b, int k) {
+    csl_block* update[CSL_MAX_LEVEL];
+    if (sl->widths_stale || k == 0) return;
+    locate_preds(sl, b->min_key, update);
+    for (int lvl = 1; lvl <= sl->level && lvl < b->skip_alloc; ++lvl) {
+        if (update[lvl]->next[lvl] != b) continue;
+        csl_skip_widths(update[lvl])[lvl] -= (uint32_t)k;
+        csl_skip_widths(b)[lvl] += (uint32_t)k;
+    }
+}
+
+/* Set the widths of all slots from the counts of the blocks, O(n_blocks). */
+static void widths_recount(cskiplist* sl) {
+    csl_block* last[CSL_MAX_LEVEL];
+    size_t lastpos[CSL_MAX_LEVEL];
+    size_t at = 0;
+
+    for (int lvl = 1; lvl <= sl->level; ++lvl) { last[lvl] = sl->head; lastpos[lvl] = 0; }
+    for (csl_block* b = sl->head->next[0]; b; b = b->next[0]) {
+        for (int lvl = 1; lvl <= sl->level && lvl < b->skip_alloc; ++lvl) {
+            if (last[lvl]->next[lvl] != b) continue; /* not linked on lvl */
+            csl_skip_widths(last[lvl])[lvl] = (uint32_t)(at - lastpos[lvl]);
+            last[lvl] = b;
+            lastpos[lvl] = at;
+        }
+        at += (size_t)b->count;
+    }
+    for (int lvl = 1; lvl <= sl->level; ++lvl)
+        csl_skip_widths(last[lvl])[lvl] = (uint32_t)(at - lastpos[lvl]);
+    sl->widths_stale = 0;
+}
+
+static void lanes_set_min_key(cskiplist* sl, csl_key_t old_key, csl_key_t key);
+
+/* Change the min_key of the linked block b to key, which must keep b
+ * between its neighbours.  Fat skip entries of b's predecessors and the
+ * fast lanes follow. */
+static void blk_set_min_key(cskiplist* sl, csl_block* b, csl_key_t key) {
+    csl_key_t old_key = b->min_key;
+    if (old_key == key) return;
+#if CSL_FAT_SKIPS
+    csl_block* update[CSL_MAX_LEVEL];
+    locate_preds(sl, old_key, update);
+    b->min_key = key;
+    for (int lvl = 0; lvl <= sl->level && lvl < b->skip_alloc; ++lvl) {
+        if (update[lvl]->next[lvl] == b) csl_skip_keys(update[lvl])[lvl] = key;
+    }
+#else
+    b->min_key = key;
+#endif
+    if (sl->lanes) lanes_set_min_key(sl, old_key, key);
+}
+
+/*-----------------------------------------------------------------------------
+ * Block search kernels, selected at run time.
+ *
+ * A kernel returns the lower bound of `key` (the number of keys below it)
+ * in n sorted keys keys[0], keys[stride], ..., keys[(n-1)*stride]; stride
+ * is 1 for the dense keys of a SoA block and CSL_KV_STRIDE for items[].
+ *
+ *   scalar  branchless halving (cmov) down to one key
+ *   sse2    halving down to CSL_SOA_WINDOW keys, then the window is
+ *           counted 4 keys per compare (dense keys only; items[] keep
+ *           the SSE2 scan/binary search of blk_binary_search)
+ *   avx2    9-ary search: 8 pivots are gathered into one vector and the
+ *           pivots below the key (a popcount) pick one of 9 parts; below
+ *           CSL_KARY_MIN8 keys halving, then 8 keys per compare
+ *   avx512  the same with 16 pivots (17-ary) and 16 keys per compare;
+ *           masked loads handle the end of the window.  items[] use the
+ *           avx2 kernel: a 16-lane gather of strided keys is slower
+ *
+ * The gathers of the k-ary steps pay off when the block is not in cache
+ * (the pivots are loaded in parallel instead of one after another); on a
+ * block in L1 halving is as fast, hence the CSL_KARY_MIN* thresholds.
+ *
+ * The best kernel supported by the CPU (cpuid, via __builtin_cpu_supports)
+ * is chosen at program start, or the one named by the environment
+ * variable CSL_ISA (scalar, sse2, avx2, avx512) if it is supported;
+ * csl_simd_select() forces a lower one.
+ * The AVX kernels are compiled with target attributes, so the rest of the
+ * file keeps its SSE2 baseline and the binary runs on any x86-64.
+ *
+ * Reference: Schlegel, Gemulla & Lehner, "k-ary search on modern
+ * processors" (DaMoN 2009).
+ *----------------------------------------------------------------------------*/
+#if CSL_USE_SIMD && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define CSL_DISPATCH 1
+  #include <immintrin.h>
+#else
+  #define CSL_DISPATCH 0
+#endif
+
+/* Keys of items[] are CSL_KV_STRIDE keys apart. */
+#define CSL_KV_STRIDE ((int)(sizeof(csl_kv) / sizeof(csl_key_t)))
+
+/* Smallest ranges searched with 8 and 16 pivots; k pivots need n >= k*(k+1). */
+#ifndef CSL_KARY_MIN8
+  #define CSL_KARY_MIN8  256
+#endif
+#ifndef CSL_KARY_MIN16
+  #define CSL_KARY_MIN16 512
+#endif
+
+typedef int (*csl_lb_fn)(const csl_key_t* keys, int stride, int n, csl_key_t key);
+
+static int lb_scalar(const csl_key_t* keys, int stride, int n, csl_key_t key) {
+    const csl_key_t* base = keys;
+    if (n == 0) return 0;
+    while (n > 1) {
+        int half = n >> 1;
+        base = (base[half * stride] < key) ? base + half * stride : base;
+        n -= half;
+    }
+    return (int)(base - keys) / stride + (*base < key);
+}
+
+#if CSL_USE_SIMD
+static int lb_sse2(const csl_key_t* keys, int stride, int n, csl_key_t key) {
+    const csl_key_t* base = keys;
+    if (stride != 1) return lb_scalar(keys, stride, n, key);
+    while (n > CSL_SOA_WINDOW) {
+        int half = n >> 1;
+        base = (base[half] < key) ? base + half : base;
+        n -= half;
+    }
+    /* The lower bound is in [base, base + n]; every key left of base is
+     * below `key`, so the lower bound is base + (keys < key in window). */
+    __m128i vkey = _mm_set1_epi32(key);
+    int below = 0, i = 0;
+    for (; i + 3 < n; i += 4) {
+        __m128i vkeys = _mm_loadu_si128((const __m128i*)&base[i]);
+        below += __builtin_popcount(
+            _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(vkeys, vkey))));
+    }
+    for (; i < n; i++) below += (base[i] < key);
+    return (int)(base - keys) + below;
+}
+#endif
+
+#if CSL_DISPATCH
+__attribute__((target("avx2,popcnt")))
+static int lb_avx2(const csl_key_t* keys, int stride, int n, csl_key_t key) {
+    const __m256i vkey = _mm256_set1_epi32(key);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int lo = 0;
+
+    /* Invariant: the lower bound is in [lo, lo + n].  Pivot i is the key
+     * at lo + (i+1)*s - 1; c pivots below the key leave s - 1 keys (or
+     * the n - 8s keys right of the last pivot when c == 8). */
+    while (n >= CSL_KARY_MIN8) {
+        int s = (n + 8) / 9;
+        __m256i vidx = _mm256_add_epi32(
+            _mm256_mullo_epi32(_mm256_add_epi32(lanes, _mm256_set1_epi32(1)),
+                               _mm256_set1_epi32(s)),
+            _mm256_set1_epi32(lo - 1));
+        vidx = _mm256_mullo_epi32(vidx, _mm256_set1_epi32(stride));
+        __m256i piv = _mm256_i32gather_epi32((const int*)keys, vidx, 4);
+        int c = _mm_popcnt_u32((unsigned)_mm256_movemask_ps(
+                    _mm256_castsi256_ps(_mm256_cmpgt_epi32(vkey, piv))));
+        lo += c * s;
+        n = (c < 8) ? s - 1 : n - 8 * s;
+    }
+    const csl_key_t* base = keys + (size_t)lo * stride;
+    while (n > 4 * 8) {
+        int half = n >> 1;
+        base = (base[half * stride] < key) ? base + half * stride : base;
+        n -= half;
+    }
+    int below = 0, i = 0;
+    if (stride == 1) {
+        for (; i + 7 < n; i += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)&base[i]);
+            below += _mm_popcnt_u32((unsigned)_mm256_movemask_ps(
+                         _mm256_castsi256_ps(_mm256_cmpgt_epi32(vkey, v))));
+        }
+    } else {
+        __m256i vidx = _mm256_mullo_epi32(lanes, _mm256_set1_epi32(stride));
+        __m256i vstep = _mm256_set1_epi32(8 * stride);
+        for (; i + 7 < n; i += 8) {
+            __m256i v = _mm256_i32gather_epi32((const int*)base, vidx, 4);
+            below += _mm_popcnt_u32((unsigned)_mm256_movemask_ps(
+                         _mm256_castsi256_ps(_mm256_cmpgt_epi32(vkey, v))));
+            vidx = _mm256_add_epi32(vidx, vstep);
+        }
+    }
+    for (; i < n; i++) below += (base[i * stride] < key);
+    return (int)(base - keys) / stride + below;
+}
+
+__attribute__((target("avx512f,popcnt")))
+static int lb_avx512(const csl_key_t* keys, int stride, int n, csl_key_t key) {
+    const __m512i vkey = _mm512_set1_epi32(key);
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15);
+    int lo = 0;
+
+    /* As in lb_avx2, with 16 pivots. */
+    while (n >= CSL_KARY_MIN16) {
+        int s = (n + 16) / 17;
+        __m512i vidx = _mm512_add_epi32(
+            _mm512_mullo_epi32(_mm512_add_epi32(lanes, _mm512_set1_epi32(1)),
+                               _mm512_set1_epi32(s)),
+            _mm512_set1_epi32(lo - 1));
+        vidx = _mm512_mullo_epi32(vidx, _mm512_set1_epi32(stride));
+        __m512i piv = _mm512_i32gather_epi32(vidx, (const void*)keys, 4);
+        int c = _mm_popcnt_u32((unsigned)_mm512_cmplt_epi32_mask(piv, vkey));
+        lo += c * s;
+        n = (c < 16) ? s - 1 : n - 16 * s;
+    }
+    const csl_key_t* base = keys + (size_t)lo * stride;
+    while (n > 4 * 16) {
+        int half = n >> 1;
+        base = (base[half * stride] < key) ? base + half * stride : base;
+        n -= half;
+    }
+    int below = 0;
+    __m512i vidx = _mm512_mullo_epi32(lanes, _mm512_set1_epi32(stride));
+    __m512i vstep = _mm512_set1_epi32(16 * stride);
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 m = (n - i >= 16) ? (__mmask16)0xFFFF
+                                    : (__mmask16)((1u << (n - i)) - 1);
+        __m512i v = (stride == 1)
+            ? _mm512_maskz_loadu_epi32(m, &base[i])
+            : _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), m, vidx,
+                                          (const void*)base, 4);
+        below += _mm_popcnt_u32((unsigned)_mm512_mask_cmplt_epi32_mask(m, v, vkey));
+        vidx = _mm512_add_epi32(vidx, vstep);
+    }
+    return (int)(base - keys) / stride + below;
+}
+#endif /* CSL_DISPATCH */
+
+/* Kernels in use: for SoA keys and for items[] (NULL = blk_binary_search's
+ * own SSE2/scalar code).  They start as the baseline of the build and are
+ * replaced at program start by csl_simd_init(). */
+#if CSL_USE_SIMD
+static csl_lb_fn csl_lb_keys = lb_sse2;
+static int csl_isa = CSL_ISA_SSE2;
+#else
+static csl_lb_fn csl_lb_keys = lb_scalar;
+static int csl_isa = CSL_ISA_SCALAR;
+#endif
+static csl_lb_fn csl_lb_items = NULL;
+
+/* Is the isa supported by this build and CPU? */
+static int csl_isa_supported(int isa) {
+    switch (isa) {
+    case CSL_ISA_SCALAR: return 1;
+#if CSL_USE_SIMD
+    case CSL_ISA_SSE2:   return 1;
+#endif
+#if CSL_DISPATCH
+    case CSL_ISA_AVX2:   __builtin_cpu_init();
+                         return __builtin_cpu_supports("avx2") &&
+                                __builtin_cpu_supports("popcnt");
+    case CSL_ISA_AVX512: __builtin_cpu_init();
+                         return __builtin_cpu_supports("avx512f") &&
+                                __builtin_cpu_supports("popcnt");
+#endif
+    default:             return 0;
+    }
+}
+
+int csl_simd_select(int isa) {
+    if (isa > CSL_ISA_AVX512) isa = CSL_ISA_AVX512;
+    while (isa > CSL_ISA_SCALAR && !csl_isa_supported(isa)) isa--;
+    switch (isa) {
+#if CSL_DISPATCH
+    case CSL_ISA_AVX512: csl_lb_keys = lb_avx512; csl_lb_items = lb_avx2;   break;
+    case CSL_ISA_AVX2:   csl_lb_keys = lb_avx2;   csl_lb_items = lb_avx2;   break;
+#endif
+#if CSL_USE_SIMD
+    case CSL_ISA_SSE2:   csl_lb_keys = lb_sse2;   csl_lb_items = NULL;      break;
+#endif
+    default:             csl_lb_keys = lb_scalar; csl_lb_items = lb_scalar; break;
+    }
+    csl_isa = isa;
+    return isa;
+}
+
+int csl_simd_isa(void) {
+    return csl_isa;
+}
+
+#if CSL_DISPATCH
+/* Instruction set named by CSL_ISA, or the widest one. */
+static int csl_isa_default(void) {
+    const char* env = getenv("CSL_ISA");
+    if (env) {
+        for (int isa = CSL_ISA_SCALAR; isa <= CSL_ISA_AVX512; isa++)
+            if (strcmp(env, csl_simd_isa_name(isa)) == 0) return isa;
+    }
+    return CSL_ISA_AVX512;
+}
+
+/* Select the kernels before main(), so threads never race to do it. */
+__attribute__((constructor)) static void csl_simd_init(void) {
+    csl_simd_select(csl_isa_default());
+}
+#endif
+
+const char* csl_simd_isa_name(int isa) {
+    static const char* names[] = { "scalar", "sse2", "avx2", "avx512" };
+    return (isa >= CSL_ISA_SCALAR && isa <= CSL_ISA_AVX512) ? names[isa] : "none";
+}
+
+/* Turn a lower bound lo of b into the result of blk_binary_search(). */
+static inline int blk_found(const csl_key_t* keys, int stride, int count,
+                            int lo, csl_key_t key) {
+    if (lo < count && keys[lo * stride] == key) return lo;
+    return -(lo + 1);
+}
+
+/* Search of a sorted SoA block with the selected kernel. */
+static int blk_soa_search(const csl_block* b, csl_key_t key) {
+    int lo = csl_lb_keys(b->keys, 1, b->count, key);
+    return blk_found(b->keys, 1, b->count, lo, key);
 }
 
 static int blk_binary_search(csl_block* b, csl_key_t key) {
+    if (b->keys) return blk_soa_search(b, key);
+    if (csl_lb_items) {
+        const csl_key_t* keys = &b->items[0].key;
+        int lo = csl_lb_items(keys, CSL_KV_STRIDE, b->count, key);
+        return blk_found(keys, CSL_KV_STRIDE, b->count, lo, key);
+    }
 #if CSL_USE_SIMD
     /*-----------------------------------------------------------------
      * SIMD path: use SSE2 to compare 4 keys at once.
@@ -279,21 +873,27 @@ static int blk_binary_search(csl_block* b, csl_key_t key) {
 
         /* Process 4 items at a time using SSE2.
          *
-         * csl_kv layout (32-bit): [key0|val0|key1|val1|key2|val2|key3|val3]
-         * Each csl_kv is 8 bytes; 4 entries = 32 bytes.
+         * csl_kv layout (CSL_VAL32): [key0|val0|key1|val1|key2|val2|key3|val3]
+         * Each csl_kv is 8 bytes; 4 entries = 32 bytes = two loads, and
+         * _mm_shuffle_ps picks the even (key) lanes of both.
          *
-         * We gather the 4 keys using _mm_set_epi32, which loads from
-         * non-contiguous memory into one SIMD register.  The compiler
-         * may optimize this into a shuffle on packed data.
+         * With pointer values each csl_kv is 16 bytes and the keys are
+         * gathered with _mm_set_epi32 from non-contiguous memory.
          */
         for (; i + 3 < count; i += 4) {
             /* Gather 4 keys from 4 consecutive csl_kv entries */
+#ifdef CSL_VAL32
+            __m128 lo = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&b->items[i]));
+            __m128 hi = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&b->items[i + 2]));
+            __m128i vkeys = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+#else
             __m128i vkeys = _mm_set_epi32(
                 b->items[i + 3].key,
                 b->items[i + 2].key,
                 b->items[i + 1].key,
                 b->items[i + 0].key
             );
+#endif
 
             /* Compare all 4 keys against search key simultaneously.
              * _mm_cmpeq_epi32: sets each 32-bit lane to 0xFFFFFFFF if equal */
@@ -388,50 +988,6 @@ static int blk_binary_search(csl_block* b, csl_key_t key) {
  *            (2015), https://arxiv.org/abs/1509.05053
  *----------------------------------------------------------------------------*/
 
-/* --- Conversion: sorted ↔ Eytzinger --- */
-
-/* Recursive in-order traversal to build Eytzinger layout from sorted array. */
-static void eyt_build(const csl_kv* sorted, csl_kv* eyt, int n, int* si, int k) {
-    if (k >= n) return;
-    eyt_build(sorted, eyt, n, si, 2*k + 1);  /* left subtree */
-    eyt[k] = sorted[(*si)++];                 /* root */
-    eyt_build(sorted, eyt, n, si, 2*k + 2);  /* right subtree */
-}
-
-/* Convert a block's items[] from sorted order to Eytzinger BFS order. */
-static void blk_sorted_to_eytzinger(csl_block* b) {
-    csl_kv* tmp;
-    int si = 0;
-
-    if (b->count <= 1) return;
-    tmp = (csl_kv*)malloc((size_t)b->count * sizeof(csl_kv));
-    if (!tmp) return;
-    memcpy(tmp, b->items, (size_t)b->count * sizeof(csl_kv));
-    eyt_build(tmp, b->items, b->count, &si, 0);
-    free(tmp);
-}
-
-/* Recursive in-order traversal to extract sorted array from Eytzinger. */
-static void eyt_extract(const csl_kv* eyt, csl_kv* sorted, int n, int* si, int k) {
-    if (k >= n) return;
-    eyt_extract(eyt, sorted, n, si, 2*k + 1);
-    sorted[(*si)++] = eyt[k];
-    eyt_extract(eyt, sorted, n, si, 2*k + 2);
-}
-
-/* Convert a block's items[] from Eytzinger BFS order back to sorted order. */
-static void blk_eytzinger_to_sorted(csl_block* b) {
-    csl_kv* tmp;
-    int si = 0;
-
-    if (b->count <= 1) return;
-    tmp = (csl_kv*)malloc((size_t)b->count * sizeof(csl_kv));
-    if (!tmp) return;
-    eyt_extract(b->items, tmp, b->count, &si, 0);
-    memcpy(b->items, tmp, (size_t)b->count * sizeof(csl_kv));
-    free(tmp);
-}
-
 /* --- Eytzinger branchless search --- */
 
 /* EYT_ITEMS_PER_CL is defined in the top-of-file constants section. */
@@ -439,18 +995,28 @@ static void blk_eytzinger_to_sorted(csl_block* b) {
 /*
  * Branchless search in Eytzinger-laid-out items[].
  * Returns: index >= 0 on exact match, -(lower_bound_index + 1) if not found.
- * The returned index is in Eytzinger space (direct items[] index).
+ * The returned index is in Eytzinger space (direct items[] index).  Only
+ * the laid-out items are searched, not the insert buffer.
  */
 static int blk_eytzinger_search(csl_block* b, csl_key_t key) {
-    int n = b->count;
+    int n = b->count - b->nbuf;
     if (n == 0) return -(0 + 1);
 
-    /* Branchless descent: k = 2k+1 if items[k] >= key, else 2k+2 */
+    /* Branchless descent: k = 2k+1 if items[k] >= key, else 2k+2.
+     * The dense keys of a SoA block put 16 nodes in a cache line. */
     unsigned k = 0;
-    while (k < (unsigned)n) {
-        /* Prefetch grandchild area (a few levels ahead) */
-        __builtin_prefetch(&b->items[k * EYT_ITEMS_PER_CL + EYT_ITEMS_PER_CL], 0, 1);
-        k = 2*k + 1 + (unsigned)(b->items[k].key < key);
+    if (b->keys) {
+        const csl_key_t* keys = b->keys;
+        while (k < (unsigned)n) {
+            __builtin_prefetch(&keys[k * EYT_KEYS_PER_CL + EYT_KEYS_PER_CL], 0, 1);
+            k = 2*k + 1 + (unsigned)(keys[k] < key);
+        }
+    } else {
+        while (k < (unsigned)n) {
+            /* Prefetch grandchild area (a few levels ahead) */
+            __builtin_prefetch(&b->items[k * EYT_ITEMS_PER_CL + EYT_ITEMS_PER_CL], 0, 1);
+            k = 2*k + 1 + (unsigned)(b->items[k].key < key);
+        }
     }
 
     /* Recover the lower-bound position (0-indexed Eytzinger).
@@ -462,7 +1028,7 @@ static int blk_eytzinger_search(csl_block* b, csl_key_t key) {
     int j = (int)(u >> shift) - 1;
     if (j < 0) return -(n + 1);       /* all elements < key */
 
-    if (b->items[j].key == key) return j;  /* exact match */
+    if (blk_key(b, j) == key) return j;    /* exact match */
     return -(j + 1);                       /* lower bound, not exact */
 }
 
@@ -520,95 +1086,717 @@ static int eyt_inorder_pred(int k, int n) {
     return -1;  /* no predecessor */
 }
 
-int csl_append(cskiplist* sl, csl_key_t key, csl_val_t val) {
-    if (!sl) return -1;
-    csl_block* tail = sl->tail;
+/* --- Eytzinger rank <-> index, O(1) for the iterators --- */
 
-    /* Lazy tail discovery: lists whose chains were built manually (tests,
-     * bulk loaders) may not have set sl->tail. */
-    if (!tail) {
-        csl_block* t = sl->head;
-        while (t->next[0]) t = t->next[0];
-        if (t != sl->head) sl->tail = tail = t;
+/*
+ * With n items, the levels above the last one form a perfect tree of
+ * top - 1 nodes (top = largest power of two <= n, the 1-based index of
+ * the first node of the last level), and the last level has n + 1 - top
+ * leaves.  In order, the leaves take the odd 1-based ranks 1, 3, ...,
+ * 2*leaves - 1; the rest is the in-order of the perfect tree, where the
+ * node of 1-based rank q is (top + q) >> (ctz(q) + 1).
+ */
+
+/* top for n > 0 items. */
+static inline unsigned eyt_top(int n) {
+    return 1u << (31 - __builtin_clz((unsigned)n));
+}
+
+/* Index of the item of in-order rank r (0-based) in a block of n, given
+ * top = eyt_top(n): the iterators keep it per block, as a bsr on every
+ * step costs more than the tree walk it replaces. */
+static inline int eyt_rank_index(int r, int n, unsigned top) {
+    unsigned leaves = (unsigned)n + 1 - top;
+    unsigned q = (unsigned)r + 1;
+    if (q <= 2 * leaves) {
+        if (q & 1) return (int)(top + (q >> 1)) - 1;  /* a last-level leaf */
+        q >>= 1;
+    } else {
+        q -= leaves;
     }
+    return (int)((top + q) >> (__builtin_ctz(q) + 1)) - 1;
+}
 
-    int was_eyt = 0;
-    if (tail) {
-        was_eyt = sl->eytzinger && tail->count > 1;
-        if (was_eyt) blk_eytzinger_to_sorted(tail);
+/* In-order rank (0-based) of the item at index k in a block of n. */
+static inline int eyt_index_rank(int k, int n) {
+    unsigned top = eyt_top(n);
+    unsigned leaves = (unsigned)n + 1 - top;
+    unsigned i = (unsigned)k + 1;
+    if (i >= top) return (int)(2 * (i - top));        /* a last-level leaf */
+    int h = 31 - __builtin_clz(top);                  /* levels above the last */
+    int d = 31 - __builtin_clz(i);                    /* depth of i */
+    unsigned q = (2 * (i - (1u << d)) + 1) << (h - 1 - d);
+    return (int)((q <= leaves) ? 2 * q : q + leaves) - 1;
+}
 
-        /* Update of the current maximum key — must be checked BEFORE the
-         * "block full" test, otherwise a duplicate lands in a new block. */
-        if (tail->count > 0 && tail->items[tail->count - 1].key == key) {
-            tail->items[tail->count - 1].val = val;
-            sl->stat_updates++;
-            if (was_eyt) blk_sorted_to_eytzinger(tail);
-            return 0;
-        }
+/*-----------------------------------------------------------------------------
+ * S-tree layout for within-block search (CSL_LAYOUT_STREE).
+ *
+ * The Eytzinger layout generalised to B = CSL_STREE_B keys per node: node
+ * j holds the positions j*B .. j*B+B-1 (sorted within the node) and its
+ * B+1 children are the nodes j*(B+1)+1 .. j*(B+1)+B+1.  The nodes are
+ * filled in BFS order, so only the last ones are partial.  A search
+ * counts the keys below the search key in one node with the vector
+ * kernel and descends to that child: log_17(n) nodes instead of log_2(n)
+ * levels, each one cache line of keys in a SoA block.
+ *
+ * Reference: Khuong & Morin, "Array Layouts for Comparison-Based Searching"
+ *            (2015), §4 (B-tree layout)
+ *----------------------------------------------------------------------------*/
 
-        /* Out-of-order key: delegate to the general insert (handles
-         * ordering, splits and Eytzinger conversion uniformly). */
-        if (tail->count > 0 && key < tail->items[tail->count - 1].key) {
-            if (was_eyt) blk_sorted_to_eytzinger(tail);
-            return csl_insert(sl, key, val);
-        }
-    }
+#define STREE_B CSL_STREE_B
 
-    if (!tail || tail->count >= tail->item_cap) {
-        if (tail && was_eyt) blk_sorted_to_eytzinger(tail);
-        csl_block* nb = blk_alloc_with_cap(sl->block_cap, random_height(sl));
-        if (!nb) return -1;
-        nb->min_key = key;
-        splice_block(sl, nb);
-        tail = nb;
-        was_eyt = 0;
-    }
+/* Node j exists in a block of n items. */
+static inline int stree_node(size_t j, int n) {
+    return j * STREE_B < (size_t)n;
+}
 
-    /* fast append at the end of the tail block */
-    tail->items[tail->count].key = key;
-    tail->items[tail->count].val = val;
-    tail->count++;
-    if (tail->count == 1) tail->min_key = key;
-    sl->size++;
-    sl->stat_inserts++;
-    if (sl->eytzinger) blk_sorted_to_eytzinger(tail);
-    return 1;
+/* Lower bound of key in the m sorted items of b from position base, with
+ * the selected kernel (an S-tree node or the insert buffer). */
+static inline int blk_lb_run(const csl_block* b, int base, int m, csl_key_t key) {
+    if (b->keys) return csl_lb_keys(b->keys + base, 1, m, key);
+    if (csl_lb_items) return csl_lb_items(&b->items[base].key, CSL_KV_STRIDE, m, key);
+    return lb_scalar(&b->items[base].key, CSL_KV_STRIDE, m, key);
 }
 
-csl_val_t csl_search(cskiplist* sl, csl_key_t key) {
-    if (!sl) return NULL;
-    csl_block* b = locate_block(sl, key);
-    if (b == sl->head) b = b->next[0]; /* first data block */
-    if (!b) return NULL;
-    /* key could be in this block only if key >= min_key and < next.min_key */
-    int idx = sl->eytzinger ? blk_eytzinger_search(b, key)
-                            : blk_binary_search(b, key);
-    if (idx >= 0) return b->items[idx].val;
-    /* if not found and key >= next.min_key, move to next and check */
-    if (b->next[0] && key >= b->next[0]->min_key) {
-        b = b->next[0];
-        idx = sl->eytzinger ? blk_eytzinger_search(b, key)
-                            : blk_binary_search(b, key);
-        if (idx >= 0) return b->items[idx].val;
+/*
+ * Search in S-tree-laid-out items.  Same result as blk_eytzinger_search:
+ * the position on exact match, else -(lower_bound_position + 1), with
+ * -(n + 1) when all keys are below key; the insert buffer is not searched.
+ */
+static int blk_stree_search(csl_block* b, csl_key_t key) {
+    int n = b->count - b->nbuf;
+    int lb = n;
+    size_t j = 0;
+
+    while (stree_node(j, n)) {
+        int base = (int)(j * STREE_B);
+        int m = (n - base < STREE_B) ? n - base : STREE_B;
+        int c = blk_lb_run(b, base, m, key);
+        if (c < m) lb = base + c;  /* smallest key >= key seen so far */
+        j = j * (STREE_B + 1) + c + 1;
     }
-    return NULL;
+    if (lb < n && blk_key(b, lb) == key) return lb;
+    return -(lb + 1);
 }
 
-/* helper: split a full block into two roughly equal halves.
- * The new right block gets a probabilistic tower height and is spliced
- * into all its levels, keeping the skip structure valid (no rebuild). */
+/* --- S-tree in-order traversal helpers for iterators --- */
+
+/* Position of the minimum in the subtree of node j. */
+static int stree_leftmost(size_t j, int n) {
+    while (stree_node(j * (STREE_B + 1) + 1, n)) j = j * (STREE_B + 1) + 1;
+    return (int)(j * STREE_B);
+}
+
+/* Position of the maximum in the subtree of node j. */
+static int stree_rightmost(size_t j, int n) {
+    for (;;) {
+        int m = (n - (int)(j * STREE_B) < STREE_B) ? n - (int)(j * STREE_B) : STREE_B;
+        size_t c = j * (STREE_B + 1) + m + 1;  /* child after the last key */
+        if (!stree_node(c, n)) return (int)(j * STREE_B) + m - 1;
+        j = c;
+    }
+}
+
+static int stree_inorder_first(int n) {
+    return (n <= 0) ? -1 : stree_leftmost(0, n);
+}
+
+static int stree_inorder_last(int n) {
+    return (n <= 0) ? -1 : stree_rightmost(0, n);
+}
+
+/* In-order successor: returns -1 if k is the maximum element. */
+static int stree_inorder_succ(int k, int n) {
+    size_t j = (size_t)k / STREE_B;
+    int i = k % STREE_B;
+    size_t c = j * (STREE_B + 1) + i + 2;  /* child right of key i */
+
+    if (stree_node(c, n)) return stree_leftmost(c, n);
+    if (i + 1 < STREE_B && k + 1 < n) return k + 1;
+    /* Go up until we come from a child left of a key */
+    while (j > 0) {
+        size_t parent = (j - 1) / (STREE_B + 1);
+        int ci = (int)((j - 1) % (STREE_B + 1));
+        if (ci < STREE_B) return (int)(parent * STREE_B) + ci;
+        j = parent;
+    }
+    return -1;
+}
+
+/* In-order predecessor: returns -1 if k is the minimum element. */
+static int stree_inorder_pred(int k, int n) {
+    size_t j = (size_t)k / STREE_B;
+    int i = k % STREE_B;
+    size_t c = j * (STREE_B + 1) + i + 1;  /* child left of key i */
+
+    if (stree_node(c, n)) return stree_rightmost(c, n);
+    if (i > 0) return k - 1;
+    /* Go up until we come from a child right of a key */
+    while (j > 0) {
+        size_t parent = (j - 1) / (STREE_B + 1);
+        int ci = (int)((j - 1) % (STREE_B + 1));
+        if (ci > 0) return (int)(parent * STREE_B) + ci - 1;
+        j = parent;
+    }
+    return -1;
+}
+
+/*-----------------------------------------------------------------------------
+ * Layout dispatch and insert buffers.
+ *
+ * Searches and iterators work in the positions of the layout.  In the
+ * Eytzinger and S-tree layouts only the first count - nbuf items of a
+ * block (its body) are laid out; the last nbuf ones are a sorted insert
+ * buffer of up to CSL_INSERT_BUF items, searched after the body.  An
+ * insert goes to the buffer while there is room; otherwise, and for
+ * deletes from the body, the block is brought to sorted order
+ * (blk_to_sorted, which also merges the buffer), changed, and laid out
+ * again (blk_from_sorted).  Both walk the layout with the in-order
+ * successor helpers through the list's scratch array: no recursion and
+ * no allocation per write.
+ *----------------------------------------------------------------------------*/
+
+static int layout_first(int layout, int n) {
+    if (layout == CSL_LAYOUT_EYTZINGER) return eyt_inorder_first(n);
+    if (layout == CSL_LAYOUT_STREE) return stree_inorder_first(n);
+    return (n > 0) ? 0 : -1;
+}
+
+static int layout_last(int layout, int n) {
+    if (layout == CSL_LAYOUT_EYTZINGER) return eyt_inorder_last(n);
+    if (layout == CSL_LAYOUT_STREE) return stree_inorder_last(n);
+    return n - 1;
+}
+
+static int layout_succ(int layout, int k, int n) {
+    if (layout == CSL_LAYOUT_EYTZINGER) return eyt_inorder_succ(k, n);
+    if (layout == CSL_LAYOUT_STREE) return stree_inorder_succ(k, n);
+    return (k + 1 < n) ? k + 1 : -1;
+}
+
+static int layout_pred(int layout, int k, int n) {
+    if (layout == CSL_LAYOUT_EYTZINGER) return eyt_inorder_pred(k, n);
+    if (layout == CSL_LAYOUT_STREE) return stree_inorder_pred(k, n);
+    return k - 1;
+}
+
+/* Search of the body of b in layout (all of b when sorted). */
+static int blk_layout_search(int layout, csl_block* b, csl_key_t key) {
+    if (layout == CSL_LAYOUT_EYTZINGER) return blk_eytzinger_search(b, key);
+    if (layout == CSL_LAYOUT_STREE) return blk_stree_search(b, key);
+    return blk_binary_search(b, key);
+}
+
+/* Position of key in the insert buffer of b, or -1. */
+static int blk_buffer_find(const csl_block* b, csl_key_t key) {
+    int base = b->count - b->nbuf;
+    int j = base + blk_lb_run(b, base, b->nbuf, key);
+    return (j < b->count && blk_key(b, j) == key) ? j : -1;
+}
+
+/* Position of key in b (body or insert buffer), or -1. */
+static int blk_find(int layout, csl_block* b, csl_key_t key) {
+    int idx = blk_layout_search(layout, b, key);
+    if (idx < 0 && b->nbuf) idx = blk_buffer_find(b, key);
+    return (idx >= 0) ? idx : -1;
+}
+
+/* Largest key of the non-empty block b. */
+static csl_key_t blk_max_key(int layout, const csl_block* b) {
+    int nbody = b->count - b->nbuf;
+    csl_key_t top = (b->nbuf) ? blk_key(b, b->count - 1) : INT_MIN;
+    if (nbody > 0) {
+        csl_key_t k = blk_key(b, layout_last(layout, nbody));
+        if (k > top) top = k;
+    }
+    return top;
+}
+
+/* Scratch array of at least n items, kept by the list (in its memory,
+ * so an arena that owns the list owns it too); NULL on OOM. */
+static csl_kv* csl_scratch(cskiplist* sl, int n) {
+    if (n > sl->scratch_cap) {
+        size_t cap = 16;
+        while (cap < (size_t)n) cap *= 2;
+        csl_kv* p = (csl_kv*)csl_mem_alloc(&sl->mem, cap * sizeof(csl_kv));
+        if (!p) return NULL;
+        csl_mem_release(&sl->mem, sl->scratch, (size_t)sl->scratch_cap * sizeof(csl_kv));
+        sl->scratch = p;
+        sl->scratch_cap = (int)cap;
+    }
+    return sl->scratch;
+}
+
+/* Bring the items of b into sorted order, merging its insert buffer. */
+static void blk_to_sorted(cskiplist* sl, csl_block* b) {
+    int n = b->count;
+    int nbody = n - b->nbuf;
+
+    if (sl->layout == CSL_LAYOUT_SORTED || n <= 1) { b->nbuf = 0; return; }
+    csl_kv* tmp = csl_scratch(sl, n);
+    if (!tmp) return;
+    /* in-order walk of the body merged with the buffer */
+    int k = layout_first(sl->layout, nbody);
+    int j = nbody;
+    for (int i = 0; i < n; ++i) {
+        int src;
+        if (j >= n || (k >= 0 && blk_key(b, k) < blk_key(b, j))) {
+            src = k;
+            k = layout_succ(sl->layout, k, nbody);
+        } else {
+            src = j++;
+        }
+        tmp[i].key = blk_key(b, src);
+        tmp[i].val = blk_val(b, src);
+    }
+    for (int i = 0; i < n; ++i) blk_put(b, i, tmp[i].key, tmp[i].val);
+    b->nbuf = 0;
+}
+
+/* Lay out the sorted items of b (all of them become the body). */
+static void blk_from_sorted(cskiplist* sl, csl_block* b) {
+    int n = b->count;
+
+    b->nbuf = 0;
+    if (sl->layout == CSL_LAYOUT_SORTED || n <= 1) return;
+    csl_kv* tmp = csl_scratch(sl, n);
+    if (!tmp) return;
+    for (int i = 0; i < n; ++i) {
+        tmp[i].key = blk_key(b, i);
+        tmp[i].val = blk_val(b, i);
+    }
+    int k = layout_first(sl->layout, n);
+    for (int i = 0; i < n; ++i) {
+        blk_put(b, k, tmp[i].key, tmp[i].val);
+        k = layout_succ(sl->layout, k, n);
+    }
+}
+
+/* Insert key, absent from b, into the insert buffer of b; 0 if the list
+ * is sorted or the block or its buffer is full. */
+static int blk_buffer_put(cskiplist* sl, csl_block* b, csl_key_t key, csl_val_t val) {
+    if (sl->layout == CSL_LAYOUT_SORTED) return 0;
+    if (b->nbuf >= CSL_INSERT_BUF || b->count >= b->item_cap) return 0;
+    int base = b->count - b->nbuf;
+    int pos = base + blk_lb_run(b, base, b->nbuf, key);
+    blk_move(b, pos + 1, pos, b->count - pos);
+    blk_put(b, pos, key, val);
+    b->count++;
+    b->nbuf++;
+    if (key < b->min_key) blk_set_min_key(sl, b, key);
+    sl->size++;
+    sl->stat_inserts++;
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * Fast lanes (see csl_lanes in cskiplist.h).
+ *
+ * The lanes are an implicit CSL_LANE_FANOUT-ary tree over the min_keys of
+ * the blocks, like a CSS-tree: the position found in lane l selects the
+ * window [pos*F, pos*F + F) of lane l-1, so no pointers are stored above
+ * blocks[].  Each window is one aligned cache line of keys.
+ *
+ * Reference: Sprenger, Zeuch & Leser, "Cache-Sensitive Skip List:
+ * Efficient Range Queries on modern CPUs" (IMDM 2016).
+ *----------------------------------------------------------------------------*/
+
+/* Keys in lane l above n blocks; 0 if there is no such lane. */
+static size_t lanes_len(size_t n, int l) {
+    if (n == 0) return 0;
+    for (int i = 0; i < l; ++i) {
+        if (n <= CSL_LANE_FANOUT) return 0;
+        n = (n + CSL_LANE_FANOUT - 1) / CSL_LANE_FANOUT;
+    }
+    return n;
+}
+
+/* Bytes of a lane of n keys, rounded to a cache line. */
+static size_t lanes_lane_bytes(size_t n) {
+    return (n * sizeof(csl_key_t) + CSL_CACHE_LINE - 1) & ~(size_t)(CSL_CACHE_LINE - 1);
+}
+
+/* Bytes of the chunk of lanes with room for cap blocks. */
+static size_t lanes_bytes(size_t cap) {
+    size_t bytes = (sizeof(csl_lanes) + cap * sizeof(csl_block*)
+                    + CSL_CACHE_LINE - 1) & ~(size_t)(CSL_CACHE_LINE - 1);
+    for (int l = 0; l < CSL_MAX_LANES; ++l) bytes += lanes_lane_bytes(lanes_len(cap, l));
+    return bytes;
+}
+
+/* Allocate lanes with room for cap blocks; not built (dirty). */
+static csl_lanes* lanes_alloc(cskiplist* sl, size_t cap) {
+    size_t bytes = lanes_bytes(cap);
+    csl_lanes* ln = (csl_lanes*)csl_mem_alloc(&sl->mem, bytes);
+    if (!ln) return NULL;
+    ln->cap = cap;
+    ln->bytes = bytes;
+    ln->dirty = 1;
+    ln->blocks = (csl_block**)(ln + 1);
+    char* p = (char*)ln + ((sizeof(csl_lanes) + cap * sizeof(csl_block*)
+                            + CSL_CACHE_LINE - 1) & ~(size_t)(CSL_CACHE_LINE - 1));
+    for (int l = 0; l < CSL_MAX_LANES; ++l) {
+        ln->keys[l] = (csl_key_t*)p;
+        p += lanes_lane_bytes(lanes_len(cap, l));
+    }
+    return ln;
+}
+
+/* Rebuild the lanes from the block chain; a larger chunk is allocated
+ * if the blocks do not fit.  Returns 0 on OOM (the lanes stay dirty). */
+static int lanes_build(cskiplist* sl) {
+    csl_lanes* ln = sl->lanes;
+    size_t n = sl->nblocks;
+
+    if (n > ln->cap) {
+        csl_lanes* nl = lanes_alloc(sl, n + n / 4);
+        if (!nl) return 0;
+        csl_mem_release(&sl->mem, ln, ln->bytes);
+        sl->lanes = ln = nl;
+    }
+    n = 0;
+    for (csl_block* b = sl->head->next[0]; b && n < ln->cap; b = b->next[0]) {
+        ln->blocks[n] = b;
+        ln->keys[0][n++] = b->min_key;
+    }
+    ln->nlanes = 0;
+    for (int l = 0; l < CSL_MAX_LANES; ++l) {
+        ln->len[l] = lanes_len(n, l);
+        if (ln->len[l] == 0) break;
+        ln->nlanes = l + 1;
+        if (l > 0) {
+            for (size_t i = 0; i < ln->len[l]; ++i)
+                ln->keys[l][i] = ln->keys[l - 1][i * CSL_LANE_FANOUT];
+        }
+    }
+    ln->dirty = 0;
+    return 1;
+}
+
+/* Number of the n sorted, distinct keys that are <= key. */
+static inline int lane_count_le(const csl_key_t* keys, int n, csl_key_t key) {
+    int lo = csl_lb_keys(keys, 1, n, key);
+    return lo + (lo < n && keys[lo] == key);
+}
+
+/* Position in lane 0 of the last block with min_key <= key, -1 if key
+ * precedes all blocks. */
+static ptrdiff_t lanes_pos(const csl_lanes* ln, csl_key_t key) {
+    int l = ln->nlanes - 1;
+    if (l < 0) return -1;
+    ptrdiff_t pos = lane_count_le(ln->keys[l], (int)ln->len[l], key) - 1;
+    if (pos < 0) return -1;
+    /* keys[l-1][pos*F] == keys[l][pos] <= key, so each count is >= 1 */
+    for (--l; l >= 0; --l) {
+        size_t start = (size_t)pos * CSL_LANE_FANOUT;
+        size_t len = ln->len[l] - start;
+        if (len > CSL_LANE_FANOUT) len = CSL_LANE_FANOUT;
+        pos = (ptrdiff_t)start + lane_count_le(ln->keys[l] + start, (int)len, key) - 1;
+    }
+    return pos;
+}
+
+/* The min_key of a block changed from old_key to key: write it in place. */
+static void lanes_set_min_key(cskiplist* sl, csl_key_t old_key, csl_key_t key) {
+    csl_lanes* ln = sl->lanes;
+    if (ln->dirty) return;
+    ptrdiff_t pos = lanes_pos(ln, old_key);
+    if (pos < 0 || ln->keys[0][pos] != old_key) { ln->dirty = 1; return; }
+    ln->keys[0][pos] = key;
+    for (int l = 1; l < ln->nlanes && pos % CSL_LANE_FANOUT == 0; ++l) {
+        pos /= CSL_LANE_FANOUT;
+        ln->keys[l][pos] = key;
+    }
+}
+
+/* Concurrent mode (see below). */
+static int cc_insert(cskiplist* sl, csl_key_t key, csl_val_t val);
+static int cc_delete(cskiplist* sl, csl_key_t key, void (*free_val)(csl_val_t));
+static csl_block* locate_block_cc(cskiplist* sl, csl_key_t key);
+static inline csl_block* blk_next_le(const cskiplist* sl, const csl_block* x, int lvl, csl_key_t key);
+
+/* locate_block() through the fast lanes when they are on; in concurrent
+ * mode as readers do. */
+static csl_block* find_block(cskiplist* sl, csl_key_t key) {
+    csl_lanes* ln = sl->lanes;
+    if (sl->sync) return locate_block_cc(sl, key);
+    if (!ln || (ln->dirty && !lanes_build(sl))) return locate_block(sl, key);
+    ptrdiff_t pos = lanes_pos(sl->lanes, key);
+    return (pos < 0) ? sl->head : sl->lanes->blocks[pos];
+}
+
+int csl_append(cskiplist* sl, csl_key_t key, csl_val_t val) {
+    if (!sl) return -1;
+    if (sl->sync) return cc_insert(sl, key, val);
+    csl_block* tail = sl->tail;
+
+    /* Lazy tail discovery: lists whose chains were built manually (tests,
+     * bulk loaders) may not have set sl->tail. */
+    if (!tail) {
+        csl_block* t = sl->head;
+        while (t->next[0]) t = t->next[0];
+        if (t != sl->head) sl->tail = tail = t;
+    }
+
+    /* A new maximum goes to the insert buffer of a laid-out tail. */
+    if (tail && tail->count > 0 && sl->layout != CSL_LAYOUT_SORTED &&
+        key > blk_max_key(sl->layout, tail) && blk_buffer_put(sl, tail, key, val)) {
+        sl->widths_stale = 1;
+        return 1;
+    }
+
+    int relayout = 0;
+    if (tail) {
+        relayout = sl->layout != CSL_LAYOUT_SORTED;
+        if (relayout) blk_to_sorted(sl, tail);
+
+        /* Update of the current maximum key — must be checked BEFORE the
+         * "block full" test, otherwise a duplicate lands in a new block. */
+        if (tail->count > 0 && blk_key(tail, tail->count - 1) == key) {
+            blk_put_val(tail, tail->count - 1, val);
+            sl->stat_updates++;
+            if (relayout) blk_from_sorted(sl, tail);
+            return 0;
+        }
+
+        /* Out-of-order key: delegate to the general insert (handles
+         * ordering, splits and layout conversion uniformly). */
+        if (tail->count > 0 && key < blk_key(tail, tail->count - 1)) {
+            if (relayout) blk_from_sorted(sl, tail);
+            return csl_insert(sl, key, val);
+        }
+    }
+
+    if (!tail || tail->count >= tail->item_cap) {
+        if (tail && relayout) blk_from_sorted(sl, tail);
+        csl_block* nb = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
+        if (!nb) return -1;
+        nb->min_key = key;
+        splice_block(sl, nb);
+        tail = nb;
+        relayout = 0;
+    }
+
+    /* fast append at the end of the tail block; the widths of the slots
+     * over it are left to a recount */
+    blk_put(tail, tail->count, key, val);
+    tail->count++;
+    if (tail->count == 1) tail->min_key = key;
+    sl->widths_stale = 1;
+    sl->size++;
+    sl->stat_inserts++;
+    blk_from_sorted(sl, tail);
+    return 1;
+}
+
+/* Finish the lookup of key in block b, where it is at idx (-1 if it is
+ * not): a key >= the min_key of the next block is looked up there.
+ * 1 and *val if found, else 0. */
+static int blk_lookup_from(cskiplist* sl, csl_block* b, int idx, csl_key_t key, csl_val_t* val) {
+    csl_block* nx;
+    if (idx < 0 && (nx = blk_next_le(sl, b, 0, key))) {
+        b = nx;
+        idx = blk_find(sl->layout, b, key);
+    }
+    if (idx < 0) return 0;
+    *val = blk_val(b, idx);
+    return 1;
+}
+
+/* Look key up in b, the block found for it (or head), and the next
+ * block; 1 and *val if it is there, else 0. */
+static int blk_lookup(cskiplist* sl, csl_block* b, csl_key_t key, csl_val_t* val) {
+    if (b == sl->head) b = blk_next_acq(b, 0); /* first data block */
+    if (!b) return 0;
+    /* key could be in this block only if key >= min_key and < next.min_key */
+    return blk_lookup_from(sl, b, blk_find(sl->layout, b, key), key, val);
+}
+
+csl_val_t csl_search(cskiplist* sl, csl_key_t key) {
+    csl_val_t val = CSL_VAL_NONE;
+    if (sl) blk_lookup(sl, find_block(sl, key), key, &val);
+    return val;
+}
+
+/*-----------------------------------------------------------------------------
+ * Batched search (group prefetching).
+ *
+ * A single search is a chain of dependent misses: a tower slot, the block
+ * it leads to, its slot one level down, ..., and then the probes of the
+ * block search.  csl_search_batch() runs CSL_BATCH_GROUP searches side by
+ * side, in rounds: each round takes every search of the group one step
+ * (right or down in the towers, one probe in the block) and prefetches
+ * what that search reads in the next round, so the misses of the group
+ * overlap instead of following each other.  With fast lanes the lanes
+ * (a few cache lines) replace the towers and only the blocks are
+ * prefetched.  The probes of a sorted or Eytzinger body are known one
+ * step ahead; an S-tree block is searched as usual after a prefetch of
+ * its root node, and insert buffers after the body.
+ *
+ * Reference: Chen, Ailamaki, Gibbons & Mowry, "Improving Hash Join
+ * Performance through Prefetching" (ICDE 2004).
+ *----------------------------------------------------------------------------*/
+
+static inline void blk_prefetch_key(const csl_block* b, int i) {
+    if (b->keys) __builtin_prefetch(&b->keys[i], 0, 3);
+    else __builtin_prefetch(&b->items[i], 0, 3);
+}
+
+/* Prefetch the header of b and the lower slots of its tower.  (The
+ * address of a fat slot key depends on b->skip_alloc, a load that would
+ * wait for the very line being prefetched.) */
+static inline void blk_prefetch_tower(const csl_block* b) {
+    __builtin_prefetch(b, 0, 3);
+    __builtin_prefetch((const char*)b + CSL_CACHE_LINE, 0, 3);
+}
+
+/* Sorted blocks b[0..m) (NULL: none): idx[j] = position of k[j] in b[j],
+ * or -1.  Branchless binary searches, one probe per search and round. */
+static void blk_batch_sorted(csl_block* const* b, const csl_key_t* k, int m, int* idx) {
+    int pos[CSL_BATCH_GROUP], len[CSL_BATCH_GROUP];
+    for (int j = 0; j < m; ++j) {
+        pos[j] = 0;
+        len[j] = b[j] ? b[j]->count : 0;
+        if (len[j] > 0) blk_prefetch_key(b[j], len[j] >> 1);
+    }
+    for (int active = m; active > 0; ) {
+        active = 0;
+        for (int j = 0; j < m; ++j) {
+            if (len[j] <= 1) continue;
+            int half = len[j] >> 1;
+            if (blk_key(b[j], pos[j] + half) <= k[j]) pos[j] += half;
+            len[j] -= half;
+            if (len[j] > 1) {
+                blk_prefetch_key(b[j], pos[j] + (len[j] >> 1));
+                active++;
+            }
+        }
+    }
+    for (int j = 0; j < m; ++j)
+        idx[j] = (len[j] == 1 && blk_key(b[j], pos[j]) == k[j]) ? pos[j] : -1;
+}
+
+/* The same for the Eytzinger bodies of b[0..m): one level per round. */
+static void blk_batch_eytzinger(csl_block* const* b, const csl_key_t* k, int m, int* idx) {
+    int node[CSL_BATCH_GROUP], nb[CSL_BATCH_GROUP];
+    for (int j = 0; j < m; ++j) {
+        node[j] = 0;
+        idx[j] = -1;
+        nb[j] = b[j] ? b[j]->count - b[j]->nbuf : 0;
+        if (nb[j] > 0) blk_prefetch_key(b[j], 0);
+    }
+    for (int active = m; active > 0; ) {
+        active = 0;
+        for (int j = 0; j < m; ++j) {
+            int i = node[j];
+            if (i >= nb[j]) continue;
+            csl_key_t c = blk_key(b[j], i);
+            if (c == k[j]) { idx[j] = i; node[j] = nb[j]; continue; }
+            node[j] = i = 2 * i + 1 + (c < k[j]);
+            if (i < nb[j]) {
+                blk_prefetch_key(b[j], i);
+                active++;
+            }
+        }
+    }
+}
+
+size_t csl_search_batch(cskiplist* sl, const csl_key_t* keys, size_t n, csl_val_t* out_vals) {
+    if (!sl || !keys || !out_vals) return 0;
+    if (sl->sync) { /* the rounds read the fat skip keys */
+        size_t found = 0;
+        for (size_t i = 0; i < n; ++i) {
+            out_vals[i] = CSL_VAL_NONE;
+            found += (size_t)blk_lookup(sl, find_block(sl, keys[i]), keys[i], &out_vals[i]);
+        }
+        return found;
+    }
+    int lanes = sl->lanes && (!sl->lanes->dirty || lanes_build(sl));
+    csl_block* cur[CSL_BATCH_GROUP];
+    int lvl[CSL_BATCH_GROUP], idx[CSL_BATCH_GROUP];
+    size_t found = 0;
+
+    for (size_t g = 0; g < n; g += CSL_BATCH_GROUP) {
+        const csl_key_t* k = keys + g;
+        int m = (n - g < CSL_BATCH_GROUP) ? (int)(n - g) : CSL_BATCH_GROUP;
+        if (m == 1) { /* nothing to overlap */
+            out_vals[g] = CSL_VAL_NONE;
+            found += (size_t)blk_lookup(sl, find_block(sl, k[0]), k[0], &out_vals[g]);
+            break;
+        }
+
+        /* find the block of every key */
+        if (lanes) {
+            for (int j = 0; j < m; ++j) {
+                ptrdiff_t pos = lanes_pos(sl->lanes, k[j]);
+                cur[j] = (pos < 0) ? sl->head : sl->lanes->blocks[pos];
+                __builtin_prefetch(cur[j], 0, 3);
+            }
+        } else {
+            for (int j = 0; j < m; ++j) { cur[j] = sl->head; lvl[j] = sl->level; }
+            for (int active = m; active > 0; ) {
+                active = 0;
+                for (int j = 0; j < m; ++j) {
+                    int l = lvl[j];
+                    if (l < 0) continue;
+                    /* x is linked at level l, so l < x->skip_alloc; the
+                     * step is a select, as the comparison is a coin flip */
+                    csl_block* x = cur[j];
+                    csl_block* nx = x->next[l];
+#if CSL_FAT_SKIPS
+                    int right = (nx != NULL) & (blk_next_key(x, l) <= k[j]);
+#else
+                    int right = nx != NULL && nx->min_key <= k[j];
+#endif
+                    cur[j] = right ? nx : x;
+                    lvl[j] = l -= !right;
+                    if (right) blk_prefetch_tower(nx);
+                    active += (l >= 0);
+                }
+            }
+        }
+        for (int j = 0; j < m; ++j)
+            if (cur[j] == sl->head) cur[j] = sl->head->next[0]; /* first data block */
+
+        /* search the blocks */
+        if (sl->layout == CSL_LAYOUT_SORTED) {
+            blk_batch_sorted(cur, k, m, idx);
+        } else if (sl->layout == CSL_LAYOUT_EYTZINGER) {
+            blk_batch_eytzinger(cur, k, m, idx);
+        } else {
+            for (int j = 0; j < m; ++j)
+                if (cur[j]) blk_prefetch_key(cur[j], 0);
+            for (int j = 0; j < m; ++j) {
+                int i = cur[j] ? blk_layout_search(sl->layout, cur[j], k[j]) : -1;
+                idx[j] = (i >= 0) ? i : -1;
+            }
+        }
+        for (int j = 0; j < m; ++j) {
+            out_vals[g + j] = CSL_VAL_NONE;
+            if (!cur[j]) continue;
+            if (idx[j] < 0 && cur[j]->nbuf) idx[j] = blk_buffer_find(cur[j], k[j]);
+            found += (size_t)blk_lookup_from(sl, cur[j], idx[j], k[j], &out_vals[g + j]);
+        }
+    }
+    return found;
+}
+
+/* helper: split a full block into two roughly equal halves.
+ * The new right block gets a probabilistic tower height and is spliced
+ * into all its levels, keeping the skip structure valid (no rebuild). */
 static csl_block* blk_split(cskiplist* sl, csl_block* b) {
     int right_cnt = b->count / 2;
     int left_cnt = b->count - right_cnt;
-    csl_block* nb = blk_alloc_with_cap(sl->block_cap, random_height(sl));
+    csl_block* nb = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
     if (!nb) return NULL;
     /* move right half into nb */
-    memcpy(nb->items, &b->items[left_cnt], right_cnt * sizeof(csl_kv));
+    blk_copy(nb, 0, b, left_cnt, right_cnt);
     nb->count = right_cnt;
-    nb->min_key = nb->items[0].key;
+    nb->min_key = blk_key(nb, 0);
     /* fix left block count (its min_key is unchanged) */
     b->count = left_cnt;
-    b->min_key = b->items[0].key;
+    b->min_key = blk_key(b, 0);
     sl->stat_splits++;
     splice_block(sl, nb); /* links all levels, prev, tail, nblocks */
     return nb;
@@ -616,35 +1804,49 @@ static csl_block* blk_split(cskiplist* sl, csl_block* b) {
 
 int csl_insert(cskiplist* sl, csl_key_t key, csl_val_t val) {
     if (!sl) return -1;
+    if (sl->sync) return cc_insert(sl, key, val);
 
     /* Skip pointers are maintained incrementally, so the skip traversal is
-     * always valid: O(log n_blocks) instead of a level-0 linear scan. */
-    csl_block* b = locate_block(sl, key);
-    if (b == sl->head) b = sl->head->next[0]; /* key precedes first block */
+     * always valid: O(log n_blocks) instead of a level-0 linear scan.
+     * path[] holds the slots whose widths the new item adds to. */
+    csl_block* path[CSL_MAX_LEVEL];
+    csl_block* b = locate_block_path(sl, key, path);
+    int on_path = b != sl->head;
+    if (!on_path) b = sl->head->next[0]; /* key precedes first block */
 
     if (!b) {
         /* empty list: create the first data block */
-        csl_block* nb = blk_alloc_with_cap(sl->block_cap, random_height(sl));
+        csl_block* nb = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
         if (!nb) return -1;
         nb->min_key = key;
-        nb->items[0].key = key;
-        nb->items[0].val = val;
+        blk_put(nb, 0, key, val);
         nb->count = 1;
         splice_block(sl, nb);
+        blk_widths_add(sl, nb, 1);
         sl->size++;
         sl->stat_inserts++;
         return 1;
     }
 
-    /* If Eytzinger layout is active, convert block to sorted for manipulation */
-    int was_eyt = sl->eytzinger && b->count > 1;
-    if (was_eyt) blk_eytzinger_to_sorted(b);
+    /* If a search layout is active, update in place or insert into the
+     * buffer; else convert block to sorted for manipulation */
+    int relayout = sl->layout != CSL_LAYOUT_SORTED;
+    if (relayout) {
+        int idx = blk_find(sl->layout, b, key);
+        if (idx >= 0) { blk_put_val(b, idx, val); sl->stat_updates++; return 0; }
+        if (blk_buffer_put(sl, b, key, val)) {
+            if (on_path) widths_add(sl, path, 1);
+            else blk_widths_add(sl, b, 1);
+            return 1;
+        }
+        blk_to_sorted(sl, b);
+    }
 
     /* insert/update within block, splitting if needed */
     int pos = blk_binary_search(b, key);
     if (pos >= 0) {
-        b->items[pos].val = val; sl->stat_updates++;
-        if (was_eyt) blk_sorted_to_eytzinger(b);
+        blk_put_val(b, pos, val); sl->stat_updates++;
+        if (relayout) blk_from_sorted(sl, b);
         return 0;
     }
     pos = -pos - 1;
@@ -654,131 +1856,1156 @@ int csl_insert(cskiplist* sl, csl_key_t key, csl_val_t val) {
     if (b->count >= b->item_cap) {
         /* full: split, then insert into whichever half owns the key */
         right = blk_split(sl, b);
-        if (!right) { if (was_eyt) blk_sorted_to_eytzinger(b); return -1; }
+        if (!right) { if (relayout) blk_from_sorted(sl, b); return -1; }
         if (key >= right->min_key) target = right;
         pos = blk_binary_search(target, key);
         pos = -pos - 1; /* key is known absent */
     }
 
-    memmove(&target->items[pos+1], &target->items[pos],
-            (target->count - pos) * sizeof(csl_kv));
-    target->items[pos].key = key;
-    target->items[pos].val = val;
+    blk_move(target, pos + 1, pos, target->count - pos);
+    blk_put(target, pos, key, val);
     target->count++;
-    if (pos == 0) target->min_key = key;
+    if (pos == 0) blk_set_min_key(sl, target, key);
+    /* a split may have raised the level above path[] */
+    if (on_path && !right) widths_add(sl, path, 1);
+    else blk_widths_add(sl, target, 1);
     sl->size++;
     sl->stat_inserts++;
-    if (sl->eytzinger) {
-        blk_sorted_to_eytzinger(b);
-        if (right) blk_sorted_to_eytzinger(right);
-    }
+    blk_from_sorted(sl, b);
+    if (right) blk_from_sorted(sl, right);
     return 1;
 }
 
+/*-----------------------------------------------------------------------------
+ * Sorted batch insert (merge).
+ *
+ * csl_insert_sorted() walks the blocks once, left to right.  The pairs that
+ * fall into a block (the keys below the min_key of the next block) are
+ * merged with its items.  A block that overflows is not split in halves:
+ * the merged items are dealt out evenly over it and as many new blocks as
+ * it takes to stay within CSL_MERGE_FILL percent, and the new blocks are
+ * linked in behind it with the predecessors the walk keeps (update[]), so
+ * no block is located from the head twice.
+ *----------------------------------------------------------------------------*/
+
+/* locate_block() for keys that only grow, as a finger search: update[lvl]
+ * is the last block on level lvl with min_key <= the previous key (the
+ * head at first).  The levels whose next block is still beyond key keep
+ * their update[]; the search descends from the lowest of them.  Leaves
+ * update[lvl] at the last block on level lvl with min_key <= key. */
+static csl_block* locate_block_from(cskiplist* sl, csl_key_t key, csl_block** update) {
+    int top = 0;
+    while (top <= sl->level && update[top]->next[top] &&
+           blk_next_key(update[top], top) <= key)
+        ++top;
+    if (top == 0) return update[0];
+    int lvl = (top > sl->level) ? sl->level : top - 1;
+    csl_block* x = update[(top > sl->level) ? sl->level : top];
+    for (; lvl >= 0; --lvl) {
+        while (x->next[lvl] && blk_next_key(x, lvl) <= key)
+            x = x->next[lvl];
+        update[lvl] = x;
+    }
+    return x;
+}
+
+/* Merge the sorted pairs run[0..m), which belong in block b (their keys
+ * are below the min_key of the next block), with the items of b; a pair
+ * updates an item or an earlier pair with its key.  update[lvl] is the
+ * last block on level lvl up to b; blocks added behind b are linked with
+ * it and it ends at the last of them.  Returns the number of new keys,
+ * -1 on OOM (b is unchanged). */
+static ptrdiff_t blk_merge_run(cskiplist* sl, csl_block* b, const csl_kv* run, size_t m,
+                               csl_block** update) {
+    size_t added = 0;
+
+    /* a few pairs go to the insert buffer of a laid-out block, as with
+     * csl_insert */
+    if (sl->layout != CSL_LAYOUT_SORTED && b->count > 0 &&
+        m <= (size_t)(CSL_INSERT_BUF - b->nbuf) && b->count + (int)m <= b->item_cap) {
+        for (size_t r = 0; r < m; ++r) {
+            int idx = blk_find(sl->layout, b, run[r].key);
+            if (idx >= 0) { blk_put_val(b, idx, run[r].val); sl->stat_updates++; }
+            else added += (size_t)blk_buffer_put(sl, b, run[r].key, run[r].val);
+        }
+        return (ptrdiff_t)added;
+    }
+
+    int nold = b->count;
+    blk_to_sorted(sl, b);
+    for (size_t r = 0; r < m; ++r) {
+        if (r + 1 < m && run[r + 1].key == run[r].key) continue;
+        added += blk_binary_search(b, run[r].key) < 0;
+    }
+    size_t total = (size_t)nold + added;
+
+    if (total <= (size_t)b->item_cap) {
+        /* in place, from the back: the items > the pair move up, then the
+         * pair (the last one of its key) is written below them */
+        int w = (int)total, a = nold - 1;
+        for (size_t r = m; r > 0; ) {
+            csl_key_t key = run[r - 1].key;
+            csl_val_t val = run[--r].val;
+            int lo = blk_lb_run(b, 0, a + 1, key);   /* last item <= key */
+            lo += (lo <= a && blk_key(b, lo) == key) - 1;
+            blk_move(b, w - (a - lo), lo + 1, a - lo);
+            w -= a - lo;
+            a = lo;
+            while (r > 0 && run[r - 1].key == key) { --r; sl->stat_updates++; }
+            if (a >= 0 && blk_key(b, a) == key) { --a; sl->stat_updates++; }
+            blk_put(b, --w, key, val);
+        }
+        b->count = (int)total;
+        if (run[0].key < b->min_key) blk_set_min_key(sl, b, run[0].key);
+        sl->size += added;
+        sl->stat_inserts += added;
+        blk_from_sorted(sl, b);
+        return (ptrdiff_t)added;
+    }
+
+    /* b overflows: its items go to the scratch array and the merge is
+     * dealt out over b and new blocks filled to CSL_MERGE_FILL */
+    csl_kv* old = csl_scratch(sl, nold > 0 ? nold : 1);
+    if (!old) { blk_from_sorted(sl, b); return -1; }
+    for (int i = 0; i < nold; ++i) {
+        old[i].key = blk_key(b, i);
+        old[i].val = blk_val(b, i);
+    }
+    size_t fill = (size_t)sl->block_cap * CSL_MERGE_FILL / 100;
+    if (fill < 1) fill = 1;
+    size_t nblk = (total + fill - 1) / fill;
+    csl_block* spare = NULL; /* the new blocks, chained through next[0] */
+    for (size_t i = 1; i < nblk; ++i) {
+        csl_block* nb = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
+        if (!nb) {
+            while (spare) { csl_block* t = spare->next[0]; blk_release(sl, spare); spare = t; }
+            blk_from_sorted(sl, b);
+            return -1;
+        }
+        nb->next[0] = spare;
+        spare = nb;
+    }
+
+    /* block k of the run gets per items, one more if k < extra */
+    size_t per = total / nblk, extra = total % nblk, k = 0;
+    size_t quota = per + (extra > 0);
+    csl_block* cur = b;
+    int nout = 0;
+    int a = 0;
+    size_t r = 0;
+    while (a < nold || r < m) {
+        csl_key_t key;
+        csl_val_t val;
+        if (r < m && (a >= nold || run[r].key <= old[a].key)) {
+            key = run[r].key;
+            while (r + 1 < m && run[r + 1].key == key) { ++r; sl->stat_updates++; }
+            val = run[r++].val;
+            if (a < nold && old[a].key == key) { ++a; sl->stat_updates++; }
+        } else {
+            key = old[a].key;
+            val = old[a].val;
+            ++a;
+        }
+        if ((size_t)nout == quota) {
+            csl_block* nb = spare;
+            spare = nb->next[0];
+            nb->next[0] = NULL;
+            cur->count = nout;
+            nb->min_key = key;
+            link_block(sl, nb, update);
+            sl->stat_splits++;
+            cur = nb;
+            nout = 0;
+            quota = per + (++k < extra);
+        }
+        blk_put(cur, nout++, key, val);
+    }
+    cur->count = nout;
+    if (run[0].key < b->min_key) blk_set_min_key(sl, b, run[0].key);
+    sl->size += added;
+    sl->stat_inserts += added;
+    for (csl_block* x = b; ; x = x->next[0]) {
+        blk_from_sorted(sl, x);
+        if (x == cur) break;
+    }
+    return (ptrdiff_t)added;
+}
+
+ptrdiff_t csl_insert_sorted(cskiplist* sl, const csl_kv* kvs, size_t n) {
+    csl_block* update[CSL_MAX_LEVEL];
+    ptrdiff_t added = 0;
+
+    if (!sl) return -1;
+    for (size_t i = sl->sync ? 0 : 1; i < n; ++i) {
+        if (i > 0 && kvs[i].key >= kvs[i - 1].key) continue;
+        /* not sorted, or concurrent mode: one at a time */
+        for (size_t j = 0; j < n; ++j) {
+            int rc = csl_insert(sl, kvs[j].key, kvs[j].val);
+            if (rc < 0) return -1;
+            added += rc;
+        }
+        return added;
+    }
+
+    /* the merges leave the slot widths to a recount */
+    sl->widths_stale = 1;
+    for (int lvl = 0; lvl < CSL_MAX_LEVEL; ++lvl) update[lvl] = sl->head;
+    for (size_t i = 0; i < n; ) {
+        csl_block* b = locate_block_from(sl, kvs[i].key, update);
+        if (b == sl->head) {
+            /* the key precedes the first block, which takes it */
+            b = sl->head->next[0];
+            if (!b) {
+                b = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
+                if (!b) return -1;
+                b->min_key = kvs[i].key;
+                link_block(sl, b, update);
+            }
+            for (int lvl = 0; lvl < b->skip_alloc; ++lvl)
+                if (sl->head->next[lvl] == b) update[lvl] = b;
+        }
+
+        /* the pairs of b: keys below the next block */
+        size_t j = i + 1;
+        if (!b->next[0]) j = n;
+        else {
+            csl_key_t limit = blk_next_key(b, 0);
+            while (j < n && kvs[j].key < limit) ++j;
+        }
+        ptrdiff_t rc = blk_merge_run(sl, b, kvs + i, j - i, update);
+        if (rc < 0) return -1;
+        added += rc;
+        i = j;
+    }
+    return added;
+}
+
+/* The neighbour of b, holding count items, that takes part in its
+ * underflow: the previous or the next block if the two fit in
+ * CSL_MERGE_FILL percent of a block, else the fuller of them; NULL for
+ * the only block. */
+static csl_block* blk_underflow_mate(const csl_block* b, int count) {
+    csl_block* p = b->prev;
+    csl_block* nx = b->next[0];
+    int limit = b->item_cap * CSL_MERGE_FILL / 100;
+
+    if (p && p->count + count <= limit) return p;
+    if (nx && count + nx->count <= limit) return nx;
+    if (p && (!nx || p->count >= nx->count)) return p;
+    return nx;
+}
+
+/* Merge the sorted items of r into l, the block before it, if the two
+ * fit in CSL_MERGE_FILL percent of l (returns 1, r is left empty), else
+ * move items over until both hold about half of the two (returns 0).
+ * Only the items and counts change. */
+static int blk_rebalance(csl_block* l, csl_block* r) {
+    if (l->count + r->count <= l->item_cap * CSL_MERGE_FILL / 100) {
+        blk_copy(l, l->count, r, 0, r->count);
+        l->count += r->count;
+        r->count = 0;
+        return 1;
+    }
+    int half = (l->count + r->count + 1) / 2;
+    if (l->count > half) {
+        int k = l->count - half;
+        blk_move(r, k, 0, r->count);
+        blk_copy(r, 0, l, half, k);
+        r->count += k;
+        l->count = half;
+    } else {
+        int k = half - l->count;
+        blk_copy(l, l->count, r, 0, k);
+        l->count = half;
+        blk_move(r, 0, k, r->count - k);
+        r->count -= k;
+    }
+    return 0;
+}
+
+/* b lost an item and holds fewer than CSL_MIN_FILL percent of its
+ * capacity: merge it with a neighbour if the two fit in CSL_MERGE_FILL
+ * percent of a block, else move items over from the fuller neighbour
+ * until both hold about half of the two. */
+static void blk_underflow(cskiplist* sl, csl_block* b) {
+    csl_block* m = blk_underflow_mate(b, b->count);
+    if (!m) return; /* the only block */
+    csl_block* l = (m == b->prev) ? m : b;
+    csl_block* r = (m == b->prev) ? b : m;
+
+    blk_to_sorted(sl, l);
+    blk_to_sorted(sl, r);
+    int rcount = r->count;
+    if (blk_rebalance(l, r)) {
+        /* r's slots go to the slots before it, the moved items with them */
+        unsplice_block(sl, r);
+        blk_release(sl, r);
+        sl->stat_merges++;
+        blk_from_sorted(sl, l);
+        return;
+    }
+    blk_set_min_key(sl, r, blk_key(r, 0));
+    blk_widths_shift(sl, r, r->count - rcount);
+    blk_from_sorted(sl, l);
+    blk_from_sorted(sl, r);
+}
+
 int csl_delete(cskiplist* sl, csl_key_t key, void (*free_val)(csl_val_t)) {
     if (!sl) return 0;
-    csl_block* b = locate_block(sl, key);
+    if (sl->sync) return cc_delete(sl, key, free_val);
+    csl_block* path[CSL_MAX_LEVEL];
+    csl_block* b = locate_block_path(sl, key, path);
     if (b == sl->head) return 0; /* key precedes the first block: not present */
 
-    /* If Eytzinger, convert to sorted for manipulation */
-    int was_eyt = sl->eytzinger && b->count > 1;
-    if (was_eyt) blk_eytzinger_to_sorted(b);
+    /* If a search layout is active, remove a buffered key in place (unless
+     * it is the min_key); else convert to sorted for manipulation */
+    int relayout = sl->layout != CSL_LAYOUT_SORTED;
+    if (relayout) {
+        int idx = blk_find(sl->layout, b, key);
+        if (idx < 0) return 0;
+        if (idx >= b->count - b->nbuf && key != b->min_key) {
+            if (free_val) free_val(blk_val(b, idx));
+            blk_move(b, idx, idx + 1, b->count - idx - 1);
+            b->count--;
+            b->nbuf--;
+            widths_add(sl, path, -1);
+            sl->size--;
+            sl->stat_deletes++;
+            if (b->count < b->item_cap * CSL_MIN_FILL / 100) blk_underflow(sl, b);
+            return 1;
+        }
+        blk_to_sorted(sl, b);
+    }
 
     int idx = blk_binary_search(b, key);
     if (idx < 0) {
-        if (was_eyt) blk_sorted_to_eytzinger(b);
+        if (relayout) blk_from_sorted(sl, b);
         return 0;
     }
-    if (free_val) free_val(b->items[idx].val);
-    memmove(&b->items[idx], &b->items[idx+1], (b->count - idx - 1) * sizeof(csl_kv));
+    if (free_val) free_val(blk_val(b, idx));
+    blk_move(b, idx, idx + 1, b->count - idx - 1);
     b->count--;
+    widths_add(sl, path, -1);
     sl->size--;
     sl->stat_deletes++;
     if (b->count == 0) {
         /* remove the emptied block from all skip levels, then free it */
         unsplice_block(sl, b);
-        free(b->items);
-        free(b->next);
-        free(b);
+        blk_release(sl, b);
+    } else {
+        if (idx == 0) blk_set_min_key(sl, b, blk_key(b, 0));
+        blk_from_sorted(sl, b);
+        if (b->count < b->item_cap * CSL_MIN_FILL / 100) blk_underflow(sl, b);
+    }
+    return 1;
+}
+
+/*-----------------------------------------------------------------------------
+ * Concurrent mode (csl_set_concurrent).
+ *
+ * Readers take no lock and write nothing but their epoch slot, so a block
+ * that readers may see is never changed again, except for its links.  A
+ * writer (one at a time, under sync->lock) copies the blocks it changes,
+ * changes the copies (cc_insert, cc_delete: the insert, split, delete or
+ * underflow of the list's own code) and links them in place of the old
+ * ones (cc_replace): first the links of the copies, then, with release
+ * stores, the link of the block before them on every level and the prev
+ * pointer of the block behind them.  A reader that reads a link with an
+ * acquire load finds the block behind it complete, and a reader that is
+ * still on an old block finds all of its keys and links as they were, up
+ * to blocks that are live or retired no earlier than it.  Either way it
+ * sees every key that the writers leave alone.
+ *
+ * The readers compare keys with the min_key of the blocks, which never
+ * changes once a block is linked, not with the fat keys of the slots:
+ * a slot's key and its link cannot be read as one, and the pair of a new
+ * key and an old link would lead a search past its block.
+ *
+ * Old blocks are retired with the epoch of the list and released once it
+ * has moved on twice (epoch-based reclamation, as in Fraser's thesis):
+ * a reader publishes the epoch it starts in, and the epoch only moves on
+ * while every reader inside a section is at the current one.  So a block
+ * retired in epoch e is released when the readers of epoch e are gone,
+ * and those that started later never saw it.
+ *
+ * Reference: K. Fraser, "Practical lock-freedom" (PhD thesis, Cambridge
+ * 2004), and Hart et al., "Performance of memory reclamation for lockless
+ * synchronization" (JPDC 2007).
+ *----------------------------------------------------------------------------*/
+
+/* Epoch of a reader slot (0 = outside a section), one per cache line. */
+typedef struct csl_reader_slot {
+    uint64_t epoch;
+    int used;
+    char pad[CSL_CACHE_LINE - sizeof(uint64_t) - sizeof(int)];
+} csl_reader_slot;
+
+typedef struct csl_retired {
+    csl_block* b;
+    uint64_t epoch;   /* epoch of the list when b was unlinked */
+} csl_retired;
+
+struct csl_sync {
+    csl_reader_slot slots[CSL_MAX_READERS];
+    pthread_mutex_t lock;     /* writers */
+    uint64_t epoch;           /* epoch of the list, from 1 */
+    int nslots;               /* slots handed out so far (high-water mark) */
+    csl_retired* retired;     /* unlinked blocks, oldest first */
+    size_t nretired;
+    size_t retired_cap;
+};
+
+/* The state is not in the memory of the list: it holds a mutex. */
+static const csl_allocator csl_libc_mem = { NULL, NULL, NULL };
+
+/* Room for n more retired blocks; 0 on OOM. */
+static int cc_reserve(csl_sync* sy, size_t n) {
+    if (sy->nretired + n <= sy->retired_cap) return 1;
+    size_t cap = sy->retired_cap ? sy->retired_cap * 2 : 64;
+    while (cap < sy->nretired + n) cap *= 2;
+    csl_retired* p = (csl_retired*)realloc(sy->retired, cap * sizeof(csl_retired));
+    if (!p) return 0;
+    sy->retired = p;
+    sy->retired_cap = cap;
+    return 1;
+}
+
+/* Move the epoch on if every reader inside a section is at the current
+ * one, and release the blocks retired two epochs ago or earlier. */
+static void cc_reclaim(cskiplist* sl) {
+    csl_sync* sy = sl->sync;
+    uint64_t e = sy->epoch;
+    int n = __atomic_load_n(&sy->nslots, __ATOMIC_ACQUIRE);
+    int behind = 0;
+
+    /* the unlinks before the slot loads (pairs with csl_read_begin) */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for (int i = 0; i < n && !behind; ++i) {
+        uint64_t r = __atomic_load_n(&sy->slots[i].epoch, __ATOMIC_ACQUIRE);
+        behind = (r != 0 && r != e);
+    }
+    if (!behind) __atomic_store_n(&sy->epoch, ++e, __ATOMIC_RELEASE);
+
+    size_t k = 0;
+    while (k < sy->nretired && sy->retired[k].epoch + 2 <= e)
+        blk_release(sl, sy->retired[k++].b);
+    if (k == 0) return;
+    memmove(sy->retired, sy->retired + k, (sy->nretired - k) * sizeof(csl_retired));
+    sy->nretired -= k;
+}
+
+/* Release every retired block (no reader is inside a section). */
+static void cc_release_all(cskiplist* sl) {
+    csl_sync* sy = sl->sync;
+    for (size_t i = 0; i < sy->nretired; ++i) blk_release(sl, sy->retired[i].b);
+    sy->nretired = 0;
+}
+
+/* Publish t as the link of slot lvl of the linked block b. */
+static inline void blk_link_pub(csl_block* b, int lvl, csl_block* t) {
+#if CSL_FAT_SKIPS
+    csl_skip_keys(b)[lvl] = t ? t->min_key : INT_MAX;
+#endif
+    __atomic_store_n(&b->next[lvl], t, __ATOMIC_RELEASE);
+}
+
+/* A copy of b, in sorted order, not linked; NULL on OOM. */
+static csl_block* cc_copy(cskiplist* sl, const csl_block* b) {
+    csl_block* nb = blk_relocate(sl, b, b->skip_alloc, b->keys != NULL);
+    if (nb) blk_to_sorted(sl, nb);
+    return nb;
+}
+
+/* Link the nnew new blocks nw[] (sorted, min_key set, not linked) in
+ * place of the nold consecutive blocks old[] and retire those; with
+ * nold == 0 the list is empty.  The new blocks are linked on every
+ * level of their towers. */
+static void cc_replace(cskiplist* sl, csl_block** old, int nold, csl_block** nw, int nnew) {
+    csl_block* update[CSL_MAX_LEVEL];
+    csl_block* first[CSL_MAX_LEVEL];
+    csl_block* last = NULL;
+    csl_block* succ0 = NULL;
+    int top = sl->level;
+
+    sl->widths_stale = 1; /* recounted under the lock when asked for */
+    for (int i = 0; i < nnew; ++i) {
+        blk_from_sorted(sl, nw[i]);
+        if (nw[i]->skip_alloc - 1 > top) top = nw[i]->skip_alloc - 1;
+    }
+    for (int lvl = sl->level + 1; lvl <= top; ++lvl) update[lvl] = sl->head;
+    locate_preds(sl, nold ? old[0]->min_key : nw[0]->min_key, update);
+
+    /* the new blocks among themselves and to the first block behind the
+     * old ones on each level */
+    for (int lvl = 0; lvl <= top; ++lvl) {
+        csl_block* succ = update[lvl]->next[lvl];
+        for (int i = 0; i < nold && succ; ) {
+            if (succ == old[i]) { succ = succ->next[lvl]; i = 0; }
+            else ++i;
+        }
+        if (lvl == 0) succ0 = succ;
+        csl_block* at = NULL;
+        first[lvl] = NULL;
+        for (int i = 0; i < nnew; ++i) {
+            if (lvl >= nw[i]->skip_alloc) continue;
+            if (at) blk_link(at, lvl, nw[i]);
+            else first[lvl] = nw[i];
+            at = nw[i];
+        }
+        if (at) blk_link(at, lvl, succ);
+        else first[lvl] = succ;
+    }
+    for (int i = 0; i < nnew; ++i) {
+        nw[i]->prev = i ? nw[i - 1] : (update[0] == sl->head ? NULL : update[0]);
+        last = nw[i];
+    }
+    if (!last) last = (update[0] == sl->head) ? NULL : update[0];
+
+    /* publish */
+    for (int lvl = 0; lvl <= top; ++lvl) blk_link_pub(update[lvl], lvl, first[lvl]);
+    if (succ0) __atomic_store_n(&succ0->prev, last, __ATOMIC_RELEASE);
+    else sl->tail = last;
+    if (top > sl->level) __atomic_store_n(&sl->level, top, __ATOMIC_RELEASE);
+    while (sl->level > 0 && !sl->head->next[sl->level])
+        __atomic_store_n(&sl->level, sl->level - 1, __ATOMIC_RELEASE);
+    sl->nblocks = sl->nblocks + (size_t)nnew - (size_t)nold;
+
+    for (int i = 0; i < nold; ++i) {
+        sl->sync->retired[sl->sync->nretired].b = old[i];
+        sl->sync->retired[sl->sync->nretired++].epoch = sl->sync->epoch;
+    }
+    if (nold) cc_reclaim(sl);
+}
+
+/* csl_insert in concurrent mode, under the lock. */
+static int cc_insert_locked(cskiplist* sl, csl_key_t key, csl_val_t val) {
+    csl_block* b = locate_block(sl, key);
+    if (b == sl->head) b = sl->head->next[0]; /* key precedes first block */
+    csl_block* nw[2];
+    int nnew = 1, ret;
+
+    if (!b) {
+        /* empty list: the first data block */
+        nw[0] = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
+        if (!nw[0]) return -1;
+        blk_put(nw[0], 0, key, val);
+        nw[0]->count = 1;
+        nw[0]->min_key = key;
+        cc_replace(sl, NULL, 0, nw, 1);
+        sl->size++;
+        sl->stat_inserts++;
+        return 1;
+    }
+    if (!cc_reserve(sl->sync, 1) || !(nw[0] = cc_copy(sl, b))) return -1;
+
+    int pos = blk_binary_search(nw[0], key);
+    if (pos >= 0) {
+        blk_put_val(nw[0], pos, val);
+        sl->stat_updates++;
+        ret = 0;
+    } else {
+        pos = -pos - 1;
+        csl_block* target = nw[0];
+        if (target->count >= target->item_cap) {
+            /* full: split the copy, then insert into the half of the key */
+            csl_block* r = blk_alloc_with_cap(sl, sl->block_cap, random_height(sl));
+            if (!r) { blk_release(sl, nw[0]); return -1; }
+            int right_cnt = target->count / 2;
+            blk_copy(r, 0, target, target->count - right_cnt, right_cnt);
+            r->count = right_cnt;
+            target->count -= right_cnt;
+            sl->stat_splits++;
+            nw[nnew++] = r;
+            if (key >= blk_key(r, 0)) target = r;
+            pos = -blk_binary_search(target, key) - 1;
+        }
+        blk_move(target, pos + 1, pos, target->count - pos);
+        blk_put(target, pos, key, val);
+        target->count++;
+        sl->size++;
+        sl->stat_inserts++;
+        ret = 1;
+    }
+    for (int i = 0; i < nnew; ++i) nw[i]->min_key = blk_key(nw[i], 0);
+    cc_replace(sl, &b, 1, nw, nnew);
+    return ret;
+}
+
+/* csl_delete in concurrent mode, under the lock; -1 on OOM (the key
+ * stays). */
+static int cc_delete_locked(cskiplist* sl, csl_key_t key, void (*free_val)(csl_val_t)) {
+    csl_block* b = locate_block(sl, key);
+    if (b == sl->head || blk_find(sl->layout, b, key) < 0) return 0;
+    csl_block* old[2] = { b, NULL };
+    csl_block* nw[2];
+    int nold = 1, nnew = 1;
+    if (!cc_reserve(sl->sync, 2) || !(nw[0] = cc_copy(sl, b))) return -1;
+
+    csl_block* nb = nw[0];
+    int idx = blk_binary_search(nb, key);
+    if (free_val) free_val(blk_val(nb, idx));
+    blk_move(nb, idx, idx + 1, nb->count - idx - 1);
+    nb->count--;
+    sl->size--;
+    sl->stat_deletes++;
+    if (nb->count == 0) {
+        blk_release(sl, nb);
+        nnew = 0;
+    } else if (nb->count < nb->item_cap * CSL_MIN_FILL / 100) {
+        /* underflow on copies of b and its mate (skipped on OOM) */
+        csl_block* m = blk_underflow_mate(b, nb->count);
+        csl_block* mc = m ? cc_copy(sl, m) : NULL;
+        if (mc) {
+            int before = (m == b->prev);
+            nw[0] = before ? mc : nb;
+            nw[1] = before ? nb : mc;
+            old[0] = before ? m : b;
+            old[1] = before ? b : m;
+            nold = nnew = 2;
+            if (blk_rebalance(nw[0], nw[1])) {
+                blk_release(sl, nw[1]);
+                nnew = 1;
+                sl->stat_merges++;
+            }
+        }
+    }
+    for (int i = 0; i < nnew; ++i) nw[i]->min_key = blk_key(nw[i], 0);
+    cc_replace(sl, old, nold, nw, nnew);
+    return 1;
+}
+
+static int cc_insert(cskiplist* sl, csl_key_t key, csl_val_t val) {
+    pthread_mutex_lock(&sl->sync->lock);
+    int ret = cc_insert_locked(sl, key, val);
+    pthread_mutex_unlock(&sl->sync->lock);
+    return ret;
+}
+
+static int cc_delete(cskiplist* sl, csl_key_t key, void (*free_val)(csl_val_t)) {
+    pthread_mutex_lock(&sl->sync->lock);
+    int ret = cc_delete_locked(sl, key, free_val);
+    pthread_mutex_unlock(&sl->sync->lock);
+    return ret;
+}
+
+/* locate_block() for readers in concurrent mode. */
+static csl_block* locate_block_cc(cskiplist* sl, csl_key_t key) {
+    csl_block* x = sl->head;
+    for (int lvl = __atomic_load_n(&sl->level, __ATOMIC_ACQUIRE); lvl >= 0; --lvl) {
+        csl_block* nx;
+        while (lvl < x->skip_alloc && (nx = blk_next_acq(x, lvl)) && nx->min_key <= key)
+            x = nx;
+    }
+    return x;
+}
+
+/* The block after x on level lvl if its min_key <= key, else NULL. */
+static inline csl_block* blk_next_le(const cskiplist* sl, const csl_block* x, int lvl, csl_key_t key) {
+    if (sl->sync) {
+        csl_block* nx = blk_next_acq(x, lvl);
+        return (nx && nx->min_key <= key) ? nx : NULL;
+    }
+    return (x->next[lvl] && blk_next_key(x, lvl) <= key) ? x->next[lvl] : NULL;
+}
+
+int csl_set_concurrent(cskiplist* sl, int enable) {
+    if (!sl) return 0;
+    if (!enable) {
+        if (!sl->sync) return 1;
+        cc_release_all(sl);
+        pthread_mutex_destroy(&sl->sync->lock);
+        free(sl->sync->retired);
+        csl_mem_release(&csl_libc_mem, sl->sync, sizeof(csl_sync));
+        sl->sync = NULL;
+        return 1;
+    }
+    if (sl->sync) return 1;
+    csl_sync* sy = (csl_sync*)csl_mem_alloc(&csl_libc_mem, sizeof(csl_sync));
+    if (!sy) return 0;
+    if (pthread_mutex_init(&sy->lock, NULL) != 0) {
+        csl_mem_release(&csl_libc_mem, sy, sizeof(csl_sync));
+        return 0;
+    }
+    sy->epoch = 1;
+    csl_set_lanes(sl, 0); /* searches build the lanes */
+    sl->sync = sy;
+    return 1;
+}
+
+int csl_reader_register(cskiplist* sl) {
+    if (!sl || !sl->sync) return -1;
+    csl_sync* sy = sl->sync;
+    for (int i = 0; i < CSL_MAX_READERS; ++i) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&sy->slots[i].used, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            int n = __atomic_load_n(&sy->nslots, __ATOMIC_RELAXED);
+            while (n < i + 1 &&
+                   !__atomic_compare_exchange_n(&sy->nslots, &n, i + 1, 0,
+                                                __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+                ;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void csl_reader_unregister(cskiplist* sl, int slot) {
+    if (!sl || !sl->sync || slot < 0 || slot >= CSL_MAX_READERS) return;
+    __atomic_store_n(&sl->sync->slots[slot].epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&sl->sync->slots[slot].used, 0, __ATOMIC_RELEASE);
+}
+
+void csl_read_begin(cskiplist* sl, int slot) {
+    csl_sync* sy = sl->sync;
+    if (!sy) return;
+    __atomic_store_n(&sy->slots[slot].epoch,
+                     __atomic_load_n(&sy->epoch, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+    /* the slot before the first link is read (pairs with cc_reclaim) */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void csl_read_end(cskiplist* sl, int slot) {
+    if (sl->sync) __atomic_store_n(&sl->sync->slots[slot].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/* The items of a block with an insert buffer are visited by merging the
+ * body (in layout order, cursor it->body, -1 past its end) with the
+ * buffer (offset it->buf): both cursors are at the smallest item >= the
+ * current one, it->idx. */
+
+/* Make the smaller cursor the current item; 0 if both are at the end. */
+static int iter_merge_next(csl_iter* it) {
+    const csl_block* b = it->b;
+    int u = b->count - b->nbuf + it->buf;
+    if (it->body >= 0 && (u >= b->count || blk_key(b, it->body) < blk_key(b, u)))
+        it->idx = it->body;
+    else if (u < b->count)
+        it->idx = u;
+    else
+        return 0;
+    return 1;
+}
+
+/* Move to the larger of the items before the cursors; 0 if none. */
+static int iter_merge_prev(csl_iter* it) {
+    const csl_block* b = it->b;
+    int nbody = b->count - b->nbuf;
+    int p = (it->body >= 0) ? layout_pred(it->layout, it->body, nbody)
+                            : layout_last(it->layout, nbody);
+    int u = nbody + it->buf - 1;
+    if (p >= 0 && (it->buf == 0 || blk_key(b, p) > blk_key(b, u))) {
+        it->body = it->idx = p;
+    } else if (it->buf > 0) {
+        it->buf--;
+        it->idx = u;
     } else {
-        if (idx == 0) b->min_key = b->items[0].key;
-        if (sl->eytzinger) blk_sorted_to_eytzinger(b);
+        return 0;
     }
     return 1;
 }
 
+/* Rank cursor of an Eytzinger block it->b without an insert buffer. */
+static void iter_set_rank(csl_iter* it, int rank) {
+    it->rank = rank;
+    if (it->layout == CSL_LAYOUT_EYTZINGER && it->b->count > 0)
+        it->top = eyt_top(it->b->count);
+}
+
+/* Position it at the first / last item of block b. */
+static int iter_enter_first(csl_iter* it, csl_block* b) {
+    it->b = b;
+    if (b->nbuf) {
+        it->body = layout_first(it->layout, b->count - b->nbuf);
+        it->buf = 0;
+        return iter_merge_next(it);
+    }
+    iter_set_rank(it, 0);
+    it->idx = layout_first(it->layout, b->count);
+    return (it->idx >= 0);
+}
+
+static int iter_enter_last(csl_iter* it, csl_block* b) {
+    it->b = b;
+    if (b->nbuf) {
+        it->body = -1;
+        it->buf = b->nbuf;
+        return iter_merge_prev(it);
+    }
+    iter_set_rank(it, b->count - 1);
+    it->idx = layout_last(it->layout, b->count);
+    return (it->idx >= 0);
+}
+
 int csl_iter_first(cskiplist* sl, csl_iter* it) {
     if (!sl || !it) return 0;
-    it->eytzinger = sl->eytzinger;
-    csl_block* b = sl->head->next[0];
+    it->layout = sl->layout;
+    csl_block* b = blk_next_acq(sl->head, 0);
     if (!b || b->count == 0) { it->b = NULL; it->idx = -1; return 0; }
-    it->b = b;
-    it->idx = sl->eytzinger ? eyt_inorder_first(b->count) : 0;
-    return 1;
+    return iter_enter_first(it, b);
+}
+
+void csl_iter_rewind(cskiplist* sl, csl_iter* it) {
+    if (!sl || !it) return;
+    it->layout = sl->layout;
+    it->b = sl->head; /* empty: the next item is the first of the next block */
+    it->idx = 0;
+    it->rank = -1;
+}
+
+/* Position it at the first item >= key, searching from cand, the last
+ * block with min_key <= key (or head). */
+static int iter_seek_in(cskiplist* sl, csl_block* cand, csl_key_t key, csl_iter* it, int* exact) {
+    it->layout = sl->layout;
+    if (cand == sl->head) cand = blk_next_acq(sl->head, 0);
+    if (!cand) { it->b = NULL; it->idx = -1; return 0; }
+    int idx = blk_layout_search(sl->layout, cand, key);
+    int nbody = cand->count - cand->nbuf;
+    it->b = cand;
+    if (cand->nbuf) {
+        /* lower bounds in the body and in the buffer */
+        it->body = (idx >= 0) ? idx : -idx - 1;
+        if (it->body >= nbody) it->body = -1;
+        it->buf = blk_lb_run(cand, nbody, cand->nbuf, key);
+        if (iter_merge_next(it)) {
+            if (exact) *exact = (blk_key(cand, it->idx) == key);
+            return 1;
+        }
+    } else {
+        if (idx >= 0 && exact) *exact = 1;
+        if (idx < 0) idx = -idx - 1; /* lower_bound in cand (a position of the layout) */
+        if (idx < cand->count) {
+            it->idx = idx;
+            if (sl->layout == CSL_LAYOUT_EYTZINGER) iter_set_rank(it, eyt_index_rank(idx, cand->count));
+            return 1;
+        }
+    }
+    /* move to first of next block */
+    csl_block* nx = blk_next_acq(cand, 0);
+    if (nx) return iter_enter_first(it, nx);
+    it->b = NULL; it->idx = -1; return 0;
 }
 
 int csl_iter_seek(cskiplist* sl, csl_key_t key, csl_iter* it, int* exact) {
     if (exact) *exact = 0;
     if (!sl || !it) return 0;
-    it->eytzinger = sl->eytzinger;
-    csl_block* cand = locate_block(sl, key);
-    if (cand == sl->head) cand = sl->head->next[0];
-    if (!cand) { it->b = NULL; it->idx = -1; return 0; }
-    int idx = sl->eytzinger ? blk_eytzinger_search(cand, key)
-                            : blk_binary_search(cand, key);
-    if (idx >= 0) { if (exact) *exact = 1; it->b = cand; it->idx = idx; return 1; }
-    idx = -idx - 1; /* lower_bound in cand (in Eytzinger or sorted space) */
-    if (idx < cand->count) { it->b = cand; it->idx = idx; return 1; }
-    /* move to first of next block */
-    if (cand->next[0]) {
-        it->b = cand->next[0];
-        it->idx = sl->eytzinger ? eyt_inorder_first(cand->next[0]->count) : 0;
+    return iter_seek_in(sl, find_block(sl, key), key, it, exact);
+}
+
+/*
+ * Finger search.  The last block with min_key <= key is found from the
+ * block x of the iterator instead of the head: the key is in x if it is
+ * below the min_key of the next block.  Otherwise the search gallops:
+ * it climbs a level while the slot above still leads to a block <= key
+ * and moves right along the current level where it does not, until the
+ * next block of the level is past the key; then it descends as
+ * locate_block() does.  That takes O(log d) steps for a key d blocks
+ * ahead.  A climb to the top level means the key is far away, and the
+ * search starts over from the head (or the lanes).
+ */
+int csl_iter_seek_from(cskiplist* sl, csl_iter* it, csl_key_t key, int* exact) {
+    if (exact) *exact = 0;
+    if (!sl || !it) return 0;
+    csl_block* x = it->b;
+    if (!x || x == sl->head || x->count == 0 || key < x->min_key)
+        return iter_seek_in(sl, find_block(sl, key), key, it, exact);
+
+    int lvl = 0;
+    int top = __atomic_load_n(&sl->level, __ATOMIC_ACQUIRE);
+    csl_block* nx;
+    while ((nx = blk_next_le(sl, x, lvl, key))) {
+        /* a slot above may be unused (a tower grown by a rebuild) or
+         * overshoot: then move along this one */
+        if (lvl + 1 < x->skip_alloc && blk_next_le(sl, x, lvl + 1, key)) {
+            if (++lvl >= top) /* a long jump */
+                return iter_seek_in(sl, find_block(sl, key), key, it, exact);
+        } else {
+            x = nx;
+        }
+    }
+    for (--lvl; lvl >= 0; --lvl) {
+        while ((nx = blk_next_le(sl, x, lvl, key)))
+            x = nx;
+    }
+    return iter_seek_in(sl, x, key, it, exact);
+}
+
+/* Move it to the next item of its block; 0 past the last one. */
+static int iter_step_in(csl_iter* it) {
+    const csl_block* b = it->b;
+    if (b->nbuf) {
+        if (it->idx < b->count - b->nbuf)
+            it->body = layout_succ(it->layout, it->body, b->count - b->nbuf);
+        else
+            it->buf++;
+        return iter_merge_next(it);
+    }
+    if (it->layout == CSL_LAYOUT_EYTZINGER) {
+        /* rank cursor: no walk up and down the implicit tree */
+        if (it->rank + 1 >= b->count) return 0;
+        it->idx = eyt_rank_index(++it->rank, b->count, it->top);
         return 1;
     }
-    it->b = NULL; it->idx = -1; return 0;
+    int next = layout_succ(it->layout, it->idx, b->count);
+    if (next < 0) return 0;
+    it->idx = next;
+    return 1;
 }
 
 int csl_iter_next(csl_iter* it) {
     if (!it || !it->b) return 0;
-    if (it->eytzinger) {
-        int next = eyt_inorder_succ(it->idx, it->b->count);
-        if (next >= 0) { it->idx = next; return 1; }
-        /* move to next block */
-        if (it->b->next[0]) {
-            it->b = it->b->next[0];
-            it->idx = eyt_inorder_first(it->b->count);
-            return (it->idx >= 0);
-        }
-    } else {
-        if (it->idx + 1 < it->b->count) { it->idx++; return 1; }
-        if (it->b->next[0]) { it->b = it->b->next[0]; it->idx = 0; return 1; }
-    }
+    if (iter_step_in(it)) return 1;
+    /* move to next block */
+    csl_block* nx = blk_next_acq(it->b, 0);
+    if (nx) return iter_enter_first(it, nx);
     it->b = NULL; it->idx = -1; return 0;
 }
 
 int csl_iter_prev(cskiplist* sl, csl_iter* it) {
     (void)sl; /* sl not needed now, kept for API symmetry */
     if (!it || !it->b) return 0;
-    if (it->eytzinger) {
-        int prev = eyt_inorder_pred(it->idx, it->b->count);
-        if (prev >= 0) { it->idx = prev; return 1; }
-        /* move to previous block */
-        if (it->b->prev) {
-            it->b = it->b->prev;
-            it->idx = eyt_inorder_last(it->b->count);
-            return (it->idx >= 0);
+    if (it->b->nbuf) {
+        if (iter_merge_prev(it)) return 1;
+    } else if (it->layout == CSL_LAYOUT_EYTZINGER) {
+        if (it->rank > 0) {
+            it->idx = eyt_rank_index(--it->rank, it->b->count, it->top);
+            return 1;
         }
     } else {
-        if (it->idx > 0) { it->idx--; return 1; }
-        if (it->b->prev) {
-            it->b = it->b->prev;
-            it->idx = it->b->count - 1;
-            return (it->idx >= 0);
-        }
+        int prev = layout_pred(it->layout, it->idx, it->b->count);
+        if (prev >= 0) { it->idx = prev; return 1; }
     }
+    /* move to previous block */
+    csl_block* p = __atomic_load_n(&it->b->prev, __ATOMIC_ACQUIRE);
+    if (p) return iter_enter_last(it, p);
     it->b = NULL; it->idx = -1; return 0;
 }
 
+/*-----------------------------------------------------------------------------
+ * Range scans.
+ *
+ * A scan seeks lo as csl_iter_seek does and then walks the blocks.  In a
+ * sorted block the items up to hi are the run [idx, e): e is the count
+ * when the last key of the block is <= hi, else found by blk_run_end, so the
+ * loop over the run has no bound check and no layout dispatch.  Blocks in
+ * the other layouts (or with an insert buffer) go item by item with the
+ * in-block step of the iterator and stop at the first key above hi.  The
+ * next block is entered only if its min_key is <= hi.
+ *----------------------------------------------------------------------------*/
+
+/* End of the items <= hi of the sorted block b, from position i.  It
+ * gallops from i (1, 2, 4, ... items ahead) before the lower bound, so a
+ * short range costs O(log length) probes, not O(log count). */
+static int blk_run_end(const csl_block* b, int i, csl_key_t hi) {
+    int last = b->count - 1;
+    if (blk_key(b, last) <= hi) return b->count;
+    if (blk_key(b, i) > hi) return i;
+    int step = 1;
+    while (i + step < last && blk_key(b, i + step) <= hi) {
+        i += step;
+        step *= 2;
+    }
+    /* key i <= hi < key i + m */
+    int m = (i + step < last) ? step : last - i;
+    int e = i + 1 + blk_lb_run(b, i + 1, m, hi);
+    return (blk_key(b, e) == hi) ? e + 1 : e;
+}
+
+/* Move it to the first item of the block after its own if that block
+ * starts at or below hi; 0 when the scan is over. */
+static int scan_next_block(csl_iter* it, csl_key_t hi) {
+    csl_block* nx = blk_next_acq(it->b, 0);
+    return nx && nx->min_key <= hi && iter_enter_first(it, nx);
+}
+
+size_t csl_range_scan(cskiplist* sl, csl_key_t lo, csl_key_t hi, csl_scan_fn cb, void* ctx) {
+    csl_iter it;
+    size_t n = 0;
+
+    if (!sl || !cb || lo > hi) return 0;
+    if (!iter_seek_in(sl, find_block(sl, lo), lo, &it, NULL)) return 0;
+    do {
+        const csl_block* b = it.b;
+        if (it.layout == CSL_LAYOUT_SORTED) {
+            int e = blk_run_end(b, it.idx, hi);
+            if (b->keys) {
+                for (int i = it.idx; i < e; ++i) {
+                    n++;
+                    if (!cb(ctx, b->keys[i], b->vals[i])) return n;
+                }
+            } else {
+                for (int i = it.idx; i < e; ++i) {
+                    n++;
+                    if (!cb(ctx, b->items[i].key, b->items[i].val)) return n;
+                }
+            }
+            if (e < b->count) return n;
+        } else {
+            do {
+                csl_key_t key = blk_key(b, it.idx);
+                if (key > hi) return n;
+                n++;
+                if (!cb(ctx, key, blk_val(b, it.idx))) return n;
+            } while (iter_step_in(&it));
+        }
+    } while (scan_next_block(&it, hi));
+    return n;
+}
+
+size_t csl_range_spans(cskiplist* sl, csl_key_t lo, csl_key_t hi, csl_span_fn cb, void* ctx) {
+    csl_key_t keys[CSL_SCAN_SPAN];
+    csl_val_t vals[CSL_SCAN_SPAN];
+    csl_iter it;
+    size_t n = 0;
+
+    if (!sl || !cb || lo > hi) return 0;
+    if (!iter_seek_in(sl, find_block(sl, lo), lo, &it, NULL)) return 0;
+    do {
+        const csl_block* b = it.b;
+        if (it.layout == CSL_LAYOUT_SORTED) {
+            int e = blk_run_end(b, it.idx, hi);
+            if (b->keys) {
+                /* the block's own arrays */
+                n += (size_t)(e - it.idx);
+                if (e > it.idx && !cb(ctx, b->keys + it.idx, b->vals + it.idx, e - it.idx))
+                    return n;
+            } else {
+                for (int i = it.idx; i < e; i += CSL_SCAN_SPAN) {
+                    int m = (e - i < CSL_SCAN_SPAN) ? e - i : CSL_SCAN_SPAN;
+                    for (int j = 0; j < m; ++j) {
+                        keys[j] = b->items[i + j].key;
+                        vals[j] = b->items[i + j].val;
+                    }
+                    n += (size_t)m;
+                    if (!cb(ctx, keys, vals, m)) return n;
+                }
+            }
+            if (e < b->count) return n;
+        } else {
+            int m = 0, past = 0;
+            do {
+                csl_key_t key = blk_key(b, it.idx);
+                if (key > hi) { past = 1; break; }
+                keys[m] = key;
+                vals[m] = blk_val(b, it.idx);
+                if (++m == CSL_SCAN_SPAN) {
+                    n += (size_t)m;
+                    if (!cb(ctx, keys, vals, m)) return n;
+                    m = 0;
+                }
+            } while (iter_step_in(&it));
+            if (m > 0) {
+                n += (size_t)m;
+                if (!cb(ctx, keys, vals, m)) return n;
+            }
+            if (past) return n;
+        }
+    } while (scan_next_block(&it, hi));
+    return n;
+}
+
+/*-----------------------------------------------------------------------------
+ * Order statistics.
+ *
+ * A descent that adds up the widths of the slots it follows knows the
+ * position of the block it ends at; the rest is the rank of the key or
+ * the item of a rank within that one block.
+ *----------------------------------------------------------------------------*/
+
+/* Number of items of b below key. */
+static int blk_count_below(int layout, csl_block* b, csl_key_t key) {
+    int n = b->count - b->nbuf;
+    int r = b->nbuf ? blk_lb_run(b, n, b->nbuf, key) : 0;
+
+    if (layout == CSL_LAYOUT_SORTED) return r + blk_lb_run(b, 0, n, key);
+    if (layout == CSL_LAYOUT_EYTZINGER) {
+        int k = blk_eytzinger_search(b, key);
+        if (k < 0) k = -k - 1;
+        return r + ((k < n) ? eyt_index_rank(k, n) : n);
+    }
+    /* S-tree: the nodes are not in key order, count them all */
+    for (int i = 0; i < n; ++i) r += blk_key(b, i) < key;
+    return r;
+}
+
+/* Index of the item of in-order rank r in b. */
+static int blk_rank_index(int layout, csl_block* b, int r) {
+    if (!b->nbuf && layout == CSL_LAYOUT_SORTED) return r;
+    if (!b->nbuf && layout == CSL_LAYOUT_EYTZINGER)
+        return eyt_rank_index(r, b->count, eyt_top(b->count));
+    csl_iter it;
+    it.layout = layout;
+    iter_enter_first(&it, b);
+    while (r-- > 0) iter_step_in(&it);
+    return it.idx;
+}
+
+static size_t rank_locked(cskiplist* sl, csl_key_t key) {
+    csl_block* x = sl->head;
+    size_t at = 0;
+
+    if (sl->widths_stale) widths_recount(sl);
+    for (int lvl = sl->level; lvl >= 0; --lvl) {
+        while (lvl < x->skip_alloc && x->next[lvl] &&
+               blk_next_key(x, lvl) <= key) {
+            at += blk_width(x, lvl);
+            x = x->next[lvl];
+        }
+    }
+    if (x == sl->head) return 0; /* key precedes the first block */
+    return at + (size_t)blk_count_below(sl->layout, x, key);
+}
+
+static int select_locked(cskiplist* sl, size_t i, csl_kv* out) {
+    csl_block* x = sl->head;
+    size_t at = 0;
+
+    if (i >= sl->size) return 0;
+    if (sl->widths_stale) widths_recount(sl);
+    /* the head's count is 0, so level 0 moves on to the first block */
+    for (int lvl = sl->level; lvl >= 0; --lvl) {
+        while (lvl < x->skip_alloc && x->next[lvl] &&
+               at + blk_width(x, lvl) <= i) {
+            at += blk_width(x, lvl);
+            x = x->next[lvl];
+        }
+    }
+    int k = blk_rank_index(sl->layout, x, (int)(i - at));
+    out->key = blk_key(x, k);
+    out->val = blk_val(x, k);
+    return 1;
+}
+
+size_t csl_rank(cskiplist* sl, csl_key_t key) {
+    if (!sl) return 0;
+    if (sl->sync) pthread_mutex_lock(&sl->sync->lock);
+    size_t r = rank_locked(sl, key);
+    if (sl->sync) pthread_mutex_unlock(&sl->sync->lock);
+    return r;
+}
+
+int csl_select(cskiplist* sl, size_t i, csl_kv* out) {
+    if (!sl || !out) return 0;
+    if (sl->sync) pthread_mutex_lock(&sl->sync->lock);
+    int ok = select_locked(sl, i, out);
+    if (sl->sync) pthread_mutex_unlock(&sl->sync->lock);
+    return ok;
+}
+
+int csl_split_ranges(cskiplist* sl, int p, csl_key_t* out) {
+    if (!sl || p < 1 || !out) return 0;
+    if (sl->sync) pthread_mutex_lock(&sl->sync->lock);
+    size_t n = sl->size;
+    int m = ((size_t)p < n) ? p : (int)n;
+    for (int k = 0; k < m; ++k) {
+        csl_kv kv;
+        select_locked(sl, n * (size_t)k / (size_t)m, &kv);
+        out[k] = kv.key;
+    }
+    if (sl->sync) pthread_mutex_unlock(&sl->sync->lock);
+    return m;
+}
+
 void csl_rebuild_skips(cskiplist* sl) {
     if (!sl) return;
     /* collect blocks into array */
@@ -799,21 +3026,24 @@ void csl_rebuild_skips(cskiplist* sl) {
      * Grow blocks that need higher skip levels.  A block at index i
      * participates in level k iff (i+1) is divisible by 2^k.  Its
      * required height = number-of-trailing-zeros(i+1) + 1, capped at
-     * top+1.  (blk_ensure_skips reallocates only the next[] array;
-     * the block itself never moves, so inbound pointers stay valid.)
+     * top+1.  A block that grows is moved to a taller chunk; all links
+     * are set from arr[] below.  If it cannot grow (OOM) it keeps its
+     * tower and is left out of the levels it lacks.
      */
     for (size_t i = 0; i < m; ++i) {
         int height = 1;
         { size_t v = i + 1; while ((v & 1) == 0 && height <= top) { v >>= 1; ++height; } }
         if (height > top + 1) height = top + 1;
-        if (arr[i]->skip_alloc < height)
-            blk_ensure_skips(arr[i], height);
+        if (arr[i]->skip_alloc < height) {
+            csl_block* nb = blk_ensure_skips(sl, arr[i], height);
+            if (nb) arr[i] = nb;
+        }
     }
 
     /* Rebuild level-0 chain and prev pointers */
-    sl->head->next[0] = (m > 0) ? arr[0] : NULL;
+    blk_link(sl->head, 0, (m > 0) ? arr[0] : NULL);
     for (size_t i = 0; i < m; ++i) {
-        arr[i]->next[0] = (i + 1 < m) ? arr[i + 1] : NULL;
+        blk_link(arr[i], 0, (i + 1 < m) ? arr[i + 1] : NULL);
         arr[i]->prev = (i > 0) ? arr[i - 1] : NULL;
     }
     sl->tail = (m > 0) ? arr[m - 1] : NULL;
@@ -822,42 +3052,164 @@ void csl_rebuild_skips(cskiplist* sl) {
      * which would otherwise go stale when the level count shrinks) */
     for (size_t i = 0; i < m; ++i) {
         for (int lvl = 1; lvl < arr[i]->skip_alloc; ++lvl)
-            arr[i]->next[lvl] = NULL;
+            blk_link(arr[i], lvl, NULL);
     }
     for (int lvl = top + 1; lvl < CSL_MAX_LEVEL; ++lvl)
-        sl->head->next[lvl] = NULL;
+        blk_link(sl->head, lvl, NULL);
 
     /* rebuild higher levels deterministically */
     for (int lvl = 1; lvl <= top; ++lvl) {
         size_t stride = 1ull << lvl;
         csl_block* prev_blk = sl->head;
         for (size_t i = stride - 1; i < m; i += stride) {
-            prev_blk->next[lvl] = arr[i];
+            if (arr[i]->skip_alloc <= lvl) continue;
+            blk_link(prev_blk, lvl, arr[i]);
             prev_blk = arr[i];
         }
-        prev_blk->next[lvl] = NULL;
+        blk_link(prev_blk, lvl, NULL);
     }
+    if (sl->lanes) sl->lanes->dirty = 1;
+    widths_recount(sl);
 
     free(arr);
 }
 
+int csl_compact(cskiplist* sl, int fill) {
+    if (!sl) return 0;
+    if (fill < 1 || fill > 100) fill = 100;
+    size_t n = sl->size;
+    if (n == 0) return 1;
+
+    /* nblk blocks; block i gets per items, one more if i < extra, and
+     * the tower that csl_rebuild_skips gives the i-th of nblk blocks */
+    size_t most = (size_t)sl->block_cap * (size_t)fill / 100;
+    if (most < 1) most = 1;
+    size_t nblk = (n + most - 1) / most;
+    size_t per = n / nblk, extra = n % nblk;
+    int top = 0;
+    while ((size_t)(1ull << (top + 1)) <= nblk) ++top;
+    if (top >= CSL_MAX_LEVEL) top = CSL_MAX_LEVEL - 1;
+
+    /* the items stream from the old blocks (src, from item si) into new
+     * ones, linked on level 0 behind last; an old block is released as
+     * soon as it is read */
+    csl_block* src = sl->head->next[0];
+    csl_block* last = sl->head;
+    int si = 0;
+    int ok = 1;
+    size_t made = 0;
+    /* the old towers go; level 0 stays valid if the rebuild fails */
+    for (int lvl = 1; lvl < CSL_MAX_LEVEL; ++lvl) blk_link(sl->head, lvl, NULL);
+    sl->level = 0;
+    blk_to_sorted(sl, src);
+    for (size_t i = 0; i < nblk; ++i) {
+        int height = 1;
+        { size_t v = i + 1; while ((v & 1) == 0 && height <= top) { v >>= 1; ++height; } }
+        if (height > top + 1) height = top + 1;
+        csl_block* nb = blk_alloc_with_cap(sl, sl->block_cap, height);
+        if (!nb) { ok = 0; break; }
+        int q = (int)(per + (i < extra));
+        while (nb->count < q) {
+            int k = src->count - si;
+            if (k > q - nb->count) k = q - nb->count;
+            blk_copy(nb, nb->count, src, si, k);
+            nb->count += k;
+            si += k;
+            if (si == src->count) {
+                csl_block* t = src->next[0];
+                blk_release(sl, src);
+                src = t;
+                si = 0;
+                if (src) blk_to_sorted(sl, src);
+            }
+        }
+        nb->min_key = blk_key(nb, 0);
+        blk_from_sorted(sl, nb);
+        blk_link(last, 0, nb);
+        last = nb;
+        made++;
+    }
+
+    /* OOM: the rest of src and the old blocks behind it follow the new
+     * blocks */
+    if (src) {
+        blk_move(src, 0, si, src->count - si);
+        src->count -= si;
+        src->min_key = blk_key(src, 0);
+        blk_from_sorted(sl, src);
+        blk_link(last, 0, src);
+        for (; src; src = src->next[0]) made++;
+    } else {
+        blk_link(last, 0, NULL);
+    }
+    sl->nblocks = made;
+    csl_rebuild_skips(sl);
+    return ok;
+}
+
+void csl_set_layout(cskiplist* sl, int layout) {
+    if (!sl || layout == sl->layout) return;
+    if (layout < CSL_LAYOUT_SORTED || layout > CSL_LAYOUT_STREE) return;
+    /* Convert all data blocks through the sorted order */
+    for (csl_block* b = sl->head->next[0]; b; b = b->next[0])
+        blk_to_sorted(sl, b);
+    sl->layout = layout;
+    for (csl_block* b = sl->head->next[0]; b; b = b->next[0])
+        blk_from_sorted(sl, b);
+}
+
 void csl_set_eytzinger(cskiplist* sl, int enable) {
-    if (!sl) return;
-    if (enable && !sl->eytzinger) {
-        /* Convert all data blocks from sorted to Eytzinger layout */
-        csl_block* b = sl->head->next[0];
-        while (b) {
-            blk_sorted_to_eytzinger(b);
-            b = b->next[0];
-        }
-        sl->eytzinger = 1;
-    } else if (!enable && sl->eytzinger) {
-        /* Convert all data blocks from Eytzinger back to sorted */
-        csl_block* b = sl->head->next[0];
-        while (b) {
-            blk_eytzinger_to_sorted(b);
-            b = b->next[0];
-        }
-        sl->eytzinger = 0;
+    csl_set_layout(sl, enable ? CSL_LAYOUT_EYTZINGER : CSL_LAYOUT_SORTED);
+}
+
+int csl_set_soa(cskiplist* sl, int enable) {
+    csl_block* last[CSL_MAX_LEVEL];
+    int ok = 1;
+
+    if (!sl) return 0;
+    enable = enable ? 1 : 0;
+    sl->soa = enable;
+    /* Each block is copied into a chunk of the other layout; item i keeps
+     * its index, so sorted and Eytzinger blocks convert alike.  last[lvl]
+     * is the last block on level lvl so far: its link to the old block
+     * is redirected to the copy. */
+    for (int lvl = 0; lvl < CSL_MAX_LEVEL; ++lvl) last[lvl] = sl->head;
+    for (csl_block* b = sl->head->next[0]; b; ) {
+        csl_block* nxt = b->next[0];
+        csl_block* nb = b;
+        if (ok && (b->keys != NULL) != enable) {
+            nb = blk_relocate(sl, b, b->skip_alloc, enable);
+            if (!nb) { ok = 0; nb = b; }
+        }
+        nb->prev = (last[0] == sl->head) ? NULL : last[0];
+        for (int lvl = 0; lvl < nb->skip_alloc; ++lvl) {
+            if (last[lvl]->next[lvl] != b) continue;
+            blk_link(last[lvl], lvl, nb);
+            last[lvl] = nb;
+        }
+        if (nb != b) blk_release(sl, b);
+        b = nxt;
+    }
+    if (sl->tail) sl->tail = (last[0] == sl->head) ? NULL : last[0];
+    if (sl->lanes) sl->lanes->dirty = 1;
+    return ok;
+}
+
+int csl_set_lanes(cskiplist* sl, int enable) {
+    if (!sl) return 0;
+    if (!enable) {
+        if (sl->lanes) csl_mem_release(&sl->mem, sl->lanes, sl->lanes->bytes);
+        sl->lanes = NULL;
+        return 1;
     }
+    if (sl->lanes) return 1;
+    if (sl->sync) return 0;
+    sl->lanes = lanes_alloc(sl, sl->nblocks);
+    if (!sl->lanes) return 0;
+    if (!lanes_build(sl)) {
+        csl_mem_release(&sl->mem, sl->lanes, sl->lanes->bytes);
+        sl->lanes = NULL;
+        return 0;
+    }
+    return 1;
 }
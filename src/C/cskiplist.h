@@ -20,8 +20,69 @@ extern "C" {
 #define CSL_MAX_LEVEL 20   /* enough for millions of blocks */
 #endif
 
+/* Fat skip entries: each tower slot also keeps the min_key of the block it
+ * points to (csl_skip_keys), so a traversal compares against the slot and
+ * reads the target block only when it moves there.  -DCSL_FAT_SKIPS=0
+ * builds the plain towers of pointers. */
+#ifndef CSL_FAT_SKIPS
+#define CSL_FAT_SKIPS 1
+#endif
+
+/* Slots of the insert buffer of a block in the Eytzinger or S-tree layout:
+ * inserts land in a small sorted run behind the laid-out items and are
+ * merged in when it is full, instead of re-laying out the block on every
+ * write.  0 re-lays out on every insert. */
+#ifndef CSL_INSERT_BUF
+#define CSL_INSERT_BUF 16
+#endif
+
+/* Fill of the blocks that csl_insert_sorted() creates, in percent of the
+ * block capacity: the room left keeps the next inserts from splitting
+ * them right away. */
+#ifndef CSL_MERGE_FILL
+#define CSL_MERGE_FILL 75
+#endif
+
+/* Underflow of a block, in percent of its capacity: a delete that leaves
+ * fewer items in a block merges it with a neighbour (if the two fit in
+ * CSL_MERGE_FILL percent) or moves items over from the fuller neighbour.
+ * 0 keeps every block until it is empty. */
+#ifndef CSL_MIN_FILL
+#define CSL_MIN_FILL 25
+#endif
+
+/* Reader slots of a list in concurrent mode (csl_reader_register). */
+#ifndef CSL_MAX_READERS
+#define CSL_MAX_READERS 128
+#endif
+
+/* Searches interleaved by csl_search_batch(). */
+#ifndef CSL_BATCH_GROUP
+#define CSL_BATCH_GROUP 16
+#endif
+
+/* Largest span that csl_range_spans() gathers from a block whose keys and
+ * values are not already two sorted arrays. */
+#ifndef CSL_SCAN_SPAN
+#define CSL_SCAN_SPAN 64
+#endif
+
 typedef int csl_key_t;
+
+/*
+ * Values are pointers by default.  With -DCSL_VAL32 they are 32-bit
+ * handles (e.g. indices of nodes kept in an arena), so a key/value pair
+ * takes 8 bytes instead of 16 on 64-bit targets and a cache line holds
+ * 8 pairs instead of 4.  CSL_VAL_NONE is what csl_search() returns for a
+ * missing key.
+ */
+#ifdef CSL_VAL32
+typedef uint32_t csl_val_t;
+#define CSL_VAL_NONE 0u
+#else
 typedef void* csl_val_t;
+#define CSL_VAL_NONE NULL
+#endif
 
 typedef struct csl_kv {
     csl_key_t key;
@@ -29,20 +90,107 @@ typedef struct csl_kv {
 } csl_kv;
 
 /*
- * Memory block of sorted key/value pairs plus separately allocated skip slots.
+ * Memory block of sorted key/value pairs with its skip slots.
  * `item_cap` is now runtime-sized per skiplist instance, which allows
  * per-instance block sizing and per-level sizing policies.
+ *
+ * A block is one chunk of memory: the header, the tower next[skip_alloc]
+ * (with CSL_FAT_SKIPS followed by the keys of its slots, then the widths
+ * of its slots) and the items, in this order (see csl_block_bytes()).
+ * Without an allocator the chunk is aligned to a cache line, so the
+ * header and the lower links of the tower share the first line and a
+ * search that moves to a block finds its items right behind them instead
+ * of following two more pointers.  items, keys and vals point into the
+ * chunk.
+ *
+ * The pairs are stored either as an array of csl_kv (items, the default)
+ * or, in the struct-of-arrays layout (csl_set_soa), as a dense keys[]
+ * array followed by a parallel vals[] array; the other pointer(s) are
+ * NULL.  Dense keys let the search load 4 keys with one vector load and
+ * keep the values out of the cache until a hit.
  */
 typedef struct csl_block {
-    int min_key;              /* minimum key in items[] */
+    int min_key;              /* minimum key in the block */
     int count;                /* number of valid items */
-    int item_cap;             /* allocated capacity of items[] */
-    int skip_alloc;           /* number of slots allocated in next[] */
+    int item_cap;             /* allocated capacity of items[] (keys[]) */
+    int16_t skip_alloc;       /* number of slots allocated in next[] */
+    int16_t nbuf;             /* last nbuf items: sorted insert buffer */
     struct csl_block* prev;   /* backward pointer on level 0 chain */
-    csl_kv* items;            /* sorted or Eytzinger-laid-out key/value array */
-    struct csl_block** next;  /* [0]=level-0 link, [1..]=skips */
+    csl_kv* items;            /* key/value array in the layout of the list */
+    csl_key_t* keys;          /* SoA layout: keys in the same order as items */
+    csl_val_t* vals;          /* SoA layout: values, vals[i] belongs to keys[i] */
+    struct csl_block* next[]; /* [0]=level-0 link, [1..]=skips; items follow */
 } csl_block;
 
+#if CSL_FAT_SKIPS
+/* Keys of the tower slots of b: csl_skip_keys(b)[lvl] is the min_key of
+ * b->next[lvl], or INT_MAX if it is NULL. */
+static inline csl_key_t* csl_skip_keys(const csl_block* b) {
+    return (csl_key_t*)(b->next + b->skip_alloc);
+}
+#endif
+
+/* Widths of the tower slots of b (an indexable skip list): for lvl >= 1,
+ * csl_skip_widths(b)[lvl] is the number of items in b and the blocks
+ * after it up to b->next[lvl], or up to the end of the list if it is
+ * NULL.  Slot 0 is unused; its width is b->count. */
+static inline uint32_t* csl_skip_widths(const csl_block* b) {
+    return (uint32_t*)((char*)(b->next + b->skip_alloc)
+                       + (size_t)CSL_FAT_SKIPS * b->skip_alloc * sizeof(csl_key_t));
+}
+
+/* Alignment of the blocks allocated with malloc. */
+#define CSL_CACHE_LINE 64
+
+/* Slots of keys[] in a SoA block: padded to 16 bytes, so vals[] is aligned. */
+#define CSL_SOA_KEY_SLOTS(cap) (((cap) + 3) & ~3)
+
+/* Bytes of the chunk of a block with item_cap items and a tower of
+ * height skip slots, in the csl_kv (soa == 0) or SoA layout. */
+size_t csl_block_bytes(int item_cap, int height, int soa);
+
+/*
+ * Optional allocator of the memory of a skip list (the list and its
+ * blocks).  alloc returns zeroed memory aligned to 16 bytes at least;
+ * release gets the size that was passed to alloc.  With alloc == NULL,
+ * cache-line aligned memory of the C library is used.  An allocator lets
+ * an owner (e.g. the arena of a set-trie index) place many small skip
+ * lists in its own slabs and free them all at once.
+ */
+typedef struct csl_allocator {
+    void* (*alloc)(void* ctx, size_t size);
+    void  (*release)(void* ctx, void* p, size_t size);
+    void* ctx;
+} csl_allocator;
+
+/*
+ * Fast lanes (csl_set_lanes), after the Cache-Sensitive Skip List of
+ * Sprenger et al.: the levels above the blocks as dense arrays of keys.
+ * Lane 0 holds the min_key of every block (blocks[] in the same order),
+ * lane l every CSL_LANE_FANOUT-th key of lane l-1, up to a top lane of at
+ * most CSL_LANE_FANOUT keys.  A search counts the keys <= key in one
+ * window of CSL_LANE_FANOUT keys per lane with the block search kernels;
+ * the window of lane l-1 is the one under the position found in lane l.
+ * Adding or removing a block marks the lanes dirty and the next search
+ * rebuilds them; a new min_key of a block is written in place.
+ */
+#define CSL_LANE_FANOUT 16  /* keys per window: one cache line */
+#define CSL_MAX_LANES   8
+
+typedef struct csl_lanes {
+    int nlanes;                      /* lanes in use; 0 when there are no blocks */
+    int dirty;                       /* blocks changed: rebuild before a search */
+    size_t cap;                      /* blocks the chunk has room for */
+    size_t bytes;                    /* bytes of the chunk (this header included) */
+    size_t len[CSL_MAX_LANES];       /* keys in each lane */
+    csl_key_t* keys[CSL_MAX_LANES];  /* the lanes, each cache-line aligned */
+    struct csl_block** blocks;       /* blocks[i] has the key keys[0][i] */
+} csl_lanes;
+
+/* State of concurrent mode (csl_set_concurrent): writer lock, epochs of
+ * the reader slots and the retired blocks. */
+typedef struct csl_sync csl_sync;
+
 /* Skip list of blocks */
 typedef struct cskiplist {
     csl_block* head;   /* sentinel block; min_key = INT32_MIN, count=0 */
@@ -57,12 +205,21 @@ typedef struct cskiplist {
     size_t stat_updates;
     size_t stat_deletes;
     size_t stat_splits;
-    int eytzinger;     /* 0=sorted layout, 1=Eytzinger BFS layout within blocks */
+    size_t stat_merges;  /* blocks merged into a neighbour on underflow */
+    int layout;        /* layout of the items within blocks (CSL_LAYOUT_*) */
+    int soa;           /* 0=csl_kv items[], 1=separate keys[]/vals[] in new blocks */
+    csl_allocator mem; /* memory of blocks; zero = calloc/free */
+    csl_lanes* lanes;  /* fast lanes for searches, NULL when off */
+    csl_kv* scratch;   /* items of a block while it is re-laid out */
+    int scratch_cap;
+    csl_sync* sync;    /* concurrent mode, NULL when off */
+    int widths_stale;  /* slot widths not kept up: recount before a rank */
 } cskiplist;
 
 /* API */
 cskiplist* csl_create(void);
 cskiplist* csl_create_with_block_cap(int block_cap);
+cskiplist* csl_create_with_allocator(int block_cap, const csl_allocator* mem);
 cskiplist* csl_create_for_level(int trie_level);
 int csl_choose_block_cap_for_level(int trie_level);
 int csl_tlb_aware_block_cap_hint(int requested_block_cap);
@@ -80,41 +237,214 @@ int csl_append(cskiplist* sl, csl_key_t key, csl_val_t val);
  * Splits blocks when full. Returns 1 on insert, 0 on update, -1 on OOM */
 int csl_insert(cskiplist* sl, csl_key_t key, csl_val_t val);
 
-/* Delete a key. Returns 1 when deleted, 0 if key not found. If provided, free_val is called on deleted value. */
+/* Insert the n pairs kvs[], sorted by key (of pairs with the same key the
+ * last one wins), in one left-to-right pass over the blocks: the pairs of
+ * each block are merged with its items, and a block that overflows is
+ * dealt out over itself and new blocks filled to CSL_MERGE_FILL percent,
+ * which get probabilistic heights and are linked in on the way.  For
+ * bulk loads and delta merges; same result as n csl_insert() calls.
+ * Pairs that are not sorted are inserted one at a time.  Returns the
+ * number of new keys, -1 on OOM (the blocks merged so far stay). */
+ptrdiff_t csl_insert_sorted(cskiplist* sl, const csl_kv* kvs, size_t n);
+
+/* Delete a key. Returns 1 when deleted, 0 if key not found. If provided, free_val is called on deleted value.
+ * A block left below CSL_MIN_FILL percent is merged with or refilled from a neighbour.
+ * In concurrent mode -1 on OOM (the key stays). */
 int csl_delete(cskiplist* sl, csl_key_t key, void (*free_val)(csl_val_t));
 
-/* Find value for key; returns NULL if not found (note: NULL may be a stored value) */
+/* Find value for key; returns CSL_VAL_NONE if not found (note: it may be a stored value) */
 csl_val_t csl_search(cskiplist* sl, csl_key_t key);
 
+/* Search the n keys[] at once: out_vals[i] gets the value of keys[i], or
+ * CSL_VAL_NONE if it is missing.  The searches run CSL_BATCH_GROUP at a
+ * time with their misses overlapped by software prefetching, which beats
+ * n csl_search() calls when the list does not fit in the cache.
+ * Returns the number of keys found. */
+size_t csl_search_batch(cskiplist* sl, const csl_key_t* keys, size_t n, csl_val_t* out_vals);
+
+/* Range scans.  Callbacks return nonzero to go on, 0 to stop the scan. */
+typedef int (*csl_scan_fn)(void* ctx, csl_key_t key, csl_val_t val);
+typedef int (*csl_span_fn)(void* ctx, const csl_key_t* keys, const csl_val_t* vals, int n);
+
+/* Call cb for each pair with lo <= key <= hi, in key order.  The scan
+ * seeks lo once and then walks the blocks: a sorted block gets one bound
+ * check for hi instead of one per item.  Returns the number of pairs
+ * passed to cb. */
+size_t csl_range_scan(cskiplist* sl, csl_key_t lo, csl_key_t hi, csl_scan_fn cb, void* ctx);
+
+/* csl_range_scan by spans: cb gets the pairs of [lo, hi] as runs of n
+ * consecutive pairs, keys[] and vals[] sorted by key.  A span never
+ * crosses a block.  A sorted SoA block without an insert buffer hands
+ * over its own arrays (one span per block); the others are gathered in
+ * spans of up to CSL_SCAN_SPAN pairs.  The arrays are valid during the
+ * call only.  Returns the number of pairs passed to cb. */
+size_t csl_range_spans(cskiplist* sl, csl_key_t lo, csl_key_t hi, csl_span_fn cb, void* ctx);
+
+/* Order statistics, O(log n_blocks) by the widths of the tower slots
+ * plus a search within one block.  csl_insert, csl_delete and block
+ * splits and merges keep the widths up; csl_append, csl_insert_sorted
+ * and the writers of concurrent mode leave them to a recount of
+ * O(n_blocks) on the next of these calls.  In concurrent mode they take
+ * the writer lock. */
+
+/* Number of keys below key. */
+size_t csl_rank(cskiplist* sl, csl_key_t key);
+
+/* The pair with i keys below it (0-based) in *out; 0 if i >= size. */
+int csl_select(cskiplist* sl, size_t i, csl_kv* out);
+
+/* Cut the list into p ranges of equal size (within one pair): out[k] is
+ * the first key of range k, which runs up to out[k+1] (exclusive), the
+ * last one to the end.  For splitting a scan over p threads or sampling.
+ * Returns the number of ranges, min(p, size); out must hold p keys. */
+int csl_split_ranges(cskiplist* sl, int p, csl_key_t* out);
+
 /* Rebuild skip pointers deterministically using power-of-two strides.
  * Optional: skips are already maintained incrementally by insert/delete.
- * Calling this after a bulk load produces perfectly balanced skips. */
+ * Calling this after a bulk load produces perfectly balanced skips.
+ * Blocks whose tower is too low are moved to a taller chunk, so block
+ * pointers and iterators taken before the call are no longer valid.
+ * The slot widths are recounted. */
 void csl_rebuild_skips(cskiplist* sl);
 
-/* Enable/disable Eytzinger (BFS) layout within blocks.
- * When enabled, items[] are rearranged for branchless, cache-friendly search.
- * Enable AFTER bulk construction for best results; inserts/deletes auto-convert. */
+/* Repack the items into as few blocks as fill percent (1..100; other
+ * values mean 100) of block_cap allows, evenly filled, and rebuild the
+ * towers as csl_rebuild_skips does (e.g. after a phase of deletes).  The
+ * blocks are new, so block pointers and iterators are no longer valid.
+ * Returns 0 on OOM (the items are all kept, the blocks behind the last
+ * new one are left as they were). */
+int csl_compact(cskiplist* sl, int fill);
+
+/* Layouts of the items within a block:
+ *   CSL_LAYOUT_SORTED    sorted order (binary search / SIMD lower bound)
+ *   CSL_LAYOUT_EYTZINGER BFS order of an implicit binary tree
+ *   CSL_LAYOUT_STREE     BFS order of an implicit CSL_STREE_B-ary tree
+ *                        (S-tree): nodes of CSL_STREE_B sorted keys, one
+ *                        cache line of keys in a SoA block */
+enum { CSL_LAYOUT_SORTED = 0, CSL_LAYOUT_EYTZINGER = 1, CSL_LAYOUT_STREE = 2 };
+
+/* Keys per node of the S-tree layout. */
+#define CSL_STREE_B 16
+
+/* Rearrange the items of all blocks into layout.  Enable it AFTER bulk
+ * construction for best results; inserts/deletes auto-convert. */
+void csl_set_layout(cskiplist* sl, int layout);
+
+/* Enable/disable Eytzinger (BFS) layout within blocks, i.e.
+ * csl_set_layout(sl, enable ? CSL_LAYOUT_EYTZINGER : CSL_LAYOUT_SORTED). */
 void csl_set_eytzinger(cskiplist* sl, int enable);
 
+/* Enable/disable the struct-of-arrays layout of blocks (keys[] and vals[]).
+ * Existing blocks are converted; it combines with all csl_set_layout layouts.
+ * Call it on an empty list to avoid the conversion.  Converted blocks are
+ * moved (as by csl_rebuild_skips).  Returns 0 on OOM (the blocks converted
+ * so far keep the new layout; all layouts work). */
+int csl_set_soa(cskiplist* sl, int enable);
+
+/* Enable/disable the fast lanes (csl_lanes) for csl_search and
+ * csl_iter_seek; inserts and deletes keep using the skip towers.  The
+ * lanes are rebuilt lazily, so a search after a split or a delete of a
+ * block takes O(blocks).  Returns 0 on OOM and in concurrent mode (the
+ * lanes stay off). */
+int csl_set_lanes(cskiplist* sl, int enable);
+
+/*
+ * Concurrent mode: csl_search, csl_search_batch, the iterators, the
+ * seeks and the range scans run without locks while other threads write.  A writer
+ * (csl_insert, csl_delete, csl_append, csl_insert_sorted) takes a lock of
+ * the list and does not change the blocks readers see: it copies the
+ * blocks it changes (a split or an underflow changes two) and links the
+ * copies in their place with release stores; the old blocks are released
+ * once no reader can be inside them (epoch-based reclamation).  So every
+ * write copies a block, and csl_insert_sorted inserts one pair at a time.
+ *
+ * A reader thread takes a slot with csl_reader_register and runs its
+ * searches, seeks and iterators inside csl_read_begin / csl_read_end; an
+ * iterator stays valid within a section whatever the writers do.  A key
+ * that no writer touches during a section is always found; one being
+ * inserted or deleted may be seen before or after the change.  The
+ * sections should be short: blocks retired while a section is open wait
+ * for its end.
+ *
+ * Not while readers are inside sections: csl_rebuild_skips, csl_compact,
+ * csl_set_layout, csl_set_soa, csl_set_concurrent(sl, 0) and csl_free.
+ * The fast lanes are turned off (csl_set_lanes fails), and with
+ * csl_delete's free_val a reader may still read a value as it is freed.
+ */
+
+/* Turn concurrent mode on or off (off releases the retired blocks).
+ * Returns 0 on failure (OOM; the list stays as it was). */
+int csl_set_concurrent(cskiplist* sl, int enable);
+
+/* Take a reader slot for the calling thread; -1 if all CSL_MAX_READERS
+ * are taken or the list is not in concurrent mode. */
+int csl_reader_register(cskiplist* sl);
+void csl_reader_unregister(cskiplist* sl, int slot);
+
+/* Enter / leave a read section of the thread that holds slot.  Sections
+ * do not nest; a writer may write inside its own section. */
+void csl_read_begin(cskiplist* sl, int slot);
+void csl_read_end(cskiplist* sl, int slot);
+
+/* Instruction sets of the intra-block search kernels.  They are chosen at
+ * program start, before main(): the best set the CPU supports (cpuid), or
+ * the one named by the environment variable CSL_ISA if it is supported.
+ * csl_simd_select() can force a lower one later. */
+enum { CSL_ISA_SCALAR = 0, CSL_ISA_SSE2 = 1, CSL_ISA_AVX2 = 2, CSL_ISA_AVX512 = 3 };
+
+/* Instruction set of the kernels in use. */
+int csl_simd_isa(void);
+
+/* Use the kernels of isa, or of the best supported set below it (e.g. to
+ * compare them in a benchmark).  Returns the instruction set selected.
+ * Not to be called while other threads search. */
+int csl_simd_select(int isa);
+
+/* Name of an instruction set: "scalar", "sse2", "avx2" or "avx512". */
+const char* csl_simd_isa_name(int isa);
+
 /* Lightweight iterator over key/value pairs (in-order) */
 typedef struct csl_iter {
     csl_block* b; /* current block, NULL if invalid */
     int idx;      /* index within block */
-    int eytzinger; /* 0=sorted, 1=Eytzinger layout (set by iter_first/iter_seek) */
+    int layout;    /* CSL_LAYOUT_* of the list (set by iter_first/iter_seek) */
+    int body, buf; /* merge cursors of a block with an insert buffer */
+    int rank, top; /* Eytzinger block: in-order rank of idx; largest 2^k <= count */
+    csl_kv kv;     /* copy of the current pair of a SoA block (csl_iter_get) */
 } csl_iter;
 
 /* Initialize iterator to first item; returns 1 if non-empty, else 0 */
 int csl_iter_first(cskiplist* sl, csl_iter* it);
 
+/* Position iterator before the first item: csl_iter_next moves to it. */
+void csl_iter_rewind(cskiplist* sl, csl_iter* it);
+
 /* Seek to first item with key >= given key. Sets *exact=1 if exact key found. Returns 1 if positioned, 0 if past end. */
 int csl_iter_seek(cskiplist* sl, csl_key_t key, csl_iter* it, int* exact);
 
+/* csl_iter_seek from the current position of it (finger search): for a
+ * key ahead of it the search starts at its block and walks up its tower
+ * only as far as the key is away, so a run of ascending seeks (the
+ * set-trie merges) costs O(log distance) each instead of O(log n).  Keys
+ * behind it and iterators that are not on a block (rewound or past the
+ * end) get a plain csl_iter_seek.  Like any iterator, it is invalidated
+ * by csl_delete, csl_rebuild_skips and csl_set_soa. */
+int csl_iter_seek_from(cskiplist* sl, csl_iter* it, csl_key_t key, int* exact);
+
 /* Move to next/prev item; return 1 if valid after move, 0 if hit end/begin */
 int csl_iter_next(csl_iter* it);
 int csl_iter_prev(cskiplist* sl, csl_iter* it);
 
-/* Accessor for current item; returns NULL if iterator invalid */
-static inline csl_kv* csl_iter_get(csl_iter* it) { return (it && it->b && it->idx >= 0 && it->idx < it->b->count) ? &it->b->items[it->idx] : NULL; }
+/* Accessor for current item; returns NULL if iterator invalid.  For a SoA
+ * block the pair is copied into the iterator, so writes through the
+ * returned pointer do not reach the list. */
+static inline csl_kv* csl_iter_get(csl_iter* it) {
+    if (!it || !it->b || it->idx < 0 || it->idx >= it->b->count) return NULL;
+    if (!it->b->keys) return &it->b->items[it->idx];
+    it->kv.key = it->b->keys[it->idx];
+    it->kv.val = it->b->vals[it->idx];
+    return &it->kv;
+}
 
 #ifdef __cplusplus
 }
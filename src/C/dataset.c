@@ -0,0 +1,779 @@
+/*
+ * File: dataset.c
+ * Author: Iztok Savnik
+ *
+ * Description: Reading sets from dataset files. Regular files are
+ * memory mapped and parsed in place; other streams are read through a
+ * refillable buffer.
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include "config.h"
+#include "set.h"
+#include "dataset.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+/* Initial size of the buffer used for streams that can not be mapped. */
+#define DSET_STREAM_SIZE  (1 << 20)
+
+/* Initial number of sets and elements of an arena. */
+#define DSET_ARENA_SETS   1024
+#define DSET_ARENA_ELEMS  (1 << 16)
+
+/* Initial number of offsets kept by a writer. */
+#define DSET_INIT_OFFS    1024
+
+/*
+  True if the bytes at ds->pos start with the magic of a binary dataset.
+ */
+static boolean dset_magic( dataset *ds )
+{
+   return ds->len - ds->pos >= 8 &&
+          memcmp(ds->buf + ds->pos, DSET_MAGIC, 8) == 0;
+} /*dset_magic*/
+
+/*
+  Check the header of the binary dataset at ds->pos (see dset_magic())
+  and set up the access to its sections. Returns false if the dataset
+  can not be read: foreign byte order, truncated or with offsets that
+  do not describe the element section.
+ */
+static boolean dset_bind( dataset *ds )
+{
+   dset_header h;
+   size_t size = ds->len - ds->pos;
+   const char *base = ds->buf + ds->pos;
+
+   if (size < sizeof(dset_header)) {
+      printf("error: (dset_bind) binary dataset is truncated.\n");
+      return false;
+   }
+   memcpy(&h, base, sizeof(h));
+   if (h.endian != DSET_ENDIAN) {
+      printf("error: (dset_bind) binary dataset has foreign byte order.\n");
+      return false;
+   }
+   // the sections must lie in the dataset; no sums that can overflow
+   if (h.elem_off > size || h.elem_bytes > size - h.elem_off ||
+       h.offs_off > size ||
+       h.nsets >= (size - h.offs_off) / sizeof(uint64_t)) {
+      printf("error: (dset_bind) binary dataset is truncated.\n");
+      return false;
+   }
+
+   // offsets run from 0 to the end of the elements and never decrease;
+   // a set must fit an int
+   const uint64_t *offs = (const uint64_t *)(base + h.offs_off);
+   uint64_t end = (h.flags & DSET_VARINT) ? h.elem_bytes : h.nelems;
+   boolean ok = (offs[0] == 0 && offs[h.nsets] == end);
+   if (!(h.flags & DSET_VARINT))
+      ok = ok && h.nelems <= h.elem_bytes / sizeof(int);
+   for (uint64_t i = 0; ok && i < h.nsets; i++)
+      ok = (offs[i] <= offs[i+1] && offs[i+1] - offs[i] <= INT_MAX);
+   if (!ok) {
+      printf("error: (dset_bind) binary dataset has bad offsets.\n");
+      return false;
+   }
+
+   ds->binary = true;
+   ds->flags = h.flags;
+   ds->nsets = h.nsets;
+   ds->next = 0;
+   ds->offs = offs;
+   ds->elems = base + h.elem_off;
+   return true;
+} /*dset_bind*/
+
+/*
+  Read the rest of a binary stream into the buffer; a binary dataset
+  is accessed randomly through its offsets.
+ */
+static void dset_slurp( dataset *ds )
+{
+   if (ds->pos > 0) {
+      memmove(ds->buf, ds->buf + ds->pos, ds->len - ds->pos);
+      ds->len -= ds->pos;
+      ds->pos = 0;
+   }
+   while (!ds->eof) {
+      if (ds->len == ds->cap) {
+         char *nb = (char *)realloc(ds->buf, ds->cap * 2);
+         if (nb == NULL) {
+            printf("error: (dset_slurp) realloc failed.\n");
+            return;
+         }
+         ds->buf = nb;
+         ds->cap *= 2;
+      }
+      size_t n = fread(ds->buf + ds->len, 1, ds->cap - ds->len, ds->f);
+      if (n == 0)
+         ds->eof = true;
+      ds->len += n;
+   }
+} /*dset_slurp*/
+
+/*
+  Map the file f into memory. Returns false if f is not a regular
+  file or the mapping fails; the caller then falls back to streaming.
+ */
+static boolean dset_map( dataset *ds, FILE *f )
+{
+#ifdef _WIN32
+   HANDLE h = (HANDLE)_get_osfhandle(_fileno(f));
+   LARGE_INTEGER size;
+   HANDLE hm;
+   void *p;
+
+   if (h == INVALID_HANDLE_VALUE || GetFileType(h) != FILE_TYPE_DISK)
+      return false;
+   if (!GetFileSizeEx(h, &size) || size.QuadPart == 0)
+      return false;
+   hm = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (hm == NULL)
+      return false;
+   p = MapViewOfFile(hm, FILE_MAP_READ, 0, 0, 0);
+   if (p == NULL) {
+      CloseHandle(hm);
+      return false;
+   }
+   ds->buf = (char *)p;
+   ds->len = (size_t)size.QuadPart;
+   ds->hmap = (void *)hm;
+#else
+   struct stat st;
+   void *p;
+
+   if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+      return false;
+   p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+   if (p == MAP_FAILED)
+      return false;
+#ifdef MADV_SEQUENTIAL
+   madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+   ds->buf = (char *)p;
+   ds->len = (size_t)st.st_size;
+#endif
+
+   // start where the stream currently is
+   long off = ftell(f);
+   ds->pos = (off > 0 && (size_t)off <= ds->len) ? (size_t)off : 0;
+   ds->mapped = true;
+   ds->eof = true;
+   return true;
+} /*dset_map*/
+
+/*
+  Open a dataset on the stream f. The stream stays owned by the
+  caller; it must remain open until dset_close(). Returns NULL on
+  failure, also for a binary dataset that can not be read.
+ */
+dataset *dset_open( FILE *f )
+{
+   dataset *ds = (dataset *)calloc(1, sizeof(dataset));
+   if (ds == NULL) {
+      printf("error: (dset_open) malloc failed.\n");
+      return NULL;
+   }
+
+   if (dset_map(ds, f)) {
+      if (dset_magic(ds) && !dset_bind(ds)) {
+         dset_close(ds);
+         return NULL;
+      }
+      return ds;
+   }
+
+   // not mappable: read the stream through a buffer
+   ds->cap = DSET_STREAM_SIZE;
+   ds->buf = (char *)malloc(ds->cap);
+   if (ds->buf == NULL) {
+      printf("error: (dset_open) malloc failed.\n");
+      free(ds);
+      return NULL;
+   }
+   ds->f = f;
+
+   // a binary stream is read as a whole
+   size_t n = fread(ds->buf, 1, ds->cap, f);
+   ds->len = n;
+   ds->eof = (n < ds->cap) && feof(f);
+   if (dset_magic(ds)) {
+      dset_slurp(ds);
+      if (!dset_bind(ds)) {
+         dset_close(ds);
+         return NULL;
+      }
+   }
+   return ds;
+} /*dset_open*/
+
+/*
+  Dispose the dataset ds. The underlying stream is not closed.
+ */
+void dset_close( dataset *ds )
+{
+   if (ds == NULL)
+      return;
+
+   if (ds->mapped) {
+#ifdef _WIN32
+      UnmapViewOfFile(ds->buf);
+      CloseHandle((HANDLE)ds->hmap);
+#else
+      munmap(ds->buf, ds->len);
+#endif
+   } else {
+      free(ds->buf);
+   }
+   free(ds);
+} /*dset_close*/
+
+/*
+  Return the number of sets in ds, or -1 if it is not known without
+  reading the whole stream. Counting the lines of a mapped text file
+  does not move the scan position.
+ */
+long dset_nsets( dataset *ds )
+{
+   if (ds->binary)
+      return (long)ds->nsets;
+   if (!ds->mapped)
+      return -1;
+
+   long n = 0;
+   const char *p = ds->buf + ds->pos;
+   const char *e = ds->buf + ds->len;
+   while (p < e) {
+      const char *nl = (const char *)memchr(p, '\n', (size_t)(e - p));
+      const char *le = (nl != NULL) ? nl : e;
+      for (const char *q = p; q < le; q++) {
+         if (*q >= '0' && *q <= '9') {
+            n++;
+            break;
+         }
+      }
+      p = le + 1;
+   }
+   return n;
+} /*dset_nsets*/
+
+/*
+  Return the bytes of ds from the scan position to the end; a stream
+  is read as a whole. The number of bytes is stored in *len. This is
+  used to access other binary images (e.g. set-trie snapshots) through
+  the same mapping.
+ */
+const char *dset_image( dataset *ds, size_t *len )
+{
+   if (!ds->mapped)
+      dset_slurp(ds);
+   *len = ds->len - ds->pos;
+   return ds->buf + ds->pos;
+} /*dset_image*/
+
+/*
+  Refill the stream buffer: move the unread bytes to the front and
+  read more from the stream. The buffer is doubled if a single line
+  does not fit.
+ */
+static void dset_fill( dataset *ds )
+{
+   size_t rest = ds->len - ds->pos;
+
+   if (ds->pos > 0) {
+      memmove(ds->buf, ds->buf + ds->pos, rest);
+      ds->pos = 0;
+      ds->len = rest;
+   }
+   if (ds->len == ds->cap) {
+      char *nb = (char *)realloc(ds->buf, ds->cap * 2);
+      if (nb == NULL) {
+         printf("error: (dset_fill) realloc failed.\n");
+         ds->eof = true;
+         return;
+      }
+      ds->buf = nb;
+      ds->cap *= 2;
+   }
+
+   size_t n = fread(ds->buf + ds->len, 1, ds->cap - ds->len, ds->f);
+   if (n == 0)
+      ds->eof = true;
+   ds->len += n;
+} /*dset_fill*/
+
+/*
+  Return the end of the line starting at ds->pos: the position of the
+  next '\n', or the end of data for the last line.
+ */
+static const char *dset_line_end( dataset *ds )
+{
+   size_t from = ds->pos;
+
+   for (;;) {
+      const char *nl = (const char *)memchr(ds->buf + from, '\n', ds->len - from);
+      if (nl != NULL)
+         return nl;
+      if (ds->eof)
+         return ds->buf + ds->len;
+
+      // keep the scanned part; pos may move to 0 in dset_fill
+      from = ds->len - ds->pos;
+      dset_fill(ds);
+      from += ds->pos;
+   }
+} /*dset_line_end*/
+
+/*
+  Count the integer numbers in the line [p,e).
+ */
+static int dset_count( const char *p, const char *e )
+{
+   int n = 0;
+   boolean in = false;
+
+   for (; p < e; p++) {
+      boolean dig = (*p >= '0' && *p <= '9');
+      if (dig && !in) n++;
+      in = dig;
+   }
+   return n;
+} /*dset_count*/
+
+/*
+  Parse the integers of the line [p,e) into arr. Any character that is
+  not a digit or a leading '-' separates numbers.
+ */
+static void dset_parse( const char *s, const char *e, int *arr )
+{
+   const char *p = s;
+   int n = 0;
+
+   while (p < e) {
+      if (*p < '0' || *p > '9') {
+         p++;
+         continue;
+      }
+
+      boolean neg = (p > s && p[-1] == '-');
+      int v = 0;
+      while (p < e && *p >= '0' && *p <= '9')
+         v = v * 10 + (*p++ - '0');
+      arr[n++] = neg ? -v : v;
+   }
+} /*dset_parse*/
+
+/*
+  Find the next non-empty line. Returns the number of elements in it
+  and sets *ps, *pe to its bounds, or returns 0 at the end of data.
+ */
+static int dset_next_line( dataset *ds, const char **ps, const char **pe )
+{
+   for (;;) {
+      if (ds->pos >= ds->len) {
+         if (ds->eof)
+            return 0;
+         dset_fill(ds);
+         continue;
+      }
+
+      const char *e = dset_line_end(ds);
+      const char *p = ds->buf + ds->pos;
+      int n = dset_count(p, e);
+
+      // skip the line and the '\n'
+      ds->pos = (size_t)(e - ds->buf);
+      if (ds->pos < ds->len) ds->pos++;
+
+      if (n > 0) {
+         *ps = p;
+         *pe = e;
+         return n;
+      }
+   }
+} /*dset_next_line*/
+
+/*
+  Elements of a set are stored sorted. Lines of a sorted dataset are
+  already sorted so this is normally a single check.
+ */
+static void dset_order( set *sp )
+{
+   for (int i = 1; i <= sp->last; i++) {
+      if (sp->arr[i] < sp->arr[i-1]) {
+         set_sort(sp);
+         return;
+      }
+   }
+} /*dset_order*/
+
+/*
+  Number of elements of set i in a binary dataset.
+ */
+static int dset_bin_size( dataset *ds, uint64_t i )
+{
+   uint64_t b = ds->offs[i];
+   uint64_t e = ds->offs[i+1];
+
+   if (!(ds->flags & DSET_VARINT))
+      return (int)(e - b);
+
+   // every varint ends with a byte that has the high bit clear
+   const unsigned char *p = (const unsigned char *)ds->elems + b;
+   const unsigned char *pe = (const unsigned char *)ds->elems + e;
+   int n = 0;
+   for (; p < pe; p++)
+      n += (*p < 0x80);
+   // a damaged set may end inside a varint; dset_bin_copy() decodes it
+   if (e > b && pe[-1] >= 0x80)
+      n++;
+   return n;
+} /*dset_bin_size*/
+
+/*
+  Copy or decode set i of a binary dataset into arr.
+ */
+static void dset_bin_copy( dataset *ds, uint64_t i, int *arr )
+{
+   uint64_t b = ds->offs[i];
+   uint64_t e = ds->offs[i+1];
+
+   if (!(ds->flags & DSET_VARINT)) {
+      memcpy(arr, ds->elems + b * sizeof(int), (size_t)(e - b) * sizeof(int));
+      return;
+   }
+
+   const unsigned char *p = (const unsigned char *)ds->elems + b;
+   const unsigned char *pe = (const unsigned char *)ds->elems + e;
+   uint32_t prev = 0;
+   int n = 0;
+   while (p < pe) {
+      uint32_t v = 0;
+      int sh = 0;
+      unsigned char c;
+      do {
+         c = *p++;
+         v |= (uint32_t)(c & 0x7f) << sh;
+         sh += 7;
+      } while ((c & 0x80) && p < pe);
+      prev += (v >> 1) ^ (0u - (v & 1));   // zigzag delta
+      arr[n++] = (int)prev;
+   }
+} /*dset_bin_copy*/
+
+/*
+  Read the next set from ds. The set is allocated with the exact
+  number of elements. Returns NULL at the end of the dataset.
+ */
+set *dset_read( dataset *ds )
+{
+   if (ds->binary) {
+      if (ds->next >= ds->nsets)
+         return NULL;
+      int n = dset_bin_size(ds, ds->next);
+      set *sp = set_alloc_size(n);
+      if (sp == NULL)
+         return NULL;
+      dset_bin_copy(ds, ds->next++, sp->arr);
+      sp->last = n - 1;
+      return sp;
+   }
+
+   const char *p, *e;
+   int n = dset_next_line(ds, &p, &e);
+   if (n == 0)
+      return NULL;
+
+   set *sp = set_alloc_size(n);
+   if (sp == NULL)
+      return NULL;
+   dset_parse(p, e, sp->arr);
+   sp->last = n - 1;
+   dset_order(sp);
+   return sp;
+} /*dset_read*/
+
+/*
+  Read the next set from ds into the existing set sp. The array of sp
+  is extended if needed. Returns false at the end of the dataset.
+ */
+boolean dset_read_into( dataset *ds, set *sp )
+{
+   if (ds->binary) {
+      set_reset(sp);
+      if (ds->next >= ds->nsets)
+         return false;
+      int n = dset_bin_size(ds, ds->next);
+      if (!set_reserve(sp, n))
+         return false;
+      dset_bin_copy(ds, ds->next++, sp->arr);
+      sp->last = n - 1;
+      return true;
+   }
+
+   const char *p, *e;
+   int n = dset_next_line(ds, &p, &e);
+
+   set_reset(sp);
+   if (n == 0)
+      return false;
+
+   if (!set_reserve(sp, n))
+      return false;
+   dset_parse(p, e, sp->arr);
+   sp->last = n - 1;
+   dset_order(sp);
+   return true;
+} /*dset_read_into*/
+
+/*
+  Make room for n more elements in the arena sa; the element array
+  and the offsets offs are doubled as needed.
+ */
+static boolean dset_arena_grow( set_arena *sa, long *lelems, long **offs, long *lsets, int n )
+{
+   if (sa->nsets + 2 > *lsets) {
+      long *no = (long *)realloc(*offs, 2 * (*lsets) * sizeof(long));
+      if (no == NULL) {
+         printf("error: (dset_arena_grow) realloc failed.\n");
+         return false;
+      }
+      *offs = no;
+      *lsets *= 2;
+   }
+   if (sa->nelems + n > *lelems) {
+      long len = *lelems;
+      while (sa->nelems + n > len)
+         len *= 2;
+      int *ne = (int *)realloc(sa->elems, len * sizeof(int));
+      if (ne == NULL) {
+         printf("error: (dset_arena_grow) realloc failed.\n");
+         return false;
+      }
+      sa->elems = ne;
+      *lelems = len;
+   }
+   return true;
+} /*dset_arena_grow*/
+
+/*
+  Parse the dataset in the stream f once into an arena of sets. Any
+  source recognized by dset_open() can be used, including stdin and
+  other streams that can not be rewound. Returns NULL on failure.
+ */
+set_arena *dset_load( FILE *f )
+{
+   dataset *ds = dset_open(f);
+   if (ds == NULL)
+      return NULL;
+
+   set_arena *sa = (set_arena *)calloc(1, sizeof(set_arena));
+   long lsets = DSET_ARENA_SETS;
+   long lelems = DSET_ARENA_ELEMS;
+   long *offs = (long *)malloc(lsets * sizeof(long));
+   if (sa != NULL)
+      sa->elems = (int *)malloc(lelems * sizeof(int));
+   if ((sa == NULL) || (sa->elems == NULL) || (offs == NULL)) {
+      printf("error: (dset_load) malloc failed.\n");
+      free(offs);
+      dset_arena_free(sa);
+      dset_close(ds);
+      return NULL;
+   }
+   offs[0] = 0;
+
+   // elements are parsed or decoded directly to the end of the arena;
+   // the offsets are turned into views when the arena stops moving
+   boolean ok = true;
+   for (;;) {
+      const char *p, *e;
+      int n;
+      if (ds->binary) {
+         if (ds->next >= ds->nsets)
+            break;
+         n = dset_bin_size(ds, ds->next);
+      } else if ((n = dset_next_line(ds, &p, &e)) == 0) {
+         break;
+      }
+      if (!(ok = dset_arena_grow(sa, &lelems, &offs, &lsets, n)))
+         break;
+
+      set tmp;
+      tmp.arr = sa->elems + sa->nelems;
+      tmp.last = n - 1;
+      if (ds->binary) {
+         dset_bin_copy(ds, ds->next++, tmp.arr);
+      } else {
+         dset_parse(p, e, tmp.arr);
+         dset_order(&tmp);
+      }
+      sa->nelems += n;
+      offs[++(sa->nsets)] = sa->nelems;
+   }
+   dset_close(ds);
+
+   if (ok) {
+      sa->sets = (set *)malloc((sa->nsets + 1) * sizeof(set));
+      if (sa->sets == NULL) {
+         printf("error: (dset_load) malloc failed.\n");
+         ok = false;
+      }
+   }
+   if (!ok) {
+      free(offs);
+      dset_arena_free(sa);
+      return NULL;
+   }
+
+   for (long i = 0; i < sa->nsets; i++) {
+      set *sp = &(sa->sets[i]);
+      sp->arr = sa->elems + offs[i];
+      sp->length = (int)(offs[i+1] - offs[i]);
+      sp->last = sp->length - 1;
+      sp->cursor = -1;
+      sp->view = true;
+   }
+   free(offs);
+   return sa;
+} /*dset_load*/
+
+/*
+  Dispose the arena sa together with all its sets.
+ */
+void dset_arena_free( set_arena *sa )
+{
+   if (sa == NULL)
+      return;
+   free(sa->sets);
+   free(sa->elems);
+   free(sa);
+} /*dset_arena_free*/
+
+/*
+  Create a writer of a binary dataset on the stream f. With the flag
+  DSET_VARINT the elements are stored as delta+varint. The header is
+  written last, so f must be seekable.
+ */
+dset_writer *dset_create( FILE *f, uint32_t flags )
+{
+   dset_header h;
+   dset_writer *dw = (dset_writer *)calloc(1, sizeof(dset_writer));
+   if (dw == NULL) {
+      printf("error: (dset_create) malloc failed.\n");
+      return NULL;
+   }
+
+   dw->offs_len = DSET_INIT_OFFS;
+   dw->offs = (uint64_t *)malloc(dw->offs_len * sizeof(uint64_t));
+   if (dw->offs == NULL) {
+      printf("error: (dset_create) malloc failed.\n");
+      free(dw);
+      return NULL;
+   }
+   dw->offs[0] = 0;
+   dw->f = f;
+   dw->flags = flags;
+   dw->start = ftell(f);
+
+   // placeholder; dset_finish() writes the real header
+   memset(&h, 0, sizeof(h));
+   fwrite(&h, sizeof(h), 1, f);
+   return dw;
+} /*dset_create*/
+
+/*
+  Append the set sp to the binary dataset.
+ */
+boolean dset_write( dset_writer *dw, set *sp )
+{
+   int n = set_size(sp);
+
+   if (dw->nsets + 2 > dw->offs_len) {
+      dw->offs_len *= 2;
+      dw->offs = (uint64_t *)realloc(dw->offs, dw->offs_len * sizeof(uint64_t));
+      if (dw->offs == NULL) {
+         printf("error: (dset_write) realloc failed.\n");
+         return false;
+      }
+   }
+
+   if (!(dw->flags & DSET_VARINT)) {
+      fwrite(sp->arr, sizeof(int), n, dw->f);
+      dw->bytes += (uint64_t)n * sizeof(int);
+      dw->nelems += n;
+      dw->offs[++(dw->nsets)] = dw->nelems;
+      return true;
+   }
+
+   uint32_t prev = 0;
+   for (int i = 0; i < n; i++) {
+      uint32_t d = (uint32_t)sp->arr[i] - prev;
+      uint32_t v = (d << 1) ^ (0u - (d >> 31));   // zigzag
+      prev = (uint32_t)sp->arr[i];
+      while (v >= 0x80) {
+         putc((int)(v & 0x7f) | 0x80, dw->f);
+         v >>= 7;
+         dw->bytes++;
+      }
+      putc((int)v, dw->f);
+      dw->bytes++;
+   }
+   dw->nelems += n;
+   dw->offs[++(dw->nsets)] = dw->bytes;
+   return true;
+} /*dset_write*/
+
+/*
+  Write the offsets and the header and dispose the writer dw. The
+  stream is left positioned at the end of the dataset.
+ */
+boolean dset_finish( dset_writer *dw )
+{
+   dset_header h;
+   static const char pad[8] = {0};
+   boolean ok;
+
+   // align the offsets array
+   uint64_t end = sizeof(dset_header) + dw->bytes;
+   uint64_t npad = (8 - (end & 7)) & 7;
+   fwrite(pad, 1, (size_t)npad, dw->f);
+   fwrite(dw->offs, sizeof(uint64_t), (size_t)(dw->nsets + 1), dw->f);
+
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, DSET_MAGIC, 8);
+   h.endian = DSET_ENDIAN;
+   h.flags = dw->flags;
+   h.nsets = dw->nsets;
+   h.nelems = dw->nelems;
+   h.elem_off = sizeof(dset_header);
+   h.elem_bytes = dw->bytes;
+   h.offs_off = end + npad;
+
+   ok = (fseek(dw->f, dw->start, SEEK_SET) == 0);
+   if (ok) {
+      fwrite(&h, sizeof(h), 1, dw->f);
+      fseek(dw->f, 0, SEEK_END);
+   } else {
+      printf("error: (dset_finish) output is not seekable.\n");
+   }
+   ok = ok && !ferror(dw->f);
+
+   free(dw->offs);
+   free(dw);
+   return ok;
+} /*dset_finish*/
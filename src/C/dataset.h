@@ -0,0 +1,111 @@
+/*
+ * File: dataset.h
+ * Author: Iztok Savnik
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ */
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdint.h>
+
+/*
+  A dataset is a read-only view of a file of sets. Two formats are
+  recognized:
+
+  1) the text format used by .mapd.sorted files: one set per line,
+     elements are decimal integers separated by spaces;
+  2) a binary CSR format (compressed sparse rows): a header, a packed
+     element section and an array of uint64 offsets with one entry
+     per set plus one. The elements are either plain 32-bit integers
+     (offsets are element indices) or, with DSET_VARINT, zigzag
+     varints of the deltas between consecutive elements of a set
+     (offsets are byte offsets into the element section).
+
+  A regular file is mapped into memory and the sets are parsed (text)
+  or copied (binary) directly from the mapped bytes. Streams that can
+  not be mapped (pipes, stdin) are read through a buffer that is
+  refilled from the stream; a binary stream is read as a whole.
+
+  The text scanner is hand written: it does not depend on locale, it
+  does not modify the input and it does not use strtok/atoi. Each set
+  is allocated once with the exact number of its elements.
+ */
+
+/* Magic string and flags of the binary format. */
+#define DSET_MAGIC   "SET2CSR"
+#define DSET_ENDIAN  0x01020304u
+#define DSET_VARINT  1
+
+/* Header of a binary dataset; offsets are relative to the header. */
+typedef struct dset_header {
+   char magic[8];        // DSET_MAGIC
+   uint32_t endian;      // DSET_ENDIAN in the byte order of the writer
+   uint32_t flags;       // DSET_VARINT
+   uint64_t nsets;       // number of sets
+   uint64_t nelems;      // number of elements in all sets
+   uint64_t elem_off;    // start of the element section
+   uint64_t elem_bytes;  // size of the element section
+   uint64_t offs_off;    // start of the offsets array (nsets+1 entries)
+   uint64_t reserved;
+} dset_header;
+
+typedef struct dataset {
+   char *buf;         // mapped file or stream buffer
+   size_t len;        // number of valid bytes in buf
+   size_t pos;        // scan position in buf
+   size_t cap;        // size of stream buffer (0 if mapped)
+   FILE *f;           // stream for refills (NULL if mapped)
+   boolean mapped;    // buf is a memory mapped file
+   boolean eof;       // stream is exhausted
+   void *hmap;        // mapping handle (Windows only)
+   boolean binary;    // binary CSR format
+   uint32_t flags;    // flags of binary format
+   uint64_t nsets;    // number of sets (binary format)
+   uint64_t next;     // index of the next set (binary format)
+   const uint64_t *offs;   // offsets array (binary format)
+   const char *elems;      // element section (binary format)
+} dataset;
+
+/* Writer of binary datasets. The stream must be seekable. */
+typedef struct dset_writer {
+   FILE *f;           // output stream
+   uint32_t flags;    // DSET_VARINT
+   long start;        // position of the header in f
+   uint64_t nsets;    // sets written so far
+   uint64_t nelems;   // elements written so far
+   uint64_t bytes;    // bytes of element section written so far
+   uint64_t *offs;    // offsets collected while writing
+   uint64_t offs_len; // allocated length of offs
+} dset_writer;
+
+/* An arena of sets. A dataset is parsed once into a single array of
+   elements; the sets are views into it (see set_free()) and stay
+   valid until the arena is freed. */
+typedef struct set_arena {
+   set *sets;         // views of the sets, in the order of input
+   int *elems;        // elements of all sets
+   long nsets;        // number of sets
+   long nelems;       // number of elements of all sets
+} set_arena;
+
+/*---------------------------- Exported functions ------------------------------
+ */
+
+extern dataset* dset_open( FILE *f );
+extern void     dset_close( dataset *ds );
+extern long     dset_nsets( dataset *ds );
+extern const char* dset_image( dataset *ds, size_t *len );
+
+extern set*     dset_read( dataset *ds );
+extern boolean  dset_read_into( dataset *ds, set *sp );
+
+extern set_arena* dset_load( FILE *f );
+extern void     dset_arena_free( set_arena *sa );
+
+extern dset_writer* dset_create( FILE *f, uint32_t flags );
+extern boolean  dset_write( dset_writer *dw, set *sp );
+extern boolean  dset_finish( dset_writer *dw );
+
+#endif /* DATASET_H */
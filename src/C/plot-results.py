@@ -11,6 +11,10 @@ Produces:
     search_vs_n.png               best-cap block skiplist vs baselines
     memory_bytes_per_key.png      structural memory comparison
     insert_ns.png                 random-order insert benchmark (if present)
+    batch_ns.png                  csl_search_batch ns/query vs batch size (if present)
+    merge_ns.png                  csl_insert_sorted vs csl_insert per delta size (if present)
+    range_ns.png                  range scans: ns per key vs keys per range (if present)
+    concurrent_mops.png           concurrent-mode reads/s vs threads per write share (if present)
 """
 import csv
 import os
@@ -38,6 +42,22 @@ for r in rows:
     r["search_ns"] = float(r["search_ns"])
     r["insert_ns"] = float(r["insert_ns"])
     r["bytes_per_key"] = float(r["bytes_per_key"])
+    r["batch"] = int(r.get("batch") or 0)  # older files have no batch column
+    r["threads"] = int(r.get("threads") or 0)
+    r["write_pct"] = int(r.get("write_pct") or 0)
+    r["mops"] = float(r.get("mops") or 0)
+
+# batch-mode rows, the delta rows of insert mode, the threaded rows of
+# concurrent mode and the rows of range mode (<structure>-iter / -scan /
+# -spans) get their own plots; the others are csl_search() rows
+cc_rows = [r for r in rows if r["threads"] > 0]
+rows = [r for r in rows if r["threads"] == 0]
+RANGE_SUFFIXES = ("-iter", "-scan", "-spans")
+range_rows = [r for r in rows if r["structure"].endswith(RANGE_SUFFIXES)]
+rows = [r for r in rows if not r["structure"].endswith(RANGE_SUFFIXES)]
+batch_rows = [r for r in rows if r["batch"] > 0 and r["insert_ns"] == 0.0]
+delta_rows = [r for r in rows if r["batch"] > 0 and r["insert_ns"] > 0]
+rows = [r for r in rows if r["batch"] == 0]
 
 def mean(xs):
     xs = list(xs)
@@ -140,4 +160,83 @@ if ins:
     fig.savefig(os.path.join(OUT_DIR, "insert_ns.png"), dpi=150)
     plt.close(fig)
 
+# ---- 5. batched search ----
+bat = defaultdict(list)
+for r in batch_rows:
+    bat[(f'{r["structure"]}@{r["block_cap"]}', r["batch"])].append(r["search_ns"])
+if bat:
+    fig, ax = plt.subplots(figsize=(7, 4))
+    for name in sorted({k[0] for k in bat}):
+        bs = sorted(b for (s, b) in bat if s == name)
+        ax.plot(bs, [mean(bat[(name, b)]) for b in bs], marker="o", label=name)
+    ax.set_xscale("log", base=2)
+    ax.set_xlabel("keys per csl_search_batch call")
+    ax.set_ylabel("ns per query")
+    ax.set_title("Batched search (group prefetching)")
+    ax.legend(fontsize=7)
+    ax.grid(alpha=0.3)
+    fig.tight_layout()
+    fig.savefig(os.path.join(OUT_DIR, "batch_ns.png"), dpi=150)
+    plt.close(fig)
+
+# ---- 6. sorted deltas: merge vs single inserts ----
+dlt = defaultdict(list)
+for r in delta_rows:
+    dlt[(f'{r["structure"]}@{r["block_cap"]}', r["batch"])].append(r["insert_ns"])
+if dlt:
+    fig, ax = plt.subplots(figsize=(7, 4))
+    for name in sorted({k[0] for k in dlt}):
+        ds = sorted(d for (s, d) in dlt if s == name)
+        ax.plot(ds, [mean(dlt[(name, d)]) for d in ds], marker="o", label=name,
+                linestyle="-" if "-merge" in name else "--")
+    ax.set_xscale("log")
+    ax.set_xlabel("keys per sorted delta")
+    ax.set_ylabel("ns per key")
+    ax.set_title("Sorted deltas: csl_insert_sorted (-merge) vs csl_insert (-single)")
+    ax.legend(fontsize=6, ncol=2)
+    ax.grid(alpha=0.3)
+    fig.tight_layout()
+    fig.savefig(os.path.join(OUT_DIR, "merge_ns.png"), dpi=150)
+    plt.close(fig)
+
+# ---- 7. range scans: iterator loop vs csl_range_scan vs csl_range_spans ----
+rng = defaultdict(list)
+for r in range_rows:
+    rng[(f'{r["structure"]}@{r["block_cap"]}', r["batch"])].append(r["search_ns"])
+if rng:
+    fig, ax = plt.subplots(figsize=(7, 4))
+    for name in sorted({k[0] for k in rng}):
+        ls = sorted(b for (s, b) in rng if s == name)
+        ax.plot(ls, [mean(rng[(name, b)]) for b in ls], marker="o", label=name,
+                linestyle="--" if "-iter" in name else "-")
+    ax.set_xscale("log", base=2)
+    ax.set_yscale("log")
+    ax.set_xlabel("keys per range")
+    ax.set_ylabel("ns per key")
+    ax.set_title("Range scans: iterator (--) vs csl_range_scan / csl_range_spans")
+    ax.legend(fontsize=6, ncol=2)
+    ax.grid(alpha=0.3)
+    fig.tight_layout()
+    fig.savefig(os.path.join(OUT_DIR, "range_ns.png"), dpi=150)
+    plt.close(fig)
+
+# ---- 8. concurrent mode: read throughput vs threads ----
+ccm = defaultdict(list)
+for r in cc_rows:
+    ccm[(f'{r["structure"]}@{r["block_cap"]} w={r["write_pct"]}%', r["threads"])].append(r["mops"])
+if ccm:
+    fig, ax = plt.subplots(figsize=(7, 4))
+    for name in sorted({k[0] for k in ccm}):
+        ts = sorted(t for (s, t) in ccm if s == name)
+        ax.plot(ts, [mean(ccm[(name, t)]) for t in ts], marker="o", label=name)
+    ax.set_xscale("log", base=2)
+    ax.set_xlabel("threads")
+    ax.set_ylabel("reads (Mops/s)")
+    ax.set_title("Concurrent mode: read throughput, w = share of writes")
+    ax.legend(fontsize=6, ncol=2)
+    ax.grid(alpha=0.3)
+    fig.tight_layout()
+    fig.savefig(os.path.join(OUT_DIR, "concurrent_mops.png"), dpi=150)
+    plt.close(fig)
+
 print(f"plots written to {OUT_DIR}/")
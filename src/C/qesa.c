@@ -27,7 +27,7 @@ qesa *qesa_alloc()
    qp->length = INIT_QESA_SIZE;
    qp->last = -1;
    qp->cursor = -1;
-   qp->arr = (void *)malloc(INIT_QESA_SIZE * sizeof(void *));
+   qp->arr = (void *)calloc(INIT_QESA_SIZE, sizeof(void *));
    if (qp->arr == NULL) {
       printf("error: (qesa_alloc) malloc array failed.\n");
       return NULL;
@@ -179,12 +179,15 @@ boolean qesa_update(qesa *qp, int ky, void *ptr)
 {
    // check for space
    if (ky > (qp->length - 1)) {
+      int len = qp->length;
       qp->length = ky + INIT_QESA_SIZE;
       qp->arr = (void *)realloc(qp->arr, qp->length * sizeof(void *));
       if (qp->arr == NULL) {
          printf("error: (qesa_update) realloc failed.\n");
          return false;
       }
+      // keys between last and ky are not set
+      memset(qp->arr + len, 0, (qp->length - len) * sizeof(void *));
    }
 
    // insert ptr at the end of int sequence
@@ -206,12 +209,15 @@ boolean qesa_increment(qesa *qp, int ky)
 {
    // check for space and extend the array if needed
    if (ky > (qp->length - 1)) {
+      int len = qp->length;
       qp->length = ky + INIT_QESA_SIZE;
       qp->arr = (void *)realloc(qp->arr, qp->length * sizeof(void *));
       if (qp->arr == NULL) {
          printf("error: (qesa_increment) realloc failed.\n");
          return false;
       }
+      // keys between last and ky are not set
+      memset(qp->arr + len, 0, (qp->length - len) * sizeof(void *));
    }
 
    // create a counter is first time accessed and then increment the
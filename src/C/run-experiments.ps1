@@ -13,7 +13,8 @@
 #   1. Structure comparison + block-size sweep at several data-set sizes
 #      that straddle L1/L2/L3/DRAM (search: 50% hits / 50% misses).
 #   2. Tiny-set regime (set-trie leaf nodes: a handful of keys).
-#   3. Random-order insert benchmark (incremental skip maintenance).
+#   3. Random-order insert benchmark (incremental skip maintenance), and
+#      sorted deltas: csl_insert_sorted vs one csl_insert per key.
 
 param(
     [switch]$Quick,
@@ -53,12 +54,35 @@ if (-not $Quick) {
     }
 }
 
-# --- Experiment 3: random-order inserts (incremental skip maintenance) ---
+# --- Experiment 3: random-order inserts (incremental skip maintenance),
+#     then sorted deltas of 16/1024/65536 keys, merged or key by key ---
 $insN = 200000
 if ($Quick) { $insN = 50000 }
 Write-Host "--- insert benchmark: n=$insN ---" -ForegroundColor Yellow
 & .\experiment.exe -m insert -n $insN -q $Queries -b "32,128,512,2048" -r $Reps -s $Seed -H 50 -o $OutDir
 
+# --- Experiment 4: batched searches (csl_search_batch) ---
+Write-Host "--- batch benchmark: n=1000000 ---" -ForegroundColor Yellow
+& .\experiment.exe -m batch -n 1000000 -q $Queries -b "128,2048" -B "1,2,4,8,16,32,64" -r $Reps -s $Seed -H 50 -o $OutDir
+
+# --- Experiment 5: monotone seeks (csl_iter_seek_from vs csl_iter_seek) ---
+Write-Host "--- monotone seeks: n=1000000 ---" -ForegroundColor Yellow
+foreach ($q in @(1000000, 10000)) {
+    & .\experiment.exe -m monotone -n 1000000 -q $q -b "16,128,2048" -r $Reps -s $Seed -H 50 -o $OutDir
+}
+
+# --- Experiment 6: 50% random deletes, then csl_compact ---
+Write-Host "--- delete benchmark: n=1000000 ---" -ForegroundColor Yellow
+& .\experiment.exe -m delete -n 1000000 -q $Queries -b "16,128,2048" -r $Reps -s $Seed -H 50 -o $OutDir
+
+# --- Experiment 7: concurrent readers and writers (copy-on-write blocks) ---
+Write-Host "--- concurrent benchmark: n=1000000 ---" -ForegroundColor Yellow
+& .\experiment.exe -m concurrent -n 1000000 -q $Queries -b "16,128,2048" -B "1,2,4,8,16,32,64" -W "0,1,10" -r $Reps -s $Seed -H 50 -o $OutDir
+
+# --- Experiment 8: range scans (iterator vs csl_range_scan vs csl_range_spans) ---
+Write-Host "--- range scan benchmark: n=1000000 ---" -ForegroundColor Yellow
+& .\experiment.exe -m range -n 1000000 -q $Queries -b "16,128,2048" -B "1,16,256,4096" -r $Reps -s $Seed -H 50 -o $OutDir
+
 # --- Merge all CSVs (single header) ---
 $merged = Join-Path $OutDir "all-results.csv"
 $first = $true
@@ -27,6 +27,7 @@ set *set_alloc()
    sp->length = INIT_SET_SIZE;
    sp->last = -1;
    sp->cursor = -1;
+   sp->view = false;
    sp->arr = (int *)malloc(INIT_SET_SIZE * sizeof(int));
    if (sp->arr == NULL) {
       printf("error: (set_alloc) malloc failed.\n");
@@ -36,6 +37,50 @@ set *set_alloc()
    return sp;
 } /*set_alloc*/
 
+/*
+  Creating a new set with the array of exactly size elements. Used by
+  loaders that know the length of a set before reading its elements.
+*/
+set *set_alloc_size(int size)
+{
+   set *sp = (set *)malloc(sizeof(set));
+   if (sp == NULL) {
+      printf("error: (set_alloc_size) malloc failed.\n");
+      return NULL;
+   }
+
+   if (size < 1) size = 1;
+   sp->length = size;
+   sp->last = -1;
+   sp->cursor = -1;
+   sp->view = false;
+   sp->arr = (int *)malloc(size * sizeof(int));
+   if (sp->arr == NULL) {
+      printf("error: (set_alloc_size) malloc failed.\n");
+      return NULL;
+   }
+
+   return sp;
+} /*set_alloc_size*/
+
+/*
+  Make sure that the array of set sp can hold at least size elements.
+  The array is extended with a single realloc.
+*/
+boolean set_reserve(set *sp, int size)
+{
+   if (sp->length >= size)
+      return true;
+
+   sp->arr = (int *)realloc(sp->arr, size * sizeof(int));
+   if (sp->arr == NULL) {
+      printf("error: (set_reserve) realloc failed.\n");
+      return false;
+   }
+   sp->length = size;
+   return true;
+} /*set_reserve*/
+
 /*
   Reset the set to the state such that the space remains as it is and
   the set is prepared for loading the elements.
@@ -50,10 +95,12 @@ boolean set_reset(set *sp)
 } /*set_reset*/
 
 /*
-  Dispose the set *sp.
+  Dispose the set *sp. A view is disposed together with its owner.
  */
 boolean set_free(set *sp)
 {
+   if (sp->view)
+      return true;
    free(sp->arr);
    free(sp);
    return true;
@@ -15,18 +15,23 @@
   the last element in set, the index of the current element in the
   set, and a sorted array of integer numbers. The current element,
   thogether with the functions set_open(), set_read(), set_write() and
-  set_eos(), implements a file-like access to sets.
+  set_eos(), implements a file-like access to sets. A view is a set
+  whose memory belongs to a set arena or a mapped image; set_free()
+  leaves it to the owner.
 */
 typedef struct set {
   int length;
   int last;
   int cursor ;
   int *arr;
+  boolean view;   // arr is owned by an arena or an image, not by set
 } set;
 
 /* Exported functions */
 
 extern set*    set_alloc();
+extern set*    set_alloc_size( int size );
+extern boolean set_reserve( set *sp, int size );
 extern boolean set_free( set *sp );
 extern int     set_size( set *sp );
 
@@ -10,20 +10,24 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <memory.h>
 #include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
 #include "config.h"
 #include "set.h"
+#include "dataset.h"
 #include "qesa.h"
 #include "connector.h"
+#include "arena.h"
 #include "set2.h"
  
 /*
-  Create a new set-trie.
+  Initialize an empty node st.
  */
-set2_node *set2_alloc()
+static void set2_init( set2_node *st, int memory )
 {
-   set2_node *st = (set2_node *)malloc(sizeof(set2_node));
    st->isset = false;
    st->istail = false;
    st->ndset = NULL;
@@ -31,15 +35,215 @@ set2_node *set2_alloc()
    st->min = -1;
    st->max = -1;
    st->cnt = 0;
+   st->memory = memory;
+   
+} /*set2_init*/
+
+#ifdef SET2_HANDLES
+
+/* Chunks of nodes by handle; chunk 0 is not used. */
+set2_node *set2_chunks[SET2_CHUNKS];
+
+/* Chunks given back by freed arenas, and the first chunk not used yet. */
+static uint32_t set2_free_chunks[SET2_CHUNKS];
+static uint32_t set2_nfree = 0;
+static uint32_t set2_nchunks = 1;
+static pthread_mutex_t set2_chunk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Arena of the nodes created while no arena is current; never freed. */
+static arena *set2_heap = NULL;
+
+/* The chunk a thread allocates from: handles next..end-1 of the arena
+   with the given id are free. */
+typedef struct set2_pool {
+   long id;
+   uint32_t next;
+   uint32_t end;
+} set2_pool;
+
+static __thread set2_pool set2_cur = { 0, 0, 0 };
+
+/*
+  Give the chunk p (a chunk number) back when its arena is freed.
+ */
+static void set2_free_chunk( void *p )
+{
+   uint32_t c = (uint32_t)(uintptr_t)p;
+   pthread_mutex_lock(&set2_chunk_lock);
+   set2_chunks[c] = NULL;
+   set2_free_chunks[set2_nfree++] = c;
+   pthread_mutex_unlock(&set2_chunk_lock);
+   
+} /*set2_free_chunk*/
+
+/*
+  Allocate a new chunk of nodes from the arena a for the pool of the
+  calling thread.
+ */
+static boolean set2_new_chunk( arena *a, set2_pool *pl )
+{
+   uint32_t c = 0;
+   pthread_mutex_lock(&set2_chunk_lock);
+   if (set2_nfree > 0)
+      c = set2_free_chunks[--set2_nfree];
+   else if (set2_nchunks < SET2_CHUNKS)
+      c = set2_nchunks++;
+   pthread_mutex_unlock(&set2_chunk_lock);
+   if (c == 0) {
+      printf("error: (set2_new_chunk) out of node handles.\n");
+      return false;
+   }
+
+   set2_node *chunk = (set2_node *)arena_alloc(a, SET2_CHUNK_SIZE * sizeof(set2_node));
+   if ((chunk == NULL) || !arena_defer(a, set2_free_chunk, (void *)(uintptr_t)c)) {
+      printf("error: (set2_new_chunk) malloc failed.\n");
+      set2_free_chunk((void *)(uintptr_t)c);
+      return false;
+   }
+   set2_chunks[c] = chunk;
+   pl->id = a->id;
+   pl->next = c << SET2_CHUNK_SHIFT;
+   pl->end = pl->next + SET2_CHUNK_SIZE;
+   return true;
+   
+} /*set2_new_chunk*/
+
+/*
+  Create a new set-trie and return its handle in ref. The node is
+  allocated from a chunk of the current arena of the thread; without
+  one it goes to an arena that is never freed.
+ */
+set2_node *set2_alloc_ref( con_val *ref )
+{
+   arena *a = arena_current();
+   if (a == NULL) {
+      pthread_mutex_lock(&set2_chunk_lock);
+      if (set2_heap == NULL)
+	 set2_heap = arena_create();
+      a = set2_heap;
+      pthread_mutex_unlock(&set2_chunk_lock);
+      if (a == NULL)
+	 return NULL;
+   }
+
+   set2_pool *pl = &set2_cur;
+   if ((pl->id != a->id) || (pl->next == pl->end)) {
+      if (!set2_new_chunk(a, pl))
+	 return NULL;
+   }
+   uint32_t h = pl->next++;
+   set2_node *st = SET2_NODE(h);
+   set2_init(st, SET2_ARENA);
+   *ref = h;
+   return st;
+   
+} /*set2_alloc_ref*/
+
+/*
+  Create a new set-trie.
+ */
+set2_node *set2_alloc()
+{
+   con_val ref;
+   return set2_alloc_ref(&ref);
+   
+} /*set2_alloc*/
+
+#else
+
+/*
+  Create a new set-trie. The node is allocated from the current arena
+  of the thread, if there is one.
+ */
+set2_node *set2_alloc()
+{
+   arena *a = arena_current();
+   set2_node *st = NULL;
+   if (a != NULL)
+      st = (set2_node *)arena_alloc(a, sizeof(set2_node));
+   else
+      st = (set2_node *)malloc(sizeof(set2_node));
+   if (st == NULL) {
+      printf("error: (set2_alloc) malloc failed.\n");
+      return NULL;
+   }
+   set2_init(st, (a != NULL) ? SET2_ARENA : SET2_HEAP);
    return st;
    
 } /*set2_alloc*/
 
 /*
-  Dispose a set-trie referenced by st.
+  Create a new set-trie and return the reference to it, that is
+  stored in a connector, in ref.
+ */
+set2_node *set2_alloc_ref( con_val *ref )
+{
+   set2_node *st = set2_alloc();
+   *ref = (con_val)st;
+   return st;
+   
+} /*set2_alloc_ref*/
+
+#endif /*SET2_HANDLES*/
+
+/*
+  Create a new set-trie index with its own arena. The nodes and
+  connectors inserted into the index are allocated from the arena.
+ */
+set2_node *set2_create()
+{
+   arena *a = arena_create();
+   if (a == NULL)
+      return NULL;
+   set2_index *ix = (set2_index *)arena_alloc(a, sizeof(set2_index));
+   if (ix == NULL) {
+      arena_free(a);
+      return NULL;
+   }
+   set2_init(&(ix->root), SET2_INDEX);
+   ix->mem = a;
+   return &(ix->root);
+   
+} /*set2_create*/
+
+/*
+  Make the arena of the index st the current arena of the thread; the
+  current arena is kept for other set-tries. Return the previous one.
+ */
+static arena *set2_use_arena( set2_node *st )
+{
+   if (st->memory == SET2_INDEX)
+      return arena_use(((set2_index *)st)->mem);
+   return arena_current();
+   
+} /*set2_use_arena*/
+
+/*
+  Dispose a set-trie referenced by st. An index is freed by freeing
+  its arena; the nodes of other set-tries are freed one by one. The
+  nodes of an arena are freed only with the arena. Sets are not
+  freed; they are owned by the caller (or by the arena of an index).
  */
 void set2_free( set2_node *st )
 {
+   if (st == NULL)
+      return;
+   if (st->memory == SET2_INDEX) {
+      arena_free(((set2_index *)st)->mem);
+      return;
+   }
+   if (st->memory == SET2_ARENA)
+      return;
+
+   if (!st->istail && (st->sub.link != NULL)) {
+      connector *cp = st->sub.link;
+      con_open(cp);
+      while (!con_eos(cp))
+	 set2_free(SET2_NODE(con_read(cp)->val));
+      con_free(cp);
+   }
+   free(st);
+   
 } /*set2_free*/
 
 
@@ -61,13 +265,13 @@ void update_bounds( set2_node *st, set *su )
 
 /*
   Inserts elements from two sets from their cursor on to the set-trie
-  st by merging them in common prefix
+  st by merging them in common prefix. If path is not NULL, the nodes
+  on the path of u2 are stored in path[d+1...]; the depth of the last
+  node of u2 is returned. The keys go into fresh connectors, so they
+  are appended with con_write() when they come in order.
  */
-void set2_insert_merge( set2_node *st, set *u1, set *u2 )
+static int set2_merge_path( set2_node *st, set *u1, set *u2, set2_node **path, int d )
 {
-   int el;
-   link *lp = NULL;
-   set *sp = NULL;
    set2_node *s2p = st;
    
    while (!set_eos(u1) && !set_eos(u2)) {
@@ -79,8 +283,10 @@ void set2_insert_merge( set2_node *st, set *u1, set *u2 )
       s2p->sub.link = con_alloc();
 
       if (el1 != el2) {
+	 con_val r1, r2;
+
  	 // create and set set2-node for u1
-	 set2_node *sn1 = set2_alloc();
+	 set2_node *sn1 = set2_alloc_ref(&r1);
 
 	 // update min-max set length bounds
          update_bounds(sn1, u1);           
@@ -93,10 +299,9 @@ void set2_insert_merge( set2_node *st, set *u1, set *u2 )
 	    sn1->sub.tail.set = u1;
 	    sn1->sub.tail.cursor = set_get_cursor(u1);
 	 }
-	 con_insert(s2p->sub.link, el1, (void *)sn1);
 
  	 // create and set set2-node for u2
-	 set2_node *sn2 = set2_alloc();
+	 set2_node *sn2 = set2_alloc_ref(&r2);
 
 	 // update min-max set length bounds
          update_bounds(sn2, u2);           
@@ -109,23 +314,35 @@ void set2_insert_merge( set2_node *st, set *u1, set *u2 )
 	    sn2->sub.tail.set = u2;
 	    sn2->sub.tail.cursor = set_get_cursor(u2);
 	 }
-	 con_insert(s2p->sub.link, el2, (void *)sn2);
+
+	 if (el1 < el2) {
+	    con_write(s2p->sub.link, el1, r1);
+	    con_write(s2p->sub.link, el2, r2);
+	 } else {
+	    con_insert(s2p->sub.link, el1, r1);
+	    con_insert(s2p->sub.link, el2, r2);
+	 }
+	 if (path != NULL)
+	    path[++d] = sn2;
 	 
          // nothing more to do
-	 return;
+	 return d;
 	 
       } else /* (el1 == el2) */ {
 	
  	 // create new set node for e1=e2.
-	 set2_node *sn1 = set2_alloc();
+	 con_val r1;
+	 set2_node *sn1 = set2_alloc_ref(&r1);
 
 	 // update min-max set length bounds
          update_bounds(sn1, u1);           
          update_bounds(sn1, u2);           
 
 	 // link s2p to sn1 through el1.
-	 con_insert(s2p->sub.link, el1, (void *)sn1);
+	 con_write(s2p->sub.link, el1, r1);
 	 s2p = sn1;
+	 if (path != NULL)
+	    path[++d] = sn1;
       }
    }
 
@@ -136,7 +353,7 @@ void set2_insert_merge( set2_node *st, set *u1, set *u2 )
       s2p->isset = true;
       s2p->ndset = u2;
       set_free(u1);   
-      return;
+      return d;
    }
    // end of u1
    if (set_eos(u1)) {
@@ -155,12 +372,23 @@ void set2_insert_merge( set2_node *st, set *u1, set *u2 )
       s2p->sub.tail.cursor = set_get_cursor(u1);
       
    }
+   return d;
+} /*set2_merge_path*/
+
+/*
+  Inserts elements from two sets from their cursor on to the set-trie
+  st by merging them in common prefix
+ */
+void set2_insert_merge( set2_node *st, set *u1, set *u2 )
+{
+   set2_merge_path(st, u1, u2, NULL, 0);
 } /*set2_insert_merge*/
 
 /*
-  Insert a parameter set se into a set-trie st.
+  Insert a parameter set se into a set-trie st; new nodes are
+  allocated from the current arena.
  */
-void set2_insert( set2_node *st, set *se )
+static void set2_insert_path( set2_node *st, set *se )
 {
    int el;
    link *lp = NULL;
@@ -200,15 +428,16 @@ void set2_insert( set2_node *st, set *se )
       if ((lp = con_lookup(s2p->sub.link, el)) == NULL) {
 
 	 // child for el does not exist; create new one
-	 set2_node *new_s2p = set2_alloc();
+	 con_val ref;
+	 set2_node *new_s2p = set2_alloc_ref(&ref);
 
-	 con_insert(s2p->sub.link, el, (void *)new_s2p);
+	 con_insert(s2p->sub.link, el, ref);
 	 s2p = new_s2p;
 	 
       } else {
 
 	 // child for el exists; just move there
-  	 s2p = (set2_node *)(lp->val);
+  	 s2p = SET2_NODE(lp->val);
       }
 
       // update min-max bounds
@@ -220,8 +449,391 @@ void set2_insert( set2_node *st, set *se )
    s2p->ndset = se;
    s2p->isset = true;
    return;
+} /*set2_insert_path*/
+
+/*
+  Insert a parameter set se into a set-trie st.
+ */
+void set2_insert( set2_node *st, set *se )
+{
+   arena *prev = set2_use_arena(st);
+   set2_insert_path(st, se);
+   arena_use(prev);
+   
 } /*set2_insert*/
 
+/*
+  Create a builder that inserts sets into the set-trie st. The builder
+  is meant for sets that come in lexicographic order (as produced by
+  sort-dataset.pl); sets out of order are inserted correctly, only
+  slower.
+ */
+set2_builder *set2_build_open( set2_node *st )
+{
+   set2_builder *sb = (set2_builder *)malloc(sizeof(set2_builder));
+   if (sb == NULL) {
+      printf("error: (set2_build_open) malloc failed.\n");
+      return NULL;
+   }
+
+   sb->length = INIT_PATH_SIZE;
+   sb->path = (set2_node **)malloc(sb->length * sizeof(set2_node *));
+   if (sb->path == NULL) {
+      printf("error: (set2_build_open) malloc failed.\n");
+      free(sb);
+      return NULL;
+   }
+   sb->root = st;
+   sb->path[0] = st;
+   sb->depth = 0;
+   sb->base = 0;
+   sb->prev = NULL;
+   sb->unsorted = 0;
+   return sb;
+   
+} /*set2_build_open*/
+
+/*
+  Insert the set se into the set-trie of builder sb. The path of the
+  previously inserted set is kept in sb->path. The nodes on the common
+  prefix of se and the previous set are taken from the path without
+  lookups. At the node where se departs from the previous set, the
+  element of se is larger than all keys in the connector, so the new
+  child is appended with con_write(). The rest of se goes into new
+  nodes (a tail, or a merge with an existing tail), just as with
+  set2_insert(); the resulting set-trie is the same. After the first
+  set out of order only the common prefix is reused.
+ */
+static void set2_build_path( set2_builder *sb, set *se )
+{
+   int el;
+   int b = sb->base;
+   int n = set_size(se) - b;
+   int lcp = 0;          // common prefix with previous set
+   int k = 0;            // depth to which the path is reused
+   int split = -1;       // depth where se departs from previous set
+   link *lp = NULL;
+   set *pv = sb->prev;
+
+   // make room for the path of se
+   if (n + 1 > sb->length) {
+      while (n + 1 > sb->length)
+         sb->length *= 2;
+      sb->path = (set2_node **)realloc(sb->path, sb->length * sizeof(set2_node *));
+      if (sb->path == NULL) {
+         printf("error: (set2_build_insert) realloc failed.\n");
+         return;
+      }
+   }
+
+   // common prefix with previous set; check the order
+   if (pv != NULL) {
+      int m = set_size(pv) - b;
+      while ((lcp < n) && (lcp < m) && (se->arr[b+lcp] == pv->arr[b+lcp]))
+	 lcp++;
+      k = (lcp < sb->depth) ? lcp : sb->depth;
+      if (lcp < m) {
+	 if ((lcp < n) && (se->arr[b+lcp] > pv->arr[b+lcp]))
+	    split = lcp;
+	 else
+	    sb->unsorted++;
+      }
+
+      // keys are known to be the largest only if all sets were sorted
+      if (sb->unsorted > 0)
+	 split = -1;
+   }
+
+   // walk the shared part of the path; update min-max bounds
+   set_restore_cursor(se, b - 1);
+   set2_node *s2p = sb->root;
+   update_bounds(s2p, se);
+   for (int d = 1; d <= k; d++) {
+      set_read(se);
+      s2p = sb->path[d];
+      update_bounds(s2p, se);
+   }
+
+   // continue as set2_insert() while recording the path
+   int d = k;
+   while (!set_eos(se)) {
+
+      // inserting into tail set
+      if (s2p->istail) {
+	 set *sp = s2p->sub.tail.set;
+         set_restore_cursor(sp, s2p->sub.tail.cursor);
+	 s2p->sub.link = NULL;
+	 s2p->istail = false;
+         sb->depth = set2_merge_path(s2p, sp, se, sb->path, d);
+	 sb->prev = se;
+	 return;
+      }
+      
+      // newly created set2-node: create tail set
+      if (s2p->sub.link == NULL) {
+ 	 s2p->istail = true;
+	 s2p->sub.tail.set = se;
+	 s2p->sub.tail.cursor = set_get_cursor(se);
+	 sb->depth = d;
+	 sb->prev = se;
+         return;
+      }
+
+      el = set_read(se);
+      if (d == split) {
+
+	 // se departs from previous set; el is the largest key 
+	 con_val ref;
+	 set2_node *new_s2p = set2_alloc_ref(&ref);
+	 con_write(s2p->sub.link, el, ref);
+	 s2p = new_s2p;
+
+      } else if ((lp = con_lookup(s2p->sub.link, el)) == NULL) {
+
+	 // child for el does not exist; create new one
+	 con_val ref;
+	 set2_node *new_s2p = set2_alloc_ref(&ref);
+	 con_insert(s2p->sub.link, el, ref);
+	 s2p = new_s2p;
+	 
+      } else {
+
+	 // child for el exists; just move there
+  	 s2p = SET2_NODE(lp->val);
+      }
+      sb->path[++d] = s2p;
+
+      // update min-max bounds
+      update_bounds(s2p, se);
+   }
+
+   // save set se and mark the end of set
+   s2p->ndset = se;
+   s2p->isset = true;
+   sb->depth = d;
+   sb->prev = se;
+   
+} /*set2_build_path*/
+
+/*
+  Insert the set se into the set-trie of builder sb.
+ */
+void set2_build_insert( set2_builder *sb, set *se )
+{
+   arena *prev = set2_use_arena(sb->root);
+   set2_build_path(sb, se);
+   arena_use(prev);
+   
+} /*set2_build_insert*/
+
+/*
+  Dispose the builder sb and return the root of its set-trie.
+ */
+set2_node *set2_build_close( set2_builder *sb )
+{
+   set2_node *st = sb->root;
+   free(sb->path);
+   free(sb);
+   return st;
+   
+} /*set2_build_close*/
+
+/*
+  A part of a parallel build: the sets with the same first element.
+  The sets of a part are ord[start..end-1]; they are inserted into the
+  subtrie node, which is linked from the root by key.
+ */
+typedef struct set2_part {
+   int key;
+   int start, end;
+   set2_node *node;
+   con_val ref;         // reference to node stored in the root
+} set2_part;
+
+/* A worker builds the subtries of parts p0..p1-1. */
+typedef struct set2_worker {
+   set **sets;
+   int *ord;
+   set2_part *parts;
+   int p0, p1;
+   arena *mem;          // arena of the subtries
+   pthread_t tid;
+   boolean started;
+} set2_worker;
+
+/* Pairs (first element, index) used to order the sets by parts. */
+typedef struct set2_first {
+   int key;
+   int ix;
+} set2_first;
+
+static int set2_first_cmp( const void *a, const void *b )
+{
+   const set2_first *x = (const set2_first *)a;
+   const set2_first *y = (const set2_first *)b;
+   if (x->key != y->key)
+      return (x->key < y->key) ? -1 : 1;
+   return (x->ix < y->ix) ? -1 : (x->ix > y->ix);
+} /*set2_first_cmp*/
+
+/*
+  Thread function: build the subtries of the parts of a worker. Each
+  subtrie is built from the second element of its sets on, exactly as
+  the serial build would build it under the root. The worker allocates
+  from its own arena, so the threads do not share an allocator.
+ */
+static void *set2_build_parts( void *arg )
+{
+   set2_worker *w = (set2_worker *)arg;
+   arena *prev = arena_use(w->mem);
+
+   for (int p = w->p0; p < w->p1; p++) {
+      set2_part *pt = &(w->parts[p]);
+      set2_builder *sb = set2_build_open(set2_alloc_ref(&(pt->ref)));
+      sb->base = 1;
+      for (int i = pt->start; i < pt->end; i++)
+	 set2_build_insert(sb, w->sets[w->ord[i]]);
+      pt->node = set2_build_close(sb);
+   }
+   arena_use(prev);
+   return NULL;
+   
+} /*set2_build_parts*/
+
+/*
+  Build a set-trie from the array of n sets using nthreads threads.
+  The sets are partitioned by their first element; the subtries under
+  the root keys are independent, so they are built concurrently and
+  then appended to the root connector in key order. Parts are given
+  to the threads in ranges of keys balanced by the number of sets.
+  The set-trie is the same as the one built by inserting the sets one
+  by one in the order of the array. The result is an index (see
+  set2_create()); the arenas of the threads are joined to its arena.
+ */
+set2_node *set2_build_parallel( set **sets, int n, int nthreads )
+{
+   set2_node *st = set2_create();
+   if (st == NULL)
+      return NULL;
+   int nfirst = 0;
+   
+   for (int i = 0; i < n; i++) {
+      if (set_size(sets[i]) > 0)
+	 nfirst++;
+   }
+
+   // small input: serial build
+   if ((nthreads <= 1) || (nfirst < SET2_PAR_MIN_SETS)) {
+      set2_builder *sb = set2_build_open(st);
+      for (int i = 0; i < n; i++)
+	 set2_build_insert(sb, sets[i]);
+      return set2_build_close(sb);
+   }
+
+   // root bounds; empty sets end in root
+   set2_first *fs = (set2_first *)malloc(nfirst * sizeof(set2_first));
+   int *ord = (int *)malloc(nfirst * sizeof(int));
+   if ((fs == NULL) || (ord == NULL)) {
+      printf("error: (set2_build_parallel) malloc failed.\n");
+      return NULL;
+   }
+   boolean sorted = true;
+   int nf = 0;
+   for (int i = 0; i < n; i++) {
+      set_open(sets[i]);
+      update_bounds(st, sets[i]);
+      if (set_size(sets[i]) == 0) {
+	 st->isset = true;
+	 st->ndset = sets[i];
+	 continue;
+      }
+      fs[nf].key = sets[i]->arr[0];
+      fs[nf].ix = i;
+      if ((nf > 0) && (fs[nf].key < fs[nf-1].key))
+	 sorted = false;
+      nf++;
+   }
+
+   // order sets by first element; keep the input order within a part
+   if (!sorted)
+      qsort(fs, nf, sizeof(set2_first), set2_first_cmp);
+
+   int nparts = 0;
+   for (int i = 0; i < nf; i++) {
+      ord[i] = fs[i].ix;
+      if ((i == 0) || (fs[i].key != fs[i-1].key))
+	 nparts++;
+   }
+   set2_part *parts = (set2_part *)malloc(nparts * sizeof(set2_part));
+   if (parts == NULL) {
+      printf("error: (set2_build_parallel) malloc failed.\n");
+      return NULL;
+   }
+   int np = 0;
+   for (int i = 0; i < nf; i++) {
+      if ((i == 0) || (fs[i].key != fs[i-1].key)) {
+	 if (np > 0)
+	    parts[np-1].end = i;
+	 parts[np].key = fs[i].key;
+	 parts[np].start = i;
+	 parts[np].node = NULL;
+	 np++;
+      }
+   }
+   parts[np-1].end = nf;
+
+   // ranges of parts balanced by the number of sets
+   if (nthreads > nparts)
+      nthreads = nparts;
+   set2_worker *ws = (set2_worker *)malloc(nthreads * sizeof(set2_worker));
+   if (ws == NULL) {
+      printf("error: (set2_build_parallel) malloc failed.\n");
+      return NULL;
+   }
+   int p = 0;
+   for (int t = 0; t < nthreads; t++) {
+      long goal = ((long)nf * (t + 1)) / nthreads;
+      ws[t].sets = sets;
+      ws[t].ord = ord;
+      ws[t].parts = parts;
+      ws[t].p0 = p;
+      ws[t].mem = arena_create();
+      while ((p < nparts) && ((t == nthreads - 1) || (parts[p].end <= goal) || (p == ws[t].p0)))
+	 p++;
+      ws[t].p1 = p;
+   }
+
+   // build the subtries; the calling thread takes the first range
+   for (int t = 1; t < nthreads; t++) {
+      ws[t].started = (pthread_create(&(ws[t].tid), NULL, set2_build_parts, &ws[t]) == 0);
+      if (!ws[t].started)
+	 set2_build_parts(&ws[t]);
+   }
+   set2_build_parts(&ws[0]);
+   for (int t = 1; t < nthreads; t++) {
+      if (ws[t].started)
+	 pthread_join(ws[t].tid, NULL);
+   }
+
+   // link the subtries to the root in key order
+   arena *prev = set2_use_arena(st);
+   st->sub.link = con_alloc();
+   for (int i = 0; i < nparts; i++)
+      con_write(st->sub.link, parts[i].key, parts[i].ref);
+   arena_use(prev);
+   for (int t = 0; t < nthreads; t++) {
+      if (ws[t].mem != NULL)
+	 arena_join(((set2_index *)st)->mem, ws[t].mem);
+   }
+
+   free(ws);
+   free(parts);
+   free(ord);
+   free(fs);
+   return st;
+   
+} /*set2_build_parallel*/
+
 /*
   Search in set-trie st the sets that are similar to the set se using
   the Hamming distance. The current path from root to active node is
@@ -317,7 +929,7 @@ void set2_simsearch_hmg( set2_node *st, set *se, set *sp, int *hmg, qesa *qp )
 	       // descend only with li->key
 	       set_push(sp, li->key);
 	       (*hmg)--;
-               set2_simsearch_hmg((set2_node *)(li->val), se, sp, hmg, qp);
+               set2_simsearch_hmg(SET2_NODE(li->val), se, sp, hmg, qp);
 	       (*hmg)++;
                set_pop(sp);
 
@@ -345,7 +957,7 @@ void set2_simsearch_hmg( set2_node *st, set *se, set *sp, int *hmg, qesa *qp )
 	 // descend in both, se and st.
 	 nel = set_read(se);
          set_push(sp, nel);
-         set2_simsearch_hmg((set2_node *)(li->val), se ,sp, hmg, qp);
+         set2_simsearch_hmg(SET2_NODE(li->val), se ,sp, hmg, qp);
 	 set_pop(sp);
 	 set_unread(se, 1);
 
@@ -432,7 +1044,7 @@ void set2_simsearch_hmg( set2_node *st, set *se, set *sp, int *hmg, qesa *qp )
 	    // descend only with li->key
 	    set_push(sp, li->key);
 	    (*hmg)--;
-            set2_simsearch_hmg((set2_node *)(li->val), se, sp, hmg, qp);
+            set2_simsearch_hmg(SET2_NODE(li->val), se, sp, hmg, qp);
 	    (*hmg)++;
             set_pop(sp);
 
@@ -533,7 +1145,7 @@ void set2_simsearch_lcs( set2_node *st, set *se, set *sp, int *skp, int *add, qe
 	       // descend only with li->key
 	       set_push(sp, li->key);
 	       (*add)--;
-               set2_simsearch_lcs((set2_node *)(li->val), se, sp, skp, add, qp);
+               set2_simsearch_lcs(SET2_NODE(li->val), se, sp, skp, add, qp);
 	       (*add)++;
                set_pop(sp);
 
@@ -562,7 +1174,7 @@ void set2_simsearch_lcs( set2_node *st, set *se, set *sp, int *skp, int *add, qe
 	 // descend in both, se and st.
 	 nel = set_read(se);
          set_push(sp, nel);
-         set2_simsearch_lcs((set2_node *)(li->val), se ,sp, skp, add, qp);
+         set2_simsearch_lcs(SET2_NODE(li->val), se ,sp, skp, add, qp);
 	 set_pop(sp);
 	 set_unread(se, 1);
 
@@ -649,7 +1261,7 @@ void set2_simsearch_lcs( set2_node *st, set *se, set *sp, int *skp, int *add, qe
 	    // descend only with li->key
 	    set_push(sp, li->key);
 	    (*add)--;
-            set2_simsearch_lcs((set2_node *)(li->val), se, sp, skp, add, qp);
+            set2_simsearch_lcs(SET2_NODE(li->val), se, sp, skp, add, qp);
 	    (*add)++;
             set_pop(sp);
 
@@ -706,7 +1318,7 @@ void set2_wtf( FILE *f, set2_node *st, set *s1 )
    for (li = con_read(st->sub.link); li != NULL; li = con_read(st->sub.link)) {
 
       set_push(s1, li->key);
-      set2_wtf(f, (set2_node *)(li->val), s1);
+      set2_wtf(f, SET2_NODE(li->val), s1);
       set_pop(s1);
    }
 
@@ -728,44 +1340,45 @@ void set2_store( set2_node *st, FILE *f )
 } /*set2_store*/
 
 /*
-  Load set-trie strie from file f.
+  Dispose the sets of an index; called when its arena is freed.
  */
-set2_node* set2_load( FILE *f )
+static void set2_free_sets( void *p )
 {
-   // init main vars
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
-
-   // prepare the root of set-trie 
-   set2_node *s2p = set2_alloc();
-
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-      // set of integers
-      set *s1 = set_alloc();
+   dset_arena_free((set_arena *)p);
    
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
+} /*set2_free_sets*/
 
-	 el = atoi(tok);
-         set_insert(s1, el);
-
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
-         
-      // reset access to s1 for reading and insert s1 into set-trie
-      set_open(s1);
-      set2_insert(s2p, s1);
+/*
+  Load set-trie strie from file f.
+ */
+set2_node* set2_load( FILE *f )
+{
+   // the sets are parsed into one arena of elements
+   set_arena *sa = dset_load(f);
+   if (sa == NULL)
+      return NULL;
+   set **sets = (set **)malloc((sa->nsets + 1) * sizeof(set *));
+   if (sets == NULL) {
+      printf("error: (set2_load) malloc failed.\n");
+      dset_arena_free(sa);
+      return NULL;
+   }
+   for (long i = 0; i < sa->nsets; i++)
+      sets[i] = &(sa->sets[i]);
+
+   // build the set-trie; datasets are sorted, so each thread inserts
+   // its sets by the builder along the previous path
+   set2_node *st = set2_build_parallel(sets, (int)sa->nsets, num_threads());
+
+   // the sets are freed together with the index
+   free(sets);
+   if ((st == NULL) || !arena_defer(((set2_index *)st)->mem, set2_free_sets, sa)) {
+      dset_arena_free(sa);
+      set2_free(st);
+      return NULL;
    }
-
-   // free allocated structures
-   free(lin);
-   free(tok);
 
    // return ptr to set-trie root
-   return s2p;
+   return st;
    
 }/*set2_load*/
-
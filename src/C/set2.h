@@ -28,6 +28,12 @@ The s2_node thus has 3 ...
 //typedef struct connector connector;
 /* Removed: kv store of arbitrarily objects ref by (void *) 18/7/24
    
+/* Memory of a node: malloc, an arena, or the root of an index that
+   owns its arena. */
+#define SET2_HEAP   0
+#define SET2_ARENA  1
+#define SET2_INDEX  2
+
 /* A node of a set-trie. */
 typedef struct set2_node {
    boolean isset;    // path represents a set
@@ -44,17 +50,80 @@ typedef struct set2_node {
    int min;   // min set that goes through this node 
    int max;   // max set that goes through this node
    int cnt;   // number of sets in trie with a given prefix */	
+   int memory; // SET2_HEAP, SET2_ARENA or SET2_INDEX
 } set2_node;
 
+/*
+  The children of a node are referenced from its connector by a
+  pointer, or by a 32-bit handle when compiled with SET2_HANDLES (a
+  link is then 8 bytes instead of 16). The nodes with handles are
+  allocated in chunks of SET2_CHUNK_SIZE nodes from arenas; handle h
+  is the node h & (SET2_CHUNK_SIZE-1) of chunk h >> SET2_CHUNK_SHIFT.
+  Handle 0 is not used. SET2_NODE() resolves the value of a link to
+  its node in both modes.
+*/
+#define SET2_CHUNK_SHIFT  14
+#define SET2_CHUNK_SIZE   (1 << SET2_CHUNK_SHIFT)
+#define SET2_CHUNKS       (1 << (32 - SET2_CHUNK_SHIFT))
+
+#ifdef SET2_HANDLES
+extern set2_node *set2_chunks[SET2_CHUNKS];
+#define SET2_NODE(v)  (&(set2_chunks[(v) >> SET2_CHUNK_SHIFT][(v) & (SET2_CHUNK_SIZE - 1)]))
+#else
+#define SET2_NODE(v)  ((set2_node *)(v))
+#endif
+
+/*
+  An index is a set-trie that owns an arena (see arena.h). Its nodes
+  and connectors are allocated from the arena and the whole index is
+  freed with set2_free() in O(#slabs). The root of an index is the
+  node of struct set2_index.
+*/
+typedef struct set2_index {
+   set2_node root;      // root of the set-trie; must be first
+   struct arena *mem;   // arena of the index
+} set2_index;
+
+/* Initial length of the path kept by a builder. */
+#define INIT_PATH_SIZE 64
+
+/* Smaller datasets are built by a single thread. */
+#ifndef SET2_PAR_MIN_SETS
+#define SET2_PAR_MIN_SETS 4096
+#endif
+
+/*
+  A builder inserts lexicographically sorted sets into a set-trie. It
+  keeps the path of the previously inserted set, so that the common
+  prefix is not looked up again and the new children are appended to
+  the connectors.
+*/
+typedef struct set2_builder {
+   set2_node *root;    // set-trie being built
+   set *prev;          // previously inserted set
+   set2_node **path;   // path[d] is the node at depth d of prev
+   int depth;          // depth of the last node of prev
+   int base;           // elements of a set consumed above the root
+   int length;         // allocated length of path
+   long unsorted;      // number of sets that came out of order
+} set2_builder;
+
 /*---------------------- Exported functions ------------------------------*/
 
 extern set2_node* set2_alloc();
+extern set2_node* set2_alloc_ref( con_val *ref );
+extern set2_node* set2_create();
 extern void set2_free( set2_node *st );
 
 extern void set2_insert( set2_node *st, set *se );
 extern void set2_simsearch_lcs( set2_node *st, set *se, set *sp, int *skp, int *add, qesa *qt );
 extern void set2_simsearch_hmg( set2_node *st, set *se, set *sp, int *hmg, qesa *qt );
 
+extern set2_builder* set2_build_open( set2_node *st );
+extern void set2_build_insert( set2_builder *sb, set *se );
+extern set2_node* set2_build_close( set2_builder *sb );
+extern set2_node* set2_build_parallel( set **sets, int n, int nthreads );
+
 extern set2_node* set2_load( FILE *f );
 extern void set2_store( set2_node *st, FILE *f );
 
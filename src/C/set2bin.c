@@ -0,0 +1,83 @@
+/*--------------------------------------------------------------------------
+ *  set2bin: convert datasets between the text and the binary CSR format
+ *
+ *  Usage: set2bin [-z] [-t] input output
+ *
+ *    -z  store elements as delta+varint (default: plain 32-bit)
+ *    -t  write text instead of binary (e.g. to check a binary file)
+ *
+ *  The input is either format; it is recognized by dset_open().
+ *
+ *  Copyright (c) 2024, FAMNIT, University of Primorska
+ *--------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "set.h"
+#include "dataset.h"
+
+static void usage( void )
+{
+   fprintf(stderr, "usage: set2bin [-z] [-t] input output\n");
+   exit(1);
+} /*usage*/
+
+int main( int argc, char *argv[] )
+{
+   uint32_t flags = 0;
+   boolean text = false;
+   int ai = 1;
+
+   for (; ai < argc && argv[ai][0] == '-' && argv[ai][1] != '\0'; ai++) {
+      if (strcmp(argv[ai], "-z") == 0)
+         flags |= DSET_VARINT;
+      else if (strcmp(argv[ai], "-t") == 0)
+         text = true;
+      else
+         usage();
+   }
+   if (argc - ai != 2)
+      usage();
+
+   FILE *in = fopen(argv[ai], "rb");
+   if (in == NULL) {
+      fprintf(stderr, "error: can not open %s\n", argv[ai]);
+      return 1;
+   }
+   FILE *out = fopen(argv[ai+1], "wb");
+   if (out == NULL) {
+      fprintf(stderr, "error: can not open %s\n", argv[ai+1]);
+      return 1;
+   }
+
+   dataset *ds = dset_open(in);
+   dset_writer *dw = text ? NULL : dset_create(out, flags);
+   set *s = set_alloc();
+   long n = 0;
+   boolean ok = (ds != NULL) && (text || dw != NULL);
+
+   while (ok && dset_read_into(ds, s)) {
+      if (text) {
+         set_print(out, s);
+         fputc('\n', out);
+      } else {
+         ok = dset_write(dw, s);
+      }
+      n++;
+   }
+   if (dw != NULL)
+      ok = dset_finish(dw) && ok;
+
+   set_free(s);
+   dset_close(ds);
+   fclose(in);
+   if (fclose(out) != 0)
+      ok = false;
+
+   fprintf(stderr, "set2bin: %ld sets written to %s\n", n, argv[ai+1]);
+   return ok ? 0 : 1;
+} /*main*/
@@ -11,8 +11,10 @@
 #include <malloc.h>
 #include "config.h"
 #include "set.h"
+#include "dataset.h"
 #include "qesa.h"
 #include "connector.h"
+#include "arena.h"
 #include "set2.h"
 #include "set2hat.h"
 
@@ -22,8 +24,16 @@
 set2_hat *s2h_alloc()
 {
    set2_hat *sh = (set2_hat *)malloc(sizeof(set2_hat));
+   if (sh == NULL) {
+      printf("error: (s2h_alloc) malloc failed.\n");
+      return NULL;
+   }
    sh->stats = NULL;
    sh->tries = NULL;
+   sh->arena = NULL;
+   sh->mem = arena_create();
+   sh->nparts = 0;
+   sh->counts = NULL;
    sh->min = -1;
    sh->max = -1;
    return sh;
@@ -31,12 +41,18 @@ set2_hat *s2h_alloc()
 } /*s2h_alloc*/
 
 /*
-  Dispose a set-trie referenced by sh.
+  Dispose a set-trie referenced by sh. The tries are freed with the
+  arena of the hat.
  */
 void s2h_free(set2_hat *sh)
 {
-   qesa_free(sh->stats);
-   con_free(sh->tries);
+   if (sh->stats != NULL)
+      qesa_free(sh->stats);
+   if (sh->tries != NULL)
+      con_free(sh->tries);
+   arena_free(sh->mem);
+   dset_arena_free(sh->arena);
+   free(sh->counts);
    free(sh);
    return;
    
@@ -52,6 +68,7 @@ void s2h_insert(set2_hat *sh, set *se, int hmg)
    link *lcur = NULL;
    link *lnxt = NULL;
    int prv_cur = -1;
+   arena *prev = arena_use(sh->mem);
    
    // find exact position of len in a list of keys
    link *lfnd = con_lookup(sh->tries, len);
@@ -83,13 +100,13 @@ void s2h_insert(set2_hat *sh, set *se, int hmg)
 
    // insert se first in main range of sequence lens
    set_open(se);
-   set2_insert((set2_node *)(lcur->val), se);
+   set2_insert(SET2_NODE(lcur->val), se);
 
    // now add to the upper neighboring range if needed 
    while ((lnxt != NULL) && ((lcur->key - len + 1) <= hmg)) {
       //set *s1 = set_copy(se);
       set_open(se);
-      set2_insert((set2_node *)(lnxt->val), se);
+      set2_insert(SET2_NODE(lnxt->val), se);
 
       // now move to next range
       lcur = lnxt;
@@ -101,11 +118,12 @@ void s2h_insert(set2_hat *sh, set *se, int hmg)
    while ((lprv != NULL) && ((len - lprv->key) <= hmg)) {
       //set *s2 = set_copy(se);
       set_open(se);
-      set2_insert((set2_node *)(lprv->val), se);
+      set2_insert(SET2_NODE(lprv->val), se);
 
       // now move to previous range
       lprv = con_read_prev(sh->tries);
    }
+   arena_use(prev);
       
 } /*s2h_insert*/
 
@@ -135,7 +153,7 @@ void s2h_simsearch_hmg(set2_hat *sh, set *se, set *sp, int *hmg, qesa *qp)
    if (lcur != NULL) {
 
       // lcur now represents the range with se length
-      set2_simsearch_hmg((set2_node *)(lcur->val), se, sp, hmg, qp);
+      set2_simsearch_hmg(SET2_NODE(lcur->val), se, sp, hmg, qp);
 
    }  // else se length is above the max length of sets from index, but
       // there can still be a match in index if
@@ -163,7 +181,7 @@ void s2h_store(set2_hat *sh, FILE *f)
          fprintf(f, "Range = 1 - %d\n", lcur->key);
       else
          fprintf(f, "Range = %d - %d\n", lprv->key + 1, lcur->key);
-      set2_store((set2_node *)(lcur->val), f);
+      set2_store(SET2_NODE(lcur->val), f);
         
       // move to next range
       lprv = lcur;
@@ -172,40 +190,16 @@ void s2h_store(set2_hat *sh, FILE *f)
 } /*s2h_store*/
 
 /*
-  Compute statistic of the lenths of sets from a dataset.
+  Compute statistic of the lenths of sets from the arena sa.
 */
-void compute_statistics(set2_hat *sh, FILE *f)
+void compute_statistics(set2_hat *sh, set_arena *sa)
 {
-   // init main vars
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
-
    // prepare the root of set-trie 
    sh->stats = qesa_alloc();
 
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-      // set of integers
-      set *s1 = set_alloc();
-   
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
-
-	 el = atoi(tok);
-         set_insert(s1, el);
-
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
-         
-      // increment the counter for the given set size in statistics
-      qesa_increment(sh->stats, set_size(s1));
-   }
-
-   // free allocated structures
-   free(lin); 
-   free(tok);
+   // increment the counter for the size of each set in statistics
+   for (long i = 0; i < sa->nsets; i++)
+      qesa_increment(sh->stats, set_size(&(sa->sets[i])));
 
 } /*compute_statistics*/
 
@@ -247,8 +241,9 @@ void generate_mapping(set2_hat *sh, int part_size)
       // current range of keys is then associated with the last key in
       // the range.
       if (part_sum >= part_cnt * part_size) {
- 	 set2_node *st = set2_alloc();
-         con_write(sh->tries, qesa_cursor(sh->stats), (void *)st);
+ 	 con_val ref;
+	 set2_alloc_ref(&ref);
+         con_write(sh->tries, qesa_cursor(sh->stats), ref);
 	 part_cnt++;
 	 pcnt_inc = true;   // inx incremented
       }
@@ -256,75 +251,109 @@ void generate_mapping(set2_hat *sh, int part_size)
 
    // the rest is stored with the last key
    if (!pcnt_inc) {
-      set2_node *st = set2_alloc();
-      con_write(sh->tries, qesa_cursor(sh->stats), (void *)st);
+      con_val ref;
+      set2_alloc_ref(&ref);
+      con_write(sh->tries, qesa_cursor(sh->stats), ref);
    }
 
-   // free qesa,it is not needed any more
    //printf("Statistics of set lengths.\n");
    //qesa_print_inxs(sh->stats, stdout);
-   qesa_free(sh->stats); 
    
 } /*generate_mapping*/
 
 /*
-  Load a dataset to a set-trie.
+  Count the sets that s2h_insert() puts into each range. A set of
+  length len goes to the range of len and to the neighboring ranges
+  within the Hamming distance hmg. Counts are computed from sh->stats,
+  which is not needed any more and is disposed.
  */
-void load_dataset(set2_hat *sh, FILE *f, int hmg)
+void count_partitions(set2_hat *sh, int hmg)
 {
-   // about to read the dataset again
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
+   // keys of ranges in ascending order
+   int n = con_size(sh->tries);
+   int *keys = (int *)malloc(n * sizeof(int));
+   sh->counts = (int *)calloc(n, sizeof(int));
+   if ((keys == NULL) || (sh->counts == NULL)) {
+      printf("error: (count_partitions) malloc failed.\n");
+      free(keys);
+      return;
+   }
+   int k = 0;
+   link *li = NULL;
+   con_open(sh->tries);
+   while ((k < n) && ((li = con_read(sh->tries)) != NULL))
+      keys[k++] = li->key;
+   sh->nparts = k;
+
+   int m = 0;
+   for (int len = 0; len <= sh->stats->last; len++) {
+      int *pint = (int *)qesa_retrieve(sh->stats, len);
+      if (pint == NULL)
+         continue;
+
+      // main range, then upper and lower neighbors as in s2h_insert()
+      while ((m < k - 1) && (keys[m] < len))
+	 m++;
+      sh->counts[m] += *pint;
+      for (int j = m + 1; (j < k) && ((keys[j-1] - len + 1) <= hmg); j++)
+	 sh->counts[j] += *pint;
+      for (int j = m - 1; (j >= 0) && ((len - keys[j]) <= hmg); j--)
+	 sh->counts[j] += *pint;
+   }
+   free(keys);
 
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
+   // free qesa,it is not needed any more
+   qesa_free(sh->stats);
+   sh->stats = NULL;
 
-      // set of integers
-      set *s1 = set_alloc();
-   
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
+} /*count_partitions*/
 
-	 el = atoi(tok);
-         set_insert(s1, el);
+/*
+  Load the sets from the arena sa to a set-trie.
+ */
+void load_dataset(set2_hat *sh, set_arena *sa, int hmg)
+{
+   for (long i = 0; i < sa->nsets; i++) {
 
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
-         
       // reset access to s1 for reading and insert s1 into set-trie
+      set *s1 = &(sa->sets[i]);
       set_open(s1);
       s2h_insert(sh, s1, hmg);
    }
-
-   // free allocated structures
-   free(lin);
-   free(tok);
   
 } /*load_dataset*/
 
 /*
-  Load set-trie strie from file f.
+  Load set-trie strie from file f. The dataset is read once, so f can
+  be stdin or any other stream.
  */
 set2_hat *s2h_load(FILE *f, int psize, int hmg)
 {
+   // parse the dataset into an arena of sets
+   set_arena *sa = dset_load(f);
+   if (sa == NULL)
+      return NULL;
+
    // create a new set-trie with hat
    set2_hat *sh = s2h_alloc();
+   sh->arena = sa;
 
-   // compute statistics from input dataset
-   compute_statistics(sh, f);
+   // compute statistics from the arena
+   compute_statistics(sh, sa);
 
    // generate a mapping from sets to ranges of set lengths. each
    // range is represented by one trie.
+   arena *prev = arena_use(sh->mem);
    generate_mapping(sh, psize);
+   arena_use(prev);
 
-   // load sets from a dataset into a range of tries
-   rewind(f);
-   load_dataset(sh, f, hmg);
+   // count the sets of each range
+   count_partitions(sh, hmg);
+
+   // insert sets from the arena into a range of tries
+   load_dataset(sh, sa, hmg);
 
    // return set-trie with hat
    return sh;
    
 }/*s2h_load*/
-
-
@@ -25,10 +25,18 @@ corresponding set-trie.
 */
 
 /* A top node of a set-trie. Statistics of set lengths is generated in
-   an array-based key-value store implemented in qesa. */
+   an array-based key-value store implemented in qesa. The sets are
+   parsed once into an arena; the tries of all ranges share them. The
+   number of sets of each range is known before the tries are built,
+   so that the ranges can be built independently. The tries and their
+   connectors are allocated from the arena mem of the hat. */
 typedef struct set2_hat {
    qesa *stats;         // statistics of sets by size
    connector *tries;    // refs to set-tries defined for ranges
+   set_arena *arena;    // sets stored in the tries
+   struct arena *mem;   // nodes and connectors of the tries
+   int nparts;          // number of ranges (tries)
+   int *counts;         // number of sets inserted into each range
    int min;             // min set that goes through this node 
    int max;             // max set that goes through this node
 } set2_hat;
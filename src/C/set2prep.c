@@ -0,0 +1,1283 @@
+/*--------------------------------------------------------------------------
+ *  set2prep: prepare a dataset for set2 in one read of the input
+ *
+ *  Usage: set2prep [-b|-z] [-n] [-j threads] [-m mapfile] [-M megabytes]
+ *                  [-T tmpdir] [-p percent] [-s seed] input output [testset]
+ *
+ *    -b  write binary CSR (default: text)
+ *    -z  write binary CSR with delta+varint elements
+ *    -n  do not rename the elements, only sort
+ *    -j  number of threads (default: SET2_THREADS or processors)
+ *    -m  write the mapping "element rank" to mapfile
+ *    -p  sample percent of the sets into testset
+ *    -s  seed of the sampling (default: 1)
+ *    -M  sort externally using at most megabytes of memory for sets
+ *    -T  directory of the temporary files of -M (default: TMPDIR or /tmp)
+ *
+ *  set2prep replaces the chain of Perl scripts from src/perl
+ *  (symb-freq, gen-map-onfreq, map-onfreq-dataset, sort-dataset and
+ *  gen-testset). The input ("-" for stdin, text or binary) is parsed
+ *  once into an arena of sets and all steps are done in memory:
+ *
+ *    1) the frequencies of the elements are counted;
+ *    2) the elements are renamed by frequency rank; the most frequent
+ *       element becomes 0, ties are broken by the element value;
+ *    3) the elements of each set are sorted;
+ *    4) the sets are sorted lexicographically (a prefix comes first);
+ *    5) percent of the sets are sampled without repetition into the
+ *       testset, which is therefore sorted as well.
+ *
+ *  Steps 1-4 run on several threads. The outputs are written in a
+ *  single pass over the sorted sets.
+ *
+ *  With -M the dataset does not have to fit in memory. The frequencies
+ *  are counted in a first pass over the input (which must then be a
+ *  file, unless -n is given). The second pass reads chunks of sets
+ *  that fit in the memory cap, renames and sorts them as above and
+ *  spills each chunk as a sorted run to a temporary file. The runs are
+ *  merged with a loser tree through large sequential buffers; if there
+ *  are too many runs for the buffers to fit in the cap, groups of runs
+ *  are first merged into longer runs. A dataset that fits in a single
+ *  chunk is written directly.
+ *
+ *  Copyright (c) 2024, FAMNIT, University of Primorska
+ *--------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include "config.h"
+#include "set.h"
+#include "dataset.h"
+
+/* MinGW's msvcrt lacks clock_gettime(); shim it as in test-set2.c. */
+#if defined(_WIN32) && !defined(CLOCK_MONOTONIC)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define CLOCK_MONOTONIC 0
+static int clock_gettime(int clk, struct timespec* ts)
+{
+   LARGE_INTEGER f, t;
+   (void)clk;
+   QueryPerformanceFrequency(&f);
+   QueryPerformanceCounter(&t);
+   ts->tv_sec  = (long)(t.QuadPart / f.QuadPart);
+   ts->tv_nsec = (long)((t.QuadPart % f.QuadPart) * 1000000000LL / f.QuadPart);
+   return 0;
+}
+#endif
+
+/* Elements are counted in a dense array if their range is at most
+   PREP_DENSE_FACTOR times the number of elements (or PREP_DENSE_MIN);
+   otherwise the distinct elements are collected and searched. */
+#define PREP_DENSE_FACTOR  4
+#define PREP_DENSE_MIN     (1 << 20)
+
+/* Size of the buffer of a text output. */
+#define PREP_OUT_SIZE      (1 << 20)
+
+/* Buffer of a run being written, and the smallest read buffer of a
+   run being merged; the fan-in of a merge is limited by the latter. */
+#define PREP_IO_SIZE       (4 << 20)
+#define PREP_MIN_READ      (256 << 10)
+
+/* Memory of a chunk per set besides its elements: the set and two
+   pointers used for sorting. */
+#define PREP_SET_BYTES     (sizeof(set) + 2 * sizeof(set *))
+
+struct prep_ctx;
+
+/* A range of work [lo,hi) done by one thread. */
+typedef struct prep_task {
+   struct prep_ctx *px;
+   int t;               // index of the thread
+   long lo, hi;
+   pthread_t tid;
+   boolean started;
+} prep_task;
+
+/* State shared by the steps. */
+typedef struct prep_ctx {
+   set_arena *sa;       // the sets
+   int nthreads;
+   prep_task *tasks;    // one per thread
+   int vmin;            // smallest element (dense keys)
+   int *vals;           // sorted distinct elements (sparse keys), or NULL
+   long nkeys;          // number of keys of elements
+   long *cnt;           // frequencies by key
+   long **lcnt;         // frequencies by thread, or NULL for atomic adds
+   int *rank;           // new name of an element by key, or NULL
+   set **ord;           // sets in sorted order
+   set **tmp;           // merge buffer
+   long *runs;          // bounds of sorted runs of ord
+   size_t cap;          // memory cap of external sort (0: in memory)
+   const char *tmpdir;  // directory of spilled runs
+   int nspill;          // number of run files created
+   int npasses;         // number of merge passes
+} prep_ctx;
+
+/* Pairs (frequency, key) ordered by rank. */
+typedef struct prep_freq {
+   long cnt;
+   long key;
+} prep_freq;
+
+/* Counts of elements in an open addressing hash table; a slot with
+   count 0 is free. Used when the elements are not all in memory. */
+typedef struct prep_hash {
+   int *keys;
+   long *cnts;
+   long cap;            // power of 2
+   long n;
+} prep_hash;
+
+/* A sorted run in a temporary file. A record is the number of
+   elements followed by the elements. When the run is merged, cur is
+   the current set, a view into the read buffer. */
+typedef struct prep_spill {
+   char name[1024];
+   FILE *f;
+   char *buf;
+   size_t len, pos, cap;
+   set cur;
+   boolean eos;
+} prep_spill;
+
+/* An output: text through a buffer or a binary dataset. */
+typedef struct prep_out {
+   FILE *f;
+   dset_writer *dw;     // binary output, else NULL
+   char *buf;
+   size_t len, cap;
+   long nsets;
+} prep_out;
+
+static double now_ms( void )
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} /*now_ms*/
+
+static void usage( void )
+{
+   fprintf(stderr, "usage: set2prep [-b|-z] [-n] [-j threads] [-m mapfile] [-M megabytes]\n"
+	   "                [-T tmpdir] [-p percent] [-s seed] input output [testset]\n");
+   exit(1);
+} /*usage*/
+
+/*
+  Run fn on the ranges of [0,n) split evenly among the threads. The
+  calling thread takes the first range.
+ */
+static void prep_run( prep_ctx *px, long n, void *(*fn)(void *) )
+{
+   int nt = px->nthreads;
+   if (nt > n)
+      nt = (n > 0) ? (int)n : 1;
+
+   prep_task *ts = px->tasks;
+   for (int t = 0; t < nt; t++) {
+      ts[t].px = px;
+      ts[t].t = t;
+      ts[t].lo = (n * t) / nt;
+      ts[t].hi = (n * (t + 1)) / nt;
+   }
+   for (int t = 1; t < nt; t++) {
+      ts[t].started = (pthread_create(&(ts[t].tid), NULL, fn, &ts[t]) == 0);
+      if (!ts[t].started)
+	 fn(&ts[t]);
+   }
+   fn(&ts[0]);
+   for (int t = 1; t < nt; t++) {
+      if (ts[t].started)
+	 pthread_join(ts[t].tid, NULL);
+   }
+} /*prep_run*/
+
+/*
+  Key of the element x: its offset from vmin, or its index in vals.
+ */
+static inline long prep_key( prep_ctx *px, int x )
+{
+   if (px->vals == NULL)
+      return (long)x - px->vmin;
+
+   long lo = 0, hi = px->nkeys - 1;
+   while (lo < hi) {
+      long mid = (lo + hi) / 2;
+      if (px->vals[mid] < x)
+	 lo = mid + 1;
+      else
+	 hi = mid;
+   }
+   return lo;
+} /*prep_key*/
+
+static int prep_int_cmp( const void *a, const void *b )
+{
+   int x = *(const int *)a;
+   int y = *(const int *)b;
+   return (x < y) ? -1 : (x > y);
+} /*prep_int_cmp*/
+
+/*
+  Choose the keys of elements: dense if the range of elements is small
+  enough, else the sorted distinct elements.
+ */
+static boolean prep_keys( prep_ctx *px )
+{
+   set_arena *sa = px->sa;
+   int vmin = 0, vmax = -1;
+
+   for (long i = 0; i < sa->nelems; i++) {
+      int x = sa->elems[i];
+      if ((i == 0) || (x < vmin)) vmin = x;
+      if ((i == 0) || (x > vmax)) vmax = x;
+   }
+   px->vmin = vmin;
+
+   long range = (long)vmax - vmin + 1;
+   if (range <= (long)PREP_DENSE_FACTOR * sa->nelems + PREP_DENSE_MIN) {
+      px->nkeys = range;
+      return true;
+   }
+
+   px->vals = (int *)malloc(sa->nelems * sizeof(int));
+   if (px->vals == NULL) {
+      printf("error: (prep_keys) malloc failed.\n");
+      return false;
+   }
+   memcpy(px->vals, sa->elems, sa->nelems * sizeof(int));
+   qsort(px->vals, sa->nelems, sizeof(int), prep_int_cmp);
+   long n = 0;
+   for (long i = 0; i < sa->nelems; i++) {
+      if ((n == 0) || (px->vals[i] != px->vals[n-1]))
+	 px->vals[n++] = px->vals[i];
+   }
+   px->nkeys = n;
+   return true;
+} /*prep_keys*/
+
+/*
+  Thread function: count the elements elems[lo..hi-1].
+ */
+static void *prep_count( void *arg )
+{
+   prep_task *tk = (prep_task *)arg;
+   prep_ctx *px = tk->px;
+   const int *el = px->sa->elems;
+
+   if (px->lcnt != NULL) {
+      long *c = px->lcnt[tk->t];
+      for (long i = tk->lo; i < tk->hi; i++)
+	 c[prep_key(px, el[i])]++;
+   } else {
+      for (long i = tk->lo; i < tk->hi; i++)
+	 __atomic_fetch_add(&(px->cnt[prep_key(px, el[i])]), 1, __ATOMIC_RELAXED);
+   }
+   return NULL;
+} /*prep_count*/
+
+/*
+  Thread function: add the counts of the threads for keys lo..hi-1.
+ */
+static void *prep_sum( void *arg )
+{
+   prep_task *tk = (prep_task *)arg;
+   prep_ctx *px = tk->px;
+
+   for (int t = 0; t < px->nthreads; t++) {
+      long *c = px->lcnt[t];
+      for (long k = tk->lo; k < tk->hi; k++)
+	 px->cnt[k] += c[k];
+   }
+   return NULL;
+} /*prep_sum*/
+
+/*
+  Count the frequencies of elements. Each thread counts into its own
+  array if they fit in the memory of the arena; otherwise the counts
+  are shared and incremented atomically.
+ */
+static boolean prep_count_all( prep_ctx *px )
+{
+   set_arena *sa = px->sa;
+
+   px->cnt = (long *)calloc(px->nkeys, sizeof(long));
+   if (px->cnt == NULL) {
+      printf("error: (prep_count_all) malloc failed.\n");
+      return false;
+   }
+
+   if ((px->nthreads > 1) && (px->nkeys * px->nthreads <= sa->nelems / 2)) {
+      px->lcnt = (long **)calloc(px->nthreads, sizeof(long *));
+      for (int t = 0; (px->lcnt != NULL) && (t < px->nthreads); t++) {
+	 px->lcnt[t] = (long *)calloc(px->nkeys, sizeof(long));
+	 if (px->lcnt[t] == NULL) {
+	    printf("error: (prep_count_all) malloc failed.\n");
+	    return false;
+	 }
+      }
+   }
+
+   prep_run(px, sa->nelems, prep_count);
+   if (px->lcnt != NULL) {
+      prep_run(px, px->nkeys, prep_sum);
+      for (int t = 0; t < px->nthreads; t++)
+	 free(px->lcnt[t]);
+      free(px->lcnt);
+      px->lcnt = NULL;
+   }
+   return true;
+} /*prep_count_all*/
+
+static int prep_freq_cmp( const void *a, const void *b )
+{
+   const prep_freq *x = (const prep_freq *)a;
+   const prep_freq *y = (const prep_freq *)b;
+   if (x->cnt != y->cnt)
+      return (x->cnt > y->cnt) ? -1 : 1;
+   return (x->key < y->key) ? -1 : (x->key > y->key);
+} /*prep_freq_cmp*/
+
+/*
+  Rank the elements by decreasing frequency. The rank of an element
+  is its new name. The mapping is written to mf if not NULL.
+ */
+static boolean prep_rank( prep_ctx *px, FILE *mf, long *nsym )
+{
+   long n = 0;
+   for (long k = 0; k < px->nkeys; k++)
+      n += (px->cnt[k] > 0);
+
+   prep_freq *fr = (prep_freq *)malloc((n + 1) * sizeof(prep_freq));
+   px->rank = (int *)malloc(px->nkeys * sizeof(int));
+   if ((fr == NULL) || (px->rank == NULL)) {
+      printf("error: (prep_rank) malloc failed.\n");
+      return false;
+   }
+   n = 0;
+   for (long k = 0; k < px->nkeys; k++) {
+      if (px->cnt[k] > 0) {
+	 fr[n].cnt = px->cnt[k];
+	 fr[n].key = k;
+	 n++;
+      }
+   }
+   qsort(fr, n, sizeof(prep_freq), prep_freq_cmp);
+
+   for (long r = 0; r < n; r++) {
+      px->rank[fr[r].key] = (int)r;
+      if (mf != NULL) {
+	 int x = (px->vals != NULL) ? px->vals[fr[r].key] : (int)(fr[r].key + px->vmin);
+	 fprintf(mf, "%d %ld\n", x, r);
+      }
+   }
+   *nsym = n;
+   free(fr);
+   return true;
+} /*prep_rank*/
+
+/*
+  Thread function: rename the elements of sets lo..hi-1 and sort them.
+ */
+static void *prep_remap( void *arg )
+{
+   prep_task *tk = (prep_task *)arg;
+   prep_ctx *px = tk->px;
+
+   for (long i = tk->lo; i < tk->hi; i++) {
+      set *sp = &(px->sa->sets[i]);
+      if (px->rank != NULL) {
+	 for (int j = 0; j <= sp->last; j++)
+	    sp->arr[j] = px->rank[prep_key(px, sp->arr[j])];
+      }
+      set_sort(sp);
+   }
+   return NULL;
+} /*prep_remap*/
+
+/*
+  Lexicographic order of sets; a prefix of a set comes first.
+ */
+static int prep_set_cmp( const void *a, const void *b )
+{
+   const set *x = *(set * const *)a;
+   const set *y = *(set * const *)b;
+   int n = (x->last < y->last) ? x->last : y->last;
+
+   for (int i = 0; i <= n; i++) {
+      if (x->arr[i] != y->arr[i])
+	 return (x->arr[i] < y->arr[i]) ? -1 : 1;
+   }
+   return (x->last < y->last) ? -1 : (x->last > y->last);
+} /*prep_set_cmp*/
+
+/*
+  Thread function: sort the sets ord[lo..hi-1].
+ */
+static void *prep_sort_run( void *arg )
+{
+   prep_task *tk = (prep_task *)arg;
+   prep_ctx *px = tk->px;
+
+   qsort(px->ord + tk->lo, tk->hi - tk->lo, sizeof(set *), prep_set_cmp);
+   return NULL;
+} /*prep_sort_run*/
+
+/*
+  Thread function: merge the pairs of runs lo..hi-1 from ord to tmp.
+  Pair p is made of runs 2p and 2p+1; a last run without a pair is
+  copied.
+ */
+static void *prep_merge_runs( void *arg )
+{
+   prep_task *tk = (prep_task *)arg;
+   prep_ctx *px = tk->px;
+
+   for (long p = tk->lo; p < tk->hi; p++) {
+      long a = px->runs[2*p], m = px->runs[2*p+1], e = px->runs[2*p+2];
+      long i = a, j = m, k = a;
+      while ((i < m) && (j < e)) {
+	 // equal sets are taken from the first run: the sort is stable
+	 if (prep_set_cmp(&(px->ord[j]), &(px->ord[i])) < 0)
+	    px->tmp[k++] = px->ord[j++];
+	 else
+	    px->tmp[k++] = px->ord[i++];
+      }
+      while (i < m)
+	 px->tmp[k++] = px->ord[i++];
+      while (j < e)
+	 px->tmp[k++] = px->ord[j++];
+   }
+   return NULL;
+} /*prep_merge_runs*/
+
+/*
+  Sort the sets: each thread sorts a run, then the runs are merged in
+  pairs until one run is left.
+ */
+static boolean prep_sort( prep_ctx *px )
+{
+   long n = px->sa->nsets;
+   int nt = px->nthreads;
+
+   px->ord = (set **)malloc((n + 1) * sizeof(set *));
+   px->tmp = (set **)malloc((n + 1) * sizeof(set *));
+   px->runs = (long *)malloc((2 * nt + 3) * sizeof(long));
+   if ((px->ord == NULL) || (px->tmp == NULL) || (px->runs == NULL)) {
+      printf("error: (prep_sort) malloc failed.\n");
+      return false;
+   }
+   for (long i = 0; i < n; i++)
+      px->ord[i] = &(px->sa->sets[i]);
+
+   prep_run(px, n, prep_sort_run);
+
+   // bounds of the runs sorted by the threads
+   long nruns = (nt > n) ? ((n > 0) ? n : 1) : nt;
+   for (long r = 0; r <= nruns; r++)
+      px->runs[r] = (n * r) / nruns;
+
+   while (nruns > 1) {
+      long npairs = nruns / 2;
+      if (nruns & 1) {
+	 // the odd run is merged with an empty run
+	 px->runs[nruns + 1] = px->runs[nruns];
+	 npairs++;
+      }
+      prep_run(px, npairs, prep_merge_runs);
+
+      set **sw = px->ord;
+      px->ord = px->tmp;
+      px->tmp = sw;
+      for (long p = 0; p <= npairs; p++)
+	 px->runs[p] = px->runs[2*p];
+      px->runs[npairs] = n;
+      nruns = npairs;
+   }
+   return true;
+} /*prep_sort*/
+
+/*
+  Dispose the arrays of prep_sort().
+ */
+static void prep_sort_free( prep_ctx *px )
+{
+   free(px->ord);
+   free(px->tmp);
+   free(px->runs);
+   px->ord = px->tmp = NULL;
+   px->runs = NULL;
+} /*prep_sort_free*/
+
+/*
+  Open the output fnam ("-" for stdout) as text or as a binary
+  dataset with flags.
+ */
+static boolean prep_open_out( prep_out *po, const char *fnam, boolean binary, uint32_t flags )
+{
+   memset(po, 0, sizeof(prep_out));
+   po->f = (strcmp(fnam, "-") == 0) ? stdout : fopen(fnam, "wb");
+   if (po->f == NULL) {
+      fprintf(stderr, "error: can not open %s\n", fnam);
+      return false;
+   }
+   if (binary) {
+      po->dw = dset_create(po->f, flags);
+      return (po->dw != NULL);
+   }
+   po->cap = PREP_OUT_SIZE;
+   po->buf = (char *)malloc(po->cap);
+   if (po->buf == NULL) {
+      printf("error: (prep_open_out) malloc failed.\n");
+      return false;
+   }
+   return true;
+} /*prep_open_out*/
+
+/*
+  Append the set sp to the output po.
+ */
+static boolean prep_put( prep_out *po, set *sp )
+{
+   po->nsets++;
+   if (po->dw != NULL)
+      return dset_write(po->dw, sp);
+
+   // at most 11 characters and a separator per element
+   size_t need = (size_t)set_size(sp) * 12 + 1;
+   if (po->len + need > po->cap) {
+      fwrite(po->buf, 1, po->len, po->f);
+      po->len = 0;
+      if (need > po->cap) {
+	 char *nb = (char *)realloc(po->buf, need);
+	 if (nb == NULL) {
+	    printf("error: (prep_put) realloc failed.\n");
+	    return false;
+	 }
+	 po->buf = nb;
+	 po->cap = need;
+      }
+   }
+
+   char *p = po->buf + po->len;
+   for (int i = 0; i <= sp->last; i++) {
+      char dig[12];
+      int nd = 0;
+      long v = sp->arr[i];
+      if (i > 0)
+	 *p++ = ' ';
+      if (v < 0) {
+	 *p++ = '-';
+	 v = -v;
+      }
+      do {
+	 dig[nd++] = (char)('0' + v % 10);
+	 v /= 10;
+      } while (v > 0);
+      while (nd > 0)
+	 *p++ = dig[--nd];
+   }
+   *p++ = '\n';
+   po->len = (size_t)(p - po->buf);
+   return true;
+} /*prep_put*/
+
+/*
+  Finish and close the output po.
+ */
+static boolean prep_close_out( prep_out *po )
+{
+   boolean ok = true;
+
+   if (po->dw != NULL)
+      ok = dset_finish(po->dw);
+   else if (po->len > 0)
+      fwrite(po->buf, 1, po->len, po->f);
+   free(po->buf);
+
+   if (po->f == stdout)
+      ok = (fflush(po->f) == 0) && ok;
+   else
+      ok = (fclose(po->f) == 0) && ok;
+   return ok;
+} /*prep_close_out*/
+
+/* The final outputs: the dataset and a sample of it as the testset. */
+typedef struct prep_sink {
+   prep_out od;
+   prep_out ot;
+   boolean test;
+   long nsets;          // sets not yet written
+   long left;           // sets not yet sampled
+   uint64_t seed;
+} prep_sink;
+
+/* xorshift64* generator; returns a number from [0,1). */
+static double prep_random( uint64_t *s )
+{
+   *s ^= *s >> 12;
+   *s ^= *s << 25;
+   *s ^= *s >> 27;
+   return (double)((*s * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+} /*prep_random*/
+
+/*
+  Prepare the sink sk for n sets; the testset gets percent of them.
+ */
+static void prep_sink_start( prep_sink *sk, long n, double percent )
+{
+   sk->nsets = n;
+   sk->left = 0;
+   if (sk->test) {
+      sk->left = (long)(n * percent / 100.0 + 1);
+      if (sk->left > n)
+	 sk->left = n;
+   }
+} /*prep_sink_start*/
+
+/*
+  Write the next set sp to the dataset. The testset is drawn by
+  selection sampling, so it is in the order of the dataset.
+ */
+static boolean prep_sink_put( void *arg, set *sp )
+{
+   prep_sink *sk = (prep_sink *)arg;
+   boolean ok = prep_put(&(sk->od), sp);
+
+   if ((sk->left > 0) && (prep_random(&(sk->seed)) * sk->nsets < sk->left)) {
+      ok = prep_put(&(sk->ot), sp) && ok;
+      sk->left--;
+   }
+   sk->nsets--;
+   return ok;
+} /*prep_sink_put*/
+
+/*
+  Slot of the element x in a hash table of length cap.
+ */
+static inline long prep_hash_slot( long cap, int x )
+{
+   uint64_t h = (uint64_t)(uint32_t)x * 0x9E3779B97F4A7C15ULL;
+   return (long)((h ^ (h >> 32)) & (uint64_t)(cap - 1));
+} /*prep_hash_slot*/
+
+/*
+  Add one to the count of the element x; the table is doubled when it
+  gets half full.
+ */
+static boolean prep_hash_add( prep_hash *h, int x )
+{
+   if (2 * (h->n + 1) > h->cap) {
+      long cap = (h->cap == 0) ? (1 << 16) : 2 * h->cap;
+      int *nk = (int *)malloc(cap * sizeof(int));
+      long *nc = (long *)calloc(cap, sizeof(long));
+      if ((nk == NULL) || (nc == NULL)) {
+	 printf("error: (prep_hash_add) malloc failed.\n");
+	 return false;
+      }
+      for (long i = 0; i < h->cap; i++) {
+	 if (h->cnts[i] == 0)
+	    continue;
+	 long j = prep_hash_slot(cap, h->keys[i]);
+	 while (nc[j] != 0)
+	    j = (j + 1) & (cap - 1);
+	 nk[j] = h->keys[i];
+	 nc[j] = h->cnts[i];
+      }
+      free(h->keys);
+      free(h->cnts);
+      h->keys = nk;
+      h->cnts = nc;
+      h->cap = cap;
+   }
+
+   long i = prep_hash_slot(h->cap, x);
+   while ((h->cnts[i] != 0) && (h->keys[i] != x))
+      i = (i + 1) & (h->cap - 1);
+   if (h->cnts[i] == 0) {
+      h->keys[i] = x;
+      h->n++;
+   }
+   h->cnts[i]++;
+   return true;
+} /*prep_hash_add*/
+
+/*
+  Choose the keys of elements and their frequencies from the counts
+  in the hash table h, as prep_keys() and prep_count_all() do for the
+  elements of an arena.
+ */
+static boolean prep_keys_hash( prep_ctx *px, prep_hash *h, long nelems )
+{
+   px->vals = (int *)malloc((h->n + 1) * sizeof(int));
+   if (px->vals == NULL) {
+      printf("error: (prep_keys_hash) malloc failed.\n");
+      return false;
+   }
+   long n = 0;
+   for (long i = 0; i < h->cap; i++) {
+      if (h->cnts[i] != 0)
+	 px->vals[n++] = h->keys[i];
+   }
+   qsort(px->vals, n, sizeof(int), prep_int_cmp);
+
+   long range = (long)px->vals[n-1] - px->vals[0] + 1;
+   px->vmin = px->vals[0];
+   if (range <= (long)PREP_DENSE_FACTOR * nelems + PREP_DENSE_MIN) {
+      free(px->vals);
+      px->vals = NULL;
+      px->nkeys = range;
+   } else {
+      px->nkeys = n;
+   }
+
+   px->cnt = (long *)calloc(px->nkeys, sizeof(long));
+   if (px->cnt == NULL) {
+      printf("error: (prep_keys_hash) malloc failed.\n");
+      return false;
+   }
+   for (long i = 0; i < h->cap; i++) {
+      if (h->cnts[i] != 0)
+	 px->cnt[prep_key(px, h->keys[i])] = h->cnts[i];
+   }
+   return true;
+} /*prep_keys_hash*/
+
+/*
+  Create the file of a new run in the temporary directory.
+ */
+static boolean prep_spill_create( prep_ctx *px, prep_spill *rs )
+{
+   memset(rs, 0, sizeof(prep_spill));
+   snprintf(rs->name, sizeof(rs->name), "%s/set2prep.%d.%d.run",
+	    px->tmpdir, (int)getpid(), px->nspill++);
+   rs->f = fopen(rs->name, "wb");
+   if (rs->f == NULL) {
+      fprintf(stderr, "error: can not open %s\n", rs->name);
+      return false;
+   }
+   setvbuf(rs->f, NULL, _IOFBF, PREP_IO_SIZE);
+   return true;
+} /*prep_spill_create*/
+
+/*
+  Append the set sp to the run arg.
+ */
+static boolean prep_spill_put( void *arg, set *sp )
+{
+   prep_spill *rs = (prep_spill *)arg;
+   int n = set_size(sp);
+
+   return (fwrite(&n, sizeof(int), 1, rs->f) == 1) &&
+      (fwrite(sp->arr, sizeof(int), n, rs->f) == (size_t)n);
+} /*prep_spill_put*/
+
+/*
+  Close the file of the run rs.
+ */
+static boolean prep_spill_close( prep_spill *rs )
+{
+   boolean ok = true;
+   if (rs->f != NULL)
+      ok = (fclose(rs->f) == 0);
+   rs->f = NULL;
+   free(rs->buf);
+   rs->buf = NULL;
+   return ok;
+} /*prep_spill_close*/
+
+/*
+  Open the run rs for reading through a buffer of cap bytes.
+ */
+static boolean prep_spill_open( prep_spill *rs, size_t cap )
+{
+   rs->cap = cap & ~(size_t)(sizeof(int) - 1);
+   rs->buf = (char *)malloc(rs->cap);
+   rs->f = fopen(rs->name, "rb");
+   if ((rs->buf == NULL) || (rs->f == NULL)) {
+      printf("error: (prep_spill_open) can not read %s.\n", rs->name);
+      return false;
+   }
+   rs->len = rs->pos = 0;
+   rs->eos = false;
+   memset(&(rs->cur), 0, sizeof(set));
+   rs->cur.view = true;
+   return true;
+} /*prep_spill_open*/
+
+/*
+  Make the next set of the run rs current. A record that does not fit
+  in the rest of the buffer is moved to its front and the buffer is
+  refilled; it is extended for a record longer than the buffer.
+ */
+static void prep_spill_next( prep_spill *rs )
+{
+   for (;;) {
+      size_t avail = rs->len - rs->pos;
+      size_t need = sizeof(int);
+      if (avail >= sizeof(int)) {
+	 int n;
+	 memcpy(&n, rs->buf + rs->pos, sizeof(int));
+	 need = sizeof(int) * (1 + (size_t)n);
+	 if (avail >= need) {
+	    rs->cur.arr = (int *)(rs->buf + rs->pos + sizeof(int));
+	    rs->cur.length = n;
+	    rs->cur.last = n - 1;
+	    rs->cur.cursor = -1;
+	    rs->pos += need;
+	    return;
+	 }
+      }
+
+      memmove(rs->buf, rs->buf + rs->pos, avail);
+      rs->len = avail;
+      rs->pos = 0;
+      if (need > rs->cap) {
+	 char *nb = (char *)realloc(rs->buf, need);
+	 if (nb == NULL) {
+	    printf("error: (prep_spill_next) realloc failed.\n");
+	    rs->eos = true;
+	    return;
+	 }
+	 rs->buf = nb;
+	 rs->cap = need;
+      }
+      size_t got = fread(rs->buf + rs->len, 1, rs->cap - rs->len, rs->f);
+      if (got == 0) {
+	 rs->eos = true;
+	 return;
+      }
+      rs->len += got;
+   }
+} /*prep_spill_next*/
+
+/*
+  Check if the current set of run a comes before the current set of
+  run b. Run k is the sentinel of the initialization of the loser tree
+  and comes first; an exhausted run comes last. Equal sets are taken
+  from the earlier run.
+ */
+static boolean prep_beats( prep_spill *rs, int k, int a, int b )
+{
+   if (a == k) return true;
+   if (b == k) return false;
+   if (rs[a].eos) return false;
+   if (rs[b].eos) return true;
+
+   set *x = &(rs[a].cur);
+   set *y = &(rs[b].cur);
+   int c = prep_set_cmp(&x, &y);
+   return (c < 0) || ((c == 0) && (a < b));
+} /*prep_beats*/
+
+/*
+  Replay the matches of the loser tree from the leaf of run i to the
+  root. Internal nodes 1..k-1 hold the losers; tree[0] is the winner.
+ */
+static void prep_replay( prep_spill *rs, int k, int *tree, int i )
+{
+   int w = i;
+   for (int t = (i + k) / 2; t > 0; t /= 2) {
+      if (prep_beats(rs, k, tree[t], w)) {
+	 int l = tree[t];
+	 tree[t] = w;
+	 w = l;
+      }
+   }
+   tree[0] = w;
+} /*prep_replay*/
+
+/*
+  Merge the k runs rs into put(arg, set). Each run is read through a
+  buffer of bufsize bytes.
+ */
+static boolean prep_merge( prep_spill *rs, int k, size_t bufsize, boolean (*put)(void *, set *), void *arg )
+{
+   int *tree = (int *)malloc(k * sizeof(int));
+   if (tree == NULL) {
+      printf("error: (prep_merge) malloc failed.\n");
+      return false;
+   }
+   boolean ok = true;
+   for (int i = 0; i < k; i++) {
+      ok = ok && prep_spill_open(&rs[i], bufsize);
+      if (ok)
+	 prep_spill_next(&rs[i]);
+   }
+
+   if (ok) {
+      for (int i = 0; i < k; i++)
+	 tree[i] = k;
+      for (int i = k - 1; i >= 0; i--)
+	 prep_replay(rs, k, tree, i);
+
+      while (ok && !rs[tree[0]].eos) {
+	 int w = tree[0];
+	 ok = put(arg, &(rs[w].cur));
+	 prep_spill_next(&rs[w]);
+	 prep_replay(rs, k, tree, w);
+      }
+   }
+
+   for (int i = 0; i < k; i++)
+      prep_spill_close(&rs[i]);
+   free(tree);
+   return ok;
+} /*prep_merge*/
+
+/*
+  Rename and sort the sets of the chunk px->sa and spill them as a new
+  run to the array *prs of *nr runs (of length *lr). The chunk is
+  emptied.
+ */
+static boolean prep_chunk_spill( prep_ctx *px, prep_spill **prs, int *nr, int *lr )
+{
+   prep_run(px, px->sa->nsets, prep_remap);
+   if (!prep_sort(px))
+      return false;
+
+   if (*nr == *lr) {
+      int len = (*lr == 0) ? 16 : 2 * (*lr);
+      prep_spill *na = (prep_spill *)realloc(*prs, len * sizeof(prep_spill));
+      if (na == NULL) {
+	 printf("error: (prep_chunk_spill) realloc failed.\n");
+	 return false;
+      }
+      *prs = na;
+      *lr = len;
+   }
+   prep_spill *rs = &((*prs)[(*nr)++]);
+   boolean ok = prep_spill_create(px, rs);
+   for (long i = 0; ok && (i < px->sa->nsets); i++)
+      ok = prep_spill_put(rs, px->ord[i]);
+   ok = prep_spill_close(rs) && ok;
+
+   prep_sort_free(px);
+   px->sa->nsets = 0;
+   px->sa->nelems = 0;
+   return ok;
+} /*prep_chunk_spill*/
+
+/*
+  Sort the input with at most px->cap bytes of sets in memory and
+  write it to the sink sk. The frequencies are counted in a first
+  pass over the input; the second pass spills sorted chunks as runs,
+  which are then merged. Groups of runs are merged into longer runs
+  first if the read buffers of all runs do not fit in the cap.
+ */
+static boolean prep_external( prep_ctx *px, FILE *in, boolean rename, FILE *mf,
+			      prep_sink *sk, double percent, long *nsym )
+{
+   set_arena ch;
+   prep_spill *rs = NULL;
+   int nr = 0, lr = 0;
+   long nsets = 0, nelems = 0;
+   boolean ok = true;
+   set *s1 = set_alloc();
+   double t0 = now_ms();
+
+   // pass 1: frequencies
+   if (rename) {
+      prep_hash h;
+      memset(&h, 0, sizeof(h));
+      dataset *ds = dset_open(in);
+      if (ds == NULL)
+	 return false;
+      while (ok && dset_read_into(ds, s1)) {
+	 nsets++;
+	 nelems += set_size(s1);
+	 for (int j = 0; ok && (j <= s1->last); j++)
+	    ok = prep_hash_add(&h, s1->arr[j]);
+      }
+      dset_close(ds);
+      if (ok && (nelems > 0))
+	 ok = prep_keys_hash(px, &h, nelems) && prep_rank(px, mf, nsym);
+      free(h.keys);
+      free(h.cnts);
+      if (!ok)
+	 return false;
+      if (fseek(in, 0, SEEK_SET) != 0) {
+	 fprintf(stderr, "error: input must be a file to be read twice\n");
+	 return false;
+      }
+   }
+   double t1 = now_ms();
+
+   // pass 2: chunks that fit in the cap; the mean set length of pass 1
+   // divides the cap between sets and elements
+   double avg = (nsets > 0) ? (double)nelems / nsets : 8.0;
+   long scap = (long)(px->cap / (avg * sizeof(int) + PREP_SET_BYTES));
+   if (scap < 1)
+      scap = 1;
+   long ecap = (long)(avg * scap) + 1;
+   memset(&ch, 0, sizeof(ch));
+   ch.sets = (set *)malloc(scap * sizeof(set));
+   ch.elems = (int *)malloc(ecap * sizeof(int));
+   if ((ch.sets == NULL) || (ch.elems == NULL)) {
+      printf("error: (prep_external) malloc failed.\n");
+      return false;
+   }
+   px->sa = &ch;
+
+   dataset *ds = dset_open(in);
+   if (ds == NULL)
+      return false;
+   nsets = 0;
+   while (ok && dset_read_into(ds, s1)) {
+      int n = set_size(s1);
+      if ((ch.nsets == scap) || (ch.nelems + n > ecap)) {
+	 if (ch.nsets > 0) {
+	    ok = prep_chunk_spill(px, &rs, &nr, &lr);
+	 }
+	 if (ok && (n > ecap)) {
+	    // a set longer than a chunk is a chunk of its own
+	    int *ne = (int *)realloc(ch.elems, n * sizeof(int));
+	    if (ne == NULL) {
+	       printf("error: (prep_external) realloc failed.\n");
+	       ok = false;
+	       break;
+	    }
+	    ch.elems = ne;
+	    ecap = n;
+	 }
+      }
+      set *sp = &(ch.sets[ch.nsets++]);
+      sp->arr = ch.elems + ch.nelems;
+      sp->length = n;
+      sp->last = n - 1;
+      sp->cursor = -1;
+      sp->view = true;
+      memcpy(sp->arr, s1->arr, n * sizeof(int));
+      ch.nelems += n;
+      nsets++;
+   }
+   dset_close(ds);
+   set_free(s1);
+
+   if (ok && (nr == 0)) {
+      // the dataset fits in one chunk
+      double t2 = now_ms();
+      prep_run(px, ch.nsets, prep_remap);
+      ok = prep_sort(px);
+      prep_sink_start(sk, ch.nsets, percent);
+      for (long i = 0; ok && (i < ch.nsets); i++)
+	 ok = prep_sink_put(sk, px->ord[i]);
+      prep_sort_free(px);
+      fprintf(stderr, "set2prep: external count_ms=%.1f sort_ms=%.1f runs=0 passes=0 cap_mb=%lu\n",
+	      t1 - t0, now_ms() - t2, (unsigned long)(px->cap >> 20));
+   } else if (ok) {
+      if (ch.nsets > 0)
+	 ok = prep_chunk_spill(px, &rs, &nr, &lr);
+      free(ch.sets);
+      free(ch.elems);
+      ch.sets = NULL;
+      ch.elems = NULL;
+      double t2 = now_ms();
+      int nruns = nr;
+
+      // merge groups of runs while there are too many of them
+      int fan = (int)(px->cap / PREP_MIN_READ) - 1;
+      if (fan < 2)
+	 fan = 2;
+      while (ok && (nr > fan)) {
+	 int nn = 0;
+	 prep_spill *ns = (prep_spill *)malloc(((nr + fan - 1) / fan) * sizeof(prep_spill));
+	 if (ns == NULL) {
+	    printf("error: (prep_external) malloc failed.\n");
+	    ok = false;
+	    break;
+	 }
+	 for (int g = 0; ok && (g < nr); g += fan) {
+	    int m = (nr - g < fan) ? (nr - g) : fan;
+	    ok = prep_spill_create(px, &ns[nn]);
+	    ok = ok && prep_merge(rs + g, m, px->cap / (m + 1), prep_spill_put, &ns[nn]);
+	    ok = prep_spill_close(&ns[nn]) && ok;
+	    nn++;
+	 }
+	 for (int i = 0; i < nr; i++)
+	    remove(rs[i].name);
+	 free(rs);
+	 rs = ns;
+	 nr = nn;
+	 px->npasses++;
+      }
+
+      // the last pass writes the outputs
+      prep_sink_start(sk, nsets, percent);
+      ok = ok && prep_merge(rs, nr, px->cap / (nr + 1), prep_sink_put, sk);
+      px->npasses++;
+      fprintf(stderr, "set2prep: external count_ms=%.1f runs_ms=%.1f merge_ms=%.1f runs=%d passes=%d cap_mb=%lu\n",
+	      t1 - t0, t2 - t1, now_ms() - t2, nruns, px->npasses, (unsigned long)(px->cap >> 20));
+   }
+
+   for (int i = 0; i < nr; i++)
+      remove(rs[i].name);
+   free(rs);
+   free(ch.sets);
+   free(ch.elems);
+   return ok;
+} /*prep_external*/
+
+int main( int argc, char *argv[] )
+{
+   boolean binary = false;
+   boolean rename = true;
+   uint32_t flags = 0;
+   int nthreads = num_threads();
+   char *mfnam = NULL;
+   double percent = -1.0;
+   uint64_t seed = 1;
+   size_t cap = 0;
+   char *tmpdir = NULL;
+   int ai = 1;
+
+   for (; ai < argc && argv[ai][0] == '-' && argv[ai][1] != '\0'; ai++) {
+      if (strcmp(argv[ai], "-b") == 0)
+	 binary = true;
+      else if (strcmp(argv[ai], "-z") == 0) {
+	 binary = true;
+	 flags |= DSET_VARINT;
+      } else if (strcmp(argv[ai], "-n") == 0)
+	 rename = false;
+      else if ((strcmp(argv[ai], "-j") == 0) && (ai + 1 < argc))
+	 nthreads = atoi(argv[++ai]);
+      else if ((strcmp(argv[ai], "-m") == 0) && (ai + 1 < argc))
+	 mfnam = argv[++ai];
+      else if ((strcmp(argv[ai], "-M") == 0) && (ai + 1 < argc))
+	 cap = (size_t)atol(argv[++ai]) << 20;
+      else if ((strcmp(argv[ai], "-T") == 0) && (ai + 1 < argc))
+	 tmpdir = argv[++ai];
+      else if ((strcmp(argv[ai], "-p") == 0) && (ai + 1 < argc))
+	 percent = atof(argv[++ai]);
+      else if ((strcmp(argv[ai], "-s") == 0) && (ai + 1 < argc))
+	 seed = strtoull(argv[++ai], NULL, 10);
+      else
+	 usage();
+   }
+   if ((argc - ai < 2) || (argc - ai > 3) || ((percent >= 0) != (argc - ai == 3)))
+      usage();
+   if (nthreads < 1)
+      nthreads = 1;
+   if (seed == 0)
+      seed = 1;
+   if (tmpdir == NULL)
+      tmpdir = getenv("TMPDIR");
+   if (tmpdir == NULL)
+      tmpdir = getenv("TMP");
+   if (tmpdir == NULL)
+#ifdef _WIN32
+      tmpdir = ".";
+#else
+      tmpdir = "/tmp";
+#endif
+   char *inam = argv[ai];
+   char *onam = argv[ai+1];
+   char *tnam = (argc - ai == 3) ? argv[ai+2] : NULL;
+
+   prep_ctx px;
+   memset(&px, 0, sizeof(px));
+   px.nthreads = nthreads;
+   px.tasks = (prep_task *)calloc(nthreads, sizeof(prep_task));
+   px.cap = cap;
+   px.tmpdir = tmpdir;
+
+   FILE *in = (strcmp(inam, "-") == 0) ? stdin : fopen(inam, "rb");
+   if (in == NULL) {
+      fprintf(stderr, "error: can not open %s\n", inam);
+      return 1;
+   }
+   if ((cap > 0) && rename && (in == stdin)) {
+      fprintf(stderr, "error: -M reads the input twice; use a file or -n\n");
+      return 1;
+   }
+   FILE *mf = NULL;
+   if (rename && (mfnam != NULL)) {
+      mf = fopen(mfnam, "w");
+      if (mf == NULL) {
+	 fprintf(stderr, "error: can not open %s\n", mfnam);
+	 return 1;
+      }
+   }
+   prep_sink sk;
+   memset(&sk, 0, sizeof(sk));
+   sk.test = (tnam != NULL);
+   sk.seed = seed;
+   if (!prep_open_out(&(sk.od), onam, binary, flags))
+      return 1;
+   if (sk.test && !prep_open_out(&(sk.ot), tnam, binary, flags))
+      return 1;
+
+   long nsym = 0;
+   boolean ok;
+   if (cap > 0) {
+      ok = prep_external(&px, in, rename, mf, &sk, percent, &nsym);
+   } else {
+
+      // 1) parse the input once
+      double t0 = now_ms();
+      px.sa = dset_load(in);
+      if ((px.sa == NULL) || (px.tasks == NULL))
+	 return 1;
+      set_arena *sa = px.sa;
+
+      // 2) frequencies and ranks of elements
+      double t1 = now_ms();
+      if (rename && (sa->nelems > 0)) {
+	 if (!prep_keys(&px) || !prep_count_all(&px) || !prep_rank(&px, mf, &nsym))
+	    return 1;
+      }
+
+      // 3) rename and sort the elements of sets
+      double t2 = now_ms();
+      prep_run(&px, sa->nsets, prep_remap);
+
+      // 4) sort the sets
+      double t3 = now_ms();
+      if (!prep_sort(&px))
+	 return 1;
+
+      // 5) write the dataset and the sampled testset in one pass
+      double t4 = now_ms();
+      prep_sink_start(&sk, sa->nsets, percent);
+      ok = true;
+      for (long i = 0; ok && (i < sa->nsets); i++)
+	 ok = prep_sink_put(&sk, px.ord[i]);
+      double t5 = now_ms();
+
+      fprintf(stderr, "set2prep: load_ms=%.1f count_ms=%.1f remap_ms=%.1f sort_ms=%.1f write_ms=%.1f\n",
+	      t1 - t0, t2 - t1, t3 - t2, t4 - t3, t5 - t4);
+      prep_sort_free(&px);
+      dset_arena_free(sa);
+   }
+   if (in != stdin)
+      fclose(in);
+   if (mf != NULL)
+      fclose(mf);
+
+   long nsets = sk.od.nsets;
+   long ntest = sk.ot.nsets;
+   ok = prep_close_out(&(sk.od)) && ok;
+   if (sk.test)
+      ok = prep_close_out(&(sk.ot)) && ok;
+   fprintf(stderr, "set2prep: sets=%ld symbols=%ld test=%ld threads=%d\n",
+	   nsets, nsym, ntest, nthreads);
+
+   free(px.cnt);
+   free(px.rank);
+   free(px.vals);
+   free(px.tasks);
+   return ok ? 0 : 1;
+} /*main*/
@@ -0,0 +1,719 @@
+/*
+ *  File: set2snap.c
+ *  Author: Iztok Savnik
+ *
+ *  Description: Snapshots of set-tries. A built set-trie is stored in
+ *  a relocatable image that is mapped read-only and queried in place.
+ *
+ *  Copyright (c) 2024, FAMNIT, University of Primorska
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <memory.h>
+#include <malloc.h>
+#include "config.h"
+#include "set.h"
+#include "dataset.h"
+#include "qesa.h"
+#include "connector.h"
+#include "set2.h"
+#include "set2snap.h"
+
+/* Initial lengths of the arrays of a snapshot writer. */
+#define INIT_SNAP_SIZE 1024
+
+/* Arrays of the image collected while the set-trie is traversed. */
+typedef struct s2s_writer {
+   s2s_node *nodes;
+   uint64_t nnodes, lnodes;
+   s2s_link *links;
+   uint64_t nlinks, llinks;
+   uint64_t *offs;
+   uint64_t nsets, lsets;
+   int *elems;
+   uint64_t nelems, lelems;
+   boolean failed;
+} s2s_writer;
+
+/*
+  Make room for need entries of given size in array *arr of length
+  *len. The length is doubled until the entries fit.
+ */
+static void *s2s_grow( void *arr, uint64_t *len, uint64_t need, size_t size, s2s_writer *w )
+{
+   if (need <= *len)
+      return arr;
+   while (need > *len)
+      *len *= 2;
+   void *na = realloc(arr, (size_t)(*len) * size);
+   if (na == NULL) {
+      printf("error: (s2s_grow) realloc failed.\n");
+      w->failed = true;
+      return arr;
+   }
+   return na;
+} /*s2s_grow*/
+
+/*
+  Add set sp to the sets of the image and return its index.
+ */
+static int s2s_add_set( s2s_writer *w, set *sp )
+{
+   int n = set_size(sp);
+
+   w->offs = (uint64_t *)s2s_grow(w->offs, &w->lsets, w->nsets + 2, sizeof(uint64_t), w);
+   w->elems = (int *)s2s_grow(w->elems, &w->lelems, w->nelems + n, sizeof(int), w);
+   if (w->failed)
+      return -1;
+
+   memcpy(w->elems + w->nelems, sp->arr, n * sizeof(int));
+   w->nelems += n;
+   w->offs[++(w->nsets)] = w->nelems;
+   return (int)(w->nsets - 1);
+} /*s2s_add_set*/
+
+/*
+  Add the subtrie st to the image in depth-first order and return the
+  index of its root node.
+ */
+static uint32_t s2s_add_node( s2s_writer *w, set2_node *st )
+{
+   s2s_node nd;
+   link *li;
+   uint32_t ix = (uint32_t)w->nnodes;
+
+   w->nodes = (s2s_node *)s2s_grow(w->nodes, &w->lnodes, w->nnodes + 1, sizeof(s2s_node), w);
+   if (w->failed)
+      return 0;
+   w->nnodes++;
+
+   memset(&nd, 0, sizeof(nd));
+   nd.min = st->min;
+   nd.max = st->max;
+   nd.ndset = -1;
+   if (st->isset) {
+      nd.flags |= S2S_ISSET;
+      nd.ndset = s2s_add_set(w, st->ndset);
+   }
+
+   // a tail is a set and the saved cursor
+   if (st->istail) {
+      nd.flags |= S2S_ISTAIL;
+      nd.a = (uint32_t)s2s_add_set(w, st->sub.tail.set);
+      nd.b = (uint32_t)st->sub.tail.cursor;
+      w->nodes[ix] = nd;
+      return ix;
+   }
+
+   // leaf
+   if (st->sub.link == NULL) {
+      w->nodes[ix] = nd;
+      return ix;
+   }
+
+   // reserve the links of st; children follow in key order
+   uint32_t n = 0;
+   con_open(st->sub.link);
+   while (con_read(st->sub.link) != NULL)
+      n++;
+   nd.a = (uint32_t)w->nlinks;
+   nd.b = n;
+   w->links = (s2s_link *)s2s_grow(w->links, &w->llinks, w->nlinks + n, sizeof(s2s_link), w);
+   if (w->failed)
+      return 0;
+   w->nlinks += n;
+   w->nodes[ix] = nd;
+
+   uint32_t i = 0;
+   con_open(st->sub.link);
+   for (li = con_read(st->sub.link); li != NULL; li = con_read(st->sub.link)) {
+      int key = li->key;
+      uint32_t child = s2s_add_node(w, SET2_NODE(li->val));
+      w->links[nd.a + i].key = key;
+      w->links[nd.a + i].child = child;
+      i++;
+   }
+   return ix;
+
+} /*s2s_add_node*/
+
+/*
+  Save the set-trie st as a snapshot to the file f.
+ */
+boolean set2_snapshot_save( set2_node *st, FILE *f )
+{
+   s2s_writer w;
+   s2s_header h;
+   boolean ok;
+
+   memset(&w, 0, sizeof(w));
+   w.lnodes = w.llinks = w.lsets = w.lelems = INIT_SNAP_SIZE;
+   w.nodes = (s2s_node *)malloc(w.lnodes * sizeof(s2s_node));
+   w.links = (s2s_link *)malloc(w.llinks * sizeof(s2s_link));
+   w.offs = (uint64_t *)malloc(w.lsets * sizeof(uint64_t));
+   w.elems = (int *)malloc(w.lelems * sizeof(int));
+   if ((w.nodes == NULL) || (w.links == NULL) || (w.offs == NULL) || (w.elems == NULL)) {
+      printf("error: (set2_snapshot_save) malloc failed.\n");
+      return false;
+   }
+   w.offs[0] = 0;
+
+   // collect the image
+   s2s_add_node(&w, st);
+
+   // all sections are multiples of 8 bytes, except the last one
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, S2S_MAGIC, 8);
+   h.endian = S2S_ENDIAN;
+   h.version = S2S_VERSION;
+   h.nnodes = w.nnodes;
+   h.nlinks = w.nlinks;
+   h.nsets = w.nsets;
+   h.nelems = w.nelems;
+   h.nodes_off = sizeof(s2s_header);
+   h.links_off = h.nodes_off + w.nnodes * sizeof(s2s_node);
+   h.offs_off = h.links_off + w.nlinks * sizeof(s2s_link);
+   h.elems_off = h.offs_off + (w.nsets + 1) * sizeof(uint64_t);
+
+   ok = !w.failed;
+   if (ok) {
+      fwrite(&h, sizeof(h), 1, f);
+      fwrite(w.nodes, sizeof(s2s_node), (size_t)w.nnodes, f);
+      fwrite(w.links, sizeof(s2s_link), (size_t)w.nlinks, f);
+      fwrite(w.offs, sizeof(uint64_t), (size_t)(w.nsets + 1), f);
+      fwrite(w.elems, sizeof(int), (size_t)w.nelems, f);
+      ok = !ferror(f);
+   }
+
+   free(w.nodes);
+   free(w.links);
+   free(w.offs);
+   free(w.elems);
+   return ok;
+
+} /*set2_snapshot_save*/
+
+/*
+  Check if the file f starts with a snapshot. The position in f is
+  not changed.
+ */
+boolean set2_snapshot_check( FILE *f )
+{
+   char magic[8];
+   long pos = ftell(f);
+   boolean ok = (fread(magic, 1, 8, f) == 8) && (memcmp(magic, S2S_MAGIC, 8) == 0);
+   fseek(f, pos, SEEK_SET);
+   return ok;
+
+} /*set2_snapshot_check*/
+
+/*
+  True if n entries of given size at offset off, aligned to align,
+  fit an image of len bytes. Nothing is added, so nothing overflows.
+ */
+static boolean s2s_section( uint64_t off, uint64_t n, size_t size, size_t align, size_t len )
+{
+   return (off % align == 0) && (off <= len) && (n <= (len - off) / size);
+} /*s2s_section*/
+
+/*
+  Check the image base[0..len) of a snapshot: the sections follow the
+  header in order and fit the image, the offsets of the sets run from
+  0 to nelems without decreasing, and every set, link and child that
+  a node refers to exists. A child follows its parent, as the nodes
+  are stored in depth-first order, so a search always terminates.
+ */
+static boolean s2s_valid( const char *base, size_t len )
+{
+   const s2s_header *h = (const s2s_header *)base;
+
+   // sections; indexes of nodes, links and sets are 32-bit
+   if ((h->nnodes == 0) || (h->nnodes > UINT32_MAX) || (h->nlinks > UINT32_MAX) ||
+       (h->nsets >= INT_MAX) ||
+       (h->nodes_off < sizeof(s2s_header)) ||
+       !s2s_section(h->nodes_off, h->nnodes, sizeof(s2s_node), sizeof(int), len) ||
+       (h->links_off < h->nodes_off + h->nnodes * sizeof(s2s_node)) ||
+       !s2s_section(h->links_off, h->nlinks, sizeof(s2s_link), sizeof(int), len) ||
+       (h->offs_off < h->links_off + h->nlinks * sizeof(s2s_link)) ||
+       !s2s_section(h->offs_off, h->nsets + 1, sizeof(uint64_t), sizeof(uint64_t), len) ||
+       (h->elems_off < h->offs_off + (h->nsets + 1) * sizeof(uint64_t)) ||
+       !s2s_section(h->elems_off, h->nelems, sizeof(int), sizeof(int), len))
+      return false;
+
+   // sets
+   const uint64_t *offs = (const uint64_t *)(base + h->offs_off);
+   if ((offs[0] != 0) || (offs[h->nsets] != h->nelems))
+      return false;
+   for (uint64_t i = 0; i < h->nsets; i++)
+      if ((offs[i] > offs[i+1]) || (offs[i+1] - offs[i] > INT_MAX))
+         return false;
+
+   // nodes and links
+   const s2s_node *nodes = (const s2s_node *)(base + h->nodes_off);
+   const s2s_link *links = (const s2s_link *)(base + h->links_off);
+   for (uint64_t i = 0; i < h->nnodes; i++) {
+      const s2s_node *nd = &nodes[i];
+      if ((nd->flags & S2S_ISSET) && ((nd->ndset < 0) || ((uint64_t)nd->ndset >= h->nsets)))
+         return false;
+      if (nd->flags & S2S_ISTAIL) {
+         // the cursor is -1 or an element of the tail
+         if (nd->a >= h->nsets)
+            return false;
+         int cursor = (int)nd->b;
+         if ((cursor < -1) || ((uint64_t)(cursor + 1) > offs[nd->a+1] - offs[nd->a]))
+            return false;
+         continue;
+      }
+      if ((nd->b > h->nlinks) || (nd->a > h->nlinks - nd->b))
+         return false;
+      for (uint32_t j = nd->a; j < nd->a + nd->b; j++)
+         if ((links[j].child <= i) || (links[j].child >= h->nnodes))
+            return false;
+   }
+   return true;
+
+} /*s2s_valid*/
+
+/*
+  Open the snapshot stored in the file f. The file is mapped, the
+  header, the nodes, the links and the offsets of the sets are checked
+  (see s2s_valid()) and the pointers to the sections are set; the
+  elements are not read. The stream must remain open until
+  set2_snapshot_close().
+ */
+set2_snapshot *set2_snapshot_open( FILE *f )
+{
+   size_t len;
+   set2_snapshot *ss = (set2_snapshot *)calloc(1, sizeof(set2_snapshot));
+   if (ss == NULL) {
+      printf("error: (set2_snapshot_open) malloc failed.\n");
+      return NULL;
+   }
+
+   ss->ds = dset_open(f);
+   if (ss->ds == NULL) {
+      free(ss);
+      return NULL;
+   }
+   const char *base = dset_image(ss->ds, &len);
+   const s2s_header *h = (const s2s_header *)base;
+
+   if ((len < sizeof(s2s_header)) || (memcmp(h->magic, S2S_MAGIC, 8) != 0)) {
+      printf("error: (set2_snapshot_open) not a snapshot.\n");
+      set2_snapshot_close(ss);
+      return NULL;
+   }
+   if ((h->endian != S2S_ENDIAN) || (h->version != S2S_VERSION) || !s2s_valid(base, len)) {
+      printf("error: (set2_snapshot_open) bad or truncated snapshot.\n");
+      set2_snapshot_close(ss);
+      return NULL;
+   }
+
+   ss->hdr = h;
+   ss->nodes = (const s2s_node *)(base + h->nodes_off);
+   ss->links = (const s2s_link *)(base + h->links_off);
+   ss->offs = (const uint64_t *)(base + h->offs_off);
+   ss->elems = (const int *)(base + h->elems_off);
+
+   // views are created on demand; untouched pages stay unmapped
+   ss->views = (set **)calloc((size_t)h->nsets + 1, sizeof(set *));
+   if (ss->views == NULL) {
+      printf("error: (set2_snapshot_open) malloc failed.\n");
+      set2_snapshot_close(ss);
+      return NULL;
+   }
+   return ss;
+
+} /*set2_snapshot_open*/
+
+/*
+  Dispose the snapshot ss. The views returned as results are freed.
+ */
+void set2_snapshot_close( set2_snapshot *ss )
+{
+   if (ss == NULL)
+      return;
+
+   if (ss->views != NULL) {
+      for (uint64_t i = 0; i < ss->hdr->nsets; i++)
+	 free(ss->views[i]);
+      free(ss->views);
+   }
+   dset_close(ss->ds);
+   free(ss);
+
+} /*set2_snapshot_close*/
+
+/*
+  Initialize the set sv as a read-only view of the set ix of the image.
+ */
+static void s2s_set_init( set2_snapshot *ss, int ix, set *sv )
+{
+   uint64_t b = ss->offs[ix];
+   int n = (int)(ss->offs[ix+1] - b);
+
+   sv->length = n;
+   sv->last = n - 1;
+   sv->cursor = -1;
+   sv->arr = (int *)(ss->elems + b);
+   sv->view = true;
+} /*s2s_set_init*/
+
+/*
+  Return the view of the set ix that is reported as a result.
+ */
+static set *s2s_view( set2_snapshot *ss, int ix )
+{
+   if (ss->views[ix] == NULL) {
+      set *sv = (set *)malloc(sizeof(set));
+      if (sv == NULL) {
+	 printf("error: (s2s_view) malloc failed.\n");
+	 return NULL;
+      }
+      s2s_set_init(ss, ix, sv);
+      ss->views[ix] = sv;
+   }
+   return ss->views[ix];
+} /*s2s_view*/
+
+/*
+  Position of the first link with key >= el among n links of ls; this
+  is where con_open_at() leaves a connector.
+ */
+static int s2s_lower_bound( const s2s_link *ls, int n, int el )
+{
+   int low = 0;
+   int high = n;
+   while (low < high) {
+      int mid = (low + high) / 2;
+      if (ls[mid].key < el)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   return low;
+} /*s2s_lower_bound*/
+
+/*
+  Search for the sets similar to se using the Hamming distance in the
+  subtrie of node ni. This is set2_simsearch_hmg() on the image: the
+  connector of a node is replaced by its array of links and a local
+  cursor cur (the next link is cur+1).
+ */
+static void s2s_simsearch_hmg( set2_snapshot *ss, uint32_t ni, set *se, set *sp, int *hmg, qesa *qp )
+{
+   const s2s_node *st = &(ss->nodes[ni]);
+   int nel = 0;           // next element
+   int cnl = 0;           // count delete operations
+   int selen = 0;
+   int sslen = 0;
+
+   // check the length of se tail against the min-max bounds
+   selen = set_tl_size(se);
+   if ( ((selen + (*hmg)) < st->min) || (selen > (st->max + (*hmg)))) {
+      return;
+   }
+
+   // are we at the end of a set?
+   if (st->flags & S2S_ISSET) {
+      if (((*hmg) - set_tl_size(se)) >= 0) {
+ 	 qesa_write(qp, (void *)s2s_view(ss, st->ndset));
+      }
+   }
+
+   // are we in a tail?
+   if (st->flags & S2S_ISTAIL) {
+
+      // save hmg
+      int tmphmg = *hmg;
+
+      // the tail is a view positioned at the saved cursor
+      set tl;
+      s2s_set_init(ss, (int)st->a, &tl);
+      tl.cursor = (int)st->b;
+
+      // check the lengths of sets
+      sslen = set_tl_size(&tl);
+      if (abs(selen - sslen) > tmphmg) {
+	 return;
+      }
+
+      // check if tail in st is similar to the rest of se
+      if (set_tl_similar_rev_hmg(&tl, se, hmg)) {
+	 qesa_write(qp, (void *)s2s_view(ss, (int)st->a));
+      }
+
+      // restore hmg
+      *hmg = tmphmg;
+      return;
+   }
+
+   // links of st; cur is the cursor of the connector
+   const s2s_link *ls = ss->links + st->a;
+   int nl = (int)st->b;
+   int cur = -1;
+   const s2s_link *li = NULL;
+
+   while (!set_eos(se) && (cur < nl - 1)) {
+
+      // peek heads of both sets
+      nel = set_peek(se);
+      li = &ls[cur+1];
+
+      if (nel > li->key) {
+
+         if (*hmg > 0) {
+
+            // add elem from link, search in sub-tree then get next one
+	    do {
+	       cur++;
+	       set_push(sp, li->key);
+	       (*hmg)--;
+               s2s_simsearch_hmg(ss, li->child, se, sp, hmg, qp);
+	       (*hmg)++;
+               set_pop(sp);
+	       li = (cur < nl - 1) ? &ls[cur+1] : NULL;
+	    } while ((li != NULL) && (nel > li->key));
+
+            continue;
+
+	 } else {
+
+            // move to the first link with key >= nel
+            cur = s2s_lower_bound(ls, nl, nel) - 1;
+            continue;
+         }
+
+      } else if (nel == li->key) {
+
+	 // descend in both, se and st.
+	 nel = set_read(se);
+         set_push(sp, nel);
+         s2s_simsearch_hmg(ss, li->child, se, sp, hmg, qp);
+	 set_pop(sp);
+	 set_unread(se, 1);
+	 cur++;
+
+	 // if possible skip element from se
+	 if (*hmg > 0) {
+	    set_read(se);
+ 	    cnl++;
+	    (*hmg)--;
+            continue;
+	 } else {
+            if (cnl > 0) {
+               *hmg += cnl;
+               set_unread(se, cnl);
+            }
+	    return;
+	 }
+
+      } else /* nel < li->key */ {
+
+	 // if possible skip element from se
+	 if (*hmg > 0) {
+	    set_read(se);
+ 	    cnl++;
+	    (*hmg)--;
+            continue;
+         } else {
+            if (cnl > 0) {
+               *hmg += cnl;
+               set_unread(se, cnl);
+            }
+	    return;
+	 }
+      }
+   } // while
+
+   // end of se: add the remaining links
+   if (set_eos(se) && (cur < nl - 1)) {
+      if (*hmg > 0) {
+	 do {
+	    li = &ls[++cur];
+	    set_push(sp, li->key);
+	    (*hmg)--;
+            s2s_simsearch_hmg(ss, li->child, se, sp, hmg, qp);
+	    (*hmg)++;
+            set_pop(sp);
+	 } while (cur < nl - 1);
+      }
+   }
+
+   // restore cursor in se and update hmg accordingly.
+   if (cnl > 0) {
+      *hmg += cnl;
+      set_unread(se, cnl);
+   }
+   return;
+
+} /*s2s_simsearch_hmg*/
+
+/*
+  Search for the sets similar to se using the LCS measure in the
+  subtrie of node ni; the image version of set2_simsearch_lcs().
+ */
+static void s2s_simsearch_lcs( set2_snapshot *ss, uint32_t ni, set *se, set *sp, int *skp, int *add, qesa *qp )
+{
+   const s2s_node *st = &(ss->nodes[ni]);
+   int nel = 0;           // next element
+   int cnl = 0;           // count delete operations
+
+   // are we at the end of a set?
+   if (st->flags & S2S_ISSET) {
+      int tmp_skp = (*skp) - set_tl_size(se);
+      if (tmp_skp >= 0) {
+	 qesa_write(qp, (void *)set_copy(sp));
+      }
+
+      // return if there are no links
+      if (!(st->flags & S2S_ISTAIL) && (st->b == 0)) {
+	 return;
+      }
+   }
+
+   // are we in a tail?
+   if (st->flags & S2S_ISTAIL) {
+
+      // save skp and add
+      int tmp_skp = *skp;
+      int tmp_add = *add;
+
+      set tl;
+      s2s_set_init(ss, (int)st->a, &tl);
+      tl.cursor = (int)st->b;
+
+      // check if tail in st is similar to the rest of se
+      if (set_tl_similar_lcs(&tl, se, skp, add)) {
+	 qesa_write(qp, (void *)s2s_view(ss, (int)st->a));
+      }
+
+      // restore skp and add
+      *skp = tmp_skp;
+      *add = tmp_add;
+      return;
+   }
+
+   // links of st; cur is the cursor of the connector
+   const s2s_link *ls = ss->links + st->a;
+   int nl = (int)st->b;
+   int cur = -1;
+   const s2s_link *li = NULL;
+
+   while (!set_eos(se) && (cur < nl - 1)) {
+
+      // peek heads of both sets
+      nel = set_peek(se);
+      li = &ls[cur+1];
+
+      if (nel > li->key) {
+
+         if (*add > 0) {
+
+            // add elem from link, search in sub-tree then get next one
+	    do {
+	       cur++;
+	       set_push(sp, li->key);
+	       (*add)--;
+               s2s_simsearch_lcs(ss, li->child, se, sp, skp, add, qp);
+	       (*add)++;
+               set_pop(sp);
+	       li = (cur < nl - 1) ? &ls[cur+1] : NULL;
+	    } while ((li != NULL) && (nel > li->key));
+
+            continue;
+
+	 } else {
+
+            // move to the first link with key >= nel
+            cur = s2s_lower_bound(ls, nl, nel) - 1;
+            continue;
+         }
+
+      } else if (nel == li->key) {
+
+	 // descend in both, se and st.
+	 nel = set_read(se);
+         set_push(sp, nel);
+         s2s_simsearch_lcs(ss, li->child, se, sp, skp, add, qp);
+	 set_pop(sp);
+	 set_unread(se, 1);
+	 cur++;
+
+	 // if possible skip element from se
+	 if (*skp > 0) {
+	    set_read(se);
+ 	    cnl++;
+	    (*skp)--;
+            continue;
+	 } else {
+            if (cnl > 0) {
+               *skp += cnl;
+               set_unread(se, cnl);
+            }
+	    return;
+	 }
+
+      } else /* nel < li->key */ {
+
+	 // if possible skip element from se
+	 if (*skp > 0) {
+	    set_read(se);
+ 	    cnl++;
+	    (*skp)--;
+            continue;
+         } else {
+            if (cnl > 0) {
+               *skp += cnl;
+               set_unread(se, cnl);
+            }
+	    return;
+	 }
+      }
+   } // while
+
+   // end of se: add the remaining links
+   if (set_eos(se) && (cur < nl - 1)) {
+      if (*add > 0) {
+	 do {
+	    li = &ls[++cur];
+	    set_push(sp, li->key);
+	    (*add)--;
+            s2s_simsearch_lcs(ss, li->child, se, sp, skp, add, qp);
+	    (*add)++;
+            set_pop(sp);
+	 } while (cur < nl - 1);
+      }
+   }
+
+   // restore cursor in se and update skp accordingly.
+   if (cnl > 0) {
+      *skp += cnl;
+      set_unread(se, cnl);
+   }
+   return;
+
+} /*s2s_simsearch_lcs*/
+
+/*
+  Search in snapshot ss the sets that are similar to the set se using
+  the Hamming distance. The results are the same as the results of
+  set2_simsearch_hmg() on the saved set-trie.
+ */
+void set2_snapshot_simsearch_hmg( set2_snapshot *ss, set *se, set *sp, int *hmg, qesa *qp )
+{
+   s2s_simsearch_hmg(ss, 0, se, sp, hmg, qp);
+} /*set2_snapshot_simsearch_hmg*/
+
+/*
+  Search in snapshot ss the sets that are similar to the set se using
+  the LCS measure.
+ */
+void set2_snapshot_simsearch_lcs( set2_snapshot *ss, set *se, set *sp, int *skp, int *add, qesa *qp )
+{
+   s2s_simsearch_lcs(ss, 0, se, sp, skp, add, qp);
+} /*set2_snapshot_simsearch_lcs*/
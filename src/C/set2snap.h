@@ -0,0 +1,89 @@
+/*--------------------------------------------------------------------------
+ *
+ * File: set2snap.h
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ *--------------------------------------------------------------------------
+ */
+
+#ifndef SET2SNAP_H
+#define SET2SNAP_H
+
+#include <stdint.h>
+
+/*
+A snapshot is an image of a built set-trie that is stored in a file
+and is queried in place. All references in the image are indexes or
+offsets, so the file is mapped read-only and searched without any
+deserialization.
+
+The image includes a header, an array of nodes, an array of links and
+the sets in CSR form (offsets and elements). The nodes are stored in
+depth-first order. The links of a node are stored one after another,
+sorted by keys; they replace the connector of the node. A set is
+referenced by its index; the tail of a node is a set index and the
+saved cursor.
+*/
+
+#define S2S_MAGIC    "SET2SNAP"
+#define S2S_ENDIAN   0x01020304u
+#define S2S_VERSION  1
+
+/* Flags of a snapshot node. */
+#define S2S_ISSET    1
+#define S2S_ISTAIL   2
+
+/* Header of a snapshot; offsets are relative to the header. */
+typedef struct s2s_header {
+   char magic[8];        // S2S_MAGIC (not 0-terminated)
+   uint32_t endian;      // S2S_ENDIAN in the byte order of the writer
+   uint32_t version;     // S2S_VERSION
+   uint64_t nnodes;      // number of nodes; node 0 is the root
+   uint64_t nlinks;      // number of links
+   uint64_t nsets;       // number of sets
+   uint64_t nelems;      // number of elements of all sets
+   uint64_t nodes_off;   // start of nodes array
+   uint64_t links_off;   // start of links array
+   uint64_t offs_off;    // start of set offsets (nsets+1 entries)
+   uint64_t elems_off;   // start of set elements
+} s2s_header;
+
+/* A node of a set-trie in a snapshot. */
+typedef struct s2s_node {
+   uint32_t flags;       // S2S_ISSET, S2S_ISTAIL
+   int min;              // min set that goes through this node
+   int max;              // max set that goes through this node
+   int ndset;            // set ending in node if isset, else -1
+   uint32_t a;           // tail set if istail, else first link
+   uint32_t b;           // tail cursor if istail, else number of links
+} s2s_node;
+
+/* A link from a node to a child. */
+typedef struct s2s_link {
+   int key;
+   uint32_t child;
+} s2s_link;
+
+/* An open snapshot. Result sets are views into the image; they are
+   created when a set is first reported and kept until close. */
+typedef struct set2_snapshot {
+   dataset *ds;              // mapping of the image
+   const s2s_header *hdr;
+   const s2s_node *nodes;
+   const s2s_link *links;
+   const uint64_t *offs;
+   const int *elems;
+   set **views;              // views of sets by index
+} set2_snapshot;
+
+/*---------------------- Exported functions ------------------------------*/
+
+extern boolean set2_snapshot_save( set2_node *st, FILE *f );
+extern set2_snapshot* set2_snapshot_open( FILE *f );
+extern void set2_snapshot_close( set2_snapshot *ss );
+extern boolean set2_snapshot_check( FILE *f );
+
+extern void set2_snapshot_simsearch_hmg( set2_snapshot *ss, set *se, set *sp, int *hmg, qesa *qp );
+extern void set2_snapshot_simsearch_lcs( set2_snapshot *ss, set *se, set *sp, int *skp, int *add, qesa *qp );
+
+#endif /*SET2SNAP_H*/
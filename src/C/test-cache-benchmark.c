@@ -114,17 +114,16 @@ static void print_cache_analysis(void) {
     /* Size of items[] array portion (the useful payload) */
     size_t items_size = CSL_BLOCK_CAP * sizeof(csl_kv);
 
-    /* Size of block metadata (min_key, count, skip_alloc, prev pointer) */
-    size_t meta_size = sizeof(int)              /* min_key */
-                     + sizeof(int)              /* count */
-                     + sizeof(int)              /* skip_alloc */
-                     + sizeof(csl_block*);      /* prev */
+    /* Size of the block header (min_key, count, item_cap, skip_alloc and
+     * the prev/items/keys/vals pointers); the tower next[] and the items
+     * follow it in the same chunk */
+    size_t meta_size = sizeof(csl_block);
 
     /* Total block size with 1 skip pointer (minimum allocation) */
-    size_t block_size_min = meta_size + items_size + 1 * sizeof(csl_block*);
+    size_t block_size_min = csl_block_bytes(CSL_BLOCK_CAP, 1, 0);
 
     /* Total block size with full skip pointers (head/max allocation) */
-    size_t block_size_max = meta_size + items_size + CSL_MAX_LEVEL * sizeof(csl_block*);
+    size_t block_size_max = csl_block_bytes(CSL_BLOCK_CAP, CSL_MAX_LEVEL, 0);
 
     /* How many cache lines does one block span? */
     int cache_lines_min = (int)((block_size_min + CACHE_LINE - 1) / CACHE_LINE);
@@ -190,9 +189,10 @@ static bench_result run_benchmark(int N) {
     r.n_items = N;
 
     /* --- Phase 1: Build skip list with N sorted keys --- */
-    /* We construct blocks directly to avoid O(N^2) tail-walk in csl_append.
-     * This benchmark measures SEARCH and CACHE performance, not insert speed.
-     * Direct construction is O(N) regardless of block size. */
+    /* Appends are O(1) (sl->tail) and fill each block before starting
+     * the next one, so every block is allocated as one chunk, as in a
+     * real bulk load.  This benchmark measures SEARCH and CACHE
+     * performance; the insert time is that of the appends. */
     cskiplist* sl = csl_create();
     if (!sl) {
         fprintf(stderr, "ERROR: csl_create() failed\n");
@@ -200,60 +200,11 @@ static bench_result run_benchmark(int N) {
     }
 
     double t0 = get_time_sec();
-    {
-        /* Calculate number of full blocks + possible partial last block */
-        int block_cap = csl_get_block_cap(sl);
-        int nblocks = (N + block_cap - 1) / block_cap;
-
-        /* Allocate all blocks, fill them with sequential keys, and link them */
-        csl_block* prev_blk = sl->head;
-        int key = 0;
-
-        for (int bi = 0; bi < nblocks; bi++) {
-            /* How many items go in this block */
-            int items_in_block = block_cap;
-            csl_block* b;
-            if (bi == nblocks - 1 && N % block_cap != 0) {
-                items_in_block = N % block_cap;
-            }
-
-            /* Allocate block with 1 skip pointer slot (minimum) */
-            b = (csl_block*)calloc(1, sizeof(csl_block));
-            if (!b) {
-                fprintf(stderr, "ERROR: block alloc failed\n");
-                csl_free(sl, NULL);
-                return r;
-            }
-            b->item_cap = block_cap;
-            b->skip_alloc = 1;
-            b->items = (csl_kv*)calloc((size_t)block_cap, sizeof(csl_kv));
-            b->next = (csl_block**)calloc(1, sizeof(csl_block*));
-            if (!b->items || !b->next) {
-                free(b->items);
-                free(b->next);
-                free(b);
-                fprintf(stderr, "ERROR: block payload alloc failed\n");
-                csl_free(sl, NULL);
-                return r;
-            }
-            b->min_key = key;
-            b->count = items_in_block;
-            b->prev = (prev_blk == sl->head) ? NULL : prev_blk;
-
-            /* Fill items with sequential keys */
-            for (int j = 0; j < items_in_block; j++) {
-                b->items[j].key = key;
-                b->items[j].val = (csl_val_t)(intptr_t)key;
-                key++;
-            }
-
-            /* Link into chain */
-            b->next[0] = NULL;
-            prev_blk->next[0] = b;
-            prev_blk = b;
-
-            sl->nblocks++;
-            sl->size += items_in_block;
+    for (int key = 0; key < N; key++) {
+        if (csl_append(sl, key, (csl_val_t)(intptr_t)key) < 0) {
+            fprintf(stderr, "ERROR: block alloc failed\n");
+            csl_free(sl, NULL);
+            return r;
         }
     }
     r.insert_sec = get_time_sec() - t0;
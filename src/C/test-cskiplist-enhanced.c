@@ -2,7 +2,10 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <limits.h>
+#include <pthread.h>
 
 void test_reverse_iteration() {
     printf("\n=== Test Reverse Iteration ===\n");
@@ -228,6 +231,977 @@ void test_level_adaptive_block_cap() {
     csl_free(deep, NULL);
 }
 
+void test_soa_layout() {
+    printf("\n=== Test Struct-of-Arrays Layout ===\n");
+    cskiplist* aos = csl_create_with_block_cap(16);
+    cskiplist* soa = csl_create_with_block_cap(16);
+    csl_set_soa(soa, 1);
+    srand(7);
+
+    // Same random inserts/updates/deletes on both layouts
+    for (int i = 0; i < 3000; i++) {
+        int key = rand() % 1000;
+        if (rand() % 4 == 0) {
+            csl_delete(aos, key, NULL);
+            csl_delete(soa, key, NULL);
+        } else {
+            csl_insert(aos, key, (void*)(intptr_t)(key + i));
+            csl_insert(soa, key, (void*)(intptr_t)(key + i));
+        }
+        if (i == 1500) {
+            csl_set_eytzinger(aos, 1);
+            csl_set_eytzinger(soa, 1);
+        }
+    }
+    for (int i = 1000; i < 1100; i++) {
+        csl_append(aos, i, (void*)(intptr_t)i);
+        csl_append(soa, i, (void*)(intptr_t)i);
+    }
+
+    int mismatches = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int key = -1; key <= 1100; key++) {
+            if (csl_search(aos, key) != csl_search(soa, key)) mismatches++;
+            csl_iter ia, is; int ea, es;
+            int pa = csl_iter_seek(aos, key, &ia, &ea);
+            int ps = csl_iter_seek(soa, key, &is, &es);
+            if (pa != ps || ea != es) mismatches++;
+            else if (pa && csl_iter_get(&ia)->key != csl_iter_get(&is)->key) mismatches++;
+        }
+        csl_iter ia, is;
+        int ra = csl_iter_first(aos, &ia), rs = csl_iter_first(soa, &is);
+        while (ra && rs) {
+            csl_kv* a = csl_iter_get(&ia);
+            csl_kv* b = csl_iter_get(&is);
+            if (a->key != b->key || a->val != b->val) mismatches++;
+            ra = csl_iter_next(&ia);
+            rs = csl_iter_next(&is);
+        }
+        if (ra != rs) mismatches++;
+        // Second pass: sorted blocks, and the SoA list converted back and forth
+        csl_set_eytzinger(aos, 0);
+        csl_set_eytzinger(soa, 0);
+        csl_set_soa(soa, 0);
+        csl_set_soa(soa, 1);
+    }
+
+    printf("Size: %zu/%zu, blocks: %zu/%zu, mismatches: %d\n",
+           aos->size, soa->size, aos->nblocks, soa->nblocks, mismatches);
+    if (mismatches == 0 && aos->size == soa->size && soa->head->next[0]->keys) {
+        printf("✓ Struct-of-arrays layout passed\n");
+    } else {
+        printf("✗ Struct-of-arrays layout failed\n");
+    }
+
+    csl_free(aos, NULL);
+    csl_free(soa, NULL);
+}
+
+void test_block_chunk() {
+    printf("\n=== Test Single-Chunk Blocks ===\n");
+    cskiplist* sl = csl_create_with_block_cap(16);
+    int errors = 0;
+
+    // Random heights from inserts; the rebuild moves blocks to taller
+    // chunks and the SoA conversion moves every block once more
+    for (int i = 0; i < 2000; i++) {
+        csl_insert(sl, (i * 7919) % 2000, (void*)(intptr_t)(i + 1));
+    }
+    for (int step = 0; step < 3; step++) {
+        if (step == 1) csl_rebuild_skips(sl);
+        if (step == 2) csl_set_soa(sl, 1);
+
+        // Items right behind the tower, in a cache-line aligned chunk;
+        // the keys of a SoA block start a cache line
+        csl_block* last = NULL;
+        size_t n = 0;
+        for (csl_block* b = sl->head->next[0]; b; b = b->next[0]) {
+            char* items = b->keys ? (char*)b->keys : (char*)b->items;
+            char* tower_end = (char*)(csl_skip_widths(b) + b->skip_alloc);
+            if ((uintptr_t)b % CSL_CACHE_LINE != 0) errors++;
+            size_t align = b->keys ? CSL_CACHE_LINE : 16;
+            if ((uintptr_t)items % align != 0) errors++;
+            if (items < tower_end || items >= tower_end + align) errors++;
+            char* items_end = b->keys ? (char*)(b->vals + b->item_cap)
+                                      : (char*)(b->items + b->item_cap);
+            if (items_end !=
+                (char*)b + csl_block_bytes(b->item_cap, b->skip_alloc, b->keys != NULL))
+                errors++;
+            if (b->prev != last) errors++;
+            last = b;
+            n++;
+        }
+        if (sl->tail != last || n != sl->nblocks) errors++;
+
+        // Each level is a sorted chain of blocks that have the level
+        for (int lvl = 1; lvl <= sl->level; lvl++) {
+            for (csl_block* b = sl->head->next[lvl]; b; b = b->next[lvl]) {
+                if (b->skip_alloc <= lvl) { errors++; break; }
+                if (b->next[lvl] && b->next[lvl]->min_key <= b->min_key) errors++;
+            }
+        }
+        for (int key = 0; key < 2000; key++) {
+            if (!csl_search(sl, key)) errors++;
+        }
+    }
+
+    // The moved blocks are still spliced and unspliced correctly
+    for (int key = 0; key < 2000; key += 2) csl_delete(sl, key, NULL);
+    for (int key = 2000; key < 2500; key++) csl_insert(sl, key, (void*)(intptr_t)key);
+    for (int key = 0; key < 2500; key++) {
+        int present = (key >= 2000) || (key % 2 == 1);
+        if ((csl_search(sl, key) != CSL_VAL_NONE) != present) errors++;
+    }
+
+    printf("Blocks: %zu, block of 16 items: %u bytes, errors: %d\n",
+           sl->nblocks, (unsigned)csl_block_bytes(16, 1, 0), errors);
+    if (errors == 0 && sl->size == 1500) {
+        printf("✓ Single-chunk blocks passed\n");
+    } else {
+        printf("✗ Single-chunk blocks failed\n");
+    }
+    csl_free(sl, NULL);
+}
+
+#if CSL_FAT_SKIPS
+// Every tower slot must carry the min_key of the block it points to
+static int check_skip_keys(cskiplist* sl) {
+    int errors = 0;
+    for (csl_block* b = sl->head; b; b = b->next[0]) {
+        for (int lvl = 0; lvl < b->skip_alloc; lvl++) {
+            int expect = b->next[lvl] ? b->next[lvl]->min_key : INT_MAX;
+            if (csl_skip_keys(b)[lvl] != expect) errors++;
+        }
+    }
+    return errors;
+}
+
+void test_fat_skips() {
+    printf("\n=== Test Fat Skip Entries ===\n");
+    cskiplist* sl = csl_create_with_block_cap(8);
+    int errors = 0;
+    srand(11);
+
+    // Descending inserts move the min_key of the first block; deletes
+    // of first items move the min_key of inner blocks
+    for (int i = 4000; i > 0; i--) {
+        csl_insert(sl, i * 3, (void*)(intptr_t)i);
+    }
+    errors += check_skip_keys(sl);
+    for (int i = 0; i < 6000; i++) {
+        int key = rand() % 12000;
+        if (rand() % 3 == 0) csl_insert(sl, key, (void*)(intptr_t)(key + 1));
+        else csl_delete(sl, key, NULL);
+    }
+    errors += check_skip_keys(sl);
+    csl_rebuild_skips(sl);
+    errors += check_skip_keys(sl);
+    csl_set_soa(sl, 1);
+    for (int i = 12000; i < 13000; i++) csl_append(sl, i, (void*)(intptr_t)i);
+    errors += check_skip_keys(sl);
+
+    // Searches agree with a walk of the blocks
+    for (csl_block* b = sl->head->next[0]; b; b = b->next[0]) {
+        for (int i = 0; i < b->count; i++) {
+            csl_key_t key = b->keys ? b->keys[i] : b->items[i].key;
+            if (csl_search(sl, key) == CSL_VAL_NONE) errors++;
+        }
+    }
+
+    printf("Blocks: %zu, levels: %d, errors: %d\n", sl->nblocks, sl->level + 1, errors);
+    if (errors == 0) {
+        printf("✓ Fat skip entries passed\n");
+    } else {
+        printf("✗ Fat skip entries failed\n");
+    }
+    csl_free(sl, NULL);
+}
+#endif
+
+void test_fast_lanes() {
+    printf("\n=== Test Fast Lanes ===\n");
+    cskiplist* plain = csl_create_with_block_cap(4);
+    cskiplist* lanes = csl_create_with_block_cap(4);
+    int mismatches = 0;
+    csl_set_lanes(lanes, 1);
+    srand(13);
+
+    // Searches between the updates use lanes that were just rebuilt or
+    // changed in place (new min_key of the first block or after deletes)
+    for (int i = 0; i < 20000; i++) {
+        int key = rand() % 5000 - 100;
+        int op = rand() % 8;
+        if (op < 4) {
+            csl_insert(plain, key, (void*)(intptr_t)(key + 1000));
+            csl_insert(lanes, key, (void*)(intptr_t)(key + 1000));
+        } else if (op < 6) {
+            csl_delete(plain, key, NULL);
+            csl_delete(lanes, key, NULL);
+        } else if (csl_search(plain, key) != csl_search(lanes, key)) {
+            mismatches++;
+        }
+        if (i == 10000) {
+            csl_rebuild_skips(lanes);
+            csl_set_soa(lanes, 1);
+        }
+    }
+
+    for (int key = -200; key <= 5100; key++) {
+        if (csl_search(plain, key) != csl_search(lanes, key)) mismatches++;
+        csl_iter ip, il; int ep, el;
+        int pp = csl_iter_seek(plain, key, &ip, &ep);
+        int pl = csl_iter_seek(lanes, key, &il, &el);
+        if (pp != pl || ep != el) mismatches++;
+        else if (pp && csl_iter_get(&ip)->key != csl_iter_get(&il)->key) mismatches++;
+    }
+
+    // The lanes list every block with its min_key
+    csl_lanes* ln = lanes->lanes;
+    size_t i = 0;
+    for (csl_block* b = lanes->head->next[0]; b; b = b->next[0], i++) {
+        if (i >= ln->len[0] || ln->blocks[i] != b || ln->keys[0][i] != b->min_key)
+            mismatches++;
+    }
+    if (ln->dirty || i != ln->len[0] || ln->len[ln->nlanes - 1] > CSL_LANE_FANOUT)
+        mismatches++;
+
+    printf("Blocks: %zu, lanes: %d, top lane: %zu keys, mismatches: %d\n",
+           lanes->nblocks, ln->nlanes, ln->len[ln->nlanes - 1], mismatches);
+    if (mismatches == 0 && plain->size == lanes->size) {
+        printf("✓ Fast lanes passed\n");
+    } else {
+        printf("✗ Fast lanes failed\n");
+    }
+    csl_free(plain, NULL);
+    csl_free(lanes, NULL);
+}
+
+void test_simd_kernels() {
+    printf("\n=== Test Block Search Kernels ===\n");
+    int best = csl_simd_isa();
+    int caps[] = { 5, 16, 100, 128, 600, 2048 };
+    int failures = 0;
+
+    printf("Kernels in use: %s\n", csl_simd_isa_name(best));
+    for (int isa = CSL_ISA_SCALAR; isa <= best; isa++) {
+        if (csl_simd_select(isa) != isa) continue;
+        for (int ci = 0; ci < 6; ci++) {
+            for (int soa = 0; soa <= 1; soa++) {
+                cskiplist* sl = csl_create_with_block_cap(caps[ci]);
+                csl_set_soa(sl, soa);
+                for (int i = 0; i < 5000; i++)
+                    csl_append(sl, 2 * i, (void*)(intptr_t)(2 * i + 1));
+                for (int key = -3; key <= 10003; key++) {
+                    void* v = csl_search(sl, key);
+                    int present = key >= 0 && key < 10000 && key % 2 == 0;
+                    if (v != (present ? (void*)(intptr_t)(key + 1) : NULL)) failures++;
+                    csl_iter it; int exact;
+                    int ok = csl_iter_seek(sl, key, &it, &exact);
+                    int expect = (key < 0) ? 0 : ((key + 1) & ~1);
+                    if (expect >= 10000 ? ok : (!ok || csl_iter_get(&it)->key != expect))
+                        failures++;
+                }
+                csl_free(sl, NULL);
+            }
+        }
+        printf("  %-7s checked\n", csl_simd_isa_name(isa));
+    }
+    csl_simd_select(best);
+
+    if (failures == 0) {
+        printf("✓ Block search kernels passed\n");
+    } else {
+        printf("✗ Block search kernels failed: %d wrong answers\n", failures);
+    }
+}
+
+/* Configurations of a list that the tests below run in: the layout of
+ * the blocks, SoA items and the fast lanes. */
+static const struct {
+    const char* name;
+    int layout, soa, lanes;
+} variants[] = {
+    { "sorted",        CSL_LAYOUT_SORTED,    0, 0 },
+    { "eytzinger",     CSL_LAYOUT_EYTZINGER, 0, 0 },
+    { "stree-soa",     CSL_LAYOUT_STREE,     1, 0 },
+    { "sorted-lanes",  CSL_LAYOUT_SORTED,    0, 1 },
+    { "sorted-soa",    CSL_LAYOUT_SORTED,    1, 0 },
+    { "eytzinger-soa", CSL_LAYOUT_EYTZINGER, 1, 0 },
+};
+#define NVARIANTS ((int)(sizeof(variants) / sizeof(variants[0])))
+
+/* Empty list with block_cap items per block in the given variant. */
+static cskiplist* make_variant(int variant, int block_cap) {
+    cskiplist* sl = csl_create_with_block_cap(block_cap);
+    if (variants[variant].soa) csl_set_soa(sl, 1);
+    if (variants[variant].lanes) csl_set_lanes(sl, 1);
+    csl_set_layout(sl, variants[variant].layout);
+    return sl;
+}
+
+void test_search_batch() {
+    printf("\n=== Test Batched Search ===\n");
+    int batches[] = { 1, 7, CSL_BATCH_GROUP, 100 };
+    int keys[100];
+    void* vals[100];
+    int mismatches = 0;
+    srand(17);
+
+    // Random inserts (probabilistic towers), in each variant
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 8);
+        int prior = mismatches;
+        for (int i = 0; i < 3000; i++) {
+            int key = rand() % 6000;
+            csl_insert(sl, key, (void*)(intptr_t)(key + 1));
+        }
+        for (int round = 0; round < 200; round++) {
+            int n = batches[round % 4];
+            size_t expect = 0;
+            for (int j = 0; j < n; j++) {
+                keys[j] = rand() % 6200 - 100;
+                expect += csl_search(sl, keys[j]) != NULL;
+            }
+            size_t found = csl_search_batch(sl, keys, (size_t)n, vals);
+            if (found != expect) mismatches++;
+            for (int j = 0; j < n; j++)
+                if (vals[j] != csl_search(sl, keys[j])) mismatches++;
+        }
+        if (mismatches != prior) printf("  %s: %d mismatches\n", variants[variant].name, mismatches - prior);
+        csl_free(sl, NULL);
+    }
+
+    printf("Variants: %d, batches: 1/7/%d/100, mismatches: %d\n", NVARIANTS, CSL_BATCH_GROUP, mismatches);
+    if (mismatches == 0) {
+        printf("✓ Batched search passed\n");
+    } else {
+        printf("✗ Batched search failed\n");
+    }
+}
+
+void test_finger_search() {
+    printf("\n=== Test Finger Search ===\n");
+    int mismatches = 0, seeks = 0;
+    srand(19);
+
+    // Towers from random inserts, then (but in the first variant) grown
+    // by a rebuild (unused slots) and filled up with more inserts, in
+    // each variant; ascending seeks with short and long jumps, and a step
+    // back now and then
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 8);
+        int prior = mismatches;
+        for (int i = 0; i < 4000; i++) {
+            int key = rand() % 20000;
+            csl_insert(sl, key, (void*)(intptr_t)(key + 1));
+        }
+        if (variant >= 1) {
+            csl_rebuild_skips(sl);
+            for (int i = 0; i < 200; i++) csl_insert(sl, rand() % 20000, NULL);
+        }
+
+        csl_iter it;
+        for (int pass = 0; pass < 10; pass++) {
+            csl_iter_rewind(sl, &it);
+            int key = -50;
+            while (key < 20100) {
+                int r = rand() % 10;
+                key += (r < 6) ? rand() % 8 : (r < 9) ? rand() % 300 : rand() % 15000;
+                if (rand() % 20 == 0) key -= rand() % 500;
+                csl_iter ref; int e1 = 0, e2 = 0;
+                int p1 = csl_iter_seek(sl, key, &ref, &e1);
+                int p2 = csl_iter_seek_from(sl, &it, key, &e2);
+                seeks++;
+                if (p1 != p2 || e1 != e2) mismatches++;
+                else if (p1 && csl_iter_get(&ref)->key != csl_iter_get(&it)->key) mismatches++;
+                if (!p2) csl_iter_rewind(sl, &it);
+            }
+        }
+        if (mismatches != prior) printf("  %s: %d mismatches\n", variants[variant].name, mismatches - prior);
+        csl_free(sl, NULL);
+    }
+
+    printf("Seeks: %d, mismatches: %d\n", seeks, mismatches);
+    if (mismatches == 0) {
+        printf("✓ Finger search passed\n");
+    } else {
+        printf("✗ Finger search failed\n");
+    }
+}
+
+static int cmp_kv_key(const void* a, const void* b) {
+    int x = ((const csl_kv*)a)->key, y = ((const csl_kv*)b)->key;
+    return (x > y) - (x < y);
+}
+
+void test_insert_sorted() {
+    printf("\n=== Test Sorted Batch Insert ===\n");
+    static csl_kv delta[3000];
+    int errors = 0, merges = 0;
+    size_t blocks = 0, items = 0;
+    srand(21);
+
+    // Deltas merged with csl_insert_sorted against the same pairs inserted
+    // one at a time: an empty list, then sorted deltas of 1..3000 pairs
+    // with repeated keys, and one unsorted delta; in each variant
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 16);
+        cskiplist* ref = csl_create_with_block_cap(16);
+        int prior = errors;
+        for (int round = 0; round < 40; round++) {
+            int n = (round == 0) ? 3000 : 1 + rand() % ((round % 3) ? 40 : 3000);
+            for (int j = 0; j < n; j++) {
+                delta[j].key = rand() % 30000 - 100;
+                delta[j].val = (void*)(intptr_t)(round * 100000 + j);
+            }
+            if (round != 7) qsort(delta, (size_t)n, sizeof(csl_kv), cmp_kv_key);
+            size_t before = ref->size;
+            for (int j = 0; j < n; j++) csl_insert(ref, delta[j].key, delta[j].val);
+            ptrdiff_t added = csl_insert_sorted(sl, delta, (size_t)n);
+            merges++;
+            if (added != (ptrdiff_t)(ref->size - before) || sl->size != ref->size) errors++;
+            for (int j = 0; j < n; j++)
+                if (csl_search(sl, delta[j].key) != csl_search(ref, delta[j].key)) errors++;
+        }
+
+        // same pairs in order; links, fat skip keys, prev and tail intact
+        csl_iter a, b;
+        int more_a = csl_iter_first(sl, &a), more_b = csl_iter_first(ref, &b);
+        while (more_a && more_b) {
+            if (csl_iter_get(&a)->key != csl_iter_get(&b)->key ||
+                csl_iter_get(&a)->val != csl_iter_get(&b)->val) errors++;
+            more_a = csl_iter_next(&a);
+            more_b = csl_iter_next(&b);
+        }
+        if (more_a != more_b) errors++;
+        csl_block* last = NULL;
+        for (csl_block* x = sl->head->next[0]; x; x = x->next[0]) {
+            if (x->prev != last || x->count < 1 || x->count > x->item_cap) errors++;
+            for (int lvl = 0; lvl < x->skip_alloc; lvl++) {
+                if (x->next[lvl] && x->next[lvl]->min_key <= x->min_key) errors++;
+#if CSL_FAT_SKIPS
+                if (csl_skip_keys(x)[lvl] != (x->next[lvl] ? x->next[lvl]->min_key : INT_MAX))
+                    errors++;
+#endif
+            }
+            last = x;
+            blocks++;
+        }
+        if (sl->tail != last) errors++;
+        items += sl->size;
+        if (errors != prior) printf("  %s: %d errors\n", variants[variant].name, errors - prior);
+        csl_free(sl, NULL);
+        csl_free(ref, NULL);
+    }
+
+    printf("Merges: %d, items: %zu in %zu blocks, errors: %d\n", merges, items, blocks, errors);
+    if (errors == 0) {
+        printf("✓ Sorted batch insert passed\n");
+    } else {
+        printf("✗ Sorted batch insert failed\n");
+    }
+}
+
+static int cmp_int(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/* Pairs, order, prev/tail and fat skip keys of sl against the n sorted
+ * keys[] (values key + 1); number of errors.  *low gets the blocks below
+ * CSL_MIN_FILL percent. */
+static int check_list(cskiplist* sl, const int* keys, int n, int* low) {
+    int errors = 0, i = 0;
+    csl_iter it;
+    if (csl_iter_first(sl, &it)) {
+        do {
+            csl_kv* kv = csl_iter_get(&it);
+            if (i >= n || kv->key != keys[i] || kv->val != (void*)(intptr_t)(keys[i] + 1)) errors++;
+            i++;
+        } while (csl_iter_next(&it));
+    }
+    if (i != n || sl->size != (size_t)n) errors++;
+    size_t blocks = 0;
+    csl_block* last = NULL;
+    *low = 0;
+    for (csl_block* x = sl->head->next[0]; x; x = x->next[0]) {
+        if (x->prev != last || x->count < 1) errors++;
+        if (x->count < x->item_cap * CSL_MIN_FILL / 100) (*low)++;
+        last = x;
+        blocks++;
+    }
+    if (sl->tail != last || sl->nblocks != blocks) errors++;
+#if CSL_FAT_SKIPS
+    errors += check_skip_keys(sl);
+#endif
+    for (int j = 0; j < n; j += 7)
+        if (csl_search(sl, keys[j]) != (void*)(intptr_t)(keys[j] + 1)) errors++;
+    return errors;
+}
+
+void test_underflow_compact() {
+    printf("\n=== Test Underflow and Compaction ===\n");
+    static int keys[20000];
+    int errors = 0, low = 0;
+    size_t merges = 0, before = 0, after = 0, packed = 0;
+    srand(23);
+
+    // Random inserts, then 90% of the keys deleted in random order: no
+    // block may stay below CSL_MIN_FILL; then csl_compact at 100% and 50%
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 16);
+        int prior = errors + low;
+        int n = 0;
+        for (int i = 0; i < 20000; i++) {
+            int key = rand() % 100000;
+            if (!csl_search(sl, key)) keys[n++] = key;
+            csl_insert(sl, key, (void*)(intptr_t)(key + 1));
+        }
+        before += sl->nblocks;
+        for (int i = n - 1; i > 0; i--) {
+            int j = rand() % (i + 1), t = keys[i];
+            keys[i] = keys[j]; keys[j] = t;
+        }
+        int keep = n / 10;
+        for (int i = keep; i < n; i++)
+            if (csl_delete(sl, keys[i], NULL) != 1) errors++;
+        qsort(keys, (size_t)keep, sizeof(int), cmp_int);
+        int l = 0;
+        errors += check_list(sl, keys, keep, &l);
+        low += l;
+        merges += sl->stat_merges;
+        after += sl->nblocks;
+
+        for (int fill = 100; fill >= 50; fill -= 50) {
+            if (!csl_compact(sl, fill)) errors++;
+            errors += check_list(sl, keys, keep, &l);
+            int most = 16 * fill / 100;
+            if (sl->nblocks != (size_t)((keep + most - 1) / most)) errors++;
+            if (sl->level != 0 && !sl->head->next[sl->level]) errors++;
+            packed += sl->nblocks;
+        }
+        if (errors + low != prior)
+            printf("  %s: %d errors\n", variants[variant].name, errors + low - prior);
+        csl_free(sl, NULL);
+    }
+
+    printf("Blocks: %zu -> %zu after deletes (%zu merges, %d below min fill), %zu compacted, errors: %d\n",
+           before, after, merges, low, packed, errors);
+    if (errors == 0 && low == 0) {
+        printf("✓ Underflow and compaction passed\n");
+    } else {
+        printf("✗ Underflow and compaction failed\n");
+    }
+}
+
+/* Collects what a range scan hands over; stops after limit pairs. */
+typedef struct {
+    int keys[6000];
+    int n, limit, spans, bad;
+} scan_out;
+
+static int scan_collect(void* ctx, csl_key_t key, csl_val_t val) {
+    scan_out* o = (scan_out*)ctx;
+    if (val != (void*)(intptr_t)(key + 1)) o->bad++;
+    o->keys[o->n++] = key;
+    return o->n < o->limit;
+}
+
+static int span_collect(void* ctx, const csl_key_t* keys, const csl_val_t* vals, int n) {
+    scan_out* o = (scan_out*)ctx;
+    o->spans++;
+    if (n <= 0) o->bad++;
+    for (int i = 0; i < n; i++) {
+        if (vals[i] != (void*)(intptr_t)(keys[i] + 1)) o->bad++;
+        o->keys[o->n++] = keys[i];
+    }
+    return o->n < o->limit;
+}
+
+void test_range_scan() {
+    printf("\n=== Test Range Scans ===\n");
+    static scan_out ref, got, spn;
+    int errors = 0, scans = 0;
+    long spans = 0, pairs = 0;
+    srand(25);
+
+    // csl_range_scan and csl_range_spans against csl_iter_seek plus
+    // csl_iter_next, on random ranges (empty, inverted, past either end,
+    // the whole key space) with and without an early stop; in each variant,
+    // with insert buffers and after deletes
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 32);
+        int prior = errors;
+        for (int i = 0; i < 5000; i++) {
+            int key = rand() % 20000;
+            csl_insert(sl, key, (void*)(intptr_t)(key + 1));
+        }
+        for (int i = 0; i < 1000; i++) csl_delete(sl, rand() % 20000, NULL);
+
+        for (int round = 0; round < 600; round++) {
+            int lo = rand() % 21000 - 500;
+            int hi = lo + ((round % 4) ? rand() % 300 : rand() % 21000) - 20;
+            if (round == 0) { lo = INT_MIN; hi = INT_MAX; }
+            if (round == 1) { lo = 20000; hi = INT_MAX; }
+            int limit = (round % 5 == 0) ? 1 + rand() % 100 : 1 << 30;
+
+            csl_iter it;
+            ref.n = 0;
+            if (lo <= hi && csl_iter_seek(sl, lo, &it, NULL)) {
+                do {
+                    csl_kv* kv = csl_iter_get(&it);
+                    if (kv->key > hi) break;
+                    ref.keys[ref.n++] = kv->key;
+                } while (ref.n < limit && csl_iter_next(&it));
+            }
+            got.n = got.bad = 0; got.limit = limit;
+            spn.n = spn.bad = spn.spans = 0; spn.limit = limit;
+            size_t n1 = csl_range_scan(sl, lo, hi, scan_collect, &got);
+            size_t n2 = csl_range_spans(sl, lo, hi, span_collect, &spn);
+            scans++;
+            // spans stop at the end of one, so they may hand over more
+            if (n1 != (size_t)ref.n || got.n != ref.n || got.bad || spn.bad ||
+                n2 != (size_t)spn.n || spn.n < ref.n ||
+                (limit > ref.n && spn.n != ref.n)) {
+                errors++;
+                continue;
+            }
+            for (int i = 0; i < ref.n; i++)
+                if (got.keys[i] != ref.keys[i] || spn.keys[i] != ref.keys[i]) { errors++; break; }
+            spans += spn.spans;
+            pairs += spn.n;
+        }
+        if (errors != prior) printf("  %s: %d errors\n", variants[variant].name, errors - prior);
+        csl_free(sl, NULL);
+    }
+
+    printf("Scans: %d, %.1f pairs per span, errors: %d\n", scans,
+           spans ? (double)pairs / spans : 0.0, errors);
+    if (errors == 0) {
+        printf("✓ Range scans passed\n");
+    } else {
+        printf("✗ Range scans failed\n");
+    }
+}
+
+/* Slot widths that differ from a count of the items they skip. */
+static int check_widths(cskiplist* sl) {
+    csl_block* last[CSL_MAX_LEVEL];
+    size_t lastpos[CSL_MAX_LEVEL];
+    size_t at = 0;
+    int bad = 0;
+    for (int lvl = 1; lvl <= sl->level; lvl++) { last[lvl] = sl->head; lastpos[lvl] = 0; }
+    for (csl_block* b = sl->head->next[0]; b; b = b->next[0]) {
+        for (int lvl = 1; lvl <= sl->level && lvl < b->skip_alloc; lvl++) {
+            if (last[lvl]->next[lvl] != b) continue;
+            if (csl_skip_widths(last[lvl])[lvl] != at - lastpos[lvl]) bad++;
+            last[lvl] = b;
+            lastpos[lvl] = at;
+        }
+        at += (size_t)b->count;
+    }
+    for (int lvl = 1; lvl <= sl->level; lvl++)
+        if (csl_skip_widths(last[lvl])[lvl] != at - lastpos[lvl]) bad++;
+    return bad;
+}
+
+/* csl_rank, csl_select and csl_split_ranges against the sorted keys of
+ * present[] (values are key + 1). */
+#define RS_KEYS 20000
+static int check_rank_select(cskiplist* sl, const char* present) {
+    static int keys[RS_KEYS + 4000];
+    static size_t below[RS_KEYS + 4001];
+    int errors = 0, n = 0;
+    for (int k = 0; k < RS_KEYS + 4000; k++) {
+        below[k] = (size_t)n;
+        if (present[k]) keys[n++] = k;
+    }
+    below[RS_KEYS + 4000] = (size_t)n;
+    if (sl->size != (size_t)n) return 1;
+
+    for (int q = 0; q < 300; q++) {
+        int key = rand() % (RS_KEYS + 4000);
+        if (csl_rank(sl, key) != below[key]) errors++;
+        size_t i = (size_t)rand() % (size_t)(n + 1);
+        csl_kv kv;
+        if (i == (size_t)n) {
+            if (csl_select(sl, i, &kv)) errors++;
+        } else if (!csl_select(sl, i, &kv) || kv.key != keys[i] ||
+                   kv.val != (void*)(intptr_t)(keys[i] + 1)) {
+            errors++;
+        }
+    }
+    if (csl_rank(sl, INT_MIN) != 0 || csl_rank(sl, INT_MAX) != (size_t)n) errors++;
+
+    csl_key_t out[64];
+    int ps[] = { 1, 3, 8, 64 };
+    for (int t = 0; t < 4; t++) {
+        int m = csl_split_ranges(sl, ps[t], out);
+        if (m != (ps[t] < n ? ps[t] : n)) { errors++; continue; }
+        for (int k = 0; k < m; k++)
+            if (out[k] != keys[(size_t)n * (size_t)k / (size_t)m]) errors++;
+    }
+    return errors;
+}
+
+void test_rank_select() {
+    printf("\n=== Test Rank and Select ===\n");
+    static char present[RS_KEYS + 4000];
+    int errors = 0, stale = 0, wrong = 0;
+    srand(26);
+
+    // Random inserts and deletes keep the widths exact (checked slot by
+    // slot); the bulk paths leave them stale and a rank recounts them.  In
+    // each variant, with insert buffers, merges and the fast lanes
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 16);
+        int prior = errors + stale + wrong;
+        memset(present, 0, sizeof(present));
+        errors += check_rank_select(sl, present);
+
+        for (int i = 0; i < 30000; i++) {
+            int key = rand() % RS_KEYS;
+            // inserts first, then mostly deletes, so blocks underflow
+            if (rand() % 100 < (i < 15000 ? 70 : 20)) {
+                csl_insert(sl, key, (void*)(intptr_t)(key + 1));
+                present[key] = 1;
+            } else {
+                csl_delete(sl, key, NULL);
+                present[key] = 0;
+            }
+            if (i % 3000 == 2999) {
+                stale += sl->widths_stale;
+                wrong += check_widths(sl);
+                errors += check_rank_select(sl, present);
+            }
+        }
+
+        // Bulk paths: a sorted merge and appends past the end
+        static csl_kv batch[2000];
+        size_t nb = 0;
+        for (int k = 1; k < RS_KEYS && nb < 2000; k += 7)
+            if (!present[k]) { batch[nb].key = k; batch[nb].val = (void*)(intptr_t)(k + 1); nb++; present[k] = 1; }
+        csl_insert_sorted(sl, batch, nb);
+        if (!sl->widths_stale) errors++;
+        errors += check_rank_select(sl, present);
+        wrong += check_widths(sl);
+        for (int k = RS_KEYS; k < RS_KEYS + 4000; k += 2) {
+            csl_append(sl, k, (void*)(intptr_t)(k + 1));
+            present[k] = 1;
+        }
+        errors += check_rank_select(sl, present);
+
+        // Rebuild and compaction recount; later deletes keep them up
+        csl_rebuild_skips(sl);
+        stale += sl->widths_stale;
+        wrong += check_widths(sl);
+        errors += check_rank_select(sl, present);
+        csl_compact(sl, 50);
+        for (int i = 0; i < 3000; i++) {
+            int key = rand() % (RS_KEYS + 4000);
+            csl_delete(sl, key, NULL);
+            present[key] = 0;
+        }
+        stale += sl->widths_stale;
+        wrong += check_widths(sl);
+        errors += check_rank_select(sl, present);
+        if (errors + stale + wrong != prior)
+            printf("  %s: %d errors\n", variants[variant].name, errors + stale + wrong - prior);
+        csl_free(sl, NULL);
+    }
+
+    printf("Errors: %d, stale after inserts/deletes: %d, wrong widths: %d\n",
+           errors, stale, wrong);
+    if (errors == 0 && stale == 0 && wrong == 0) {
+        printf("✓ Rank and select passed\n");
+    } else {
+        printf("✗ Rank and select failed\n");
+    }
+}
+
+/* Concurrent stress: the multiples of 8 below CC_KEYS are never
+ * written; writer w inserts and deletes the other keys k with k % 2 == w
+ * and keeps its own truth (in its second half it mostly deletes, so
+ * blocks underflow).  Readers check every answer against that oracle:
+ * stable keys are found with their value, other keys are absent or
+ * carry their value, and a scan from a seek is ascending and misses no
+ * stable key. */
+#define CC_KEYS    32000
+#define CC_WRITERS 2
+#define CC_READERS 4
+#define CC_WRITES  60000
+
+typedef struct {
+    cskiplist* sl;
+    int id;
+    unsigned seed;
+    int errors;
+    long reads;
+    unsigned char present[CC_KEYS]; /* writer: truth of its keys */
+} cc_worker;
+
+static int cc_writing;
+
+static unsigned cc_rand(unsigned* s) {
+    *s = *s * 1103515245u + 12345u;
+    return *s >> 8;
+}
+
+static void* cc_writer(void* arg) {
+    cc_worker* w = (cc_worker*)arg;
+    for (int i = 0; i < CC_WRITES; i++) {
+        unsigned r = cc_rand(&w->seed);
+        int key = (int)(r % CC_KEYS);
+        if (key % 8 == 0) {
+            // update of a stable key with its own value: a copy as well
+            if (csl_insert(w->sl, key, (void*)(intptr_t)(key + 1)) != 0) w->errors++;
+            continue;
+        }
+        if (key % 2 != w->id) continue;
+        if (w->present[key]) {
+            if (csl_delete(w->sl, key, NULL) != 1) w->errors++;
+        } else if (i < CC_WRITES / 2 || r % 4 == 0) {
+            if (csl_insert(w->sl, key, (void*)(intptr_t)(key + 1)) != 1) w->errors++;
+        } else {
+            continue;
+        }
+        w->present[key] ^= 1;
+    }
+    return NULL;
+}
+
+/* A seek to key and a scan of up to 40 pairs, in one section. */
+static int cc_scan(cskiplist* sl, int key) {
+    int errors = 0, last = INT_MIN;
+    int stable = (key + 7) & ~7; /* next stable key expected */
+    csl_iter it;
+    if (!csl_iter_seek(sl, key, &it, NULL)) return stable < CC_KEYS;
+    for (int n = 0; n < 40; n++) {
+        csl_kv* kv = csl_iter_get(&it);
+        if (!kv || kv->key <= last || kv->key < key ||
+            kv->val != (void*)(intptr_t)(kv->key + 1)) errors++;
+        if (kv && kv->key % 8 == 0) {
+            if (kv->key != stable) errors++;
+            stable = kv->key + 8;
+        } else if (kv && kv->key > stable) {
+            errors++;
+        }
+        if (kv) last = kv->key;
+        if (!csl_iter_next(&it)) break;
+    }
+    return errors;
+}
+
+/* Span callback of the readers: ctx is {last key, stable keys, errors}. */
+static int cc_span(void* ctx, const csl_key_t* keys, const csl_val_t* vals, int n) {
+    int* st = (int*)ctx;
+    for (int i = 0; i < n; i++) {
+        if (keys[i] <= st[0] || vals[i] != (void*)(intptr_t)(keys[i] + 1)) st[2]++;
+        st[1] += (keys[i] % 8 == 0);
+        st[0] = keys[i];
+    }
+    return 1;
+}
+
+static void* cc_reader(void* arg) {
+    cc_worker* w = (cc_worker*)arg;
+    int slot = csl_reader_register(w->sl);
+    if (slot < 0) { w->errors++; return NULL; }
+    while (__atomic_load_n(&cc_writing, __ATOMIC_ACQUIRE)) {
+        csl_read_begin(w->sl, slot);
+        for (int i = 0; i < 64; i++, w->reads++) {
+            unsigned r = cc_rand(&w->seed);
+            int key = (int)(r % CC_KEYS);
+            if (i == 0) {
+                w->errors += cc_scan(w->sl, key);
+                continue;
+            }
+            if (i == 1) {
+                // a range of 200 keys holds 25 stable ones
+                int st[3] = { INT_MIN, 0, 0 };
+                key &= ~7;
+                csl_range_spans(w->sl, key, key + 199, cc_span, st);
+                w->errors += st[2] + (key + 199 < CC_KEYS && st[1] != 25);
+                continue;
+            }
+            csl_val_t v = csl_search(w->sl, key);
+            if (key % 8 == 0 ? v != (void*)(intptr_t)(key + 1)
+                             : v != CSL_VAL_NONE && v != (void*)(intptr_t)(key + 1))
+                w->errors++;
+        }
+        // finger seeks over the stable keys
+        csl_iter it;
+        csl_iter_rewind(w->sl, &it);
+        for (int key = (int)(cc_rand(&w->seed) % 64) * 8; key < CC_KEYS; key += 1000) {
+            int exact = 0;
+            if (!csl_iter_seek_from(w->sl, &it, key, &exact) || !exact) w->errors++;
+        }
+        csl_read_end(w->sl, slot);
+    }
+    csl_reader_unregister(w->sl, slot);
+    return NULL;
+}
+
+void test_concurrent() {
+    printf("\n=== Test Concurrent Readers and Writers ===\n");
+    static cc_worker ws[CC_WRITERS + CC_READERS];
+    static int keys[CC_KEYS];
+    int errors = 0;
+    long reads = 0;
+    size_t splits = 0, merges = 0;
+
+    for (int variant = 0; variant < NVARIANTS; variant++) {
+        cskiplist* sl = make_variant(variant, 16);
+        int prior = errors;
+        for (int k = 0; k < CC_KEYS; k += 8) csl_append(sl, k, (void*)(intptr_t)(k + 1));
+        csl_set_lanes(sl, 1);
+        if (!csl_set_concurrent(sl, 1) || sl->lanes || csl_set_lanes(sl, 1)) errors++;
+
+        pthread_t tid[CC_WRITERS + CC_READERS];
+        __atomic_store_n(&cc_writing, 1, __ATOMIC_RELEASE);
+        for (int t = 0; t < CC_WRITERS + CC_READERS; t++) {
+            memset(&ws[t], 0, sizeof(ws[t]));
+            ws[t].sl = sl;
+            ws[t].id = t;
+            ws[t].seed = 1000u * (unsigned)variant + (unsigned)t;
+            if (t >= CC_WRITERS) pthread_create(&tid[t], NULL, cc_reader, &ws[t]);
+        }
+        for (int t = 0; t < CC_WRITERS; t++) pthread_create(&tid[t], NULL, cc_writer, &ws[t]);
+        for (int t = 0; t < CC_WRITERS; t++) pthread_join(tid[t], NULL);
+        __atomic_store_n(&cc_writing, 0, __ATOMIC_RELEASE);
+        for (int t = CC_WRITERS; t < CC_WRITERS + CC_READERS; t++) pthread_join(tid[t], NULL);
+        for (int t = 0; t < CC_WRITERS + CC_READERS; t++) {
+            errors += ws[t].errors;
+            reads += ws[t].reads;
+        }
+
+        // the list against the truth of the writers, single-threaded
+        int n = 0;
+        for (int k = 0; k < CC_KEYS; k++) {
+            if (k % 8 == 0 || ws[k % 2].present[k]) keys[n++] = k;
+        }
+        int low;
+        errors += check_list(sl, keys, n, &low);
+        // the writers left the widths to a recount under the lock
+        csl_kv kv;
+        if (csl_rank(sl, keys[n / 2]) != (size_t)(n / 2) ||
+            !csl_select(sl, (size_t)n / 3, &kv) || kv.key != keys[n / 3])
+            errors++;
+        splits += sl->stat_splits;
+        merges += sl->stat_merges;
+        if (!csl_set_concurrent(sl, 0) || sl->sync) errors++;
+        if (errors != prior) printf("  %s: %d errors\n", variants[variant].name, errors - prior);
+        csl_free(sl, NULL);
+    }
+
+    printf("Reads: %ld, splits: %zu, merges: %zu, errors: %d\n", reads, splits, merges, errors);
+    if (errors == 0) {
+        printf("✓ Concurrent readers and writers passed\n");
+    } else {
+        printf("✗ Concurrent readers and writers failed\n");
+    }
+}
+
 int main(void) {
     printf("╔═══════════════════════════════════════════════════════╗\n");
     printf("║  Enhanced CSkiplist Test Suite                       ║\n");
@@ -240,6 +1214,20 @@ int main(void) {
     test_random_operations();
     test_runtime_block_cap();
     test_level_adaptive_block_cap();
+    test_soa_layout();
+    test_block_chunk();
+#if CSL_FAT_SKIPS
+    test_fat_skips();
+#endif
+    test_fast_lanes();
+    test_simd_kernels();
+    test_search_batch();
+    test_finger_search();
+    test_insert_sorted();
+    test_underflow_compact();
+    test_range_scan();
+    test_rank_select();
+    test_concurrent();
     
     printf("\n╔═══════════════════════════════════════════════════════╗\n");
     printf("║  All tests completed successfully!                   ║\n");
@@ -0,0 +1,183 @@
+/*--------------------------------------------------------------------------
+ * test-dataset.c — binary datasets: round trip and damaged images.
+ *
+ * Usage:
+ *   dsettest <datafile>
+ *
+ * Writes the sets of datafile as a binary dataset, plain and with
+ * DSET_VARINT, and reads them back: they must be the sets of datafile.
+ * Then the binary dataset is damaged (foreign byte order, cut short in
+ * the sections and in the header, corrupt offsets): dset_open() and
+ * dset_load() must fail instead of reading the bytes as a text dataset.
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ *--------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "set.h"
+#include "dataset.h"
+
+static int nfail = 0;
+
+static void check(int ok, const char *what) {
+    printf("%s: %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) nfail++;
+}
+
+/* Bytes of the stream f, from its start; *len gets their number. */
+static char *slurp(FILE *f, size_t *len) {
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    char *buf = (char *)malloc(n > 0 ? (size_t)n : 1);
+    rewind(f);
+    *len = (buf && n > 0) ? fread(buf, 1, (size_t)n, f) : 0;
+    return buf;
+}
+
+/* A temporary file holding the first len bytes of buf. */
+static FILE *image(const char *buf, size_t len) {
+    FILE *f = tmpfile();
+    if (f == NULL) return NULL;
+    fwrite(buf, 1, len, f);
+    rewind(f);
+    return f;
+}
+
+/* Number of sets of the dataset in f that differ from sets[]; the
+ * dataset must have n sets. */
+static long compare(FILE *f, set **sets, long n) {
+    dataset *ds = dset_open(f);
+    if (ds == NULL) return n + 1;
+    set *s = set_alloc();
+    long i = 0, bad = 0;
+    while (dset_read_into(ds, s)) {
+        if (i >= n || set_size(s) != set_size(sets[i]) ||
+            memcmp(s->arr, sets[i]->arr, set_size(s) * sizeof(int)) != 0)
+            bad++;
+        i++;
+    }
+    set_free(s);
+    dset_close(ds);
+    return bad + (i != n);
+}
+
+/* dset_open() and dset_load() on the damaged image buf[0..len). */
+static void check_damaged(const char *buf, size_t len, const char *what) {
+    char msg[128];
+    FILE *f = image(buf, len);
+    dataset *ds = dset_open(f);
+    snprintf(msg, sizeof(msg), "dset_open fails on %s", what);
+    check(ds == NULL, msg);
+    dset_close(ds);
+    rewind(f);
+    set_arena *sa = dset_load(f);
+    snprintf(msg, sizeof(msg), "dset_load fails on %s", what);
+    check(sa == NULL, msg);
+    dset_arena_free(sa);
+    fclose(f);
+
+#ifndef _WIN32
+    /* a stream that can not be mapped is read through the buffer */
+    f = fmemopen((void *)buf, len, "rb");
+    if (f != NULL) {
+        ds = dset_open(f);
+        snprintf(msg, sizeof(msg), "dset_open fails on %s (stream)", what);
+        check(ds == NULL, msg);
+        dset_close(ds);
+        fclose(f);
+    }
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <datafile>\n", argv[0]);
+        return 1;
+    }
+
+    /* the sets of datafile */
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) { fprintf(stderr, "error: cannot open '%s'\n", argv[1]); return 1; }
+    dataset *ds = dset_open(in);
+    if (!ds) { printf("FAIL: open '%s'\n", argv[1]); return 1; }
+    long n = 0, cap = 1024;
+    set **sets = (set **)malloc(cap * sizeof(set *));
+    set *s;
+    while ((s = dset_read(ds)) != NULL) {
+        if (n == cap) {
+            cap *= 2;
+            sets = (set **)realloc(sets, cap * sizeof(set *));
+        }
+        sets[n++] = s;
+    }
+    dset_close(ds);
+    fclose(in);
+
+    for (int z = 0; z <= 1; z++) {
+        /* write and read back */
+        FILE *bf = tmpfile();
+        dset_writer *dw = bf ? dset_create(bf, z ? DSET_VARINT : 0) : NULL;
+        boolean ok = (dw != NULL);
+        for (long i = 0; ok && i < n; i++)
+            ok = dset_write(dw, sets[i]);
+        ok = (dw != NULL) && dset_finish(dw) && ok;
+        rewind(bf);
+        check(ok && compare(bf, sets, n) == 0,
+              z ? "varint round trip" : "plain round trip");
+
+        /* damaged copies */
+        size_t len;
+        char *buf = slurp(bf, &len);
+        fclose(bf);
+        dset_header h;
+        memcpy(&h, buf, sizeof(h));
+        h.endian = ((h.endian & 0xffu) << 24) | ((h.endian & 0xff00u) << 8) |
+                   ((h.endian >> 8) & 0xff00u) | (h.endian >> 24);
+        memcpy(buf, &h, sizeof(h));
+        check_damaged(buf, len, "foreign byte order");
+        h.endian = DSET_ENDIAN;
+        memcpy(buf, &h, sizeof(h));
+        check_damaged(buf, len - 1, "truncated offsets");
+        check_damaged(buf, sizeof(dset_header) + h.elem_bytes / 2, "truncated elements");
+        check_damaged(buf, sizeof(dset_header) - 8, "truncated header");
+
+        /* corrupt offsets, in a copy */
+        char *bad = (char *)malloc(len);
+        uint64_t *offs = (uint64_t *)(bad + h.offs_off);
+        memcpy(bad, buf, len);
+        offs[n / 2] = ~(uint64_t)0 / 2;
+        check_damaged(bad, len, "offset past the elements");
+        memcpy(bad, buf, len);
+        offs[n] -= 1;
+        check_damaged(bad, len, "offsets that end before the elements");
+        if (n >= 3) {
+            memcpy(bad, buf, len);
+            offs[1] = offs[2] + 1;
+            check_damaged(bad, len, "decreasing offsets");
+        }
+        memcpy(bad, buf, len);
+        offs[0] = 1;
+        check_damaged(bad, len, "first offset not 0");
+        dset_header hb = h;
+        hb.offs_off = ~(uint64_t)0 - 7;
+        memcpy(bad, buf, len);
+        memcpy(bad, &hb, sizeof(hb));
+        check_damaged(bad, len, "offsets section that wraps around");
+        hb = h;
+        hb.nsets = ~(uint64_t)0;
+        memcpy(bad, &hb, sizeof(hb));
+        check_damaged(bad, len, "number of sets that wraps around");
+        free(bad);
+        free(buf);
+    }
+
+    for (long i = 0; i < n; i++) set_free(sets[i]);
+    free(sets);
+    printf("%s: %ld sets, %d failures\n", nfail ? "FAIL" : "PASS", n, nfail);
+    return nfail ? 1 : 0;
+}
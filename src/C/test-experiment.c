@@ -9,6 +9,9 @@
  *   skiplist    classic probabilistic skip list (node per key)
  *   csl         block skip list, sorted blocks
  *   csl-eyt     block skip list, Eytzinger-laid-out blocks
+ *   csl-soa     block skip list, sorted blocks with separate keys[]/vals[]
+ *   csl-lanes   block skip list, sorted blocks found through fast lanes
+ *   csl-stree   block skip list, SoA blocks in the S-tree layout (16-key nodes)
  *
  * All block-based structures are swept over a list of block capacities at
  * RUNTIME (no recompilation needed).  Queries are generated per the
@@ -25,7 +28,8 @@
  *
  * Usage:
  *   experiment [options]
- *     -m mode      search | insert            (default search)
+ *     -m mode      search | insert | batch | monotone | delete | concurrent | range
+ *                  (default search)
  *     -n N         number of keys             (default 1000000)
  *     -q Q         number of queries          (default 500000)
  *     -b caps      comma-separated block caps (default 16,32,64,128,256,512,1024,2048)
@@ -35,14 +39,66 @@
  *     -d dist      uniform | dense            (default uniform)
  *     -f file      read keys from file (whitespace-separated ints; overrides -n/-d)
  *     -o dir       output directory           (default results)
+ *     -B sizes     comma-separated batch sizes of batch mode (default 1,2,4,8,16,32,64),
+ *                  delta sizes of insert mode (default 16,1024,65536)
+ *                  thread counts of concurrent mode (default 1,2,4,8,16,32,64)
+ *                  or keys per range of range mode (default 1,16,256,4096)
+ *     -W pcts      comma-separated write percentages of concurrent mode (default 0,1,10)
  *
- * Build: gcc -O3 -msse2 -o experiment cskiplist.c skiplist.c test-experiment.c -lpsapi
+ * Batch mode builds the block skip lists as in search mode and answers the
+ * queries with csl_search_batch(), B keys per call, for each batch size B;
+ * the row of B = 0 is the same list queried with csl_search().
+ *
+ * Insert mode inserts the keys in random order with csl_insert, one key at
+ * a time; then, for each delta size D, in sorted deltas of D keys, once
+ * with a csl_insert per key (rows <structure>-single) and once with one
+ * csl_insert_sorted per delta (rows <structure>-merge); the deltas are
+ * sorted before the clock starts.
+ *
+ * Monotone mode sorts the queries and runs them as a forward sweep of
+ * iterator seeks over each block skip list, the access pattern of the
+ * set-trie merges: rows <structure>-seek seek from the head
+ * (csl_iter_seek), rows <structure>-finger from the previous position
+ * (csl_iter_seek_from).
+ * -q sets the mean jump (n/q keys).
+ *
+ * Delete mode builds the block skip lists as in search mode, deletes a
+ * random half of the keys with csl_delete (rows <structure>-del, prep_ms
+ * = delete time) and then repacks them with csl_compact (rows
+ * <structure>-compact, prep_ms = compact time).  Queries of deleted keys
+ * count as misses; bytes_per_key is over the keys left.
+ *
+ * Concurrent mode builds the block skip lists as in search mode (no
+ * lanes) in csl_set_concurrent mode and runs T threads on each, for each
+ * T of -B and write percentage W of -W (rows <structure>-cc).  Every
+ * thread runs q operations in read sections of 64: W% are writes, an
+ * insert or a delete (in turn) of keys that no query asks for, the rest
+ * are the queries, from a different offset per thread.  mops is the read
+ * throughput of all threads (reads per microsecond of wall time),
+ * search_ns the wall time per read of one thread; the hits of each
+ * thread are checked against the queries it ran.
+ *
+ * Range mode builds the block skip lists as in search mode and scans q/L
+ * ranges of L keys each (from random positions in the keys) for each L
+ * of -B: with csl_iter_seek and csl_iter_next (rows <structure>-iter),
+ * csl_range_scan (rows <structure>-scan) and csl_range_spans (rows
+ * <structure>-spans); batch = L, search_ns = ns per key scanned, hits =
+ * the keys scanned.
+ *
+ * Build: gcc -O3 -msse2 -o experiment cskiplist.c skiplist.c test-experiment.c -lpthread -lpsapi
+ *
+ * The width of a key/value pair is fixed at compile time: values are
+ * pointers (16-byte pairs) or, with -DCSL_VAL32, 32-bit handles (8-byte
+ * pairs; `make experiment-h32`).  Every row records kv_bytes, so the CSV
+ * files of both builds can be merged and compared by bytes per key and
+ * search ns.  Files of the 32-bit build get the suffix _kv8.
  *----------------------------------------------------------------------------*/
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <pthread.h>
 #include "cskiplist.h"
 #include "skiplist.h"
 
@@ -116,7 +172,12 @@ static int arr_search_branchless(const csl_kv* a, int n, int key) {
 }
 
 /* Eytzinger (BFS) layout of the whole array + branchless descent
- * (Khuong & Morin §4).  8 = items per 64-byte cache line for csl_kv. */
+ * (Khuong & Morin §4).  Prefetch one cache line of csl_kv ahead. */
+#define KV_PER_CL (64 / (int)sizeof(csl_kv))
+
+/* Value stored for a key (never CSL_VAL_NONE for keys >= 0). */
+#define KEY_VAL(k) ((csl_val_t)(intptr_t)((k) + 1))
+
 static void eyt_build_kv(const csl_kv* sorted, csl_kv* eyt, int n, int* si, int k) {
     if (k >= n) return;
     eyt_build_kv(sorted, eyt, n, si, 2*k + 1);
@@ -126,7 +187,7 @@ static void eyt_build_kv(const csl_kv* sorted, csl_kv* eyt, int n, int* si, int
 static int arr_search_eytzinger(const csl_kv* a, int n, int key) {
     unsigned k = 0;
     while (k < (unsigned)n) {
-        __builtin_prefetch(&a[k * 8 + 8], 0, 1);
+        __builtin_prefetch(&a[k * KV_PER_CL + KV_PER_CL], 0, 1);
         k = 2*k + 1 + (unsigned)(a[k].key < key);
     }
     unsigned u = k + 1;
@@ -141,11 +202,9 @@ static int arr_search_eytzinger(const csl_kv* a, int n, int key) {
 
 static size_t mem_csl(const cskiplist* sl) {
     size_t bytes = sizeof(cskiplist);
-    for (const csl_block* b = sl->head; b; b = b->next[0]) {
-        bytes += sizeof(csl_block)
-               + (size_t)b->item_cap * sizeof(csl_kv)
-               + (size_t)b->skip_alloc * sizeof(csl_block*);
-    }
+    for (const csl_block* b = sl->head; b; b = b->next[0])
+        bytes += csl_block_bytes(b->item_cap, b->skip_alloc, b->keys != NULL);
+    if (sl->lanes) bytes += sl->lanes->bytes;
     return bytes;
 }
 static size_t mem_skiplist(const skiplist* sl) {
@@ -158,11 +217,16 @@ static size_t mem_skiplist(const skiplist* sl) {
 /* ---------------- experiment configuration ---------------- */
 
 typedef struct {
-    const char* mode;    /* search | insert */
+    const char* mode;    /* search | insert | batch | monotone | delete | concurrent */
     int n;               /* keys */
     int q;               /* queries */
     int caps[64];        /* block-cap sweep */
     int ncaps;
+    int batches[64];     /* batch-size sweep (batch mode), delta sizes (insert mode),
+                            thread counts (concurrent mode) */
+    int nbatches;
+    int writes[16];      /* write percentages (concurrent mode) */
+    int nwrites;
     int reps;
     uint32_t seed;
     int hit_pct;         /* 0..100 */
@@ -179,21 +243,32 @@ typedef struct {
     double prep_ms;         /* rebuild + layout conversion */
     double search_ns;       /* per query, this repetition */
     double insert_ns;       /* per key (insert mode), else 0 */
+    int batch;              /* keys per csl_search_batch() call, 0 = csl_search();
+                               insert mode: keys per delta */
     long   hits;
     size_t mem_bytes;
+    int keys;               /* keys held, 0 = n (delete mode: after deletes) */
+    int threads;            /* concurrent mode: threads, else 0 */
+    int write_pct;          /* concurrent mode: percent of operations that write */
+    double mops;            /* concurrent mode: reads per us, all threads */
 } row;
 
 static FILE* g_csv;
 static config g_cfg;
 
+static double bytes_per_key(const row* r) {
+    return (double)r->mem_bytes / (double)(r->keys ? r->keys : g_cfg.n);
+}
+
 static void csv_write(const row* r, int rep, long expected_hits) {
     fprintf(g_csv,
-        "%s,%s,%d,%d,%d,%s,%d,%u,%d,%.3f,%.3f,%.2f,%.2f,%ld,%ld,%lu,%.2f\n",
+        "%s,%s,%d,%d,%d,%s,%d,%u,%d,%.3f,%.3f,%.2f,%.2f,%ld,%ld,%lu,%.2f,%d,%d,%d,%d,%.3f\n",
         r->structure, r->layout, r->block_cap, g_cfg.n, g_cfg.q,
         g_cfg.dist, g_cfg.hit_pct, g_cfg.seed, rep,
         r->build_ms, r->prep_ms, r->search_ns, r->insert_ns,
         r->hits, expected_hits, (unsigned long)r->mem_bytes,
-        (double)r->mem_bytes / (double)g_cfg.n);
+        bytes_per_key(r), (int)sizeof(csl_kv), r->batch,
+        r->threads, r->write_pct, r->mops);
     if (r->hits != expected_hits)
         printf("  !! %s(%s,cap=%d): hits=%ld expected=%ld\n",
                r->structure, r->layout, r->block_cap, r->hits, expected_hits);
@@ -201,11 +276,37 @@ static void csv_write(const row* r, int rep, long expected_hits) {
 }
 
 static void print_row(const row* r, double best_ns) {
+    if (r->threads) {
+        printf("  %-14s %-6s cap=%-5d threads=%-3d writes=%2d%%  reads=%8.2f Mops/s  %8.2f ns/read\n",
+               r->structure, r->layout, r->block_cap, r->threads, r->write_pct,
+               r->mops, r->search_ns);
+        return;
+    }
+    if (r->keys) {
+        printf("  %-18s %-6s cap=%-5d search=%8.2f ns  prep=%8.1f ms  mem=%6.2f B/key\n",
+               r->structure, r->layout, r->block_cap, r->search_ns, r->prep_ms,
+               bytes_per_key(r));
+        return;
+    }
+    if (r->batch && r->insert_ns > 0) {
+        printf("  %-16s %-6s cap=%-5d delta=%-6d insert=%8.2f ns  search=%8.2f ns\n",
+               r->structure, r->layout, r->block_cap, r->batch, r->insert_ns, r->search_ns);
+        return;
+    }
+    if (r->batch && strcmp(g_cfg.mode, "range") == 0) {
+        printf("  %-16s %-6s cap=%-5d range=%-5d scan=%8.2f ns/key\n",
+               r->structure, r->layout, r->block_cap, r->batch, r->search_ns);
+        return;
+    }
+    if (r->batch) {
+        printf("  %-10s %-6s cap=%-5d batch=%-4d search=%8.2f ns\n",
+               r->structure, r->layout, r->block_cap, r->batch, r->search_ns);
+        return;
+    }
     printf("  %-10s %-6s cap=%-5d search=%8.2f ns  (best %7.2f)  "
            "build=%8.1f ms  mem=%6.2f B/key\n",
            r->structure, r->layout, r->block_cap,
-           r->search_ns, best_ns, r->build_ms,
-           (double)r->mem_bytes / (double)g_cfg.n);
+           r->search_ns, best_ns, r->build_ms, bytes_per_key(r));
 }
 
 /* ---------------- query loop (identical for every structure) ----------------
@@ -237,7 +338,177 @@ static long run_q_skiplist(skiplist* sl, const int* qk, int nq, double* out_ns)
     TIMED_QUERY_LOOP(sl_search(sl, key) != NULL);
 }
 static long run_q_csl(cskiplist* sl, const int* qk, int nq, double* out_ns) {
-    TIMED_QUERY_LOOP(csl_search(sl, key) != NULL);
+    TIMED_QUERY_LOOP(csl_search(sl, key) != CSL_VAL_NONE);
+}
+
+/* The same queries through csl_search_batch(), batch keys per call. */
+static long run_q_csl_batch(cskiplist* sl, const int* qk, int nq, int batch, double* out_ns) {
+    csl_val_t* vals = (csl_val_t*)malloc((size_t)batch * sizeof(csl_val_t));
+    long hits = 0;
+    double t0 = now_us();
+    for (int qi = 0; qi < nq; qi += batch) {
+        int m = (nq - qi < batch) ? nq - qi : batch;
+        hits += (long)csl_search_batch(sl, qk + qi, (size_t)m, vals);
+    }
+    *out_ns = (now_us() - t0) * 1000.0 / (double)nq;
+    free(vals);
+    return hits;
+}
+
+/* Sorted queries as one forward sweep of seeks, from the head or from
+ * the previous position; hits are exact matches. */
+static long run_q_csl_seek(cskiplist* sl, const int* qk, int nq, int finger, double* out_ns) {
+    csl_iter it;
+    long hits = 0;
+    csl_iter_rewind(sl, &it);
+    double t0 = now_us();
+    for (int qi = 0; qi < nq; ++qi) {
+        int exact = 0;
+        if (finger) csl_iter_seek_from(sl, &it, qk[qi], &exact);
+        else csl_iter_seek(sl, qk[qi], &it, &exact);
+        hits += exact;
+    }
+    *out_ns = (now_us() - t0) * 1000.0 / (double)nq;
+    return hits;
+}
+
+/* ---------------- range mode ---------------- */
+
+static long g_scan_sink; /* key sums of the scans, so they are not elided */
+
+static int scan_sum(void* ctx, csl_key_t key, csl_val_t val) {
+    (void)val;
+    *(long*)ctx += key;
+    return 1;
+}
+
+static int span_sum(void* ctx, const csl_key_t* keys, const csl_val_t* vals, int n) {
+    long s = 0;
+    (void)vals;
+    for (int i = 0; i < n; ++i) s += keys[i];
+    *(long*)ctx += s;
+    return 1;
+}
+
+/* The nr ranges [lo[i], hi[i]] through csl_iter_seek and csl_iter_next
+ * (method 0), csl_range_scan (1) or csl_range_spans (2); returns the
+ * pairs visited, *out_ns per pair. */
+static long run_ranges(cskiplist* sl, const int* lo, const int* hi, int nr, int method,
+                       double* out_ns) {
+    long pairs = 0, sum = 0;
+    double t0 = now_us();
+    for (int i = 0; i < nr; ++i) {
+        if (method == 1) {
+            pairs += (long)csl_range_scan(sl, lo[i], hi[i], scan_sum, &sum);
+        } else if (method == 2) {
+            pairs += (long)csl_range_spans(sl, lo[i], hi[i], span_sum, &sum);
+        } else {
+            csl_iter it;
+            if (!csl_iter_seek(sl, lo[i], &it, NULL)) continue;
+            do {
+                csl_kv* kv = csl_iter_get(&it);
+                if (kv->key > hi[i]) break;
+                sum += kv->key;
+                pairs++;
+            } while (csl_iter_next(&it));
+        }
+    }
+    *out_ns = (now_us() - t0) * 1000.0 / (double)(pairs ? pairs : 1);
+    g_scan_sink += sum;
+    return pairs;
+}
+
+/* ---------------- concurrent mode ---------------- */
+
+typedef struct {
+    cskiplist* sl;
+    const int* qk;            /* the queries ... */
+    const unsigned char* hit; /* ... and which of them are keys of the list */
+    int nq;
+    int start;                /* first query of this thread */
+    int ops;
+    int write_pct;
+    const int* churn;         /* keys of the writes (no query asks for them) */
+    int nchurn;
+    uint32_t rng;
+    long reads, hits, expected;
+    pthread_t tid;
+} cc_thread;
+
+static void* cc_run(void* arg) {
+    cc_thread* t = (cc_thread*)arg;
+    int slot = csl_reader_register(t->sl);
+    int qi = t->start, ci = 0, inserted = 0;
+
+    if (slot < 0) { t->expected = -1; return NULL; }
+    for (int i = 0; i < t->ops; i += 64) {
+        int m = (t->ops - i < 64) ? t->ops - i : 64;
+        csl_read_begin(t->sl, slot);
+        for (int j = 0; j < m; ++j) {
+            uint32_t x = t->rng;
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            t->rng = x;
+            if ((int)(x % 100u) < t->write_pct && t->nchurn > 0) {
+                /* insert a key, then delete it again */
+                int key = t->churn[ci];
+                if (inserted) {
+                    csl_delete(t->sl, key, NULL);
+                    if (++ci == t->nchurn) ci = 0;
+                } else {
+                    csl_insert(t->sl, key, KEY_VAL(key));
+                }
+                inserted ^= 1;
+                continue;
+            }
+            t->hits += csl_search(t->sl, t->qk[qi]) != CSL_VAL_NONE;
+            t->expected += t->hit[qi];
+            t->reads++;
+            if (++qi == t->nq) qi = 0;
+        }
+        csl_read_end(t->sl, slot);
+    }
+    if (inserted) csl_delete(t->sl, t->churn[ci], NULL);
+    csl_reader_unregister(t->sl, slot);
+    return NULL;
+}
+
+/* nthreads threads of ops operations each on sl (in concurrent mode),
+ * write_pct percent of them writes of the churn keys.  Fills the hits,
+ * mops and search_ns of r; returns the hits expected (-1 if a thread
+ * did not get a reader slot). */
+static long run_cc(cskiplist* sl, const int* qk, const unsigned char* hit, int nq,
+                   const int* churn, int nchurn, int nthreads, int write_pct, row* r) {
+    cc_thread* ts = (cc_thread*)calloc((size_t)nthreads, sizeof(cc_thread));
+    int share = nchurn / nthreads;
+    long reads = 0, expected = 0;
+
+    double t0 = now_us();
+    for (int i = 0; i < nthreads; ++i) {
+        cc_thread* t = &ts[i];
+        t->sl = sl;
+        t->qk = qk;
+        t->hit = hit;
+        t->nq = nq;
+        t->start = (int)((long)nq * i / nthreads);
+        t->ops = nq;
+        t->write_pct = write_pct;
+        t->churn = churn + (size_t)i * share;
+        t->nchurn = share;
+        t->rng = g_cfg.seed * 2654435761u + (uint32_t)i + 1u;
+        pthread_create(&t->tid, NULL, cc_run, t);
+    }
+    r->hits = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        pthread_join(ts[i].tid, NULL);
+        reads += ts[i].reads;
+        r->hits += ts[i].hits;
+        if (expected >= 0) expected = (ts[i].expected < 0) ? -1 : expected + ts[i].expected;
+    }
+    double us = now_us() - t0;
+    r->mops = (double)reads / us;
+    r->search_ns = us * 1000.0 * nthreads / (double)reads;
+    free(ts);
+    return expected;
 }
 
 /* ---------------- key & query generation ---------------- */
@@ -310,6 +581,11 @@ static int cmp_int(const void* a, const void* b) {
     return (x > y) - (x < y);
 }
 
+static int cmp_kv(const void* a, const void* b) {
+    int x = ((const csl_kv*)a)->key, y = ((const csl_kv*)b)->key;
+    return (x > y) - (x < y);
+}
+
 /* Build the query sequence: hit_pct% present keys, rest absent keys.
  * Returns expected number of hits. */
 static long gen_queries(int* qk, int nq, int hit_pct,
@@ -330,21 +606,51 @@ static long gen_queries(int* qk, int nq, int hit_pct,
 
 /* ---------------- structure builders ---------------- */
 
-static cskiplist* build_csl(const int* sorted, int n, int cap, int eyt,
-                            double* build_ms, double* prep_ms) {
+static cskiplist* build_csl(const int* sorted, int n, int cap, int layout, int soa,
+                            int lanes, double* build_ms, double* prep_ms) {
     double t0 = now_us();
     cskiplist* sl = csl_create_with_block_cap(cap);
+    if (soa) csl_set_soa(sl, 1);
     for (int i = 0; i < n; ++i)
-        csl_append(sl, sorted[i], (void*)(intptr_t)(sorted[i] + 1));
+        csl_append(sl, sorted[i], KEY_VAL(sorted[i]));
     *build_ms = (now_us() - t0) / 1000.0;
 
     t0 = now_us();
     csl_rebuild_skips(sl);
-    if (eyt) csl_set_eytzinger(sl, 1);
+    csl_set_layout(sl, layout);
+    if (lanes) csl_set_lanes(sl, 1);
     *prep_ms = (now_us() - t0) / 1000.0;
     return sl;
 }
 
+/* The keys rnd[0..n) as pairs in deltas of m keys (a set-trie node
+ * getting new children in batches), each delta sorted. */
+static csl_kv* make_deltas(const int* rnd, int n, int m) {
+    csl_kv* d = (csl_kv*)malloc((size_t)n * sizeof(csl_kv));
+    for (int i = 0; i < n; ++i) {
+        d[i].key = rnd[i];
+        d[i].val = KEY_VAL(rnd[i]);
+    }
+    for (int i = 0; i < n; i += m)
+        qsort(d + i, (size_t)((n - i < m) ? n - i : m), sizeof(csl_kv), cmp_kv);
+    return d;
+}
+
+/* Insert the deltas of m pairs of d[0..n): one csl_insert_sorted per
+ * delta (merge) or one csl_insert per pair.  Returns ns per key. */
+static double insert_csl_deltas(cskiplist* sl, const csl_kv* d, int n, int m, int merge) {
+    double t0 = now_us();
+    for (int i = 0; i < n; i += m) {
+        int k = (n - i < m) ? n - i : m;
+        if (merge) {
+            csl_insert_sorted(sl, d + i, (size_t)k);
+        } else {
+            for (int j = i; j < i + k; ++j) csl_insert(sl, d[j].key, d[j].val);
+        }
+    }
+    return (now_us() - t0) * 1000.0 / n;
+}
+
 static skiplist* build_skiplist(const int* sorted, int n, double* build_ms) {
     double t0 = now_us();
     skiplist* sl = sl_create();
@@ -358,9 +664,9 @@ static skiplist* build_skiplist(const int* sorted, int n, double* build_ms) {
 
 static void usage(const char* prog) {
     fprintf(stderr,
-        "Usage: %s [-m search|insert] [-n keys] [-q queries] [-b cap,cap,...]\n"
-        "          [-r reps] [-s seed] [-H hit_pct] [-d uniform|dense|cluster]\n"
-        "          [-f keyfile] [-o outdir]\n", prog);
+        "Usage: %s [-m search|insert|batch|monotone|delete|concurrent|range] [-n keys] [-q queries]\n"
+        "          [-b cap,cap,...] [-r reps] [-s seed] [-H hit_pct] [-d uniform|dense|cluster]\n"
+        "          [-f keyfile] [-o outdir] [-B batch,batch,...] [-W pct,pct,...]\n", prog);
     exit(1);
 }
 
@@ -383,6 +689,17 @@ int main(int argc, char** argv) {
         memcpy(cfg.caps, defaults, sizeof(defaults));
         cfg.ncaps = 8;
     }
+    {
+        int defaults[] = {1, 2, 4, 8, 16, 32, 64};
+        memcpy(cfg.batches, defaults, sizeof(defaults));
+        cfg.nbatches = 7;
+    }
+    {
+        int defaults[] = {0, 1, 10};
+        memcpy(cfg.writes, defaults, sizeof(defaults));
+        cfg.nwrites = 3;
+    }
+    int batches_given = 0;
 
     for (int i = 1; i < argc; ++i) {
         if (!strcmp(argv[i], "-m") && i+1 < argc) cfg.mode = argv[++i];
@@ -399,9 +716,43 @@ int main(int argc, char** argv) {
             char* tok = strtok(argv[++i], ",");
             while (tok && cfg.ncaps < 64) { cfg.caps[cfg.ncaps++] = atoi(tok); tok = strtok(NULL, ","); }
         }
+        else if (!strcmp(argv[i], "-B") && i+1 < argc) {
+            cfg.nbatches = 0;
+            batches_given = 1;
+            char* tok = strtok(argv[++i], ",");
+            while (tok && cfg.nbatches < 64) {
+                int b = atoi(tok);
+                if (b > 0) cfg.batches[cfg.nbatches++] = b;
+                tok = strtok(NULL, ",");
+            }
+        }
+        else if (!strcmp(argv[i], "-W") && i+1 < argc) {
+            cfg.nwrites = 0;
+            char* tok = strtok(argv[++i], ",");
+            while (tok && cfg.nwrites < 16) {
+                int w = atoi(tok);
+                if (w >= 0 && w <= 100) cfg.writes[cfg.nwrites++] = w;
+                tok = strtok(NULL, ",");
+            }
+        }
         else usage(argv[0]);
     }
     if (cfg.n < 1 || cfg.q < 1 || cfg.reps < 1) usage(argv[0]);
+    if (!batches_given && strcmp(cfg.mode, "insert") == 0) {
+        int defaults[] = {16, 1024, 65536};
+        memcpy(cfg.batches, defaults, sizeof(defaults));
+        cfg.nbatches = 3;
+    }
+    if (!batches_given && strcmp(cfg.mode, "range") == 0) {
+        int defaults[] = {1, 16, 256, 4096}; /* keys per range */
+        memcpy(cfg.batches, defaults, sizeof(defaults));
+        cfg.nbatches = 4;
+    }
+    if (!batches_given && strcmp(cfg.mode, "concurrent") == 0) {
+        int defaults[] = {1, 2, 4, 8, 16, 32, 64}; /* threads */
+        memcpy(cfg.batches, defaults, sizeof(defaults));
+        cfg.nbatches = 7;
+    }
     g_cfg = cfg;
     g_rng = cfg.seed ? cfg.seed : 42;
 
@@ -448,20 +799,22 @@ int main(int argc, char** argv) {
     int nq = cfg.q;
     int* qk = (int*)malloc((size_t)nq * sizeof(int));
     long expected_hits = gen_queries(qk, nq, cfg.hit_pct, present, n, absent, n_absent);
+    if (strcmp(cfg.mode, "monotone") == 0) qsort(qk, (size_t)nq, sizeof(int), cmp_int);
 
     /* ---- output file: parameters encoded in the name ---- */
     MKDIR(cfg.outdir);
     char path[512];
-    snprintf(path, sizeof(path), "%s/exp_%s_%s_n%d_q%d_hit%d_seed%u.csv",
-             cfg.outdir, cfg.mode, cfg.dist, n, nq, cfg.hit_pct, cfg.seed);
+    snprintf(path, sizeof(path), "%s/exp_%s_%s_n%d_q%d_hit%d_seed%u%s.csv",
+             cfg.outdir, cfg.mode, cfg.dist, n, nq, cfg.hit_pct, cfg.seed,
+             (sizeof(csl_kv) == 8) ? "_kv8" : "");
     g_csv = fopen(path, "w");
     if (!g_csv) { fprintf(stderr, "cannot open %s\n", path); return 1; }
     fprintf(g_csv, "structure,layout,block_cap,n,q,dist,hit_pct,seed,rep,"
                    "build_ms,prep_ms,search_ns,insert_ns,hits,expected_hits,"
-                   "mem_bytes,bytes_per_key\n");
+                   "mem_bytes,bytes_per_key,kv_bytes,batch,threads,write_pct,mops\n");
 
-    printf("=== experiment: mode=%s dist=%s n=%d q=%d hit=%d%% seed=%u reps=%d ===\n",
-           cfg.mode, cfg.dist, n, nq, cfg.hit_pct, cfg.seed, cfg.reps);
+    printf("=== experiment: mode=%s dist=%s n=%d q=%d hit=%d%% seed=%u reps=%d kv=%dB ===\n",
+           cfg.mode, cfg.dist, n, nq, cfg.hit_pct, cfg.seed, cfg.reps, (int)sizeof(csl_kv));
     printf("    output: %s\n\n", path);
 
     int verify_ok = 1;
@@ -493,86 +846,271 @@ int main(int argc, char** argv) {
                 sl_free(sl, NULL);
             }
             /* block skip list per cap (skips maintained incrementally!) */
+            static const struct { const char* s; const char* l; int layout, soa, lanes; }
+            csls[] = {
+                { "csl",       "sorted", CSL_LAYOUT_SORTED,    0, 0 },
+                { "csl-eyt",   "eyt",    CSL_LAYOUT_EYTZINGER, 0, 0 },
+                { "csl-soa",   "soa",    CSL_LAYOUT_SORTED,    1, 0 },
+                { "csl-lanes", "sorted", CSL_LAYOUT_SORTED,    0, 1 },
+                { "csl-stree", "stree",  CSL_LAYOUT_STREE,     1, 0 },
+            };
             for (int ci = 0; ci < cfg.ncaps; ++ci) {
-                row r; memset(&r, 0, sizeof(r));
-                r.structure = "csl"; r.layout = "sorted"; r.block_cap = cfg.caps[ci];
-                double t0 = now_us();
-                cskiplist* sl = csl_create_with_block_cap(cfg.caps[ci]);
-                for (int i = 0; i < n; ++i)
-                    csl_insert(sl, rnd[i], (void*)(intptr_t)(rnd[i] + 1));
-                r.insert_ns = (now_us() - t0) * 1000.0 / n;
-                r.build_ms = r.insert_ns * n / 1e6;
-                r.mem_bytes = mem_csl(sl);
-                long h = run_q_csl(sl, qk, nq, &r.search_ns);
-                r.hits = h;
-                if (h != expected_hits) verify_ok = 0;
-                csv_write(&r, rep, expected_hits);
-                print_row(&r, r.search_ns);
-                csl_free(sl, NULL);
+                for (int vi = 0; vi < (int)(sizeof(csls) / sizeof(csls[0])); ++vi) {
+                    row r; memset(&r, 0, sizeof(r));
+                    r.structure = csls[vi].s;
+                    r.layout = csls[vi].l;
+                    r.block_cap = cfg.caps[ci];
+                    double t0 = now_us();
+                    cskiplist* sl = csl_create_with_block_cap(cfg.caps[ci]);
+                    if (csls[vi].soa) csl_set_soa(sl, 1);
+                    if (csls[vi].lanes) csl_set_lanes(sl, 1);
+                    csl_set_layout(sl, csls[vi].layout);
+                    for (int i = 0; i < n; ++i)
+                        csl_insert(sl, rnd[i], KEY_VAL(rnd[i]));
+                    r.insert_ns = (now_us() - t0) * 1000.0 / n;
+                    r.build_ms = r.insert_ns * n / 1e6;
+                    long h = run_q_csl(sl, qk, nq, &r.search_ns);
+                    r.mem_bytes = mem_csl(sl); /* lanes are built by the first search */
+                    r.hits = h;
+                    if (h != expected_hits) verify_ok = 0;
+                    csv_write(&r, rep, expected_hits);
+                    print_row(&r, r.search_ns);
+                    csl_free(sl, NULL);
+
+                    /* the same keys in sorted deltas: one csl_insert per
+                     * key (-single) vs one csl_insert_sorted (-merge) */
+                    for (int bi = 0; bi < cfg.nbatches; ++bi) {
+                        int m = (cfg.batches[bi] < n) ? cfg.batches[bi] : n;
+                        csl_kv* d = make_deltas(rnd, n, m);
+                        for (int merge = 0; merge <= 1; ++merge) {
+                            char name[32];
+                            snprintf(name, sizeof(name), "%s-%s", csls[vi].s,
+                                     merge ? "merge" : "single");
+                            r.structure = name;
+                            r.batch = m;
+                            sl = csl_create_with_block_cap(cfg.caps[ci]);
+                            if (csls[vi].soa) csl_set_soa(sl, 1);
+                            if (csls[vi].lanes) csl_set_lanes(sl, 1);
+                            csl_set_layout(sl, csls[vi].layout);
+                            r.insert_ns = insert_csl_deltas(sl, d, n, m, merge);
+                            r.build_ms = r.insert_ns * n / 1e6;
+                            h = run_q_csl(sl, qk, nq, &r.search_ns);
+                            r.mem_bytes = mem_csl(sl);
+                            r.hits = h;
+                            if (h != expected_hits) verify_ok = 0;
+                            csv_write(&r, rep, expected_hits);
+                            print_row(&r, r.search_ns);
+                            csl_free(sl, NULL);
+                        }
+                        free(d);
+                    }
+                }
             }
         }
     } else {
         /* ------- SEARCH MODE: bulk load sorted, then query ------- */
+        /* (batch / monotone mode: the block skip lists only, queried with
+         * csl_search_batch / iterator seeks as well) */
+        int batch_mode = strcmp(cfg.mode, "batch") == 0;
+        int monotone_mode = strcmp(cfg.mode, "monotone") == 0;
+        int delete_mode = strcmp(cfg.mode, "delete") == 0;
+        int cc_mode = strcmp(cfg.mode, "concurrent") == 0;
+        int range_mode = strcmp(cfg.mode, "range") == 0;
+
+        /* delete mode: a random half of the keys goes, in random order;
+         * the hits left are the queries of keys not in it */
+        int ndel = delete_mode ? n / 2 : 0;
+        int* del = NULL;
+        long expected_left = expected_hits;
+        if (delete_mode) {
+            del = (int*)malloc((size_t)n * sizeof(int));
+            memcpy(del, present, (size_t)n * sizeof(int));
+            shuffle(del, n);
+            int* gone = (int*)malloc((size_t)ndel * sizeof(int));
+            memcpy(gone, del, (size_t)ndel * sizeof(int));
+            qsort(gone, (size_t)ndel, sizeof(int), cmp_int);
+            for (int qi = 0; qi < nq; ++qi)
+                if (bsearch(&qk[qi], gone, (size_t)ndel, sizeof(int), cmp_int))
+                    expected_left--;
+            free(gone);
+        }
+
+        /* concurrent mode: which queries hit, and the absent keys that
+         * no query asks for, for the writes */
+        unsigned char* hit = NULL;
+        int* churn = NULL;
+        int nchurn = 0;
+        if (cc_mode) {
+            hit = (unsigned char*)malloc((size_t)nq);
+            for (int qi = 0; qi < nq; ++qi)
+                hit[qi] = bsearch(&qk[qi], sorted, (size_t)n, sizeof(int), cmp_int) != NULL;
+            int* asked = (int*)malloc((size_t)nq * sizeof(int));
+            memcpy(asked, qk, (size_t)nq * sizeof(int));
+            qsort(asked, (size_t)nq, sizeof(int), cmp_int);
+            churn = (int*)malloc((size_t)n_absent * sizeof(int));
+            memcpy(churn, absent, (size_t)n_absent * sizeof(int));
+            qsort(churn, (size_t)n_absent, sizeof(int), cmp_int);
+            for (int i = 0; i < n_absent; ++i) {
+                if ((nchurn > 0 && churn[i] == churn[nchurn - 1]) ||
+                    bsearch(&churn[i], asked, (size_t)nq, sizeof(int), cmp_int))
+                    continue;
+                churn[nchurn++] = churn[i];
+            }
+            free(asked);
+            shuffle(churn, nchurn);
+        }
 
         /* sorted kv array shared by the three array baselines */
         csl_kv* akv = (csl_kv*)malloc((size_t)n * sizeof(csl_kv));
         for (int i = 0; i < n; ++i) {
             akv[i].key = sorted[i];
-            akv[i].val = (void*)(intptr_t)(sorted[i] + 1);
+            akv[i].val = KEY_VAL(sorted[i]);
         }
         csl_kv* ekv = (csl_kv*)malloc((size_t)n * sizeof(csl_kv));
         { int si = 0; eyt_build_kv(akv, ekv, n, &si, 0); }
 
         for (int rep = 0; rep < cfg.reps; ++rep) {
             /* --- array baselines (no block cap) --- */
-            struct { const char* s; const char* l;
-                     long (*fn)(const csl_kv*, int, const int*, int, double*);
-                     const csl_kv* data; }
-            arrs[] = {
-                { "array",     "sorted", run_q_arr_branchy,    akv },
-                { "array-bl",  "sorted", run_q_arr_branchless, akv },
-                { "array-eyt", "eyt",    run_q_arr_eyt,        ekv },
-            };
-            for (int ai = 0; ai < 3; ++ai) {
-                row r; memset(&r, 0, sizeof(r));
-                r.structure = arrs[ai].s; r.layout = arrs[ai].l; r.block_cap = 0;
-                r.mem_bytes = (size_t)n * sizeof(csl_kv);
-                long h = arrs[ai].fn(arrs[ai].data, n, qk, nq, &r.search_ns);
-                r.hits = h;
-                if (h != expected_hits) verify_ok = 0;
-                csv_write(&r, rep, expected_hits);
-                print_row(&r, r.search_ns);
-            }
+            if (!batch_mode && !monotone_mode && !delete_mode && !cc_mode && !range_mode) {
+                struct { const char* s; const char* l;
+                         long (*fn)(const csl_kv*, int, const int*, int, double*);
+                         const csl_kv* data; }
+                arrs[] = {
+                    { "array",     "sorted", run_q_arr_branchy,    akv },
+                    { "array-bl",  "sorted", run_q_arr_branchless, akv },
+                    { "array-eyt", "eyt",    run_q_arr_eyt,        ekv },
+                };
+                for (int ai = 0; ai < 3; ++ai) {
+                    row r; memset(&r, 0, sizeof(r));
+                    r.structure = arrs[ai].s; r.layout = arrs[ai].l; r.block_cap = 0;
+                    r.mem_bytes = (size_t)n * sizeof(csl_kv);
+                    long h = arrs[ai].fn(arrs[ai].data, n, qk, nq, &r.search_ns);
+                    r.hits = h;
+                    if (h != expected_hits) verify_ok = 0;
+                    csv_write(&r, rep, expected_hits);
+                    print_row(&r, r.search_ns);
+                }
 
-            /* --- classic skip list --- */
-            {
-                row r; memset(&r, 0, sizeof(r));
-                r.structure = "skiplist"; r.layout = "nodes"; r.block_cap = 0;
-                skiplist* sl = build_skiplist(sorted, n, &r.build_ms);
-                r.mem_bytes = mem_skiplist(sl);
-                long h = run_q_skiplist(sl, qk, nq, &r.search_ns);
-                r.hits = h;
-                if (h != expected_hits) verify_ok = 0;
-                csv_write(&r, rep, expected_hits);
-                print_row(&r, r.search_ns);
-                sl_free(sl, NULL);
+                /* --- classic skip list --- */
+                {
+                    row r; memset(&r, 0, sizeof(r));
+                    r.structure = "skiplist"; r.layout = "nodes"; r.block_cap = 0;
+                    skiplist* sl = build_skiplist(sorted, n, &r.build_ms);
+                    r.mem_bytes = mem_skiplist(sl);
+                    long h = run_q_skiplist(sl, qk, nq, &r.search_ns);
+                    r.hits = h;
+                    if (h != expected_hits) verify_ok = 0;
+                    csv_write(&r, rep, expected_hits);
+                    print_row(&r, r.search_ns);
+                    sl_free(sl, NULL);
+                }
             }
 
-            /* --- block skip list: cap sweep x {sorted, eytzinger} --- */
+            /* --- block skip list: cap sweep x {sorted, eytzinger, soa, lanes, stree} --- */
+            static const struct { const char* s; const char* l; int layout, soa, lanes; }
+            csls[] = {
+                { "csl",       "sorted", CSL_LAYOUT_SORTED,    0, 0 },
+                { "csl-eyt",   "eyt",    CSL_LAYOUT_EYTZINGER, 0, 0 },
+                { "csl-soa",   "soa",    CSL_LAYOUT_SORTED,    1, 0 },
+                { "csl-lanes", "sorted", CSL_LAYOUT_SORTED,    0, 1 },
+                { "csl-stree", "stree",  CSL_LAYOUT_STREE,     1, 0 },
+            };
             for (int ci = 0; ci < cfg.ncaps; ++ci) {
-                for (int eyt = 0; eyt <= 1; ++eyt) {
+                for (int vi = 0; vi < (int)(sizeof(csls) / sizeof(csls[0])); ++vi) {
+                    if (cc_mode && csls[vi].lanes) continue; /* no lanes in concurrent mode */
                     row r; memset(&r, 0, sizeof(r));
-                    r.structure = eyt ? "csl-eyt" : "csl";
-                    r.layout = eyt ? "eyt" : "sorted";
+                    r.structure = csls[vi].s;
+                    r.layout = csls[vi].l;
                     r.block_cap = cfg.caps[ci];
-                    cskiplist* sl = build_csl(sorted, n, cfg.caps[ci], eyt,
-                                              &r.build_ms, &r.prep_ms);
+                    cskiplist* sl = build_csl(sorted, n, cfg.caps[ci],
+                                              csls[vi].layout, csls[vi].soa,
+                                              csls[vi].lanes, &r.build_ms, &r.prep_ms);
                     r.mem_bytes = mem_csl(sl);
-                    long h = run_q_csl(sl, qk, nq, &r.search_ns);
-                    r.hits = h;
-                    if (h != expected_hits) verify_ok = 0;
-                    csv_write(&r, rep, expected_hits);
-                    print_row(&r, r.search_ns);
+                    long h;
+                    if (!monotone_mode && !range_mode) {
+                        h = run_q_csl(sl, qk, nq, &r.search_ns);
+                        r.hits = h;
+                        if (h != expected_hits) verify_ok = 0;
+                        csv_write(&r, rep, expected_hits);
+                        print_row(&r, r.search_ns);
+                    }
+                    for (int bi = 0; batch_mode && bi < cfg.nbatches; ++bi) {
+                        r.batch = cfg.batches[bi];
+                        h = run_q_csl_batch(sl, qk, nq, r.batch, &r.search_ns);
+                        r.hits = h;
+                        if (h != expected_hits) verify_ok = 0;
+                        csv_write(&r, rep, expected_hits);
+                        print_row(&r, r.search_ns);
+                    }
+                    for (int finger = 0; monotone_mode && finger <= 1; ++finger) {
+                        char name[32];
+                        snprintf(name, sizeof(name), "%s-%s", csls[vi].s, finger ? "finger" : "seek");
+                        r.structure = name;
+                        h = run_q_csl_seek(sl, qk, nq, finger, &r.search_ns);
+                        r.hits = h;
+                        if (h != expected_hits) verify_ok = 0;
+                        csv_write(&r, rep, expected_hits);
+                        print_row(&r, r.search_ns);
+                    }
+                    for (int phase = 0; delete_mode && phase <= 1; ++phase) {
+                        char name[32];
+                        snprintf(name, sizeof(name), "%s-%s", csls[vi].s, phase ? "compact" : "del");
+                        r.structure = name;
+                        double t0 = now_us();
+                        if (phase) {
+                            csl_compact(sl, 100);
+                        } else {
+                            for (int i = 0; i < ndel; ++i) csl_delete(sl, del[i], NULL);
+                        }
+                        r.prep_ms = (now_us() - t0) / 1000.0;
+                        h = run_q_csl(sl, qk, nq, &r.search_ns);
+                        r.mem_bytes = mem_csl(sl);
+                        r.keys = n - ndel;
+                        r.hits = h;
+                        if (h != expected_left) verify_ok = 0;
+                        csv_write(&r, rep, expected_left);
+                        print_row(&r, r.search_ns);
+                    }
+                    for (int li = 0; range_mode && li < cfg.nbatches; ++li) {
+                        /* q/L ranges of L keys from random positions */
+                        int len = cfg.batches[li] < n ? cfg.batches[li] : n;
+                        int nr = (nq / len > 0) ? nq / len : 1;
+                        int* lo = (int*)malloc((size_t)nr * 2 * sizeof(int));
+                        int* hi = lo + nr;
+                        for (int i = 0; i < nr; ++i) {
+                            int s0 = (int)(xrand() % (uint32_t)(n - len + 1));
+                            lo[i] = sorted[s0];
+                            hi[i] = sorted[s0 + len - 1];
+                        }
+                        static const char* how[] = { "iter", "scan", "spans" };
+                        for (int method = 0; method < 3; ++method) {
+                            char name[32];
+                            snprintf(name, sizeof(name), "%s-%s", csls[vi].s, how[method]);
+                            r.structure = name;
+                            r.batch = len;
+                            h = run_ranges(sl, lo, hi, nr, method, &r.search_ns);
+                            r.hits = h;
+                            if (h != (long)nr * len) verify_ok = 0;
+                            csv_write(&r, rep, (long)nr * len);
+                            print_row(&r, r.search_ns);
+                        }
+                        free(lo);
+                    }
+                    if (cc_mode && !csl_set_concurrent(sl, 1)) verify_ok = 0;
+                    for (int wi = 0; cc_mode && wi < cfg.nwrites; ++wi) {
+                        for (int ti = 0; ti < cfg.nbatches; ++ti) {
+                            char name[32];
+                            snprintf(name, sizeof(name), "%s-cc", csls[vi].s);
+                            r.structure = name;
+                            r.threads = cfg.batches[ti];
+                            r.write_pct = cfg.writes[wi];
+                            long want = run_cc(sl, qk, hit, nq, churn, nchurn,
+                                               r.threads, r.write_pct, &r);
+                            if (r.hits != want) verify_ok = 0;
+                            csv_write(&r, rep, want);
+                            print_row(&r, r.search_ns);
+                        }
+                    }
                     csl_free(sl, NULL);
                 }
             }
@@ -580,6 +1118,9 @@ int main(int argc, char** argv) {
         }
         free(akv);
         free(ekv);
+        free(del);
+        free(hit);
+        free(churn);
     }
 
     fclose(g_csv);
@@ -42,6 +42,10 @@ static double timer_us(void) {
 #define TEST2_N               300   /* test_eytzinger_iteration:   skiplist size */
 #define TEST3_N               200   /* test_eytzinger_seek:        skiplist size */
 #define TEST4_N               100   /* test_eytzinger_insert_delete: skiplist size */
+#define TEST6_N              5000   /* test_stree_layout:          skiplist size */
+#define TEST7_UNIVERSE       3000   /* test_insert_buffer: key range */
+#define TEST7_OPS           12000   /* test_insert_buffer: random inserts/deletes */
+#define TEST8_MAX_CAP         300   /* test_eytzinger_rank_cursor: largest block cap */
 
 #define BENCH_N            100000   /* benchmark: number of items in skiplist */
 #define BENCH_QUERIES      500000   /* benchmark: number of search queries */
@@ -60,56 +64,20 @@ static double timer_us(void) {
 
 static int failures = 0;
 
-/* ---- Build a skiplist directly (O(N), same as cache benchmark) ---- */
+/* ---- Build a skiplist of full blocks (O(N), same as cache benchmark) ---- */
 
 static cskiplist* build_skiplist(int n) {
     cskiplist* sl = csl_create();
     if (!sl) return NULL;
 
-    int cap = csl_get_block_cap(sl);
-    int nblocks = (n + cap - 1) / cap;
-    csl_block** blocks = (csl_block**)malloc(sizeof(csl_block*) * nblocks);
-
-    /* create blocks and fill with sequential keys */
-    for (int bi = 0; bi < nblocks; bi++) {
-        int start = bi * cap;
-        int end = start + cap;
-        csl_block* b = (csl_block*)calloc(1, sizeof(csl_block));
-        if (end > n) end = n;
-        if (!b) { free(blocks); csl_free(sl, NULL); return NULL; }
-        b->item_cap = cap;
-        b->skip_alloc = 1;
-        b->items = (csl_kv*)calloc((size_t)cap, sizeof(csl_kv));
-        b->next = (csl_block**)calloc(1, sizeof(csl_block*));
-        if (!b->items || !b->next) {
-            free(b->items);
-            free(b->next);
-            free(b);
-            free(blocks);
+    /* keys: 0, 2, 4, ...; appends fill each block before the next one */
+    for (int i = 0; i < n; i++) {
+        if (csl_append(sl, i * 2, (void*)(intptr_t)(i * 2 + 1)) < 0) {
             csl_free(sl, NULL);
             return NULL;
         }
-        b->count = end - start;
-        b->min_key = start * 2;  /* keys: 0, 2, 4, ... */
-        for (int j = 0; j < b->count; j++) {
-            b->items[j].key = (start + j) * 2;
-            b->items[j].val = (void*)(intptr_t)((start + j) * 2 + 1);
-        }
-        blocks[bi] = b;
-    }
-
-    /* link blocks */
-    sl->head->next[0] = blocks[0];
-    for (int bi = 0; bi < nblocks; bi++) {
-        blocks[bi]->next[0] = (bi + 1 < nblocks) ? blocks[bi + 1] : NULL;
-        blocks[bi]->prev = (bi > 0) ? blocks[bi - 1] : NULL;
     }
-    sl->nblocks = nblocks;
-    sl->size = n;
-    sl->level = 0;
     csl_rebuild_skips(sl);
-
-    free(blocks);
     return sl;
 }
 
@@ -344,6 +312,231 @@ static void test_eytzinger_edges(void) {
     PASS;
 }
 
+/* ---- Test 6: S-tree layout (csl_set_layout) ---- */
+
+/* Check search, seek and both iteration directions of sl, which holds
+ * the keys 0, 2, ..., 2*(n-1) with value key+1.  Returns 0 on failure. */
+static int check_layout(cskiplist* sl, int n) {
+    csl_iter it;
+    int exact, count, prev_key;
+
+    for (int i = 0; i < n; i++) {
+        if ((intptr_t)csl_search(sl, i * 2) != i * 2 + 1) { FAIL("layout search"); return 0; }
+        if (csl_search(sl, i * 2 + 1) != NULL) { FAIL("layout miss"); return 0; }
+    }
+    for (int i = 0; i < n; i++) {
+        /* exact seek on even keys, lower bound on odd ones */
+        csl_iter_seek(sl, i * 2, &it, &exact);
+        csl_kv* kv = csl_iter_get(&it);
+        if (!exact || !kv || kv->key != i * 2) { FAIL("layout exact seek"); return 0; }
+        int found = csl_iter_seek(sl, i * 2 - 1, &it, &exact);
+        kv = csl_iter_get(&it);
+        if (!found || exact || !kv || kv->key != i * 2) {
+            printf("  seek %d: got %d\n", i * 2 - 1, kv ? kv->key : -1);
+            FAIL("layout lower_bound"); return 0;
+        }
+    }
+    if (csl_iter_seek(sl, n * 2, &it, &exact)) { FAIL("layout seek past end"); return 0; }
+
+    count = 0; prev_key = -2;
+    if (csl_iter_first(sl, &it)) {
+        do {
+            csl_kv* kv = csl_iter_get(&it);
+            if (!kv || kv->key != prev_key + 2) { FAIL("layout forward order"); return 0; }
+            prev_key = kv->key;
+            count++;
+        } while (csl_iter_next(&it));
+    }
+    if (count != n) { printf("  forward %d of %d\n", count, n); FAIL("layout forward count"); return 0; }
+
+    count = 0; prev_key = n * 2;
+    if (csl_iter_seek(sl, (n - 1) * 2, &it, &exact)) {
+        do {
+            csl_kv* kv = csl_iter_get(&it);
+            if (!kv || kv->key != prev_key - 2) { FAIL("layout reverse order"); return 0; }
+            prev_key = kv->key;
+            count++;
+        } while (csl_iter_prev(sl, &it));
+    }
+    if (count != n) { printf("  reverse %d of %d\n", count, n); FAIL("layout reverse count"); return 0; }
+    return 1;
+}
+
+static void test_stree_layout(void) {
+    printf("Test 6: S-tree layout (search, seek, iteration, insert/delete)\n");
+    /* caps around the node size and deep trees (2048 items: 3 levels) */
+    static const int caps[] = { 2, 15, 16, 17, 100, 272, 300, 2048 };
+    int ncaps = (int)(sizeof(caps) / sizeof(caps[0]));
+
+    for (int soa = 0; soa <= 1; soa++) {
+        for (int c = 0; c < ncaps; c++) {
+            int n = TEST6_N;
+            cskiplist* sl = csl_create_with_block_cap(caps[c]);
+            if (!sl) { FAIL("create"); return; }
+            csl_set_soa(sl, soa);
+            for (int i = 0; i < n; i++) csl_append(sl, i * 2, (void*)(intptr_t)(i * 2 + 1));
+            csl_rebuild_skips(sl);
+
+            csl_set_layout(sl, CSL_LAYOUT_STREE);
+            if (!check_layout(sl, n)) {
+                printf("  cap=%d soa=%d\n", caps[c], soa); csl_free(sl, NULL); return;
+            }
+
+            /* delete the odd positions and re-insert them in the layout */
+            for (int i = 1; i < n; i += 2) csl_delete(sl, i * 2, NULL);
+            for (int i = 1; i < n; i += 2) csl_insert(sl, i * 2, (void*)(intptr_t)(i * 2 + 1));
+            if (!check_layout(sl, n)) {
+                printf("  after modify: cap=%d soa=%d\n", caps[c], soa); csl_free(sl, NULL); return;
+            }
+
+            /* switch layouts directly and back to sorted */
+            csl_set_layout(sl, CSL_LAYOUT_EYTZINGER);
+            if (!check_layout(sl, n)) { FAIL("stree -> eytzinger"); csl_free(sl, NULL); return; }
+            csl_set_layout(sl, CSL_LAYOUT_STREE);
+            csl_set_layout(sl, CSL_LAYOUT_SORTED);
+            if (!check_layout(sl, n)) { FAIL("stree -> sorted"); csl_free(sl, NULL); return; }
+            csl_free(sl, NULL);
+        }
+    }
+    PASS;
+}
+
+/* ---- Test 7: insert buffers of laid-out blocks under random writes ---- */
+
+/* Compare sl with the reference present[0..u): search, seek, and
+ * iteration in both directions.  Returns 0 on failure. */
+static int check_against(cskiplist* sl, const char* present, int u) {
+    csl_iter it;
+    int exact, prev_key = -1, count = 0, n = 0;
+
+    for (int k = 0; k < u; k++) {
+        csl_val_t v = csl_search(sl, k);
+        if (present[k] ? (intptr_t)v != k + 1 : v != NULL) { FAIL("buffered search"); return 0; }
+        n += present[k];
+    }
+    if (csl_iter_first(sl, &it)) {
+        do {
+            csl_kv* kv = csl_iter_get(&it);
+            if (!kv || kv->key <= prev_key || !present[kv->key]) { FAIL("buffered forward"); return 0; }
+            prev_key = kv->key;
+            count++;
+        } while (csl_iter_next(&it));
+    }
+    if (count != n) { FAIL("buffered forward count"); return 0; }
+    count = 0;
+    if (n > 0 && csl_iter_seek(sl, prev_key, &it, &exact)) {
+        prev_key = u;
+        do {
+            csl_kv* kv = csl_iter_get(&it);
+            if (!kv || kv->key >= prev_key || !present[kv->key]) { FAIL("buffered reverse"); return 0; }
+            prev_key = kv->key;
+            count++;
+        } while (csl_iter_prev(sl, &it));
+    }
+    if (count != n) { FAIL("buffered reverse count"); return 0; }
+    for (int k = 0; k < u; k += 7) {
+        int next = k;
+        while (next < u && !present[next]) next++;
+        int found = csl_iter_seek(sl, k, &it, &exact);
+        csl_kv* kv = found ? csl_iter_get(&it) : NULL;
+        if (next == u ? found : (!kv || kv->key != next || exact != (next == k))) {
+            FAIL("buffered seek"); return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_insert_buffer(void) {
+    printf("Test 7: Insert buffers (random inserts/deletes, %d-item buffer)\n", CSL_INSERT_BUF);
+    static const int layouts[] = { CSL_LAYOUT_EYTZINGER, CSL_LAYOUT_STREE };
+    static const int caps[] = { 16, 128 };
+    int u = TEST7_UNIVERSE;
+    char* present = (char*)malloc((size_t)u);
+    if (!present) { FAIL("malloc"); return; }
+
+    for (int li = 0; li < 2; li++) {
+        for (int soa = 0; soa <= 1; soa++) {
+            for (int c = 0; c < 2; c++) {
+                uint32_t rng = 12345u;
+                cskiplist* sl = csl_create_with_block_cap(caps[c]);
+                if (!sl) { FAIL("create"); free(present); return; }
+                csl_set_soa(sl, soa);
+                csl_set_layout(sl, layouts[li]);
+                memset(present, 0, (size_t)u);
+
+                for (int op = 1; op <= TEST7_OPS; op++) {
+                    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+                    int k = (int)(rng % (uint32_t)u);
+                    /* two inserts per delete; in the first quarter of the
+                     * operations the keys ascend and go through csl_append */
+                    if (op < TEST7_OPS / 4) k = op;
+                    int r;
+                    if (rng % 3 == 0) {
+                        r = csl_delete(sl, k, NULL);
+                        if (r != present[k]) { FAIL("buffered delete"); break; }
+                        present[k] = 0;
+                    } else {
+                        r = (op < TEST7_OPS / 4) ? csl_append(sl, k, (void*)(intptr_t)(k + 1))
+                                                 : csl_insert(sl, k, (void*)(intptr_t)(k + 1));
+                        if (r != !present[k]) { FAIL("buffered insert"); break; }
+                        present[k] = 1;
+                    }
+                    if (op % 997 == 0 && !check_against(sl, present, u)) break;
+                }
+                int ok = (failures == 0) && check_against(sl, present, u);
+                csl_free(sl, NULL);
+                if (!ok) {
+                    printf("  layout=%d soa=%d cap=%d\n", layouts[li], soa, caps[c]);
+                    free(present);
+                    return;
+                }
+            }
+        }
+    }
+    free(present);
+    PASS;
+}
+
+/* ---- Test 8: rank cursor of Eytzinger blocks ---- */
+static void test_eytzinger_rank_cursor(void) {
+    printf("Test 8: Eytzinger rank cursor (every block size up to %d)\n", TEST8_MAX_CAP);
+    for (int cap = 2; cap <= TEST8_MAX_CAP; cap++) {
+        int n = cap * 3 + cap / 2;  /* full blocks and a partial one */
+        cskiplist* sl = csl_create_with_block_cap(cap);
+        if (!sl) { FAIL("create"); return; }
+        for (int i = 0; i < n; i++) csl_append(sl, i * 2, (void*)(intptr_t)(i * 2 + 1));
+        csl_set_eytzinger(sl, 1);
+        if (!check_layout(sl, n)) { printf("  cap=%d\n", cap); csl_free(sl, NULL); return; }
+
+        /* zigzag as a connector scan does: two steps forward, one back */
+        csl_iter it;
+        int expect = 0, ok = csl_iter_first(sl, &it);
+        while (ok) {
+            csl_kv* kv = csl_iter_get(&it);
+            if (!kv || kv->key != expect * 2) {
+                printf("  cap=%d at %d\n", cap, expect);
+                FAIL("zigzag"); csl_free(sl, NULL); return;
+            }
+            if (expect % 3 == 2 && csl_iter_prev(sl, &it)) {
+                kv = csl_iter_get(&it);
+                if (!kv || kv->key != (expect - 1) * 2) { FAIL("zigzag prev"); csl_free(sl, NULL); return; }
+                csl_iter_next(&it);
+            }
+            ok = csl_iter_next(&it);
+            expect++;
+        }
+        if (expect != n) { FAIL("zigzag count"); csl_free(sl, NULL); return; }
+
+        /* a rewound iterator moves to the first item */
+        csl_iter_rewind(sl, &it);
+        if (!csl_iter_next(&it) || csl_iter_get(&it)->key != 0) {
+            FAIL("rewind"); csl_free(sl, NULL); return;
+        }
+        csl_free(sl, NULL);
+    }
+    PASS;
+}
+
 /* ---- Benchmark: sorted vs Eytzinger search ---- */
 static void benchmark(int N, int nqueries) {
     printf("\n=== Benchmark: N=%d, queries=%d, block_cap=%d ===\n", N, nqueries, CSL_BLOCK_CAP);
@@ -755,6 +948,9 @@ int main(int argc, char* argv[]) {
     test_eytzinger_seek();
     test_eytzinger_insert_delete();
     test_eytzinger_edges();
+    test_stree_layout();
+    test_insert_buffer();
+    test_eytzinger_rank_cursor();
 
     if (failures > 0) {
         printf("\n*** %d test(s) FAILED ***\n", failures);
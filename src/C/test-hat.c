@@ -16,6 +16,7 @@
 #include <string.h>
 #include "config.h"
 #include "set.h"
+#include "dataset.h"
 #include "qesa.h"
 #include "connector.h"
 #include "set2.h"
@@ -52,10 +53,10 @@ void apply_tests_to_strie_lcs( FILE *f, set2_node *st, int *add, int *skp ) {
    int d2 = *skp;
    printf("# add=%d, skp=%d\n", d1, d2);
 
-   // init main vars
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
+   // open the testset; queries are parsed directly from input
+   dataset *ds = dset_open(f);
+   if (ds == NULL)
+      return;
 
    // define time stuff
    uint64_t elap;
@@ -68,20 +69,8 @@ void apply_tests_to_strie_lcs( FILE *f, set2_node *st, int *add, int *skp ) {
    // create qesa for storing the results of queries
    void *q1 = qesa_alloc();
 
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-      // reset s1 to act as an empty set
-      set_reset(s1);
-   
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
-
-	 el = atoi(tok);
-         set_insert(s1, el);
-
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
+   // read sets from input; s1 is reset for each query
+   while (dset_read_into(ds, s1)) {
 
       // print the query
       printf("? ");
@@ -116,8 +105,7 @@ void apply_tests_to_strie_lcs( FILE *f, set2_node *st, int *add, int *skp ) {
    set_free(sp);
    
    // free allocated structures
-   free(lin);
-   free(tok);
+   dset_close(ds);
    
 } /*apply_tests_to_strie_lcs*/
 
@@ -130,10 +118,10 @@ void apply_tests_to_strie_hmg( FILE *f, set2_hat *sh, int *hmg ) {
    int d1 = *hmg;
    printf("# hamming=%d\n", d1);
 
-   // init main vars
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
+   // open the testset; queries are parsed directly from input
+   dataset *ds = dset_open(f);
+   if (ds == NULL)
+      return;
 
    // define time stuff
    uint64_t elap;
@@ -146,20 +134,8 @@ void apply_tests_to_strie_hmg( FILE *f, set2_hat *sh, int *hmg ) {
    // create qesa for storing the results of queries
    void *q1 = qesa_alloc();
 
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-      // reset s1 to act as an empty set
-      set_reset(s1);
-   
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
-
-	 el = atoi(tok);
-         set_insert(s1, el);
-
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
+   // read sets from input; s1 is reset for each query
+   while (dset_read_into(ds, s1)) {
 
       // print the query
       printf("? ");
@@ -196,8 +172,7 @@ void apply_tests_to_strie_hmg( FILE *f, set2_hat *sh, int *hmg ) {
    set_free(sp);
    
    // free allocated structures
-   free(lin);
-   free(tok);
+   dset_close(ds);
    
 } /*apply_tests_to_strie_hmg*/
 
@@ -210,11 +185,14 @@ int main( int argc, char *argv[] )
    int hmg = atoi(argv[1]);
    int part_size = atoi(argv[2]);
    char *fnam = argv[3];
+   char *tnam = (argc > 4) ? argv[4] : NULL;
 		      
-   // reading a dataset from a file
-   FILE *infile = fopen(fnam, "r");
+   // reading a dataset from a file, or from stdin if fnam is "-";
+   // then the tests are read from tnam
+   FILE *infile = (strcmp(fnam, "-") == 0) ? stdin : fopen(fnam, "rb");
    set2_hat *sh = s2h_load(infile, part_size, hmg);
-   fclose(infile);
+   if (infile != stdin) fclose(infile);
+   if (sh == NULL) return 1;
 
    // printing statistics of the lengths of sets from a dataset
    //printf("Statistics of set lengths.\n");
@@ -224,13 +202,20 @@ int main( int argc, char *argv[] )
    //printf("Print keys of a kvs (mapping).\n");
    //con_print_keys(sh->tries, stdout);
    
+   // printing the number of sets in ranges
+   //printf("Print counts of sets in ranges.\n");
+   //for (int i = 0; i < sh->nparts; i++) printf("%d ", sh->counts[i]);
+   //printf("\n");
+   
    // printing a dataset from set-trie sh
    //printf("Print sets stored in set-trie.\n");
    //s2h_store(sh, stdout);
    
    // foreach set from testset search simsets in st
    //printf("Print results of tests.\n");
-   apply_tests_to_strie_hmg(stdin, sh, &hmg);
+   FILE *testfile = (tnam != NULL) ? fopen(tnam, "rb") : stdin;
+   apply_tests_to_strie_hmg(testfile, sh, &hmg);
+   if (testfile != stdin) fclose(testfile);
    
 } /*main*/
 
@@ -240,7 +225,7 @@ int old_main( int argc, char *argv[] )
 {  
 
    printf("-------Reading a dataset from a file.\n");
-   FILE *infile = fopen(argv[1], "r");
+   FILE *infile = fopen(argv[1], "rb");
    set2_node *st = set2_load(infile);
 
    //printf("-------Printing a dataset from set-trie st.\n");
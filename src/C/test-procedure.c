@@ -9,16 +9,25 @@
  * Usage:
  *   test-procedure <datafile> [testfile] [hmg]
  *
- *   datafile  - dataset file (one set per line, space-separated ints)
+ *   datafile  - dataset file (one set per line, space-separated ints),
+ *               binary dataset, or set-trie snapshot (see snaptest)
  *   testfile  - optional query file (same format); if omitted, queries
  *               are read from stdin
  *   hmg       - Hamming distance for similarity search (default: 1)
  *
+ * The set-trie is built by num_threads() threads (environment variable
+ * SET2_THREADS, default: number of processors).  With the environment
+ * variable SET2_COMPARE_BUILD set to a nonzero value, the dataset is
+ * parsed twice more after the queries and built with set2_insert() and
+ * with the sorted-input builder ([BUILD] line); this is off by default,
+ * as it takes about twice the time of the rest on large datasets.
+ *
  * Output format:
- *   [CONFIG]  block_cap=128 simd=1
+ *   [CONFIG]  block_cap=128 simd=1 threads=8
  *   [LOAD]    sets=30 time_ms=1.234 mem_kb=456
  *   [QUERY]   qnum=1 results=3 time_us=567.8
  *   [SUMMARY] queries=3 total_ms=1.701 avg_us=567.1 mem_kb=512
+ *   [BUILD]   sets=30 insert_ms=0.321 sorted_ms=0.123 speedup=2.61 unsorted=0  (SET2_COMPARE_BUILD)
  *
  * Copyright (c) 2024-25, FAMNIT, University of Primorska
  */
@@ -31,9 +40,11 @@
 #include <malloc.h>
 #include "config.h"
 #include "set.h"
+#include "dataset.h"
 #include "qesa.h"
 #include "connector.h"
 #include "set2.h"
+#include "set2snap.h"
 #include "cskiplist.h"
 
 /* ---------- Platform-specific timing and memory ---------- */
@@ -90,13 +101,25 @@ static void print_config(void) {
 #ifdef CSL_USE_SIMD
     simd = CSL_USE_SIMD;
 #endif
-    printf("[CONFIG]  block_cap=%d simd=%d\n", block_cap, simd);
+    printf("[CONFIG]  block_cap=%d simd=%d threads=%d\n", block_cap, simd,
+           num_threads());
 }
 
 /*
- * Count lines in a file (number of sets).
+ * Count sets in a file: taken from the header of a binary dataset or
+ * the line count of a mapped text file, else counted with fgets.
+ * Returns -1 if the dataset can not be opened.
  */
-static int count_lines(FILE *f) {
+static int count_sets(FILE *f) {
+    dataset *ds = dset_open(f);
+    if (ds == NULL)
+        return -1;
+    long n = dset_nsets(ds);
+    dset_close(ds);
+    rewind(f);
+    if (n >= 0)
+        return (int)n;
+
     int count = 0;
     char buf[4096];
     while (fgets(buf, sizeof(buf), f))
@@ -107,14 +130,32 @@ static int count_lines(FILE *f) {
 
 /* ---------- Phase 1: Load dataset ---------- */
 
+/* Snapshot queried in place when the datafile is a snapshot. */
+static set2_snapshot *snap = NULL;
+
 static set2_node* load_dataset(const char *path, int *nsets, double *load_time_us) {
-    FILE *f = fopen(path, "r");
+    FILE *f = fopen(path, "rb");
     if (!f) {
         fprintf(stderr, "error: cannot open datafile '%s'\n", path);
         return NULL;
     }
 
-    *nsets = count_lines(f);
+    /* a snapshot is mapped, not built; f stays open with the mapping */
+    if (set2_snapshot_check(f)) {
+        double t0 = timer_now_us();
+        snap = set2_snapshot_open(f);
+        double t1 = timer_now_us();
+        *nsets = snap ? (int)snap->hdr->nsets : 0;
+        *load_time_us = t1 - t0;
+        return NULL;
+    }
+
+    *nsets = count_sets(f);
+    if (*nsets < 0) {
+        fprintf(stderr, "error: cannot read datafile '%s'\n", path);
+        fclose(f);
+        return NULL;
+    }
 
     double t0 = timer_now_us();
     set2_node *st = set2_load(f);
@@ -127,12 +168,13 @@ static set2_node* load_dataset(const char *path, int *nsets, double *load_time_u
 
 /* ---------- Phase 2: Run queries ---------- */
 
-static void run_queries(FILE *f, set2_node *st, int use_lcs,
-                        int hmg_dist, int skp_dist, int add_dist) {
+/* Returns 0 if the queries can not be read. */
+static int run_queries(FILE *f, set2_node *st, int use_lcs,
+                       int hmg_dist, int skp_dist, int add_dist) {
 
-    int el = -1;
-    char *lin = (char *)malloc(MAX_STRING_SIZE);
-    char *tok_buf = (char *)malloc(INIT_STRING_SIZE);
+    dataset *ds = dset_open(f);
+    if (ds == NULL)
+        return 0;
 
     set *s1 = set_alloc();
     set *sp = set_alloc();
@@ -141,21 +183,8 @@ static void run_queries(FILE *f, set2_node *st, int use_lcs,
     int qnum = 0;
     double total_query_us = 0.0;
 
-    while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-        /* skip blank lines */
-        char *trimmed = strtrm(lin);
-        if (trimmed[0] == '\0' || trimmed[0] == '\n')
-            continue;
-
-        /* parse set from line */
-        set_reset(s1);
-        char *tok = strtok(trimmed, " \n\f\r");
-        if (!tok) continue;
-        do {
-            el = atoi(tok);
-            set_insert(s1, el);
-        } while ((tok = strtok(NULL, " \n\f\r")) != NULL);
+    /* parse sets straight from the input (blank lines are skipped) */
+    while (dset_read_into(ds, s1)) {
 
         /* prepare for search */
         set_open(s1);
@@ -167,7 +196,11 @@ static void run_queries(FILE *f, set2_node *st, int use_lcs,
 
         /* timed similarity search (Hamming or LCS measure) */
         double t0 = timer_now_us();
-        if (use_lcs)
+        if (snap && use_lcs)
+            set2_snapshot_simsearch_lcs(snap, s1, sp, &skp, &add, q1);
+        else if (snap)
+            set2_snapshot_simsearch_hmg(snap, s1, sp, &hmg, q1);
+        else if (use_lcs)
             set2_simsearch_lcs(st, s1, sp, &skp, &add, q1);
         else
             set2_simsearch_hmg(st, s1, sp, &hmg, q1);
@@ -190,9 +223,75 @@ static void run_queries(FILE *f, set2_node *st, int use_lcs,
 
     set_free(s1);
     set_free(sp);
+    qesa_reset(q1);   /* results are sets of the index; not freed here */
     qesa_free(q1);
-    free(lin);
-    free(tok_buf);
+    dset_close(ds);
+    return 1;
+}
+
+/* ---------- Phase 3: Compare build paths ---------- */
+
+/*
+ * Parse a dataset into an arena; *sets gets pointers to its sets, which
+ * are views: set_free() leaves them to the arena.
+ */
+static set_arena* read_sets(const char *path, set ***sets) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    set_arena *sa = dset_load(f);
+    fclose(f);
+    if (!sa) return NULL;
+
+    *sets = (set **)malloc((sa->nsets + 1) * sizeof(set *));
+    if (!*sets) { dset_arena_free(sa); return NULL; }
+    for (long i = 0; i < sa->nsets; i++)
+        (*sets)[i] = &sa->sets[i];
+    return sa;
+}
+
+/*
+ * Build the set-trie from the same parsed sets with set2_insert() (a
+ * root-to-leaf lookup per set) and with the sorted-input builder, and
+ * report both build times. The sets are views into two arenas owned
+ * here, so the set_free() of a duplicate set by the merge of a path
+ * leaves them alone; the arenas are freed after both tries.
+ */
+static void compare_build(const char *path) {
+    set **a = NULL, **b = NULL;
+    set_arena *sa_a = read_sets(path, &a);
+    set_arena *sa_b = read_sets(path, &b);
+    if (!sa_a || !sa_b) {
+        if (sa_a) { free(a); dset_arena_free(sa_a); }
+        if (sa_b) { free(b); dset_arena_free(sa_b); }
+        return;
+    }
+    int na = (int)sa_a->nsets, nb = (int)sa_b->nsets;
+
+    double t0 = timer_now_us();
+    set2_node *st = set2_create();
+    for (int i = 0; i < na; i++) {
+        set_open(a[i]);
+        set2_insert(st, a[i]);
+    }
+    double t1 = timer_now_us();
+    set2_builder *sb = set2_build_open(set2_create());
+    for (int i = 0; i < nb; i++)
+        set2_build_insert(sb, b[i]);
+    long unsorted = sb->unsorted;
+    set2_node *sbt = set2_build_close(sb);
+    double t2 = timer_now_us();
+    set2_free(st);
+    set2_free(sbt);
+    double t3 = timer_now_us();
+
+    double ins_us = t1 - t0, srt_us = t2 - t1;
+    printf("[BUILD]   sets=%d insert_ms=%.3f sorted_ms=%.3f speedup=%.2f unsorted=%ld free_ms=%.3f\n",
+           na, ins_us / 1000.0, srt_us / 1000.0,
+           (srt_us > 0.0) ? ins_us / srt_us : 0.0, unsorted, (t3 - t2) / 1000.0);
+    free(a);
+    free(b);
+    dset_arena_free(sa_a);
+    dset_arena_free(sa_b);
 }
 
 /* ---------- Main ---------- */
@@ -207,7 +306,10 @@ int main(int argc, char *argv[])
             "  testfile  - query file (same format); stdin if omitted\n"
             "  N         - Hamming distance (default: 1)\n"
             "  hmg N     - explicit Hamming mode with distance N\n"
-            "  lcs S A   - LCS mode with skip distance S and add distance A\n",
+            "  lcs S A   - LCS mode with skip distance S and add distance A\n"
+            "\n"
+            "Environment: SET2_THREADS=N builds with N threads; SET2_COMPARE_BUILD=1\n"
+            "also times set2_insert vs. the sorted-input builder ([BUILD]).\n",
             argv[0]);
         return 1;
     }
@@ -238,7 +340,7 @@ int main(int argc, char *argv[])
     int nsets = 0;
     double load_us = 0.0;
     set2_node *st = load_dataset(datafile, &nsets, &load_us);
-    if (!st) return 1;
+    if (!st && !snap) return 1;
 
     long mem_after = get_mem_kb();
     printf("[LOAD]    sets=%d time_ms=%.3f mem_kb=%ld (delta=%ld)\n",
@@ -247,7 +349,7 @@ int main(int argc, char *argv[])
     /* Phase 2: run queries */
     FILE *qf = NULL;
     if (testfile) {
-        qf = fopen(testfile, "r");
+        qf = fopen(testfile, "rb");
         if (!qf) {
             fprintf(stderr, "error: cannot open testfile '%s'\n", testfile);
             return 1;
@@ -258,10 +360,19 @@ int main(int argc, char *argv[])
 
     printf("[MODE]    %s hmg=%d skp=%d add=%d\n",
            use_lcs ? "lcs" : "hmg", hmg_dist, skp_dist, add_dist);
-    run_queries(qf, st, use_lcs, hmg_dist, skp_dist, add_dist);
+    int ok = run_queries(qf, st, use_lcs, hmg_dist, skp_dist, add_dist);
 
     if (testfile && qf)
         fclose(qf);
+    if (!ok) {
+        fprintf(stderr, "error: cannot read queries\n");
+        return 1;
+    }
+
+    /* Phase 3: set2_insert vs. sorted-input builder, on request */
+    const char *cmp = getenv("SET2_COMPARE_BUILD");
+    if (!snap && cmp && atoi(cmp) != 0)
+        compare_build(datafile);
 
     return 0;
 }
@@ -16,6 +16,7 @@
 #include <string.h>
 #include "config.h"
 #include "set.h"
+#include "dataset.h"
 #include "qesa.h"
 #include "connector.h"
 #include "set2.h"
@@ -52,10 +53,10 @@ void apply_tests_to_strie_lcs( FILE *f, set2_node *st, int *add, int *skp ) {
    int d2 = *skp;
    printf("# add=%d, skp=%d\n", d1, d2);
 
-   // init main vars
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
+   // open the testset; queries are parsed directly from input
+   dataset *ds = dset_open(f);
+   if (ds == NULL)
+      return;
 
    // define time stuff
    uint64_t elap;
@@ -68,20 +69,8 @@ void apply_tests_to_strie_lcs( FILE *f, set2_node *st, int *add, int *skp ) {
    // create qesa for storing the results of queries
    void *q1 = qesa_alloc();
 
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-      // reset s1 to act as an empty set
-      set_reset(s1);
-   
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
-
-	 el = atoi(tok);
-         set_insert(s1, el);
-
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
+   // read sets from input; s1 is reset for each query
+   while (dset_read_into(ds, s1)) {
 
       // print the query
       printf("? ");
@@ -116,8 +105,7 @@ void apply_tests_to_strie_lcs( FILE *f, set2_node *st, int *add, int *skp ) {
    set_free(sp);
    
    // free allocated structures
-   free(lin);
-   free(tok);
+   dset_close(ds);
    
 } /*apply_tests_to_strie_lcs*/
 
@@ -130,10 +118,10 @@ void apply_tests_to_strie_hmg( FILE *f, set2_node *st, int *hmg ) {
    int d1 = *hmg;
    printf("# hamming=%d\n", d1);
 
-   // init main vars
-   int el = -1;
-   char *lin = (char *)malloc(MAX_STRING_SIZE);
-   char *tok = (char *)malloc(INIT_STRING_SIZE);
+   // open the testset; queries are parsed directly from input
+   dataset *ds = dset_open(f);
+   if (ds == NULL)
+      return;
 
    // define time stuff
    uint64_t elap;
@@ -146,20 +134,8 @@ void apply_tests_to_strie_hmg( FILE *f, set2_node *st, int *hmg ) {
    // create qesa for storing the results of queries
    void *q1 = qesa_alloc();
 
-   // read lines from input 
-   while (fgets(lin, MAX_STRING_SIZE, f) != NULL) {
-
-      // reset s1 to act as an empty set
-      set_reset(s1);
-   
-      // read next token from lin
-      tok = (char *)strtok(strtrm(lin)," \n\f\r");
-      do {
-
-	 el = atoi(tok);
-         set_insert(s1, el);
-
-      } while ((tok = (char *)strtok(NULL," \n\f\r")) != NULL);
+   // read sets from input; s1 is reset for each query
+   while (dset_read_into(ds, s1)) {
 
       // print the query
       printf("? ");
@@ -197,8 +173,7 @@ void apply_tests_to_strie_hmg( FILE *f, set2_node *st, int *hmg ) {
    set_free(sp);
    
    // free allocated structures
-   free(lin);
-   free(tok);
+   dset_close(ds);
    
 } /*apply_tests_to_strie_hmg*/
 
@@ -208,12 +183,13 @@ int main( int argc, char *argv[] )
 {  
 
    // reading a dataset from a file
-   FILE *infile = fopen(argv[2], "r");
+   FILE *infile = fopen(argv[2], "rb");
    set2_node *st = set2_load(infile);
 
    // printing a dataset from set-trie st
    //set2_store(stdout, st);
    fclose(infile);
+   if (st == NULL) return 1;
 
    // simserach params
    int hmg = atoi(argv[1]);
@@ -229,7 +205,7 @@ int old_main( int argc, char *argv[] )
 {  
 
    printf("-------Reading a dataset from a file.\n");
-   FILE *infile = fopen(argv[1], "r");
+   FILE *infile = fopen(argv[1], "rb");
    set2_node *st = set2_load(infile);
 
    //printf("-------Printing a dataset from set-trie st.\n");
@@ -11,6 +11,14 @@
  *   Compile with SIMD:    gcc -O3 -msse2 -o simd-bench.exe ...
  *   Compile without SIMD: gcc -O3 -DCSL_USE_SIMD=0 -o scalar-bench.exe ...
  *   Or use: run-simd-bench.ps1 which does both automatically.
+ *
+ * The kernels of the SIMD build are chosen at run time (scalar, SSE2,
+ * AVX2, AVX-512).  After the default table the benchmark selects each
+ * instruction set the CPU supports with csl_simd_select() and repeats the
+ * search over several block capacities, for items[] and for SoA blocks,
+ * printing lines "ISA,isa,layout,block_cap,N,nblocks,seq_ns,rnd_ns,
+ * seq_cyc,rnd_cyc".  Run it on each host class to see the gain of its
+ * widest kernels.
  *----------------------------------------------------------------------------*/
 
 #include <stdio.h>
@@ -69,57 +77,19 @@ static void shuffle(int* arr, int n) {
 }
 
 /*-----------------------------------------------------------------------------
- * Build a skip list with N sequential keys using direct block construction.
- * This is O(N) — bypasses the O(N^2) tail-walk in csl_append.
+ * Build a skip list with N sequential keys of full blocks.  Appends are
+ * O(1) (sl->tail), so the build is O(N).
  *----------------------------------------------------------------------------*/
-static cskiplist* build_skiplist(int N) {
-    cskiplist* sl = csl_create();
+static cskiplist* build_skiplist(int N, int cap) {
+    cskiplist* sl = csl_create_with_block_cap(cap);
     if (!sl) return NULL;
 
-    /* Direct block construction: allocate and fill blocks manually */
-    int block_cap = csl_get_block_cap(sl);
-    int nblocks = (N + block_cap - 1) / block_cap;
-    csl_block* prev_blk = sl->head;
-    int key = 0;
-
-    for (int bi = 0; bi < nblocks; bi++) {
-        int items_in_block = block_cap;
-        csl_block* b;
-        if (bi == nblocks - 1 && N % block_cap != 0) {
-            items_in_block = N % block_cap;
-        }
-
-        /* Allocate block with 1 skip pointer slot */
-        b = (csl_block*)calloc(1, sizeof(csl_block));
-        if (!b) { csl_free(sl, NULL); return NULL; }
-        b->item_cap = block_cap;
-        b->skip_alloc = 1;
-        b->items = (csl_kv*)calloc((size_t)block_cap, sizeof(csl_kv));
-        b->next = (csl_block**)calloc(1, sizeof(csl_block*));
-        if (!b->items || !b->next) {
-            free(b->items);
-            free(b->next);
-            free(b);
+    /* Appends fill each block before the next one */
+    for (int key = 0; key < N; key++) {
+        if (csl_append(sl, key, (csl_val_t)(intptr_t)key) < 0) {
             csl_free(sl, NULL);
             return NULL;
         }
-        b->min_key = key;
-        b->count = items_in_block;
-        b->prev = (prev_blk == sl->head) ? NULL : prev_blk;
-
-        /* Fill items with sequential keys */
-        for (int j = 0; j < items_in_block; j++) {
-            b->items[j].key = key;
-            b->items[j].val = (csl_val_t)(intptr_t)key;
-            key++;
-        }
-
-        b->next[0] = NULL;
-        prev_blk->next[0] = b;
-        prev_blk = b;
-
-        sl->nblocks++;
-        sl->size += items_in_block;
     }
 
     /* Rebuild skip pointers for O(log N) block-level search */
@@ -142,15 +112,16 @@ typedef struct {
     int search_hits;        /* number of successful searches (sanity check) */
 } simd_result;
 
-static simd_result bench_search(int N) {
+static simd_result bench_search(int N, int cap, int soa) {
     simd_result r;
     memset(&r, 0, sizeof(r));
     r.N = N;
 
     /* Build the skip list */
-    cskiplist* sl = build_skiplist(N);
-    if (!sl) {
+    cskiplist* sl = build_skiplist(N, cap);
+    if (!sl || !csl_set_soa(sl, soa)) {
         fprintf(stderr, "ERROR: build_skiplist(%d) failed\n", N);
+        if (sl) csl_free(sl, NULL);
         return r;
     }
     r.nblocks = (int)sl->nblocks;
@@ -239,7 +210,9 @@ int main(int argc, char* argv[]) {
     if (!csv_only) {
         printf("================================================================\n");
         printf("  SIMD Search Benchmark - CSL_BLOCK_CAP = %d\n", CSL_BLOCK_CAP);
-        printf("  SIMD status: %s\n", simd_enabled ? "ENABLED (SSE2)" : "DISABLED (scalar only)");
+        printf("  SIMD status: %s, kernels: %s\n",
+               simd_enabled ? "ENABLED" : "DISABLED (scalar only)",
+               csl_simd_isa_name(csl_simd_isa()));
 #if defined(CSL_SIMD_SCAN_THRESHOLD)
         printf("  SIMD scan threshold: %d items (SIMD scan if count <= this)\n",
                CSL_SIMD_SCAN_THRESHOLD);
@@ -262,7 +235,7 @@ int main(int argc, char* argv[]) {
     }
 
     for (int s = 0; s < n_sizes; s++) {
-        simd_result r = bench_search(sizes[s]);
+        simd_result r = bench_search(sizes[s], CSL_BLOCK_CAP, 0);
 
         if (!csv_only) {
             printf("%-8d %-8d %-10.1f %-10.1f %-10.1f %-10.1f %-8d\n",
@@ -277,6 +250,46 @@ int main(int argc, char* argv[]) {
                r.seq_ns, r.rnd_ns, r.seq_cyc, r.rnd_cyc);
     }
 
+    /* Per-ISA kernels: the same searches with each supported instruction
+     * set, over block capacities where the k-ary kernels take over. */
+    {
+        int best = csl_simd_isa();
+        int caps[] = { 32, 128, 512, 2048 };
+        int n_caps = sizeof(caps) / sizeof(caps[0]);
+        int N = 500000;
+
+        if (!csv_only) {
+            printf("\n=== Per-ISA kernels (N = %d) ===\n\n", N);
+            printf("%-8s %-6s %-6s %-10s %-10s %-10s %-10s\n",
+                   "ISA", "Layout", "Cap", "Seq(ns)", "Rnd(ns)", "Seq(cyc)", "Rnd(cyc)");
+            printf("%-8s %-6s %-6s %-10s %-10s %-10s %-10s\n",
+                   "------", "------", "----", "--------", "--------", "--------", "--------");
+        }
+        for (int isa = CSL_ISA_SCALAR; isa <= best; isa++) {
+            if (csl_simd_select(isa) != isa) continue;
+            for (int c = 0; c < n_caps; c++) {
+                for (int soa = 0; soa <= 1; soa++) {
+                    /* best of 3 runs: the differences are a few ns */
+                    simd_result r = bench_search(N, caps[c], soa);
+                    for (int rep = 1; rep < 3; rep++) {
+                        simd_result r2 = bench_search(N, caps[c], soa);
+                        if (r2.seq_ns < r.seq_ns) { r.seq_ns = r2.seq_ns; r.seq_cyc = r2.seq_cyc; }
+                        if (r2.rnd_ns < r.rnd_ns) { r.rnd_ns = r2.rnd_ns; r.rnd_cyc = r2.rnd_cyc; }
+                    }
+                    if (!csv_only) {
+                        printf("%-8s %-6s %-6d %-10.1f %-10.1f %-10.1f %-10.1f\n",
+                               csl_simd_isa_name(isa), soa ? "soa" : "items", caps[c],
+                               r.seq_ns, r.rnd_ns, r.seq_cyc, r.rnd_cyc);
+                    }
+                    printf("ISA,%s,%s,%d,%d,%d,%.1f,%.1f,%.1f,%.1f\n",
+                           csl_simd_isa_name(isa), soa ? "soa" : "items", caps[c],
+                           r.N, r.nblocks, r.seq_ns, r.rnd_ns, r.seq_cyc, r.rnd_cyc);
+                }
+            }
+        }
+        csl_simd_select(best);
+    }
+
     if (!csv_only) {
         printf("\n");
         printf("=== Notes ===\n");
@@ -286,7 +299,8 @@ int main(int argc, char* argv[]) {
 #else
         printf("  - SIMD (SSE2) scans 4 keys per cycle for blocks <= 32 items (default)\n");
 #endif
-        printf("  - Larger blocks use binary search with __builtin_expect hints\n");
+        printf("  - Larger blocks use branchless binary search, or k-ary search\n");
+        printf("    with AVX2 (8 pivots) / AVX-512 (16 pivots) kernels\n");
         printf("  - Compare SIMD vs SCALAR by compiling with/without -DCSL_USE_SIMD=0\n");
         printf("  - Lower ns/op = faster.  Cycles/op removes clock speed variation.\n");
         printf("\n");
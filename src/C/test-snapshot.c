@@ -0,0 +1,219 @@
+/*--------------------------------------------------------------------------
+ * test-snapshot.c — set-trie snapshot: save, map and query in place.
+ *
+ * Usage:
+ *   snaptest <datafile> <snapshot> [testfile]
+ *
+ * Builds the set-trie of datafile, saves it to snapshot, opens the
+ * snapshot and runs the queries from testfile (default: datafile)
+ * against both. The results (Hamming distance 0..3 and LCS 1/1) must be
+ * the same sets in the same order. Then damaged copies of the snapshot
+ * (cut short, sections out of place, bad offsets, nodes and links) must
+ * be rejected by set2_snapshot_open(). The snapshot file is kept and can
+ * be passed to testproc as its datafile.
+ *
+ * Copyright (c) 2024, FAMNIT, University of Primorska
+ *--------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "config.h"
+#include "set.h"
+#include "dataset.h"
+#include "qesa.h"
+#include "connector.h"
+#include "set2.h"
+#include "set2snap.h"
+
+/* MinGW's msvcrt lacks clock_gettime(); shim it as in test-set2.c. */
+#if defined(_WIN32) && !defined(CLOCK_MONOTONIC)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define CLOCK_MONOTONIC 0
+static int clock_gettime(int clk, struct timespec* ts)
+{
+   LARGE_INTEGER f, t;
+   (void)clk;
+   QueryPerformanceFrequency(&f);
+   QueryPerformanceCounter(&t);
+   ts->tv_sec  = (long)(t.QuadPart / f.QuadPart);
+   ts->tv_nsec = (long)((t.QuadPart % f.QuadPart) * 1000000000LL / f.QuadPart);
+   return 0;
+}
+#endif
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Two result lists are equal if they hold equal sets in equal order. */
+static int same_results(qesa *a, qesa *b) {
+    if (qesa_size(a) != qesa_size(b)) return 0;
+    for (int i = 0; i < qesa_size(a); i++) {
+        set *x = (set *)a->arr[i];
+        set *y = (set *)b->arr[i];
+        if (set_size(x) != set_size(y)) return 0;
+        if (memcmp(x->arr, y->arr, set_size(x) * sizeof(int)) != 0) return 0;
+    }
+    return 1;
+}
+
+/* set2_snapshot_open() on the image buf[0..len) must fail if bad is
+ * set and succeed otherwise; returns 1 if it does not. */
+static int check_image(const char *buf, size_t len, int bad, const char *what) {
+    FILE *f = tmpfile();
+    if (!f) return 1;
+    fwrite(buf, 1, len, f);
+    rewind(f);
+    set2_snapshot *ss = set2_snapshot_open(f);
+    int fail = bad ? (ss != NULL) : (ss == NULL);
+    printf("%s: open %s %s\n", fail ? "FAIL" : "PASS", bad ? "rejects" : "accepts", what);
+    set2_snapshot_close(ss);
+    fclose(f);
+    return fail;
+}
+
+/* Damage copies of the snapshot in file path; each must be rejected. */
+static int check_damaged(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 1;
+    fseek(f, 0, SEEK_END);
+    size_t len = (size_t)ftell(f);
+    rewind(f);
+    char *buf = (char *)malloc(len);
+    char *bad = (char *)malloc(len);
+    size_t got = fread(buf, 1, len, f);
+    fclose(f);
+    if (got != len) { free(buf); free(bad); return 1; }
+
+    s2s_header h;
+    memcpy(&h, buf, sizeof(h));
+    s2s_node *nodes = (s2s_node *)(bad + h.nodes_off);
+    s2s_link *links = (s2s_link *)(bad + h.links_off);
+    uint64_t *offs = (uint64_t *)(bad + h.offs_off);
+    s2s_header *hb = (s2s_header *)bad;
+    int nfail = 0;
+
+    nfail += check_image(buf, len, 0, "the snapshot");
+    nfail += check_image(buf, len - 1, 1, "a truncated snapshot");
+    memcpy(bad, buf, len);
+    hb->links_off = ~(uint64_t)0 - 7;
+    nfail += check_image(bad, len, 1, "a links section that wraps around");
+    memcpy(bad, buf, len);
+    hb->offs_off = hb->nodes_off;
+    nfail += check_image(bad, len, 1, "offsets over the nodes");
+    if (h.nsets > 0) {
+        memcpy(bad, buf, len);
+        offs[h.nsets / 2] = ~(uint64_t)0 / 2;
+        nfail += check_image(bad, len, 1, "a set offset past the elements");
+    }
+    if (h.nlinks > 0) {
+        memcpy(bad, buf, len);
+        links[h.nlinks - 1].child = 0;
+        nfail += check_image(bad, len, 1, "a link back to the root");
+        memcpy(bad, buf, len);
+        links[0].child = (uint32_t)h.nnodes;
+        nfail += check_image(bad, len, 1, "a link past the nodes");
+    }
+    for (uint64_t i = 0; i < h.nnodes; i++) {
+        memcpy(bad, buf, len);
+        if (nodes[i].flags & S2S_ISTAIL) {
+            nodes[i].b = 1u << 30;
+            nfail += check_image(bad, len, 1, "a tail cursor past its set");
+            break;
+        }
+    }
+    for (uint64_t i = 0; i < h.nnodes; i++) {
+        memcpy(bad, buf, len);
+        if (nodes[i].flags & S2S_ISSET) {
+            nodes[i].ndset = (int)h.nsets;
+            nfail += check_image(bad, len, 1, "a set index past the sets");
+            break;
+        }
+    }
+    free(buf);
+    free(bad);
+    return nfail;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <datafile> <snapshot> [testfile]\n", argv[0]);
+        return 1;
+    }
+    const char *testfile = (argc >= 4) ? argv[3] : argv[1];
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) { fprintf(stderr, "error: cannot open '%s'\n", argv[1]); return 1; }
+    double t0 = now_ms();
+    set2_node *st = set2_load(f);
+    double t1 = now_ms();
+    fclose(f);
+    if (!st) { printf("FAIL: load\n"); return 1; }
+
+    FILE *sf = fopen(argv[2], "wb");
+    if (!sf || !set2_snapshot_save(st, sf)) { printf("FAIL: save\n"); return 1; }
+    fclose(sf);
+    double t2 = now_ms();
+
+    sf = fopen(argv[2], "rb");
+    if (!sf || !set2_snapshot_check(sf)) { printf("FAIL: check\n"); return 1; }
+    double t3 = now_ms();
+    set2_snapshot *ss = set2_snapshot_open(sf);
+    double t4 = now_ms();
+    if (!ss) { printf("FAIL: open\n"); return 1; }
+
+    printf("build_ms=%.3f save_ms=%.3f open_ms=%.3f nodes=%llu links=%llu sets=%llu\n",
+           t1 - t0, t2 - t1, t4 - t3,
+           (unsigned long long)ss->hdr->nnodes, (unsigned long long)ss->hdr->nlinks,
+           (unsigned long long)ss->hdr->nsets);
+
+    FILE *qf = fopen(testfile, "rb");
+    if (!qf) { fprintf(stderr, "error: cannot open '%s'\n", testfile); return 1; }
+    dataset *ds = dset_open(qf);
+    if (!ds) { printf("FAIL: open '%s'\n", testfile); return 1; }
+    set *s1 = set_alloc();
+    set *sp = set_alloc();
+    qesa *qa = qesa_alloc();
+    qesa *qb = qesa_alloc();
+    int nq = 0, nfail = 0;
+    long nres = 0;
+
+    while (dset_read_into(ds, s1) && nq < 2000) {
+        for (int mode = 0; mode <= 4; mode++) {
+            int ha = mode, hb = mode, ka = 1, kb = 1, aa = 1, ab = 1;
+            set_open(s1); set_reset(sp); qesa_reset(qa);
+            if (mode < 4) set2_simsearch_hmg(st, s1, sp, &ha, qa);
+            else          set2_simsearch_lcs(st, s1, sp, &ka, &aa, qa);
+            set_open(s1); set_reset(sp); qesa_reset(qb);
+            if (mode < 4) set2_snapshot_simsearch_hmg(ss, s1, sp, &hb, qb);
+            else          set2_snapshot_simsearch_lcs(ss, s1, sp, &kb, &ab, qb);
+            nres += qesa_size(qa);
+            if (!same_results(qa, qb)) {
+                if (nfail < 5) {
+                    printf("FAIL: query %d mode %d: %d vs %d results\n",
+                           nq + 1, mode, qesa_size(qa), qesa_size(qb));
+                }
+                nfail++;
+            }
+        }
+        nq++;
+    }
+    printf("%s: %d queries x 5 modes, %ld results, %d mismatches\n",
+           nfail ? "FAIL" : "PASS", nq, nres, nfail);
+    int ndamaged = check_damaged(argv[2]);
+    nfail += ndamaged;
+
+    dset_close(ds);
+    fclose(qf);
+    set2_snapshot_close(ss);
+    fclose(sf);
+    set2_free(st);
+    return nfail ? 1 : 0;
+}